@@ -0,0 +1,59 @@
+#include "ButtonDebounce.h"
+
+ButtonDebounce::ButtonDebounce(uint8_t integrate, uint16_t longPress, uint16_t repeat)
+  : _integrate(integrate ? integrate : 1), _longPress(longPress), _repeat(repeat) {
+  reset();
+}
+
+void ButtonDebounce::reset() {
+  _state = 0;
+  for (uint8_t i = 0; i < BUTTON_DEBOUNCE_MAX; i++) {
+    _count[i] = 0;
+    _held[i] = 0;
+  }
+}
+
+uint8_t ButtonDebounce::tick(uint8_t pressed, ButtonGestureEvent *events) {
+  uint8_t n = 0;
+  for (uint8_t i = 0; i < BUTTON_DEBOUNCE_MAX; i++) {
+    uint8_t bit = 1 << i;
+    bool down = (_state & bit) != 0;
+    if (pressed & bit) {
+      if (_count[i] < _integrate) {
+        _count[i]++;
+      }
+    } else if (_count[i] > 0) {
+      _count[i]--;
+    }
+
+    if (!down && _count[i] == _integrate) {
+      _state |= bit;
+      _held[i] = 0;
+      events[n].button = i;
+      events[n].gesture = BUTTON_PRESS;
+      n++;
+    } else if (down && _count[i] == 0) {
+      _state &= ~bit;
+      events[n].button = i;
+      events[n].gesture = BUTTON_RELEASE;
+      n++;
+    } else if (down && _longPress) {
+      // held time counts from the debounced press and stops one past the long press
+      // when there are no repeats, so the long press fires once
+      if (_held[i] <= _longPress || _repeat) {
+        _held[i]++;
+      }
+      if (_held[i] == _longPress) {
+        events[n].button = i;
+        events[n].gesture = BUTTON_LONG_PRESS;
+        n++;
+      } else if (_repeat && _held[i] == _longPress + _repeat) {
+        _held[i] = _longPress;
+        events[n].button = i;
+        events[n].gesture = BUTTON_REPEAT;
+        n++;
+      }
+    }
+  }
+  return n;
+}
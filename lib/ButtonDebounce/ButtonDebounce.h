@@ -0,0 +1,50 @@
+#ifndef ButtonDebounce_h
+#define ButtonDebounce_h
+
+#include <stdint.h>
+
+// buttons one engine looks after, one bit each in the sampled mask
+#define BUTTON_DEBOUNCE_MAX 8
+
+enum ButtonGesture {
+  BUTTON_PRESS,         // the button went down and stayed down for the integrate time
+  BUTTON_RELEASE,       // and came back up again
+  BUTTON_LONG_PRESS,    // still held after the long press time
+  BUTTON_REPEAT         // still held, once per repeat period after the long press
+};
+
+struct ButtonGestureEvent {
+  uint8_t button;       // bit number in the sampled mask
+  uint8_t gesture;      // ButtonGesture
+};
+
+// Debounces up to 8 buttons sampled together as a bitmask on a fixed tick. Each
+// button has an integrator that counts up while its bit is set and down while
+// it is clear, the button only changes state when the count reaches the top or
+// the bottom, so a bounce has to last the whole integrate time to get through.
+// Everything is counted in ticks and there is no hardware access, the same
+// trace of masks always gives the same events.
+class ButtonDebounce {
+public:
+  // integrate: samples in a row to change state, longPress and repeat: ticks
+  // held before the long press and between repeats after it, 0 turns them off
+  ButtonDebounce(uint8_t integrate, uint16_t longPress, uint16_t repeat);
+
+  // feed one sample, bit n set means button n is pressed right now. Writes at
+  // most one event per button into events and returns how many
+  uint8_t tick(uint8_t pressed, ButtonGestureEvent *events);
+
+  // debounced state, bit n set while button n is held
+  uint8_t state() const { return _state; }
+  void reset();
+
+private:
+  uint8_t _integrate;
+  uint16_t _longPress;
+  uint16_t _repeat;
+  uint8_t _state;
+  uint8_t _count[BUTTON_DEBOUNCE_MAX];
+  uint16_t _held[BUTTON_DEBOUNCE_MAX];
+};
+
+#endif
@@ -0,0 +1,11 @@
+#include "Crc16.h"
+
+uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc) {
+  while (length--) {
+    crc ^= (uint16_t)(*data++) << 8;
+    for (uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    }
+  }
+  return crc;
+}
@@ -0,0 +1,11 @@
+#ifndef Crc16_h
+#define Crc16_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// CRC-16/CCITT-FALSE, what every record kept in flash is checked with.
+// Pass the previous result as crc to carry on over more data.
+uint16_t crc16(const uint8_t *data, size_t length, uint16_t crc = 0xFFFF);
+
+#endif
@@ -0,0 +1,19 @@
+#ifndef FlashFile_h
+#define FlashFile_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// A file the journal and the food catalog live in. Only appends, reads and
+// truncation are needed, which LittleFS does on the device and a plain file
+// does on Linux.
+class FlashFile {
+public:
+  virtual ~FlashFile() {}
+  virtual long size() = 0;
+  virtual bool read(long offset, uint8_t *buffer, size_t length) = 0;
+  virtual bool append(const uint8_t *buffer, size_t length) = 0;
+  virtual bool truncate(long size) = 0;
+};
+
+#endif
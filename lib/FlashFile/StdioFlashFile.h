@@ -0,0 +1,54 @@
+#ifndef StdioFlashFile_h
+#define StdioFlashFile_h
+
+// FlashFile on a plain POSIX file, for running the journal and the catalog
+// on Linux (the collector, or the firmware logic off the device)
+#ifndef ARDUINO
+
+#include "FlashFile.h"
+#include <stdio.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+class StdioFlashFile : public FlashFile {
+public:
+  explicit StdioFlashFile(const char *path) : _path(path) {}
+
+  long size() {
+    struct stat st;
+    return stat(_path, &st) == 0 ? (long)st.st_size : 0;
+  }
+
+  bool read(long offset, uint8_t *buffer, size_t length) {
+    FILE *f = fopen(_path, "rb");
+    if (!f) {
+      return false;
+    }
+    bool ok = fseek(f, offset, SEEK_SET) == 0 && fread(buffer, 1, length, f) == length;
+    fclose(f);
+    return ok;
+  }
+
+  bool append(const uint8_t *buffer, size_t length) {
+    FILE *f = fopen(_path, "ab");
+    if (!f) {
+      return false;
+    }
+    bool ok = fwrite(buffer, 1, length, f) == length;
+    return fclose(f) == 0 && ok;
+  }
+
+  bool truncate(long size) {
+    if (this->size() == 0 && size == 0) {
+      return true;
+    }
+    return ::truncate(_path, size) == 0;
+  }
+
+private:
+  const char *_path;
+};
+
+#endif
+
+#endif
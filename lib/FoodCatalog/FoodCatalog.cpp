@@ -0,0 +1,539 @@
+#include "FoodCatalog.h"
+#include <Crc16.h>
+#include <stdio.h>
+#include <string.h>
+
+// Header, all little endian:
+//   0  magic      "FOOD"
+//   4  version    u8
+//   5  spare      u8
+//   6  count      u16
+//   8  revision   u32, whatever the collector numbers its catalogs with
+//  12  spare      u16
+//  14  crc16      u16 over bytes 0-13
+// Record:
+//   0  id         u16
+//   2  tare       i16
+//   4  density    u16
+//   6  name       24 bytes, zero padded
+//  30  crc16      u16 over bytes 0-29
+// Records follow the header sorted by compare() on the name.
+// Id index entry, sorted by id:
+//   0  id         u16
+//   2  index      u16, position of the food in the catalog
+// then a trailer:
+//   0  magic      "FIDX"
+//   4  count      u16
+//   6  catalog    u16, crc16 of the catalog header it was built from
+//   8  records    u16, crc16 over all the records after that header
+//  10  crc16      u16 over bytes 0-9
+
+static void putLE(uint8_t *out, uint32_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; i++) {
+    out[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static uint32_t getLE(const uint8_t *in, uint8_t bytes) {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < bytes; i++) {
+    value |= (uint32_t)in[i] << (8 * i);
+  }
+  return value;
+}
+
+static char fold(char c) {
+  return (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+}
+
+FoodCatalog::FoodCatalog(FlashFile &file, FlashFile &index) : _file(file), _index(index) {
+  _count = 0;
+  _revision = 0;
+  _indexed = false;
+  _windowStart = -1;
+  _windowCount = 0;
+}
+
+bool FoodCatalog::open() {
+  _count = 0;
+  _revision = 0;
+  _indexed = false;
+  _windowStart = -1;
+  uint8_t header[FOOD_HEADER_SIZE];
+  uint16_t count;
+  uint32_t revision;
+  if (!_file.read(0, header, FOOD_HEADER_SIZE) || !decodeHeader(header, count, revision)) {
+    return false;
+  }
+  if (_file.size() != FOOD_HEADER_SIZE + (long)count * FOOD_RECORD_SIZE) {
+    return false;
+  }
+  _count = count;
+  _revision = revision;
+  _indexed = checkIndex(headerCrc(header));
+  return true;
+}
+
+bool FoodCatalog::checkIndex(uint16_t headerCrc) {
+  long entries = _count * FOOD_INDEX_ENTRY_SIZE;
+  uint8_t trailer[FOOD_INDEX_TRAILER_SIZE];
+  if (_index.size() != entries + FOOD_INDEX_TRAILER_SIZE || !_index.read(entries, trailer, FOOD_INDEX_TRAILER_SIZE)) {
+    return false;
+  }
+  if (memcmp(trailer, "FIDX", 4) || getLE(trailer + 4, 2) != (uint32_t)_count ||
+      getLE(trailer + 6, 2) != headerCrc || getLE(trailer + 10, 2) != crc16(trailer, 10)) {
+    return false;
+  }
+  uint16_t crc;
+  return recordsCrc(crc) && crc == getLE(trailer + 8, 2);
+}
+
+// a page at a time, like load()
+bool FoodCatalog::recordsCrc(uint16_t &crc) {
+  uint8_t page[FOOD_WINDOW * FOOD_RECORD_SIZE];
+  crc = 0xFFFF;
+  for (long start = 0; start < _count; start += FOOD_WINDOW) {
+    long left = _count - start;
+    size_t bytes = (left < FOOD_WINDOW ? left : FOOD_WINDOW) * FOOD_RECORD_SIZE;
+    if (!_file.read(FOOD_HEADER_SIZE + start * FOOD_RECORD_SIZE, page, bytes)) {
+      return false;
+    }
+    crc = crc16(page, bytes, crc);
+  }
+  return true;
+}
+
+bool FoodCatalog::load(long index) {
+  long start = index - index % FOOD_WINDOW;
+  if (start == _windowStart) {
+    return true;
+  }
+  _windowStart = -1;
+  long left = _count - start;
+  _windowCount = left < FOOD_WINDOW ? (uint8_t)left : FOOD_WINDOW;
+  // one read per page, decoded in place
+  uint8_t page[FOOD_WINDOW * FOOD_RECORD_SIZE];
+  if (!_file.read(FOOD_HEADER_SIZE + start * FOOD_RECORD_SIZE, page, _windowCount * FOOD_RECORD_SIZE)) {
+    return false;
+  }
+  for (uint8_t i = 0; i < _windowCount; i++) {
+    if (!decode(page + i * FOOD_RECORD_SIZE, _window[i])) {
+      return false;
+    }
+  }
+  _windowStart = start;
+  return true;
+}
+
+bool FoodCatalog::get(long index, FoodItem &item) {
+  if (index < 0 || index >= _count || !load(index)) {
+    return false;
+  }
+  item = _window[index - _windowStart];
+  return true;
+}
+
+long FoodCatalog::find(uint16_t id) {
+  // ids aren't in any order, look in the window first since it is usually the food on screen
+  if (_windowStart >= 0) {
+    for (uint8_t i = 0; i < _windowCount; i++) {
+      if (_window[i].id == id) {
+        return _windowStart + i;
+      }
+    }
+  }
+  if (!_indexed) {
+    return -1;
+  }
+  // first entry not below id, the same search as jump() over the index file
+  long low = 0;
+  long high = _count;
+  uint8_t entry[FOOD_INDEX_ENTRY_SIZE];
+  while (low < high) {
+    long middle = low + (high - low) / 2;
+    if (!_index.read(middle * FOOD_INDEX_ENTRY_SIZE, entry, FOOD_INDEX_ENTRY_SIZE)) {
+      return -1;
+    }
+    if (getLE(entry, 2) < id) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  if (low == _count || !_index.read(low * FOOD_INDEX_ENTRY_SIZE, entry, FOOD_INDEX_ENTRY_SIZE) || getLE(entry, 2) != id) {
+    return -1;
+  }
+  // the index has no CRC per entry, the record it points at has to agree
+  long index = (long)getLE(entry + 2, 2);
+  FoodItem item;
+  return get(index, item) && item.id == id ? index : -1;
+}
+
+long FoodCatalog::jump(const char *prefix) {
+  size_t length = strlen(prefix);
+  long low = 0;
+  long high = _count;
+  FoodItem item;
+  while (low < high) {
+    long middle = low + (high - low) / 2;
+    if (!get(middle, item)) {
+      return 0;
+    }
+    if (compare(item.name, prefix, length) < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  return low;
+}
+
+long FoodCatalog::nextInitial(long index) {
+  FoodItem item;
+  if (!get(index, item)) {
+    return index;
+  }
+  char next[2] = { (char)(fold(item.name[0]) + 1), 0 };
+  long found = jump(next);
+  return found < _count ? found : index;
+}
+
+long FoodCatalog::previousInitial(long index) {
+  FoodItem item;
+  if (!get(index, item)) {
+    return index;
+  }
+  char initial[2] = { item.name[0], 0 };
+  long start = jump(initial);
+  if (start < index || start == 0) {
+    return start;
+  }
+  if (!get(start - 1, item)) {
+    return start;
+  }
+  initial[0] = item.name[0];
+  return jump(initial);
+}
+
+int FoodCatalog::compare(const char *a, const char *b, size_t length) {
+  for (size_t i = 0; i < length; i++) {
+    char x = fold(a[i]);
+    char y = fold(b[i]);
+    if (x != y) {
+      return (unsigned char)x < (unsigned char)y ? -1 : 1;
+    }
+    if (!x) {
+      break;
+    }
+  }
+  return 0;
+}
+
+void FoodCatalog::encodeHeader(uint16_t count, uint32_t revision, uint8_t *out) {
+  memcpy(out, "FOOD", 4);
+  out[4] = FOOD_CATALOG_VERSION;
+  out[5] = 0;
+  putLE(out + 6, count, 2);
+  putLE(out + 8, revision, 4);
+  putLE(out + 12, 0, 2);
+  putLE(out + 14, crc16(out, 14), 2);
+}
+
+uint16_t FoodCatalog::headerCrc(const uint8_t *header) {
+  return (uint16_t)getLE(header + 14, 2);
+}
+
+bool FoodCatalog::decodeHeader(const uint8_t *in, uint16_t &count, uint32_t &revision) {
+  if (memcmp(in, "FOOD", 4) || in[4] != FOOD_CATALOG_VERSION || crc16(in, 14) != (uint16_t)getLE(in + 14, 2)) {
+    return false;
+  }
+  count = (uint16_t)getLE(in + 6, 2);
+  revision = getLE(in + 8, 4);
+  return true;
+}
+
+void FoodCatalog::encode(const FoodItem &item, uint8_t *out) {
+  putLE(out, item.id, 2);
+  putLE(out + 2, (uint16_t)item.tare, 2);
+  putLE(out + 4, item.density, 2);
+  memset(out + 6, 0, FOOD_NAME_LENGTH);
+  snprintf((char *)out + 6, FOOD_NAME_LENGTH, "%s", item.name);
+  putLE(out + 30, crc16(out, 30), 2);
+}
+
+bool FoodCatalog::decode(const uint8_t *in, FoodItem &item) {
+  if (crc16(in, 30) != (uint16_t)getLE(in + 30, 2)) {
+    return false;
+  }
+  item.id = (uint16_t)getLE(in, 2);
+  item.tare = (int16_t)getLE(in + 2, 2);
+  item.density = (uint16_t)getLE(in + 4, 2);
+  memcpy(item.name, in + 6, FOOD_NAME_LENGTH);
+  item.name[FOOD_NAME_LENGTH - 1] = 0;
+  return true;
+}
+
+FoodCatalogWriter::FoodCatalogWriter(FlashFile &file) : _file(file) {
+  _used = 0;
+  _header = false;
+  _failed = true;
+  _count = 0;
+  _written = 0;
+  _revision = 0;
+  _last[0] = 0;
+}
+
+bool FoodCatalogWriter::begin() {
+  _used = 0;
+  _header = false;
+  _count = 0;
+  _written = 0;
+  _revision = 0;
+  _last[0] = 0;
+  _failed = !_file.truncate(0);
+  return !_failed;
+}
+
+bool FoodCatalogWriter::write(const uint8_t *data, size_t length) {
+  while (length && !_failed) {
+    uint8_t want = _header ? FOOD_RECORD_SIZE : FOOD_HEADER_SIZE;
+    size_t n = want - _used;
+    if (n > length) {
+      n = length;
+    }
+    memcpy(_buffer + _used, data, n);
+    _used += n;
+    data += n;
+    length -= n;
+    if (_used == want) {
+      _failed = !take();
+      _used = 0;
+    }
+  }
+  return !_failed;
+}
+
+bool FoodCatalogWriter::take() {
+  if (!_header) {
+    if (!FoodCatalog::decodeHeader(_buffer, _count, _revision)) {
+      return false;
+    }
+    _header = true;
+    return _file.append(_buffer, FOOD_HEADER_SIZE);
+  }
+  FoodItem item;
+  if (_written == _count || !FoodCatalog::decode(_buffer, item)) {
+    return false;
+  }
+  if (_written && FoodCatalog::compare(_last, item.name, FOOD_NAME_LENGTH) > 0) {
+    return false;
+  }
+  memcpy(_last, item.name, FOOD_NAME_LENGTH);
+  _written++;
+  return _file.append(_buffer, FOOD_RECORD_SIZE);
+}
+
+bool FoodCatalogWriter::finish() {
+  return !_failed && _header && _used == 0 && _written == _count;
+}
+
+FoodIndexWriter::FoodIndexWriter(FlashFile &catalog, FlashFile &index, FlashFile &scratch)
+    : _catalog(catalog), _from(&index), _to(&scratch), _index(index), _scratch(scratch) {
+  _count = 0;
+  _headerCrc = 0;
+  _recordsCrc = 0xFFFF;
+  _next = 0;
+  _width = 0;
+  _pair = 0;
+  _outCount = 0;
+  _sorting = false;
+  _done = false;
+  _failed = true;
+}
+
+bool FoodIndexWriter::begin() {
+  _next = 0;
+  _width = FOOD_INDEX_RUN;
+  _pair = 0;
+  _outCount = 0;
+  _sorting = true;
+  _done = false;
+  _failed = true;
+  uint8_t header[FOOD_HEADER_SIZE];
+  uint16_t count;
+  uint32_t revision;
+  if (!_catalog.read(0, header, FOOD_HEADER_SIZE) || !FoodCatalog::decodeHeader(header, count, revision) ||
+      !_index.truncate(0) || !_scratch.truncate(0)) {
+    return false;
+  }
+  _count = count;
+  _headerCrc = FoodCatalog::headerCrc(header);
+  _recordsCrc = 0xFFFF;
+  // every merge pass doubles the run width and swaps the files, so the runs
+  // start in the index if the number of passes is even
+  uint8_t passes = 0;
+  for (long width = FOOD_INDEX_RUN; width < _count; width *= 2) {
+    passes++;
+  }
+  _to = passes % 2 ? &_scratch : &_index;
+  _from = passes % 2 ? &_index : &_scratch;
+  _failed = false;
+  return true;
+}
+
+bool FoodIndexWriter::poll() {
+  if (_done || _failed) {
+    return false;
+  }
+  _failed = !(_sorting ? sortRun() : merge());
+  return !_done && !_failed;
+}
+
+bool FoodIndexWriter::sortRun() {
+  uint32_t run[FOOD_INDEX_RUN];
+  uint8_t page[FOOD_WINDOW * FOOD_RECORD_SIZE];
+  uint8_t length = 0;
+  while (length < FOOD_INDEX_RUN && _next < _count) {
+    long left = _count - _next;
+    uint8_t n = left < FOOD_WINDOW ? (uint8_t)left : FOOD_WINDOW;
+    if (!_catalog.read(FOOD_HEADER_SIZE + _next * FOOD_RECORD_SIZE, page, n * FOOD_RECORD_SIZE)) {
+      return false;
+    }
+    _recordsCrc = crc16(page, n * FOOD_RECORD_SIZE, _recordsCrc);
+    for (uint8_t i = 0; i < n; i++) {
+      FoodItem item;
+      if (!FoodCatalog::decode(page + i * FOOD_RECORD_SIZE, item)) {
+        return false;
+      }
+      // id in the high half so sorting the entries sorts by id
+      uint32_t entry = ((uint32_t)item.id << 16) | (uint16_t)(_next + i);
+      uint8_t j = length++;
+      for (; j > 0 && run[j - 1] > entry; j--) {
+        run[j] = run[j - 1];
+      }
+      run[j] = entry;
+    }
+    _next += n;
+  }
+  for (uint8_t i = 0; i < length; i++) {
+    if (!put(run[i])) {
+      return false;
+    }
+  }
+  if (!flushOut()) {
+    return false;
+  }
+  if (_next < _count) {
+    return true;
+  }
+  _sorting = false;
+  return startPass();
+}
+
+bool FoodIndexWriter::startPass() {
+  if (_width >= _count) {
+    return writeTrailer();
+  }
+  FlashFile *swap = _from;
+  _from = _to;
+  _to = swap;
+  _pair = 0;
+  _left.end = _left.pos = 0;
+  _right.end = _right.pos = 0;
+  _left.have = _left.at = _right.have = _right.at = 0;
+  return _to->truncate(0);
+}
+
+bool FoodIndexWriter::merge() {
+  for (uint8_t emitted = 0; emitted < FOOD_INDEX_RUN; emitted++) {
+    if (_left.pos == _left.end && _left.at == _left.have && _right.pos == _right.end && _right.at == _right.have) {
+      if (_pair >= _count) {
+        if (!flushOut()) {
+          return false;
+        }
+        _width *= 2;
+        return startPass();
+      }
+      _left.pos = _pair;
+      _left.end = _pair + _width < _count ? _pair + _width : _count;
+      _right.pos = _left.end;
+      _right.end = _left.end + _width < _count ? _left.end + _width : _count;
+      _left.have = _left.at = _right.have = _right.at = 0;
+      _pair = _right.end;
+    }
+    uint32_t left;
+    uint32_t right;
+    bool fromLeft = head(_left, left);
+    bool fromRight = head(_right, right);
+    if (_failed) {
+      return false;
+    }
+    if (fromLeft && fromRight) {
+      fromLeft = left <= right;
+    }
+    if (fromLeft) {
+      _left.at++;
+    } else {
+      _right.at++;
+    }
+    if (!put(fromLeft ? left : right)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool FoodIndexWriter::head(Input &in, uint32_t &entry) {
+  if (in.at == in.have) {
+    if (in.pos == in.end) {
+      return false;
+    }
+    long left = in.end - in.pos;
+    in.have = left < FOOD_INDEX_BUFFER ? (uint8_t)left : FOOD_INDEX_BUFFER;
+    in.at = 0;
+    uint8_t bytes[FOOD_INDEX_BUFFER * FOOD_INDEX_ENTRY_SIZE];
+    if (!_from->read(in.pos * FOOD_INDEX_ENTRY_SIZE, bytes, in.have * FOOD_INDEX_ENTRY_SIZE)) {
+      _failed = true;
+      in.have = 0;
+      in.pos = in.end;
+      return false;
+    }
+    for (uint8_t i = 0; i < in.have; i++) {
+      const uint8_t *b = bytes + i * FOOD_INDEX_ENTRY_SIZE;
+      in.buf[i] = (getLE(b, 2) << 16) | getLE(b + 2, 2);
+    }
+    in.pos += in.have;
+  }
+  entry = in.buf[in.at];
+  return true;
+}
+
+bool FoodIndexWriter::put(uint32_t entry) {
+  _out[_outCount++] = entry;
+  return _outCount < FOOD_INDEX_BUFFER || flushOut();
+}
+
+bool FoodIndexWriter::flushOut() {
+  uint8_t bytes[FOOD_INDEX_BUFFER * FOOD_INDEX_ENTRY_SIZE];
+  for (uint8_t i = 0; i < _outCount; i++) {
+    putLE(bytes + i * FOOD_INDEX_ENTRY_SIZE, _out[i] >> 16, 2);
+    putLE(bytes + i * FOOD_INDEX_ENTRY_SIZE + 2, _out[i] & 0xFFFF, 2);
+  }
+  uint8_t n = _outCount;
+  _outCount = 0;
+  return !n || _to->append(bytes, n * FOOD_INDEX_ENTRY_SIZE);
+}
+
+bool FoodIndexWriter::writeTrailer() {
+  uint8_t trailer[FOOD_INDEX_TRAILER_SIZE];
+  memcpy(trailer, "FIDX", 4);
+  putLE(trailer + 4, (uint32_t)_count, 2);
+  putLE(trailer + 6, _headerCrc, 2);
+  putLE(trailer + 8, _recordsCrc, 2);
+  putLE(trailer + 10, crc16(trailer, 10), 2);
+  if (!_index.append(trailer, FOOD_INDEX_TRAILER_SIZE) || !_scratch.truncate(0)) {
+    return false;
+  }
+  _done = true;
+  return true;
+}
@@ -0,0 +1,147 @@
+#ifndef FoodCatalog_h
+#define FoodCatalog_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <FlashFile.h>
+
+// bytes at the start of the catalog file, see FoodCatalog.cpp for the layout
+#define FOOD_HEADER_SIZE 16
+// bytes per food on flash
+#define FOOD_RECORD_SIZE 32
+// longest name, plus the terminator
+#define FOOD_NAME_LENGTH 24
+// foods held in RAM at a time, the catalog is read a page of this many at a time
+#define FOOD_WINDOW 8
+#define FOOD_CATALOG_VERSION 1
+// bytes per id index entry and of the trailer after them
+#define FOOD_INDEX_ENTRY_SIZE 4
+#define FOOD_INDEX_TRAILER_SIZE 12
+// ids sorted in RAM at a time while the index is built, and merged per poll()
+#define FOOD_INDEX_RUN 64
+#define FOOD_INDEX_BUFFER 16
+
+struct FoodItem {
+  uint16_t id;                    // what readings carry, stays the same when the catalog is reordered
+  int16_t tare;                   // grams of the container it is kept in, 0 if none
+  uint16_t density;               // grams per litre, 0 if unknown
+  char name[FOOD_NAME_LENGTH];
+};
+
+// Read only food list kept in a file sorted by name, so the position in the
+// file is the index for paging and a binary search finds a prefix. Only a
+// window of FOOD_WINDOW foods is in RAM whatever the size of the catalog.
+// The file is replaced as a whole by FoodCatalogWriter, the same bytes are
+// what the collector serves, so an update is a download checked on the way in.
+// A second file holds the ids sorted with their index, written by
+// FoodIndexWriter, so find() is a binary search too. Its trailer carries a CRC
+// over all the records it was built from, open() reads the catalog once to
+// check it, so an index is only used with the very records it points into.
+class FoodCatalog {
+public:
+  FoodCatalog(FlashFile &file, FlashFile &index);
+  bool open();                                   // false if the file is missing or damaged, the catalog is then empty
+  long count() const { return _count; }
+  uint32_t revision() const { return _revision; }
+  bool indexed() const { return _indexed; }      // the id index is there and belongs to this catalog
+
+  bool get(long index, FoodItem &item);          // foods in name order
+  long find(uint16_t id);                        // index of a food by id, -1 if there is none or no index
+  long jump(const char *prefix);                 // first food at or after prefix, ignoring case
+  long nextInitial(long index);                  // first food starting with a later letter, or index if none
+  long previousInitial(long index);              // start of this letter, or of the letter before if already there
+
+  static void encodeHeader(uint16_t count, uint32_t revision, uint8_t *out);
+  static bool decodeHeader(const uint8_t *in, uint16_t &count, uint32_t &revision);
+  static void encode(const FoodItem &item, uint8_t *out);
+  static bool decode(const uint8_t *in, FoodItem &item);    // false on a bad CRC
+  static int compare(const char *a, const char *b, size_t length);   // like strncmp without case
+  static uint16_t headerCrc(const uint8_t *header);   // what ties an id index to the catalog it was built for
+
+private:
+  bool load(long index);
+  bool checkIndex(uint16_t headerCrc);
+  bool recordsCrc(uint16_t &crc);
+  FlashFile &_file;
+  FlashFile &_index;
+  long _count;
+  uint32_t _revision;
+  bool _indexed;
+  long _windowStart;              // index of _window[0], -1 when nothing is loaded
+  uint8_t _windowCount;
+  FoodItem _window[FOOD_WINDOW];
+};
+
+// Takes a new catalog file in chunks of any size, as it comes off the network,
+// and writes it out only if the header checks out, every record has a good CRC
+// and the names are in order. finish() says if the file is complete, a caller
+// then swaps it in for the old one.
+class FoodCatalogWriter {
+public:
+  explicit FoodCatalogWriter(FlashFile &file);
+  bool begin();                                  // empties the file
+  bool write(const uint8_t *data, size_t length);   // false as soon as something is wrong
+  bool finish();
+  uint32_t revision() const { return _revision; }
+
+private:
+  bool take();
+  FlashFile &_file;
+  uint8_t _buffer[FOOD_RECORD_SIZE];
+  uint8_t _used;
+  bool _header;                   // header seen
+  bool _failed;
+  uint16_t _count;
+  uint16_t _written;
+  uint32_t _revision;
+  char _last[FOOD_NAME_LENGTH];
+};
+
+// Builds the id index of a catalog file a bounded piece per poll(), so sorting
+// thousands of ids neither holds up loop() for long nor needs more than about
+// a kilobyte of RAM. Runs of FOOD_INDEX_RUN ids are sorted in RAM, then merged
+// pairwise between the index and a scratch file until one run is left, starting
+// in whichever file makes the last pass land in the index.
+class FoodIndexWriter {
+public:
+  FoodIndexWriter(FlashFile &catalog, FlashFile &index, FlashFile &scratch);
+  bool begin();                                  // reads the catalog header and empties both files
+  bool poll();                                   // true while there is more to do
+  bool finish() const { return _done && !_failed; }
+
+private:
+  struct Input {
+    long pos;                     // next entry to read into buf
+    long end;
+    uint8_t have;
+    uint8_t at;
+    uint32_t buf[FOOD_INDEX_BUFFER];
+  };
+  bool sortRun();
+  bool merge();
+  bool startPass();
+  bool head(Input &in, uint32_t &entry);
+  bool put(uint32_t entry);
+  bool flushOut();
+  bool writeTrailer();
+  FlashFile &_catalog;
+  FlashFile *_from;
+  FlashFile *_to;
+  FlashFile &_index;
+  FlashFile &_scratch;
+  long _count;
+  uint16_t _headerCrc;
+  uint16_t _recordsCrc;           // running CRC over the records sorted so far
+  long _next;                     // next food to sort into a run
+  long _width;                    // entries per run in _from
+  long _pair;                     // first entry of the runs being merged
+  Input _left;
+  Input _right;
+  uint8_t _outCount;
+  uint32_t _out[FOOD_INDEX_BUFFER];
+  bool _sorting;
+  bool _done;
+  bool _failed;
+};
+
+#endif
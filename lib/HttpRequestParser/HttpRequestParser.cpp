@@ -0,0 +1,180 @@
+#include "HttpRequestParser.h"
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+HttpRequestParser::HttpRequestParser() {
+  reset();
+}
+
+void HttpRequestParser::reset() {
+  _state = REQUEST_LINE;
+  _lineLen = 0;
+  _lineCut = false;
+  _method[0] = 0;
+  _path[0] = 0;
+  _query[0] = 0;
+  _body[0] = 0;
+  _bodyLength = 0;
+  _contentLength = 0;
+  _keepAlive = true;
+  _error = 0;
+}
+
+HttpRequestParser::Result HttpRequestParser::result() const {
+  if (_state == DONE) {
+    return COMPLETE;
+  }
+  return _state == ERROR ? FAILED : INCOMPLETE;
+}
+
+HttpRequestParser::Result HttpRequestParser::feed(char c) {
+  if (_state == DONE || _state == ERROR) {
+    return result();
+  }
+  if (_state == BODY) {
+    _body[_bodyLength++] = c;
+    _body[_bodyLength] = 0;
+    if ((long)_bodyLength == _contentLength) {
+      _state = DONE;
+    }
+    return result();
+  }
+  if (c == '\r') {
+    return INCOMPLETE;
+  }
+  if (c == '\n') {
+    line();
+    _lineLen = 0;
+    _lineCut = false;
+    return result();
+  }
+  if (_lineLen < HTTP_LINE_SIZE - 1) {
+    _line[_lineLen++] = c;
+  } else {
+    _lineCut = true;
+  }
+  return INCOMPLETE;
+}
+
+void HttpRequestParser::line() {
+  _line[_lineLen] = 0;
+  if (_state == REQUEST_LINE) {
+    if (_lineLen > 0) {       // blank lines before a request are allowed
+      requestLine();
+    }
+    return;
+  }
+  if (_lineLen > 0) {
+    header();
+    return;
+  }
+  // blank line, end of the headers
+  if (_contentLength > HTTP_BODY_SIZE) {
+    fail(413);
+  } else {
+    _state = _contentLength > 0 ? BODY : DONE;
+  }
+}
+
+// METHOD SP target SP HTTP/1.x
+void HttpRequestParser::requestLine() {
+  if (_lineCut) {
+    fail(414);
+    return;
+  }
+  char *target = strchr(_line, ' ');
+  char *version = target ? strchr(target + 1, ' ') : 0;
+  if (!version || target - _line >= HTTP_METHOD_SIZE || strncmp(version + 1, "HTTP/1.", 7)) {
+    fail(400);
+    return;
+  }
+  *target++ = 0;
+  *version++ = 0;
+  strcpy(_method, _line);
+  _keepAlive = version[7] != '0';        // 1.1 keeps the connection by default, 1.0 doesn't
+  char *query = strchr(target, '?');
+  if (query) {
+    *query++ = 0;
+    if (strlen(query) >= HTTP_QUERY_SIZE) {
+      fail(414);
+      return;
+    }
+    strcpy(_query, query);
+  }
+  if (strlen(target) >= HTTP_PATH_SIZE) {
+    fail(414);
+    return;
+  }
+  strcpy(_path, target);
+  _state = HEADERS;
+}
+
+void HttpRequestParser::header() {
+  char *value = strchr(_line, ':');
+  if (!value) {
+    return;
+  }
+  *value++ = 0;
+  while (*value == ' ') {
+    value++;
+  }
+  if (!strcasecmp(_line, "Content-Length")) {
+    _contentLength = atol(value);
+  } else if (!strcasecmp(_line, "Connection")) {
+    _keepAlive = strcasecmp(value, "close") != 0;
+  } else if (!strcasecmp(_line, "Transfer-Encoding")) {
+    fail(501);            // no chunked request bodies
+  }
+}
+
+void HttpRequestParser::fail(int status) {
+  _state = ERROR;
+  _error = status;
+  _keepAlive = false;
+}
+
+static int hexDigit(char c) {
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  if (c >= 'A' && c <= 'F') {
+    return c - 'A' + 10;
+  }
+  return -1;
+}
+
+bool HttpRequestParser::param(const char *name, char *out, size_t size) const {
+  return findParam(_query, name, out, size) || findParam(_body, name, out, size);
+}
+
+bool HttpRequestParser::findParam(const char *from, const char *name, char *out, size_t size) {
+  size_t nameLen = strlen(name);
+  while (*from) {
+    if (!strncmp(from, name, nameLen) && from[nameLen] == '=') {
+      from += nameLen + 1;
+      size_t n = 0;
+      while (*from && *from != '&' && n + 1 < size) {
+        char c = *from++;
+        if (c == '+') {
+          c = ' ';
+        } else if (c == '%' && hexDigit(from[0]) >= 0 && hexDigit(from[1]) >= 0) {
+          c = (char)(hexDigit(from[0]) * 16 + hexDigit(from[1]));
+          from += 2;
+        }
+        out[n++] = c;
+      }
+      out[n] = 0;
+      return true;
+    }
+    from = strchr(from, '&');
+    if (!from) {
+      break;
+    }
+    from++;
+  }
+  return false;
+}
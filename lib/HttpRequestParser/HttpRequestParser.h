@@ -0,0 +1,63 @@
+#ifndef HttpRequestParser_h
+#define HttpRequestParser_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// longest method, path and query string taken, longer ones are refused with 414
+#define HTTP_METHOD_SIZE 8
+#define HTTP_PATH_SIZE 32
+#define HTTP_QUERY_SIZE 48
+// request line and header lines are read through this, longer header lines are cut off
+#define HTTP_LINE_SIZE 96
+// largest body taken, anything bigger is refused with 413
+#define HTTP_BODY_SIZE 64
+
+// Incremental HTTP/1.x request parser with fixed buffers, fed one byte at a time
+// as it comes off the socket. Only the request line, Content-Length and
+// Connection are looked at, everything else is skipped. Once feed() has said
+// COMPLETE the request stays readable until reset(). Plain C++, no Arduino.
+class HttpRequestParser {
+public:
+  enum Result { INCOMPLETE, COMPLETE, FAILED };
+
+  HttpRequestParser();
+  void reset();
+  Result feed(char c);
+  Result result() const;
+
+  const char *method() const { return _method; }
+  const char *path() const { return _path; }
+  const char *query() const { return _query; }
+  const char *body() const { return _body; }
+  size_t bodyLength() const { return _bodyLength; }
+  bool keepAlive() const { return _keepAlive; }
+  int error() const { return _error; }           // status to answer a FAILED request with
+  bool started() const { return _state != REQUEST_LINE || _lineLen > 0; }
+
+  // value of name=value from the query string or a form body, %XX and + decoded
+  bool param(const char *name, char *out, size_t size) const;
+
+private:
+  void line();
+  void requestLine();
+  void header();
+  void fail(int status);
+  static bool findParam(const char *from, const char *name, char *out, size_t size);
+
+  enum State { REQUEST_LINE, HEADERS, BODY, DONE, ERROR };
+  State _state;
+  char _line[HTTP_LINE_SIZE];
+  uint8_t _lineLen;
+  bool _lineCut;          // the current line didn't fit in _line
+  char _method[HTTP_METHOD_SIZE];
+  char _path[HTTP_PATH_SIZE];
+  char _query[HTTP_QUERY_SIZE];
+  char _body[HTTP_BODY_SIZE + 1];
+  size_t _bodyLength;
+  long _contentLength;
+  bool _keepAlive;
+  int _error;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "ReadingJournal.h"
+#include <Crc16.h>
+
+// Record layout, all little endian:
+//   0  seq        u32
+//   4  timestamp  u64
+//  12  weight     i32
+//  16  food       u16
+//  18  flags      u8
+//  19  spare      u8
+//  20  crc16      u16 over bytes 0-19
+// Cursor entry:
+//   0  offset     u32
+//   4  next seq   u32
+//   8  crc16      u16 over bytes 0-7
+//  10  spare      u16
+
+static void putLE(uint8_t *out, uint64_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; i++) {
+    out[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static uint64_t getLE(const uint8_t *in, uint8_t bytes) {
+  uint64_t value = 0;
+  for (uint8_t i = 0; i < bytes; i++) {
+    value |= (uint64_t)in[i] << (8 * i);
+  }
+  return value;
+}
+
+ReadingJournal::ReadingJournal(FlashFile &log, FlashFile &cursor)
+  : _log(log), _cursor(cursor) {
+  _end = 0;
+  _acked = 0;
+  _handed = 0;
+  _nextSeq = 0;
+}
+
+bool ReadingJournal::open() {
+  // everything up to the first record that doesn't check out survived, the rest goes
+  uint8_t buffer[JOURNAL_RECORD_SIZE];
+  JournalRecord record;
+  long size = _log.size();
+  _end = 0;
+  _nextSeq = 0;
+  while (_end + JOURNAL_RECORD_SIZE <= size && _log.read(_end, buffer, JOURNAL_RECORD_SIZE) && decode(buffer, record)) {
+    _nextSeq = record.seq + 1;
+    _end += JOURNAL_RECORD_SIZE;
+  }
+  if (_end != size && !_log.truncate(_end)) {
+    return false;
+  }
+
+  // the last good cursor entry wins
+  uint8_t entry[JOURNAL_CURSOR_SIZE];
+  long cursorSize = _cursor.size();
+  long good = 0;
+  _acked = 0;
+  uint32_t cursorSeq = 0;
+  while (good + JOURNAL_CURSOR_SIZE <= cursorSize && _cursor.read(good, entry, JOURNAL_CURSOR_SIZE)
+         && crc16(entry, 8) == (uint16_t)getLE(entry + 8, 2)) {
+    _acked = (long)getLE(entry, 4);
+    cursorSeq = (uint32_t)getLE(entry + 4, 4);
+    good += JOURNAL_CURSOR_SIZE;
+  }
+  if (cursorSeq > _nextSeq) {
+    _nextSeq = cursorSeq;
+  }
+  if (good != cursorSize && !_cursor.truncate(good)) {
+    return false;
+  }
+  if (_acked > _end || _acked % JOURNAL_RECORD_SIZE) {
+    _acked = 0;       // can't trust it, replaying everything is the safe side
+  }
+  _handed = _acked;
+  if (good == 0) {
+    // a fresh or wiped cursor gets its first entry now, writeCursor() never drops that one
+    return writeCursor(0);
+  }
+  return true;
+}
+
+bool ReadingJournal::append(JournalRecord &record) {
+  if (_end + JOURNAL_RECORD_SIZE > JOURNAL_MAX_BYTES) {
+    return false;
+  }
+  uint8_t buffer[JOURNAL_RECORD_SIZE];
+  record.seq = _nextSeq;
+  encode(record, buffer);
+  if (!_log.append(buffer, JOURNAL_RECORD_SIZE)) {
+    // a partial write is cut off by the next open()
+    return false;
+  }
+  _nextSeq++;
+  _end += JOURNAL_RECORD_SIZE;
+  return true;
+}
+
+uint8_t ReadingJournal::peek(JournalRecord *records, uint8_t max) {
+  uint8_t buffer[JOURNAL_RECORD_SIZE];
+  uint8_t count = 0;
+  while (count < max && _handed < _end) {
+    if (!_log.read(_handed, buffer, JOURNAL_RECORD_SIZE) || !decode(buffer, records[count])) {
+      break;
+    }
+    _handed += JOURNAL_RECORD_SIZE;
+    count++;
+  }
+  return count;
+}
+
+bool ReadingJournal::ack(uint8_t count) {
+  // only what peek() handed out can have been delivered
+  _acked += (long)count * JOURNAL_RECORD_SIZE;
+  if (_acked > _handed) {
+    _acked = _handed;
+  }
+  if (_end == 0) {
+    return true;
+  }
+  if (_acked == _end) {
+    // all delivered, start the log over. The cursor entry with the next seq goes in
+    // before the records go, so a reset in between replays records the collector
+    // already has (it drops them by seq) and never hands out a seq twice
+    if (!writeCursor(0) || !_log.truncate(0)) {
+      return false;
+    }
+    _end = 0;
+    _acked = 0;
+    _handed = 0;
+    return true;
+  }
+  return writeCursor(_acked);
+}
+
+void ReadingJournal::rewind() {
+  _handed = _acked;
+}
+
+bool ReadingJournal::writeCursor(long offset) {
+  if (_cursor.size() >= (long)JOURNAL_CURSOR_SIZE * JOURNAL_CURSOR_ENTRIES) {
+    // keep only the first entry, offset 0 from open(). A reset before the new entry
+    // lands replays from the start, and the log still holds the seq because this
+    // only happens while there are records
+    if (!_cursor.truncate(JOURNAL_CURSOR_SIZE)) {
+      return false;
+    }
+  }
+  uint8_t entry[JOURNAL_CURSOR_SIZE];
+  putLE(entry, (uint32_t)offset, 4);
+  putLE(entry + 4, _nextSeq, 4);
+  putLE(entry + 8, crc16(entry, 8), 2);
+  putLE(entry + 10, 0, 2);
+  return _cursor.append(entry, JOURNAL_CURSOR_SIZE);
+}
+
+void ReadingJournal::encode(const JournalRecord &record, uint8_t *out) {
+  putLE(out, record.seq, 4);
+  putLE(out + 4, record.timestamp, 8);
+  putLE(out + 12, (uint32_t)record.weight, 4);
+  putLE(out + 16, record.food, 2);
+  out[18] = record.flags;
+  out[19] = 0;
+  putLE(out + 20, crc16(out, 20), 2);
+}
+
+bool ReadingJournal::decode(const uint8_t *in, JournalRecord &record) {
+  if (crc16(in, 20) != (uint16_t)getLE(in + 20, 2)) {
+    return false;
+  }
+  record.seq = (uint32_t)getLE(in, 4);
+  record.timestamp = getLE(in + 4, 8);
+  record.weight = (int32_t)(uint32_t)getLE(in + 12, 4);
+  record.food = (uint16_t)getLE(in + 16, 2);
+  record.flags = in[18];
+  return true;
+}
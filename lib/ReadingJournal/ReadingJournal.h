@@ -0,0 +1,58 @@
+#ifndef ReadingJournal_h
+#define ReadingJournal_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <FlashFile.h>
+
+// bytes per record on flash, see ReadingJournal.cpp for the layout
+#define JOURNAL_RECORD_SIZE 22
+// bytes per entry in the cursor file
+#define JOURNAL_CURSOR_SIZE 12
+// the cursor file is rewritten from scratch once it holds this many entries
+#define JOURNAL_CURSOR_ENTRIES 64
+// refuse new readings once the journal is this big, about 3000 of them
+#define JOURNAL_MAX_BYTES 65516L
+
+// one reading as it is kept in the journal
+struct JournalRecord {
+  uint32_t seq;         // increases by one per reading, lets the collector drop replays
+  uint64_t timestamp;   // ms when the reading was taken
+  int32_t weight;       // grams
+  uint16_t food;        // food catalog id
+  uint8_t flags;        // up to the application, the scale keeps READING_EPOCH here
+};
+
+// Durable append-only queue of readings. Records are fixed size with a CRC so
+// a record cut short by power loss is found and dropped by open(). A second file
+// holds the cursor, how far the collector has acknowledged, also as appended
+// CRC'd entries, together with the next sequence number so it survives the
+// journal being emptied. Once everything is acknowledged the log starts over.
+// The cursor file always holds a valid entry and rolls over to its first one.
+// Delivery is at least once: power loss between a post and its ack replays it.
+class ReadingJournal {
+public:
+  ReadingJournal(FlashFile &log, FlashFile &cursor);
+  bool open();                                   // recover after a reset, call before anything else
+  bool append(JournalRecord &record);            // assigns record.seq, false when the journal is full
+  uint8_t peek(JournalRecord *records, uint8_t max);   // oldest records not yet handed out, without removing them
+  bool ack(uint8_t count);                       // the oldest count records handed out reached the collector
+  void rewind();                                 // hand out everything unacknowledged again, a failed record keeps its place and seq
+  long unacked() const { return (_end - _acked) / JOURNAL_RECORD_SIZE; }
+  long unsent() const { return (_end - _handed) / JOURNAL_RECORD_SIZE; }
+  uint32_t nextSeq() const { return _nextSeq; }
+
+  static void encode(const JournalRecord &record, uint8_t *out);
+  static bool decode(const uint8_t *in, JournalRecord &record);   // false on a bad CRC
+
+private:
+  bool writeCursor(long offset);
+  FlashFile &_log;
+  FlashFile &_cursor;
+  long _end;          // bytes of valid records
+  long _acked;        // everything before this has been acknowledged
+  long _handed;       // everything before this has been handed out by peek()
+  uint32_t _nextSeq;
+};
+
+#endif
@@ -0,0 +1,172 @@
+#include "TelemetryCodec.h"
+
+// Record layout, all little endian:
+//   0  version    u8
+//   1  seq        u32
+//   5  timestamp  u64
+//  13  weight     i32
+//  17  food       u16
+//  19  flags      u8
+
+#define CBOR_UNSIGNED 0
+#define CBOR_NEGATIVE 1
+#define CBOR_ARRAY 4
+#define CBOR_MAP 5
+
+static void putLE(uint8_t *out, uint64_t value, uint8_t bytes) {
+  for (uint8_t i = 0; i < bytes; i++) {
+    out[i] = (uint8_t)(value >> (8 * i));
+  }
+}
+
+static uint64_t getLE(const uint8_t *in, uint8_t bytes) {
+  uint64_t value = 0;
+  for (uint8_t i = 0; i < bytes; i++) {
+    value |= (uint64_t)in[i] << (8 * i);
+  }
+  return value;
+}
+
+size_t TelemetryCodec::encodeRecord(const TelemetryReading &reading, uint8_t *out) {
+  out[0] = TELEMETRY_RECORD_VERSION;
+  putLE(out + 1, reading.seq, 4);
+  putLE(out + 5, reading.timestamp, 8);
+  putLE(out + 13, (uint32_t)reading.weight, 4);
+  putLE(out + 17, reading.food, 2);
+  out[19] = reading.flags;
+  return TELEMETRY_RECORD_SIZE;
+}
+
+size_t TelemetryCodec::decodeRecord(const uint8_t *in, size_t length, TelemetryReading &reading) {
+  if (length < TELEMETRY_RECORD_SIZE || in[0] != TELEMETRY_RECORD_VERSION) {
+    return 0;
+  }
+  reading.seq = (uint32_t)getLE(in + 1, 4);
+  reading.timestamp = getLE(in + 5, 8);
+  reading.weight = (int32_t)(uint32_t)getLE(in + 13, 4);
+  reading.food = (uint16_t)getLE(in + 17, 2);
+  reading.flags = in[19];
+  return TELEMETRY_RECORD_SIZE;
+}
+
+size_t TelemetryCodec::encodeCbor(const TelemetryReading &reading, uint8_t *out) {
+  size_t n = cborHead(CBOR_MAP, 4, out);
+  n += cborHead(CBOR_UNSIGNED, TELEMETRY_KEY_SEQ, out + n);
+  n += cborHead(CBOR_UNSIGNED, reading.seq, out + n);
+  n += cborHead(CBOR_UNSIGNED, (reading.flags & TELEMETRY_FLAG_EPOCH) ? TELEMETRY_KEY_TIMESTAMP : TELEMETRY_KEY_UPTIME, out + n);
+  n += cborHead(CBOR_UNSIGNED, reading.timestamp, out + n);
+  n += cborHead(CBOR_UNSIGNED, TELEMETRY_KEY_WEIGHT, out + n);
+  n += cborInt(reading.weight, out + n);
+  n += cborHead(CBOR_UNSIGNED, TELEMETRY_KEY_FOOD, out + n);
+  n += cborHead(CBOR_UNSIGNED, reading.food, out + n);
+  return n;
+}
+
+size_t TelemetryCodec::encodeCborArray(uint32_t count, uint8_t *out) {
+  return cborHead(CBOR_ARRAY, count, out);
+}
+
+size_t TelemetryCodec::decodeCbor(const uint8_t *in, size_t length, TelemetryReading &reading) {
+  uint8_t major;
+  uint64_t pairs;
+  size_t used = cborReadHead(in, length, major, pairs);
+  if (!used || major != CBOR_MAP) {
+    return 0;
+  }
+  reading.seq = 0;
+  reading.timestamp = 0;
+  reading.weight = 0;
+  reading.food = 0;
+  reading.flags = 0;
+  for (uint64_t i = 0; i < pairs; i++) {
+    uint64_t key;
+    uint64_t value;
+    size_t n = cborReadHead(in + used, length - used, major, key);
+    if (!n || major != CBOR_UNSIGNED) {
+      return 0;
+    }
+    used += n;
+    n = cborReadHead(in + used, length - used, major, value);
+    if (!n || (major != CBOR_UNSIGNED && major != CBOR_NEGATIVE)) {
+      return 0;
+    }
+    used += n;
+    // a negative n is stored as -1 - n
+    int64_t number = (major == CBOR_NEGATIVE) ? -1 - (int64_t)value : (int64_t)value;
+    switch (key) {
+      case TELEMETRY_KEY_SEQ:       reading.seq = (uint32_t)number; break;
+      case TELEMETRY_KEY_TIMESTAMP: reading.timestamp = (uint64_t)number; reading.flags |= TELEMETRY_FLAG_EPOCH; break;
+      case TELEMETRY_KEY_UPTIME:    reading.timestamp = (uint64_t)number; break;
+      case TELEMETRY_KEY_WEIGHT:    reading.weight = (int32_t)number; break;
+      case TELEMETRY_KEY_FOOD:      reading.food = (uint16_t)number; break;
+      default: break;
+    }
+  }
+  return used;
+}
+
+size_t TelemetryCodec::decodeCborArray(const uint8_t *in, size_t length, uint32_t &count) {
+  uint8_t major;
+  uint64_t value;
+  size_t used = cborReadHead(in, length, major, value);
+  if (!used || major != CBOR_ARRAY) {
+    return 0;
+  }
+  count = (uint32_t)value;
+  return used;
+}
+
+// major type in the top 3 bits, values under 24 fit in the same byte,
+// otherwise 24-27 say 1, 2, 4 or 8 big endian bytes follow
+size_t TelemetryCodec::cborHead(uint8_t major, uint64_t value, uint8_t *out) {
+  uint8_t bytes;
+  uint8_t info;
+  if (value < 24) {
+    out[0] = (major << 5) | (uint8_t)value;
+    return 1;
+  } else if (value <= 0xFF) {
+    bytes = 1; info = 24;
+  } else if (value <= 0xFFFF) {
+    bytes = 2; info = 25;
+  } else if (value <= 0xFFFFFFFFULL) {
+    bytes = 4; info = 26;
+  } else {
+    bytes = 8; info = 27;
+  }
+  out[0] = (major << 5) | info;
+  for (uint8_t i = 0; i < bytes; i++) {
+    out[bytes - i] = (uint8_t)(value >> (8 * i));
+  }
+  return bytes + 1;
+}
+
+size_t TelemetryCodec::cborReadHead(const uint8_t *in, size_t length, uint8_t &major, uint64_t &value) {
+  if (length < 1) {
+    return 0;
+  }
+  major = in[0] >> 5;
+  uint8_t info = in[0] & 0x1F;
+  if (info < 24) {
+    value = info;
+    return 1;
+  }
+  if (info > 27) {
+    return 0;     // indefinite lengths and reserved values aren't used here
+  }
+  uint8_t bytes = 1 << (info - 24);
+  if (length < (size_t)bytes + 1) {
+    return 0;
+  }
+  value = 0;
+  for (uint8_t i = 1; i <= bytes; i++) {
+    value = (value << 8) | in[i];
+  }
+  return bytes + 1;
+}
+
+size_t TelemetryCodec::cborInt(int64_t value, uint8_t *out) {
+  if (value < 0) {
+    return cborHead(CBOR_NEGATIVE, (uint64_t)(-1 - value), out);
+  }
+  return cborHead(CBOR_UNSIGNED, (uint64_t)value, out);
+}
@@ -0,0 +1,59 @@
+#ifndef TelemetryCodec_h
+#define TelemetryCodec_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Content-Type values the collector picks the decoder by
+#define TELEMETRY_CBOR_TYPE "application/cbor"
+#define TELEMETRY_RECORD_TYPE "application/x-wifiscale-record"
+
+// bytes in one fixed record, see TelemetryCodec.cpp for the layout
+#define TELEMETRY_RECORD_SIZE 20
+#define TELEMETRY_RECORD_VERSION 1
+// worst case bytes for one reading as CBOR
+#define TELEMETRY_CBOR_MAX 32
+
+// CBOR map keys, small integers instead of names keep a reading around 20 bytes
+#define TELEMETRY_KEY_SEQ 0
+#define TELEMETRY_KEY_TIMESTAMP 1
+#define TELEMETRY_KEY_WEIGHT 2
+#define TELEMETRY_KEY_FOOD 3
+#define TELEMETRY_KEY_UPTIME 4      // used instead of TELEMETRY_KEY_TIMESTAMP before the clock is synced
+
+// timestamp is epoch ms, otherwise ms since the scale booted
+#define TELEMETRY_FLAG_EPOCH 0x01
+
+struct TelemetryReading {
+  uint32_t seq;
+  uint64_t timestamp;   // ms
+  int32_t weight;       // grams
+  uint16_t food;        // food catalog id, not the name
+  uint8_t flags;
+};
+
+// Binary encodings of a reading, shared by the scale and the collector.
+// Plain C++ with no Arduino dependency. Encoders return the bytes written,
+// decoders the bytes consumed, 0 meaning the input didn't check out.
+//
+// CBOR: a map {0: seq, 1: timestamp, 2: weight, 3: food}, key 4 replaces key 1
+// while the time is still uptime. A batch is a CBOR array of those. Unknown
+// integer keys are skipped so fields can be added.
+// Record: fixed 20 bytes little endian, a batch is records back to back.
+class TelemetryCodec {
+public:
+  static size_t encodeRecord(const TelemetryReading &reading, uint8_t *out);
+  static size_t decodeRecord(const uint8_t *in, size_t length, TelemetryReading &reading);
+
+  static size_t encodeCbor(const TelemetryReading &reading, uint8_t *out);
+  static size_t encodeCborArray(uint32_t count, uint8_t *out);       // header in front of count readings
+  static size_t decodeCbor(const uint8_t *in, size_t length, TelemetryReading &reading);
+  static size_t decodeCborArray(const uint8_t *in, size_t length, uint32_t &count);
+
+private:
+  static size_t cborHead(uint8_t major, uint64_t value, uint8_t *out);
+  static size_t cborReadHead(const uint8_t *in, size_t length, uint8_t &major, uint64_t &value);
+  static size_t cborInt(int64_t value, uint8_t *out);
+};
+
+#endif
@@ -0,0 +1,163 @@
+#include "Arduino.h"
+#include "Hal.h"
+
+EspClass ESP;
+
+namespace {
+
+struct Interrupt {
+  void (*isr)();
+  int mode;
+  int level;        // last level seen, to find the edge
+  bool pending;     // edge arrived while interrupts were off
+};
+
+const uint8_t PIN_COUNT = 32;
+Interrupt handlers[PIN_COUNT];
+bool enabled = true;
+
+}
+
+unsigned long millis() {
+  return (unsigned long)(hal.clock->micros() / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)hal.clock->micros();
+}
+
+void delay(unsigned long ms) {
+  hal.clock->sleep(ms * 1000);
+  halRunTimers();
+}
+
+void delayMicroseconds(unsigned int us) {
+  hal.clock->sleep(us);
+}
+
+void yield() {
+  hal.clock->idle();
+  halRunTimers();
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  hal.gpio->mode(pin, mode);
+}
+
+int digitalRead(uint8_t pin) {
+  return hal.gpio->read(pin) ? HIGH : LOW;
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  hal.gpio->write(pin, value);
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+  if (pin >= PIN_COUNT) {
+    return;
+  }
+  handlers[pin].isr = isr;
+  handlers[pin].mode = mode;
+  handlers[pin].level = hal.gpio->read(pin);
+  handlers[pin].pending = false;
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin < PIN_COUNT) {
+    handlers[pin].isr = 0;
+  }
+}
+
+void noInterrupts() {
+  enabled = false;
+}
+
+// edges that came in while interrupts were off fire now, like a latched interrupt on the chip
+static void runPending() {
+  for (uint8_t pin = 0; pin < PIN_COUNT; pin++) {
+    if (handlers[pin].pending && handlers[pin].isr) {
+      handlers[pin].pending = false;
+      enabled = false;
+      handlers[pin].isr();
+      enabled = true;
+    }
+  }
+}
+
+void interrupts() {
+  enabled = true;
+  runPending();
+}
+
+void halPinChanged(uint8_t pin, int level) {
+  if (pin >= PIN_COUNT) {
+    return;
+  }
+  Interrupt &handler = handlers[pin];
+  bool rising = !handler.level && level;
+  bool falling = handler.level && !level;
+  handler.level = level;
+  if (!handler.isr) {
+    return;
+  }
+  bool fire = (handler.mode == CHANGE && (rising || falling)) ||
+              (handler.mode == RISING && rising) ||
+              (handler.mode == FALLING && falling);
+  if (!fire) {
+    return;
+  }
+  if (!enabled) {
+    handler.pending = true;
+    return;
+  }
+  // interrupts don't nest on the chip either, an edge during the handler runs after it
+  enabled = false;
+  handler.isr();
+  enabled = true;
+  runPending();
+}
+
+static char *unsignedToString(unsigned long value, char *out, int base) {
+  char digits[sizeof(unsigned long) * 8 + 1];
+  uint8_t n = 0;
+  do {
+    uint8_t digit = value % base;
+    digits[n++] = digit < 10 ? '0' + digit : 'a' + digit - 10;
+    value /= base;
+  } while (value);
+  for (uint8_t i = 0; i < n; i++) {
+    out[i] = digits[n - 1 - i];
+  }
+  out[n] = 0;
+  return out;
+}
+
+char *ultoa(unsigned long value, char *out, int base) {
+  return unsignedToString(value, out, base);
+}
+
+char *utoa(unsigned value, char *out, int base) {
+  return unsignedToString(value, out, base);
+}
+
+char *ltoa(long value, char *out, int base) {
+  if (value < 0 && base == 10) {
+    out[0] = '-';
+    unsignedToString(-(unsigned long)value, out + 1, base);
+    return out;
+  }
+  return unsignedToString((unsigned long)value, out, base);
+}
+
+char *itoa(int value, char *out, int base) {
+  return ltoa(value, out, base);
+}
+
+// a simulator brings its own main() and runs setup() and loop() under its clock
+__attribute__((weak)) int main() {
+  setup();
+  for (;;) {
+    loop();
+    yield();      // the core hands over to the SDK between passes too
+  }
+}
@@ -0,0 +1,78 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+// The parts of the ESP8266 Arduino core the firmware uses, on top of Hal.h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+#include <algorithm>
+#include "WString.h"
+#include "Print.h"
+#include "Stream.h"
+#include "HardwareSerial.h"
+#include "binary.h"
+#include "pins_arduino.h"
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x00
+#define OUTPUT 0x01
+#define INPUT_PULLUP 0x02
+
+#define RISING 0x01
+#define FALLING 0x02
+#define CHANGE 0x03
+
+// flash placement means nothing off the device
+#define IRAM_ATTR
+#define ICACHE_RAM_ATTR
+#define PROGMEM
+#define PSTR(s) (s)
+#define F(s) (s)
+#define memcpy_P memcpy
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+
+#define digitalPinToInterrupt(pin) (pin)
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+using std::min;
+using std::max;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+int digitalRead(uint8_t pin);
+void digitalWrite(uint8_t pin, uint8_t value);
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void detachInterrupt(uint8_t pin);
+void noInterrupts();
+void interrupts();
+
+char *itoa(int value, char *out, int base);
+char *ltoa(long value, char *out, int base);
+char *utoa(unsigned value, char *out, int base);
+char *ultoa(unsigned long value, char *out, int base);
+
+class EspClass {
+public:
+  uint32_t getChipId() { return 0x00abcd; }
+  uint32_t getFreeHeap() { return 40000; }
+  void restart() { exit(0); }
+};
+
+extern EspClass ESP;
+
+void setup();
+void loop();
+
+#endif
@@ -0,0 +1,80 @@
+#include "ESP8266HTTPClient.h"
+#include <strings.h>
+
+// http://host[:port]/path only
+bool HTTPClient::begin(WiFiClient &client, const char *url) {
+  if (strncmp(url, "http://", 7)) {
+    return false;
+  }
+  const char *host = url + 7;
+  const char *path = strchr(host, '/');
+  const char *port = strchr(host, ':');
+  size_t hostEnd = path ? path - host : strlen(host);
+  if (port && (!path || port < path)) {
+    _port = (uint16_t)atoi(port + 1);
+    hostEnd = port - host;
+  }
+  _host = String(std::string(host, hostEnd));
+  _path = path ? path : "/";
+  _client = &client;
+  _headers = "";
+  _size = -1;
+  return true;
+}
+
+void HTTPClient::addHeader(const String &name, const String &value) {
+  _headers += name;
+  _headers += ": ";
+  _headers += value;
+  _headers += "\r\n";
+}
+
+bool HTTPClient::readLine(String &line) {
+  line = "";
+  unsigned long start = millis();
+  while (millis() - start < _timeout) {
+    int c = _client->read();
+    if (c < 0) {
+      if (!_client->connected()) {
+        return false;
+      }
+      yield();
+      continue;
+    }
+    if (c == '\n') {
+      return true;
+    }
+    if (c != '\r') {
+      line += (char)c;
+    }
+  }
+  return false;
+}
+
+int HTTPClient::GET() {
+  if (!_client || !_client->connect(_host.c_str(), _port)) {
+    return HTTPC_ERROR_CONNECTION_REFUSED;
+  }
+  _client->setTimeout(_timeout);
+  String request = "GET " + _path + " HTTP/1.1\r\nHost: " + _host + "\r\n" + _headers + "Connection: close\r\n\r\n";
+  if (_client->print(request) != request.length()) {
+    return HTTPC_ERROR_SEND_HEADER_FAILED;
+  }
+  String line;
+  if (!readLine(line) || strncmp(line.c_str(), "HTTP/1.", 7)) {
+    return HTTPC_ERROR_READ_TIMEOUT;
+  }
+  int status = atoi(line.c_str() + 9);
+  while (readLine(line) && line.length() > 0) {
+    if (!strncasecmp(line.c_str(), "Content-Length:", 15)) {
+      _size = atoi(line.c_str() + 15);
+    }
+  }
+  return status;
+}
+
+void HTTPClient::end() {
+  if (_client) {
+    _client->stop();
+  }
+}
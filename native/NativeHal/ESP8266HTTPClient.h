@@ -0,0 +1,39 @@
+#ifndef ESP8266HTTPClient_h
+#define ESP8266HTTPClient_h
+
+#include "Arduino.h"
+#include "WiFiClient.h"
+
+#define HTTP_CODE_OK 200
+#define HTTP_CODE_NOT_MODIFIED 304
+#define HTTPC_ERROR_CONNECTION_REFUSED (-1)
+#define HTTPC_ERROR_SEND_HEADER_FAILED (-2)
+#define HTTPC_ERROR_READ_TIMEOUT (-11)
+
+// Blocking GET over a WiFiClient, enough for what the firmware fetches. The
+// response headers are read up to the body, which is then read from
+// getStreamPtr(). Waits go through yield() so a virtual clock keeps moving.
+class HTTPClient {
+public:
+  HTTPClient() : _client(0), _port(80), _timeout(5000), _size(-1) {}
+  bool begin(WiFiClient &client, const char *url);
+  void addHeader(const String &name, const String &value);
+  void setTimeout(uint16_t timeout) { _timeout = timeout; }
+  int GET();
+  int getSize() { return _size; }
+  WiFiClient *getStreamPtr() { return _client; }
+  bool connected() { return _client && _client->connected(); }
+  void end();
+
+private:
+  bool readLine(String &line);
+  WiFiClient *_client;
+  String _host;
+  uint16_t _port;
+  String _path;
+  String _headers;
+  unsigned long _timeout;
+  int _size;
+};
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef ESP8266WiFi_h
+#define ESP8266WiFi_h
+
+#include "Arduino.h"
+#include "IPAddress.h"
+#include "WiFiClient.h"
+#include "WiFiServer.h"
+
+enum WiFiMode { WIFI_OFF, WIFI_STA, WIFI_AP, WIFI_AP_STA };
+
+enum wl_status_t {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED = 6
+};
+
+// station side of the ESP8266 WiFi class, joining and leaving go to hal.network
+class ESP8266WiFiClass {
+public:
+  void persistent(bool /*persistent*/) {}
+  bool mode(WiFiMode /*mode*/) { return true; }
+  bool setAutoReconnect(bool /*autoReconnect*/) { return true; }
+  wl_status_t begin(const char *ssid, const char *password = 0) {
+    hal.network->join(ssid, password);
+    return status();
+  }
+  bool disconnect(bool /*wifiOff*/ = false) {
+    hal.network->leave();
+    return true;
+  }
+  wl_status_t status() { return hal.network->linkUp() ? WL_CONNECTED : WL_DISCONNECTED; }
+  bool isConnected() { return status() == WL_CONNECTED; }
+  IPAddress localIP() { return IPAddress(hal.network->localIp()); }
+  // a literal address goes straight through like on the ESP8266, names go to hal.network
+  int hostByName(const char *host, IPAddress &result, uint32_t /*timeoutMs*/ = 10000) {
+    if (result.fromString(host)) {
+      return 1;
+    }
+    result = IPAddress(hal.network->resolve(host));
+    return (uint32_t)result ? 1 : 0;
+  }
+};
+
+extern ESP8266WiFiClass WiFi;
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef ESP8266WiFiMulti_h
+#define ESP8266WiFiMulti_h
+
+#include "ESP8266WiFi.h"
+
+// included by the firmware but not used, there is only ever one network here
+class ESP8266WiFiMulti {
+public:
+  bool addAP(const char * /*ssid*/, const char * /*password*/ = 0) { return true; }
+  wl_status_t run() { return WiFi.status(); }
+};
+
+#endif
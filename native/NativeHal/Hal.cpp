@@ -0,0 +1,47 @@
+#include "Hal.h"
+#include <chrono>
+#include <thread>
+
+namespace {
+
+class HostClock : public HalClock {
+public:
+  HostClock() : _start(std::chrono::steady_clock::now()) {}
+  uint64_t micros() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - _start).count();
+  }
+  void sleep(uint32_t us) {
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+  }
+private:
+  std::chrono::steady_clock::time_point _start;
+};
+
+class NoGpio : public HalGpio {
+public:
+  int read(uint8_t /*pin*/) { return 1; }
+  void write(uint8_t /*pin*/, uint8_t /*value*/) {}
+};
+
+class NoI2c : public HalI2c {
+public:
+  uint8_t transmit(uint8_t /*address*/, const uint8_t * /*data*/, size_t /*length*/) { return 0; }
+};
+
+class NoNetwork : public HalNetwork {
+public:
+  bool linkUp() { return false; }
+  HalSocketPtr connect(const char * /*host*/, uint16_t /*port*/) { return HalSocketPtr(); }
+  HalSocketPtr accept(uint16_t /*port*/) { return HalSocketPtr(); }
+  bool sendDatagram(uint16_t /*localPort*/, const char * /*host*/, uint16_t /*port*/, const uint8_t * /*data*/, size_t /*length*/) { return false; }
+  int receiveDatagram(uint16_t /*localPort*/, uint8_t * /*buffer*/, size_t /*size*/) { return -1; }
+};
+
+HostClock hostClock;
+NoGpio noGpio;
+NoI2c noI2c;
+NoNetwork noNetwork;
+
+}
+
+HalDevices hal = { &hostClock, &noGpio, &noI2c, &noNetwork, "littlefs", 0 };
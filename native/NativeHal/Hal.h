@@ -0,0 +1,87 @@
+#ifndef Hal_h
+#define Hal_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+
+// Hardware the native build runs the firmware against. The Arduino and ESP8266
+// functions and classes in this library forward to whatever is installed in
+// hal, the firmware itself is compiled unchanged. The defaults are the host's
+// clock and devices that aren't there: input pins read high, I2C writes are
+// acked and dropped and the network never comes up. A simulator installs its
+// own before calling setup().
+
+class HalClock {
+public:
+  virtual ~HalClock() {}
+  virtual uint64_t micros() = 0;
+  virtual void sleep(uint32_t us) = 0;        // delay() and delayMicroseconds() end up here
+  virtual void idle() {}                      // yield(), a virtual clock moves on here so busy waits end
+};
+
+// the HX711 is bit-banged on two pins, so a load cell model is a HalGpio as well
+class HalGpio {
+public:
+  virtual ~HalGpio() {}
+  virtual void mode(uint8_t /*pin*/, uint8_t /*mode*/) {}
+  virtual int read(uint8_t pin) = 0;
+  virtual void write(uint8_t pin, uint8_t value) = 0;
+};
+
+class HalI2c {
+public:
+  virtual ~HalI2c() {}
+  // one Wire transaction, returns what endTransmission() does: 0 acked, 2 address not acked
+  virtual uint8_t transmit(uint8_t address, const uint8_t *data, size_t length) = 0;
+};
+
+// one TCP connection, either end
+class HalSocket {
+public:
+  virtual ~HalSocket() {}
+  virtual int available() = 0;
+  virtual int read(uint8_t *buffer, size_t size) = 0;   // up to size bytes, 0 when nothing is waiting
+  virtual int peek() = 0;                               // next byte or -1
+  virtual size_t write(const uint8_t *data, size_t length) = 0;
+  virtual int writable() = 0;                           // bytes write() takes right now
+  virtual bool connected() = 0;
+  virtual void close() = 0;
+};
+
+typedef std::shared_ptr<HalSocket> HalSocketPtr;
+
+class HalNetwork {
+public:
+  virtual ~HalNetwork() {}
+  virtual void join(const char * /*ssid*/, const char * /*password*/) {}
+  virtual void leave() {}
+  virtual bool linkUp() = 0;                            // what WiFi.status() reports
+  virtual uint32_t localIp() { return 0; }
+  virtual uint32_t resolve(const char * /*host*/) { return 0; }        // 0 when the name doesn't resolve
+  virtual HalSocketPtr connect(const char *host, uint16_t port) = 0;   // null when refused
+  virtual bool listen(uint16_t /*port*/) { return false; }
+  virtual HalSocketPtr accept(uint16_t port) = 0;       // next waiting incoming connection, or null
+  virtual bool sendDatagram(uint16_t localPort, const char *host, uint16_t port, const uint8_t *data, size_t length) = 0;
+  virtual int receiveDatagram(uint16_t localPort, uint8_t *buffer, size_t size) = 0;   // -1 when nothing arrived
+};
+
+class Print;
+
+struct HalDevices {
+  HalClock *clock;
+  HalGpio *gpio;
+  HalI2c *i2c;
+  HalNetwork *network;
+  const char *fsRoot;           // host directory LittleFS lives in
+  Print *serial;                // where Serial output goes, stdout when null
+};
+
+extern HalDevices hal;
+
+// called by a pin model whenever an input pin changes, runs the attached interrupt on a matching edge
+void halPinChanged(uint8_t pin, int level);
+// runs Ticker callbacks that are due, done from delay() and yield(), which main() calls between loop() passes
+void halRunTimers();
+
+#endif
@@ -0,0 +1,28 @@
+#include "HardwareSerial.h"
+#include "Hal.h"
+#include <stdio.h>
+
+HardwareSerial Serial;
+
+size_t HardwareSerial::write(uint8_t c) {
+  if (hal.serial) {
+    return hal.serial->write(c);
+  }
+  return fputc(c, stdout) == EOF ? 0 : 1;
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size) {
+  if (hal.serial) {
+    return hal.serial->write(buffer, size);
+  }
+  return fwrite(buffer, 1, size, stdout);
+}
+
+void HardwareSerial::flush() {
+  fflush(stdout);
+}
+
+// line buffered so a log piped through another program keeps up with the firmware
+void HardwareSerial::begin(unsigned long /*baud*/) {
+  setvbuf(stdout, NULL, _IOLBF, 0);
+}
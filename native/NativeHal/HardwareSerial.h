@@ -0,0 +1,23 @@
+#ifndef HardwareSerial_h
+#define HardwareSerial_h
+
+#include "Stream.h"
+
+// Serial goes to stdout, nothing is ever read from it
+class HardwareSerial : public Stream {
+public:
+  void begin(unsigned long baud);
+  void end() {}
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *buffer, size_t size);
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+  int availableForWrite() { return 256; }
+  void flush();
+  using Print::write;
+};
+
+extern HardwareSerial Serial;
+
+#endif
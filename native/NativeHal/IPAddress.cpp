@@ -0,0 +1,23 @@
+#include "IPAddress.h"
+#include "Print.h"
+#include <stdio.h>
+
+bool IPAddress::fromString(const char *address) {
+  unsigned a, b, c, d;
+  char extra;
+  if (sscanf(address, "%u.%u.%u.%u%c", &a, &b, &c, &d, &extra) != 4 || a > 255 || b > 255 || c > 255 || d > 255) {
+    return false;
+  }
+  _address = a | (b << 8) | (c << 16) | ((uint32_t)d << 24);
+  return true;
+}
+
+String IPAddress::toString() const {
+  char out[16];
+  snprintf(out, sizeof(out), "%u.%u.%u.%u", (*this)[0], (*this)[1], (*this)[2], (*this)[3]);
+  return String(out);
+}
+
+size_t IPAddress::printTo(Print &p) const {
+  return p.print(toString());
+}
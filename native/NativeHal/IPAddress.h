@@ -0,0 +1,23 @@
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <stdint.h>
+#include "Printable.h"
+#include "WString.h"
+
+class IPAddress : public Printable {
+public:
+  IPAddress() : _address(0) {}
+  IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : _address(a | (b << 8) | (c << 16) | ((uint32_t)d << 24)) {}
+  IPAddress(uint32_t address) : _address(address) {}
+  operator uint32_t() const { return _address; }
+  uint8_t operator[](int index) const { return (uint8_t)(_address >> (8 * index)); }
+  bool fromString(const char *address);
+  String toString() const;
+  size_t printTo(Print &p) const;
+
+private:
+  uint32_t _address;      // first octet in the low byte, like lwIP
+};
+
+#endif
@@ -0,0 +1,103 @@
+#include "LittleFS.h"
+#include "Hal.h"
+#include <sys/stat.h>
+#include <unistd.h>
+
+FS LittleFS;
+
+File::File(FILE *file, const char *name) : _file(file, fclose), _name(name) {}
+
+size_t File::write(const uint8_t *buffer, size_t size) {
+  return _file ? fwrite(buffer, 1, size, _file.get()) : 0;
+}
+
+int File::read() {
+  return _file ? fgetc(_file.get()) : -1;
+}
+
+int File::read(uint8_t *buffer, size_t size) {
+  return _file ? (int)fread(buffer, 1, size, _file.get()) : -1;
+}
+
+int File::available() {
+  return _file ? (int)(size() - position()) : 0;
+}
+
+int File::peek() {
+  if (!_file) {
+    return -1;
+  }
+  int c = fgetc(_file.get());
+  if (c != EOF) {
+    ungetc(c, _file.get());
+  }
+  return c;
+}
+
+void File::flush() {
+  if (_file) {
+    fflush(_file.get());
+  }
+}
+
+bool File::seek(uint32_t position, SeekMode mode) {
+  static const int whence[] = { SEEK_SET, SEEK_CUR, SEEK_END };
+  return _file && fseek(_file.get(), position, whence[mode]) == 0;
+}
+
+size_t File::position() const {
+  return _file ? (size_t)ftell(_file.get()) : 0;
+}
+
+size_t File::size() const {
+  struct stat st;
+  if (!_file) {
+    return 0;
+  }
+  fflush(_file.get());
+  return fstat(fileno(_file.get()), &st) == 0 ? (size_t)st.st_size : 0;
+}
+
+bool File::truncate(uint32_t size) {
+  if (!_file) {
+    return false;
+  }
+  fflush(_file.get());
+  return ftruncate(fileno(_file.get()), size) == 0;
+}
+
+// the filesystem is flat on the device, paths map straight under the root
+String FS::hostPath(const char *path) {
+  String out(hal.fsRoot);
+  if (path[0] != '/') {
+    out += "/";
+  }
+  out += path;
+  return out;
+}
+
+bool FS::begin() {
+  struct stat st;
+  return stat(hal.fsRoot, &st) == 0 || mkdir(hal.fsRoot, 0755) == 0;
+}
+
+File FS::open(const char *path, const char *mode) {
+  // binary modes, "r+" and friends keep their meaning
+  String hostMode(mode);
+  hostMode += "b";
+  FILE *file = fopen(hostPath(path).c_str(), hostMode.c_str());
+  return file ? File(file, path) : File();
+}
+
+bool FS::exists(const char *path) {
+  struct stat st;
+  return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::remove(const char *path) {
+  return ::remove(hostPath(path).c_str()) == 0;
+}
+
+bool FS::rename(const char *from, const char *to) {
+  return ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
@@ -0,0 +1,51 @@
+#ifndef LittleFS_h
+#define LittleFS_h
+
+#include "Arduino.h"
+#include <stdio.h>
+#include <memory>
+
+enum SeekMode { SeekSet = 0, SeekCur = 1, SeekEnd = 2 };
+
+// a file in the host directory hal.fsRoot, copies share the open file
+class File : public Stream {
+public:
+  File() {}
+  explicit File(FILE *file, const char *name);
+  operator bool() const { return (bool)_file; }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size);
+  int read();
+  int read(uint8_t *buffer, size_t size);
+  int available();
+  int peek();
+  void flush();
+  bool seek(uint32_t position, SeekMode mode = SeekSet);
+  size_t position() const;
+  size_t size() const;
+  bool truncate(uint32_t size);
+  void close() { _file.reset(); }
+  const char *name() const { return _name.c_str(); }
+  using Print::write;
+
+private:
+  std::shared_ptr<FILE> _file;
+  String _name;
+};
+
+class FS {
+public:
+  bool begin();
+  void end() {}
+  File open(const char *path, const char *mode);
+  bool exists(const char *path);
+  bool remove(const char *path);
+  bool rename(const char *from, const char *to);
+
+private:
+  String hostPath(const char *path);
+};
+
+extern FS LittleFS;
+
+#endif
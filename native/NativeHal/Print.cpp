@@ -0,0 +1,65 @@
+#include "Print.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+  size_t n = 0;
+  while (size--) {
+    n += write(*buffer++);
+  }
+  return n;
+}
+
+size_t Print::print(long value, int base) {
+  if (base == DEC) {
+    return print((long long)value, base);
+  }
+  return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base) {
+  return print((unsigned long long)value, base);
+}
+
+size_t Print::print(long long value, int base) {
+  if (value < 0 && base == DEC) {
+    return print('-') + print((unsigned long long)-value, base);
+  }
+  return print((unsigned long long)value, base);
+}
+
+size_t Print::print(unsigned long long value, int base) {
+  if (base < 2) {
+    base = DEC;
+  }
+  char digits[65];
+  uint8_t n = 0;
+  do {
+    uint8_t digit = value % base;
+    digits[n++] = digit < 10 ? '0' + digit : 'A' + digit - 10;
+    value /= base;
+  } while (value);
+  char out[65];
+  for (uint8_t i = 0; i < n; i++) {
+    out[i] = digits[n - 1 - i];
+  }
+  return write(out, n);
+}
+
+size_t Print::print(double value, int digits) {
+  char out[48];
+  int n = snprintf(out, sizeof(out), "%.*f", digits, value);
+  return write(out, n < (int)sizeof(out) ? n : sizeof(out) - 1);
+}
+
+size_t Print::printf(const char *format, ...) {
+  char out[128];
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(out, sizeof(out), format, args);
+  va_end(args);
+  if (n < 0) {
+    return 0;
+  }
+  return write(out, n < (int)sizeof(out) ? n : sizeof(out) - 1);
+}
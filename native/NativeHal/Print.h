@@ -0,0 +1,46 @@
+#ifndef Print_h
+#define Print_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "WString.h"
+#include "Printable.h"
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  size_t write(const char *str) { return str ? write((const uint8_t *)str, strlen(str)) : 0; }
+  size_t write(const char *buffer, size_t size) { return write((const uint8_t *)buffer, size); }
+  virtual int availableForWrite() { return 0; }
+  virtual void flush() {}
+
+  size_t print(const char *str) { return write(str); }
+  size_t print(const String &str) { return write(str.c_str(), str.length()); }
+  size_t print(char c) { return write((uint8_t)c); }
+  size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(int value, int base = DEC) { return print((long)value, base); }
+  size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+  size_t print(long value, int base = DEC);
+  size_t print(unsigned long value, int base = DEC);
+  size_t print(long long value, int base = DEC);
+  size_t print(unsigned long long value, int base = DEC);
+  size_t print(double value, int digits = 2);
+  size_t print(const Printable &value) { return value.printTo(*this); }
+
+  size_t println() { return write("\r\n"); }
+  template<typename T> size_t println(const T &value) { return print(value) + println(); }
+  template<typename T> size_t println(const T &value, int format) { return print(value, format) + println(); }
+  size_t println(const char *str) { return print(str) + println(); }
+
+  size_t printf(const char *format, ...) __attribute__((format(printf, 2, 3)));
+};
+
+#endif
@@ -0,0 +1,27 @@
+#include "Stream.h"
+#include "Arduino.h"
+
+// waits up to the timeout, yielding so a simulator can move time and deliver data
+int Stream::timedRead() {
+  unsigned long start = millis();
+  do {
+    int c = read();
+    if (c >= 0) {
+      return c;
+    }
+    yield();
+  } while (millis() - start < _timeout);
+  return -1;
+}
+
+size_t Stream::readBytes(uint8_t *buffer, size_t length) {
+  size_t n = 0;
+  while (n < length) {
+    int c = timedRead();
+    if (c < 0) {
+      break;
+    }
+    buffer[n++] = (uint8_t)c;
+  }
+  return n;
+}
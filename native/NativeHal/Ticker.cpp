@@ -0,0 +1,53 @@
+#include "Ticker.h"
+#include "Hal.h"
+
+static Ticker *tickers = 0;
+
+Ticker::Ticker() : _periodUs(0), _nextUs(0), _repeat(false), _armed(false) {
+  _next = tickers;
+  tickers = this;
+}
+
+Ticker::~Ticker() {
+  for (Ticker **t = &tickers; *t; t = &(*t)->_next) {
+    if (*t == this) {
+      *t = _next;
+      break;
+    }
+  }
+}
+
+void Ticker::arm(uint32_t milliseconds, bool repeat, callback_function_t callback) {
+  _callback = callback;
+  _periodUs = (uint64_t)milliseconds * 1000;
+  _nextUs = hal.clock->micros() + _periodUs;
+  _repeat = repeat;
+  _armed = true;
+}
+
+void Ticker::detach() {
+  _armed = false;
+}
+
+// a ticker that fell behind runs once and picks up from now, like os_timer does
+void Ticker::runDue() {
+  uint64_t now = hal.clock->micros();
+  for (Ticker *t = tickers; t; t = t->_next) {
+    if (!t->_armed || now < t->_nextUs) {
+      continue;
+    }
+    t->_armed = t->_repeat;
+    t->_nextUs = (now - t->_nextUs >= t->_periodUs) ? now + t->_periodUs : t->_nextUs + t->_periodUs;
+    t->_callback();
+  }
+}
+
+void halRunTimers() {
+  static bool running = false;
+  if (running) {
+    return;       // a callback that calls delay() or yield() doesn't run the timers again
+  }
+  running = true;
+  Ticker::runDue();
+  running = false;
+}
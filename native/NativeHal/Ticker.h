@@ -0,0 +1,34 @@
+#ifndef Ticker_h
+#define Ticker_h
+
+#include <stdint.h>
+#include <functional>
+
+// Periodic callbacks run by halRunTimers(), from delay(), yield() and between
+// loop() passes. On the device they run from the SDK's timer task, which also
+// never preempts loop(), so the ordering is the same.
+class Ticker {
+public:
+  typedef std::function<void(void)> callback_function_t;
+
+  Ticker();
+  ~Ticker();
+  void attach_ms(uint32_t milliseconds, callback_function_t callback) { arm(milliseconds, true, callback); }
+  void attach(float seconds, callback_function_t callback) { arm((uint32_t)(seconds * 1000), true, callback); }
+  void once_ms(uint32_t milliseconds, callback_function_t callback) { arm(milliseconds, false, callback); }
+  void detach();
+  bool active() const { return _armed; }
+
+  static void runDue();
+
+private:
+  void arm(uint32_t milliseconds, bool repeat, callback_function_t callback);
+  callback_function_t _callback;
+  uint64_t _periodUs;
+  uint64_t _nextUs;
+  bool _repeat;
+  bool _armed;
+  Ticker *_next;          // every Ticker in one list
+};
+
+#endif
@@ -0,0 +1,22 @@
+#include "WString.h"
+#include <stdlib.h>
+
+std::string String::number(long value, unsigned char base) {
+  if (value < 0 && base == 10) {
+    return "-" + number((unsigned long)-value, base);
+  }
+  return number((unsigned long)value, base);
+}
+
+std::string String::number(unsigned long value, unsigned char base) {
+  if (base < 2) {
+    base = 10;
+  }
+  std::string digits;
+  do {
+    unsigned digit = value % base;
+    digits.insert(digits.begin(), (char)(digit < 10 ? '0' + digit : 'a' + digit - 10));
+    value /= base;
+  } while (value);
+  return digits;
+}
@@ -0,0 +1,51 @@
+#ifndef WString_h
+#define WString_h
+
+#include <string>
+#include <string.h>
+#include <stdlib.h>
+
+// Arduino String over std::string, heap and all, which is fine off the device
+class String {
+public:
+  String(const char *str = "") : _value(str ? str : "") {}
+  String(const std::string &str) : _value(str) {}
+  String(char c) : _value(1, c) {}
+  String(int value, unsigned char base = 10) : _value(number((long)value, base)) {}
+  String(unsigned int value, unsigned char base = 10) : _value(number((unsigned long)value, base)) {}
+  String(long value, unsigned char base = 10) : _value(number(value, base)) {}
+  String(unsigned long value, unsigned char base = 10) : _value(number(value, base)) {}
+
+  const char *c_str() const { return _value.c_str(); }
+  unsigned int length() const { return (unsigned int)_value.size(); }
+  char operator[](unsigned int index) const { return index < _value.size() ? _value[index] : 0; }
+
+  String &operator+=(const String &other) { _value += other._value; return *this; }
+  String &operator+=(const char *str) { _value += str ? str : ""; return *this; }
+  String &operator+=(char c) { _value += c; return *this; }
+  String &operator+=(int value) { _value += number((long)value, 10); return *this; }
+  String &operator+=(unsigned int value) { _value += number((unsigned long)value, 10); return *this; }
+  String &operator+=(long value) { _value += number(value, 10); return *this; }
+  String &operator+=(unsigned long value) { _value += number(value, 10); return *this; }
+  bool concat(const String &other) { _value += other._value; return true; }
+
+  bool operator==(const String &other) const { return _value == other._value; }
+  bool operator!=(const String &other) const { return _value != other._value; }
+  bool operator==(const char *str) const { return _value == (str ? str : ""); }
+  bool equals(const String &other) const { return _value == other._value; }
+  int indexOf(char c) const { size_t at = _value.find(c); return at == std::string::npos ? -1 : (int)at; }
+  String substring(unsigned int from) const { return from < _value.size() ? String(_value.substr(from)) : String(); }
+  String substring(unsigned int from, unsigned int to) const { return from < _value.size() && to > from ? String(_value.substr(from, to - from)) : String(); }
+  long toInt() const { return atol(_value.c_str()); }
+
+  friend String operator+(const String &a, const String &b) { String s(a); s += b; return s; }
+  friend String operator+(const String &a, const char *b) { String s(a); s += b; return s; }
+  friend String operator+(const char *a, const String &b) { String s(a); s += b; return s; }
+
+private:
+  static std::string number(long value, unsigned char base);
+  static std::string number(unsigned long value, unsigned char base);
+  std::string _value;
+};
+
+#endif
@@ -0,0 +1,30 @@
+#include "WiFiClient.h"
+
+int WiFiClient::connect(IPAddress ip, uint16_t port) {
+  return connect(ip.toString().c_str(), port);
+}
+
+int WiFiClient::connect(const char *host, uint16_t port) {
+  stop();
+  _socket = hal.network->connect(host, port);
+  return _socket ? 1 : 0;
+}
+
+size_t WiFiClient::write(const uint8_t *buffer, size_t size) {
+  if (!_socket || !_socket->connected()) {
+    return 0;
+  }
+  return _socket->write(buffer, size);
+}
+
+int WiFiClient::read() {
+  uint8_t c;
+  return read(&c, 1) == 1 ? c : -1;
+}
+
+void WiFiClient::stop() {
+  if (_socket) {
+    _socket->close();
+    _socket.reset();
+  }
+}
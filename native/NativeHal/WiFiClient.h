@@ -0,0 +1,34 @@
+#ifndef WiFiClient_h
+#define WiFiClient_h
+
+#include "Arduino.h"
+#include "Client.h"
+#include "Hal.h"
+
+// a HalSocket from hal.network, copies share the connection like they do on the ESP8266
+class WiFiClient : public Client {
+public:
+  WiFiClient() {}
+  explicit WiFiClient(HalSocketPtr socket) : _socket(socket) {}
+  int connect(IPAddress ip, uint16_t port);
+  int connect(const char *host, uint16_t port);
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size);
+  int available() { return _socket ? _socket->available() : 0; }
+  int read();
+  int read(uint8_t *buffer, size_t size) { return _socket ? _socket->read(buffer, size) : -1; }
+  int peek() { return _socket ? _socket->peek() : -1; }
+  int availableForWrite() { return _socket ? _socket->writable() : 0; }
+  void flush() {}
+  void stop();
+  uint8_t connected() { return _socket && (_socket->connected() || _socket->available() > 0); }
+  operator bool() { return (bool)_socket; }
+  void setNoDelay(bool /*noDelay*/) {}
+  IPAddress remoteIP() { return IPAddress(); }
+  using Print::write;
+
+private:
+  HalSocketPtr _socket;
+};
+
+#endif
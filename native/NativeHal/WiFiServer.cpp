@@ -0,0 +1,14 @@
+#include "WiFiServer.h"
+
+bool WiFiServer::hasClient() {
+  if (!_next) {
+    _next = hal.network->accept(_port);
+  }
+  return (bool)_next;
+}
+
+WiFiClient WiFiServer::available() {
+  HalSocketPtr socket = _next ? _next : hal.network->accept(_port);
+  _next.reset();
+  return WiFiClient(socket);
+}
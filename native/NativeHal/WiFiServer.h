@@ -0,0 +1,19 @@
+#ifndef WiFiServer_h
+#define WiFiServer_h
+
+#include "WiFiClient.h"
+
+class WiFiServer {
+public:
+  explicit WiFiServer(uint16_t port) : _port(port) {}
+  void begin() { hal.network->listen(_port); }
+  void setNoDelay(bool /*noDelay*/) {}
+  bool hasClient();
+  WiFiClient available();
+
+private:
+  uint16_t _port;
+  HalSocketPtr _next;     // taken by hasClient(), handed out by available()
+};
+
+#endif
@@ -0,0 +1,47 @@
+#include "WiFiUdp.h"
+#include "Hal.h"
+
+int WiFiUDP::beginPacket(IPAddress ip, uint16_t port) {
+  return beginPacket(ip.toString().c_str(), port);
+}
+
+int WiFiUDP::beginPacket(const char *host, uint16_t port) {
+  _host = host;
+  _port = port;
+  _outLength = 0;
+  return 1;
+}
+
+int WiFiUDP::endPacket() {
+  return hal.network->sendDatagram(_localPort, _host.c_str(), _port, _out, _outLength) ? 1 : 0;
+}
+
+size_t WiFiUDP::write(const uint8_t *buffer, size_t size) {
+  if (size > WIFIUDP_PACKET_SIZE - _outLength) {
+    size = WIFIUDP_PACKET_SIZE - _outLength;
+  }
+  memcpy(_out + _outLength, buffer, size);
+  _outLength += size;
+  return size;
+}
+
+int WiFiUDP::parsePacket() {
+  int size = hal.network->receiveDatagram(_localPort, _in, sizeof(_in));
+  _inRead = 0;
+  _inLength = size > 0 ? size : 0;
+  return (int)_inLength;
+}
+
+int WiFiUDP::read() {
+  return _inRead < _inLength ? _in[_inRead++] : -1;
+}
+
+int WiFiUDP::read(unsigned char *buffer, size_t length) {
+  size_t n = _inLength - _inRead;
+  if (n > length) {
+    n = length;
+  }
+  memcpy(buffer, _in + _inRead, n);
+  _inRead += n;
+  return (int)n;
+}
@@ -0,0 +1,42 @@
+#ifndef WiFiUdp_h
+#define WiFiUdp_h
+
+#include "Arduino.h"
+#include "Udp.h"
+
+#define WIFIUDP_PACKET_SIZE 1472
+
+// datagrams through hal.network, one packet being built and one being read at a time
+class WiFiUDP : public UDP {
+public:
+  WiFiUDP() : _localPort(0), _outLength(0), _inLength(0), _inRead(0) {}
+  uint8_t begin(uint16_t port) { _localPort = port; return 1; }
+  void stop() { _localPort = 0; }
+  int beginPacket(IPAddress ip, uint16_t port);
+  int beginPacket(const char *host, uint16_t port);
+  int endPacket();
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size);
+  int parsePacket();
+  int available() { return (int)(_inLength - _inRead); }
+  int read();
+  int read(unsigned char *buffer, size_t length);
+  int read(char *buffer, size_t length) { return read((unsigned char *)buffer, length); }
+  int peek() { return _inRead < _inLength ? _in[_inRead] : -1; }
+  void flush() { _inRead = _inLength; }
+  IPAddress remoteIP() { return IPAddress(); }
+  uint16_t remotePort() { return 0; }
+  using Print::write;
+
+private:
+  uint16_t _localPort;
+  String _host;
+  uint16_t _port;
+  uint8_t _out[WIFIUDP_PACKET_SIZE];
+  size_t _outLength;
+  uint8_t _in[WIFIUDP_PACKET_SIZE];
+  size_t _inLength;
+  size_t _inRead;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "Wire.h"
+#include "Hal.h"
+
+TwoWire Wire;
+
+void TwoWire::beginTransmission(uint8_t address) {
+  _address = address;
+  _length = 0;
+}
+
+uint8_t TwoWire::endTransmission(bool /*sendStop*/) {
+  uint8_t status = hal.i2c->transmit(_address, _buffer, _length);
+  _length = 0;
+  return status;
+}
+
+// like the core, bytes past the buffer are dropped and write() says so
+size_t TwoWire::write(uint8_t c) {
+  if (_length >= BUFFER_LENGTH) {
+    return 0;
+  }
+  _buffer[_length++] = c;
+  return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buffer, size_t size) {
+  for (size_t i = 0; i < size; i++) {
+    if (!write(buffer[i])) {
+      return i;
+    }
+  }
+  return size;
+}
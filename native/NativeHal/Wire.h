@@ -0,0 +1,36 @@
+#ifndef TwoWire_h
+#define TwoWire_h
+
+#include "Arduino.h"
+#include "Stream.h"
+
+// same as the ESP8266 core, the LCD batches up to this many bytes per transaction
+#define BUFFER_LENGTH 128
+
+// I2C master, every transaction goes to hal.i2c when it ends. Nothing is ever read back.
+class TwoWire : public Stream {
+public:
+  TwoWire() : _address(0), _length(0) {}
+  void begin() {}
+  void begin(int /*sda*/, int /*scl*/) {}
+  void setClock(uint32_t /*frequency*/) {}
+  void beginTransmission(uint8_t address);
+  void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+  uint8_t endTransmission(bool sendStop = true);
+  uint8_t requestFrom(uint8_t /*address*/, uint8_t /*quantity*/) { return 0; }
+  size_t write(uint8_t c);
+  size_t write(const uint8_t *buffer, size_t size);
+  int available() { return 0; }
+  int read() { return -1; }
+  int peek() { return -1; }
+  using Print::write;
+
+private:
+  uint8_t _address;
+  uint8_t _buffer[BUFFER_LENGTH];
+  size_t _length;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef Pins_Arduino_h
+#define Pins_Arduino_h
+
+// NodeMCU board labels to ESP8266 GPIO numbers
+static const uint8_t D0 = 16;
+static const uint8_t D1 = 5;
+static const uint8_t D2 = 4;
+static const uint8_t D3 = 0;
+static const uint8_t D4 = 2;
+static const uint8_t D5 = 14;
+static const uint8_t D6 = 12;
+static const uint8_t D7 = 13;
+static const uint8_t D8 = 15;
+static const uint8_t LED_BUILTIN = 2;
+
+#endif
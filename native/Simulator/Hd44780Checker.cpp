@@ -0,0 +1,114 @@
+#include "Hd44780Checker.h"
+#include <stdio.h>
+
+// the lines that have to be stable around EN
+#define HD44780_BUS_LINES (0xf0 | PCF8574_RS | PCF8574_RW)
+
+Hd44780Checker::Hd44780Checker(uint8_t cols, uint8_t rows, uint32_t i2cHz)
+  : Hd44780Model(cols, rows), _byteNs(9000000000ULL / i2cHz), _pins(0), _riseNs(0), _lastStrobeNs(0),
+    _busyUntil(HD44780_POWER_ON_US), _checking(0), _previousData(false), _previous(0), _minimumPins(0), _resets(0),
+    _violationCount(0), _strobes(0), _minimumBytes(0), _slackNs(0) {}
+
+void Hd44780Checker::expanderWrite(uint64_t timeUs, uint8_t pins) {
+  uint64_t ns = timeUs * 1000;
+  bool rising = !(_pins & PCF8574_EN) && (pins & PCF8574_EN);
+  bool falling = (_pins & PCF8574_EN) && !(pins & PCF8574_EN);
+  bool linesChanged = ((_pins ^ pins) & HD44780_BUS_LINES) != 0;
+  if ((_pins ^ pins) & PCF8574_BACKLIGHT) {
+    _minimumBytes++;
+  }
+  _checking = pins;
+  if (rising) {
+    if (linesChanged) {
+      violation(timeUs, "RS or data changed as EN rose", 0);
+    }
+    if (_riseNs && ns - _riseNs < HD44780_ENABLE_CYCLE_NS) {
+      violation(timeUs, "EN cycle too short", 0);
+    }
+    _riseNs = ns;
+  }
+  if (falling) {
+    if (linesChanged) {
+      violation(timeUs, "RS or data changed as EN fell", 0);
+    }
+    if (ns - _riseNs < HD44780_ENABLE_HIGH_NS) {
+      violation(timeUs, "EN pulse too short", 0);
+    }
+    if (timeUs < _busyUntil) {
+      violation(timeUs, _strobes ? "sent while busy" : "sent before power on wait", (uint32_t)(_busyUntil - timeUs));
+    }
+    // a minimal driver sets the lines up with EN low, raises EN and lowers it
+    uint8_t lines = _pins & HD44780_BUS_LINES;
+    uint8_t bytes = (lines == _minimumPins) ? 2 : 3;
+    _minimumBytes += bytes;
+    _minimumPins = lines;
+    if (_strobes) {
+      uint64_t needed = (uint64_t)bytes * _byteNs;
+      uint64_t busyNs = _busyUntil * 1000;
+      if (busyNs > _lastStrobeNs && busyNs - _lastStrobeNs > needed) {
+        needed = busyNs - _lastStrobeNs;
+      }
+      uint64_t gap = ns - _lastStrobeNs;
+      if (gap < (uint64_t)HD44780_SLACK_HORIZON_US * 1000 && gap > needed) {
+        _slackNs += gap - needed;
+      }
+    }
+    _strobes++;
+    _lastStrobeNs = ns;
+  }
+  _pins = pins;
+  Hd44780Model::expanderWrite(timeUs, pins);
+}
+
+void Hd44780Checker::execute(uint64_t timeUs, bool data, uint8_t value) {
+  Hd44780Model::execute(timeUs, data, value);
+  _busyUntil = timeUs + executionUs(data, value);
+  _previousData = data;
+  _previous = value;
+}
+
+uint32_t Hd44780Checker::executionUs(bool data, uint8_t value) {
+  if (data) {
+    return HD44780_DATA_US;
+  }
+  if ((value & 0xe0) == 0x20 && (value & 0x10) && !fourBit()) {
+    _resets++;
+    return _resets == 1 ? HD44780_FIRST_RESET_US : _resets == 2 ? HD44780_SECOND_RESET_US : HD44780_COMMAND_US;
+  }
+  return value == 0x01 || (value & 0xfe) == 0x02 ? HD44780_CLEAR_US : HD44780_COMMAND_US;
+}
+
+void Hd44780Checker::violation(uint64_t timeUs, const char *rule, uint32_t earlyUs) {
+  _violationCount++;
+  if (_violations.size() < HD44780_VIOLATIONS_KEPT) {
+    Hd44780Violation violation = { timeUs, rule, _checking, _previousData, _previous, earlyUs };
+    _violations.push_back(violation);
+  }
+}
+
+const char *Hd44780Checker::describe(bool data, uint8_t value, char *out, size_t size) {
+  if (data) {
+    if (value >= 0x20 && value < 0x7f) {
+      snprintf(out, size, "data '%c'", value);
+    } else {
+      snprintf(out, size, "data 0x%02x", value);
+    }
+  } else if (value & 0x80) {
+    snprintf(out, size, "DDRAM address 0x%02x", value & 0x7f);
+  } else if (value & 0x40) {
+    snprintf(out, size, "CGRAM address 0x%02x", value & 0x3f);
+  } else if (value & 0x20) {
+    snprintf(out, size, "function set 0x%02x", value);
+  } else if (value & 0x10) {
+    snprintf(out, size, "shift 0x%02x", value);
+  } else if (value & 0x08) {
+    snprintf(out, size, "display control 0x%02x", value);
+  } else if (value & 0x04) {
+    snprintf(out, size, "entry mode 0x%02x", value);
+  } else if (value & 0x02) {
+    snprintf(out, size, "return home");
+  } else {
+    snprintf(out, size, value ? "clear display" : "nop");
+  }
+  return out;
+}
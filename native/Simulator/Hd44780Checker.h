@@ -0,0 +1,80 @@
+#ifndef Hd44780Checker_h
+#define Hd44780Checker_h
+
+#include "Hd44780Model.h"
+#include <vector>
+
+// HD44780 timing at the nominal 270kHz oscillator, in microseconds
+#define HD44780_POWER_ON_US 40000     // from power on to the first instruction
+#define HD44780_FIRST_RESET_US 4100   // after the first 8 bit function set of the init sequence
+#define HD44780_SECOND_RESET_US 100   // after the second
+#define HD44780_CLEAR_US 1520         // clear display and return home
+#define HD44780_COMMAND_US 37         // every other instruction
+#define HD44780_DATA_US 41            // a data write, including the address counter update
+#define HD44780_ENABLE_HIGH_NS 450
+#define HD44780_ENABLE_CYCLE_NS 1000
+
+// gaps between strobes longer than this are the driver having nothing to send, not slack
+#define HD44780_SLACK_HORIZON_US 10000
+
+// kept in full, the rest are only counted
+#define HD44780_VIOLATIONS_KEPT 16
+
+struct Hd44780Violation {
+  uint64_t time;
+  const char *rule;
+  uint8_t pins;                 // the expander byte that broke it
+  bool previousData;            // the instruction or data write before it
+  uint8_t previous;
+  uint32_t earlyUs;             // how much too soon, 0 for rules that aren't about waiting
+};
+
+// The HD44780 model with a timing check on top. Every strobe (falling EN) has
+// to come after the previous instruction has finished executing, and after the
+// power on wait for the first one. RS, R/W and the data lines have to be set up
+// before EN rises and held until after it falls, which through a PCF8574 means
+// they can't change in the same byte as EN.
+//
+// It also works out what a driver that wastes nothing would need for the same
+// instructions: the fewest expander bytes (3 per nibble, 2 when the data lines
+// already hold it, 1 for a backlight change) and their bus time, and how much
+// longer than needed the gaps between back to back strobes were.
+class Hd44780Checker : public Hd44780Model {
+public:
+  Hd44780Checker(uint8_t cols, uint8_t rows, uint32_t i2cHz);
+  void expanderWrite(uint64_t timeUs, uint8_t pins);
+
+  const std::vector<Hd44780Violation> &violations() const { return _violations; }
+  uint32_t violationCount() const { return _violationCount; }
+  uint32_t strobes() const { return _strobes; }
+  uint32_t minimumBytes() const { return _minimumBytes; }
+  uint64_t minimumBusUs() const { return (uint64_t)_minimumBytes * _byteNs / 1000; }
+  uint64_t slackUs() const { return _slackNs / 1000; }
+
+  static const char *describe(bool data, uint8_t value, char *out, size_t size);
+
+protected:
+  void execute(uint64_t timeUs, bool data, uint8_t value);
+
+private:
+  void violation(uint64_t timeUs, const char *rule, uint32_t earlyUs);
+  uint32_t executionUs(bool data, uint8_t value);
+
+  uint32_t _byteNs;             // one expander byte on the bus
+  uint8_t _pins;
+  uint64_t _riseNs;             // when EN last went high
+  uint64_t _lastStrobeNs;
+  uint64_t _busyUntil;          // when the last instruction finishes
+  uint8_t _checking;            // the byte being checked and what went before it, for the report
+  bool _previousData;
+  uint8_t _previous;
+  uint8_t _minimumPins;         // what a minimal driver would have left on the data lines
+  uint8_t _resets;              // 8 bit function sets so far
+  std::vector<Hd44780Violation> _violations;
+  uint32_t _violationCount;
+  uint32_t _strobes;
+  uint32_t _minimumBytes;
+  uint64_t _slackNs;
+};
+
+#endif
@@ -0,0 +1,148 @@
+#include "Hd44780Model.h"
+#include <string.h>
+
+// a line of DDRAM is 40 positions, the second one starts at 0x40
+#define HD44780_LINE_LENGTH 40
+
+Hd44780Model::Hd44780Model(uint8_t cols, uint8_t rows)
+  : _cols(cols), _rows(rows), _pins(0), _fourBit(false), _highNibble(true), _pending(0), _twoLine(false),
+    _cgramAccess(false), _address(0), _increment(true), _shiftDisplay(false), _shift(0), _displayOn(false),
+    _backlight(false), _changes(0) {
+  memset(_ddram, ' ', sizeof(_ddram));
+  memset(_cgram, 0, sizeof(_cgram));
+  memset(_changedAt, 0, sizeof(_changedAt));
+}
+
+void Hd44780Model::expanderWrite(uint64_t timeUs, uint8_t pins) {
+  bool falling = (_pins & PCF8574_EN) && !(pins & PCF8574_EN);
+  _pins = pins;
+  if (_backlight != ((pins & PCF8574_BACKLIGHT) != 0)) {
+    _backlight = !_backlight;
+    visibleChange(timeUs);
+  }
+  if (falling && !(pins & PCF8574_RW)) {
+    strobe(timeUs, pins);
+  }
+}
+
+void Hd44780Model::strobe(uint64_t timeUs, uint8_t pins) {
+  uint8_t nibble = pins & 0xf0;
+  bool data = (pins & PCF8574_RS) != 0;
+  if (!_fourBit) {
+    execute(timeUs, data, nibble);      // DB0-3 aren't wired, they read as low
+    return;
+  }
+  if (_highNibble) {
+    _pending = nibble;
+    _highNibble = false;
+    return;
+  }
+  _highNibble = true;
+  execute(timeUs, data, _pending | (nibble >> 4));
+}
+
+void Hd44780Model::execute(uint64_t timeUs, bool data, uint8_t value) {
+  if (data) {
+    writeData(value);
+  } else {
+    instruction(value);
+  }
+  visibleChange(timeUs);
+}
+
+void Hd44780Model::instruction(uint8_t value) {
+  if (value & 0x80) {               // set DDRAM address
+    _address = value & 0x7f;
+    _cgramAccess = false;
+  } else if (value & 0x40) {        // set CGRAM address
+    _address = value & 0x3f;
+    _cgramAccess = true;
+  } else if (value & 0x20) {        // function set
+    _fourBit = !(value & 0x10);
+    _highNibble = true;
+    _twoLine = (value & 0x08) != 0;
+  } else if (value & 0x10) {        // cursor or display shift
+    bool right = (value & 0x04) != 0;
+    if (value & 0x08) {
+      _shift = (_shift + (right ? HD44780_LINE_LENGTH - 1 : 1)) % HD44780_LINE_LENGTH;
+    } else {
+      moveAddress(right);
+    }
+  } else if (value & 0x08) {        // display on/off control, the cursor isn't modelled
+    _displayOn = (value & 0x04) != 0;
+  } else if (value & 0x04) {        // entry mode set
+    _increment = (value & 0x02) != 0;
+    _shiftDisplay = (value & 0x01) != 0;
+  } else if (value & 0x02) {        // return home
+    _address = 0;
+    _cgramAccess = false;
+    _shift = 0;
+  } else if (value & 0x01) {        // clear display
+    memset(_ddram, ' ', sizeof(_ddram));
+    _address = 0;
+    _cgramAccess = false;
+    _shift = 0;
+    _increment = true;
+  }
+}
+
+void Hd44780Model::writeData(uint8_t value) {
+  if (_cgramAccess) {
+    _cgram[_address & 0x3f] = value & 0x1f;
+    _address = (_address + (_increment ? 1 : 63)) & 0x3f;
+    return;
+  }
+  _ddram[_address] = value;
+  moveAddress(_increment);
+  if (_shiftDisplay) {
+    _shift = (_shift + (_increment ? 1 : HD44780_LINE_LENGTH - 1)) % HD44780_LINE_LENGTH;
+  }
+}
+
+// in two line mode the counter runs 0x00-0x27 then 0x40-0x67 and wraps around
+void Hd44780Model::moveAddress(bool increment) {
+  if (!_twoLine) {
+    _address = (_address + (increment ? 1 : 79)) % 80;
+    return;
+  }
+  uint8_t linear = (_address & 0x40 ? HD44780_LINE_LENGTH : 0) + (_address & 0x3f) % HD44780_LINE_LENGTH;
+  linear = (linear + (increment ? 1 : 79)) % 80;
+  _address = linear < HD44780_LINE_LENGTH ? linear : 0x40 + linear - HD44780_LINE_LENGTH;
+}
+
+uint8_t Hd44780Model::visibleAddress(uint8_t row, uint8_t col) const {
+  if (!_twoLine) {
+    return (col + _shift) % 80;
+  }
+  // rows 2 and 3 of a 4 line display continue rows 0 and 1 one row length on
+  uint8_t start = (row & 1 ? 0x40 : 0) + (row & 2 ? _cols : 0);
+  return (start & 0x40) + ((start & 0x3f) + col + _shift) % HD44780_LINE_LENGTH;
+}
+
+std::string Hd44780Model::row(uint8_t row) const {
+  std::string text;
+  for (uint8_t col = 0; col < _cols; col++) {
+    text += (char)_ddram[visibleAddress(row, col)];
+  }
+  return text;
+}
+
+// a row counts as changed when its characters do or a glyph it shows was redrawn
+void Hd44780Model::visibleChange(uint64_t timeUs) {
+  for (uint8_t r = 0; r < _rows && r < 4; r++) {
+    std::string shown;
+    if (_displayOn && _backlight) {
+      shown = row(r);
+      for (uint8_t col = 0; col < _cols; col++) {
+        if ((uint8_t)shown[col] < 16) {
+          shown.append((const char *)&_cgram[(shown[col] & 7) * 8], 8);
+        }
+      }
+    }
+    if (shown != _shown[r]) {
+      _shown[r] = shown;
+      _changedAt[r] = timeUs;
+      _changes++;
+    }
+  }
+}
@@ -0,0 +1,71 @@
+#ifndef Hd44780Model_h
+#define Hd44780Model_h
+
+#include <stdint.h>
+#include <string>
+
+// PCF8574 outputs as wired on the usual I2C backpack
+#define PCF8574_RS 0x01
+#define PCF8574_RW 0x02
+#define PCF8574_EN 0x04
+#define PCF8574_BACKLIGHT 0x08
+
+// HD44780 behind a PCF8574. expanderWrite() gets every byte the expander
+// latches with the time it was acked; a nibble is taken on each falling edge of
+// EN. The controller powers up in 8 bit mode and goes to 4 bit mode on a function
+// set with DL clear, after which two nibbles make a byte. Only what ends up
+// visible is modelled: DDRAM, CGRAM, the address counter, entry mode, display
+// shift and display on/off.
+class Hd44780Model {
+public:
+  Hd44780Model(uint8_t cols, uint8_t rows);
+  virtual ~Hd44780Model() {}
+  virtual void expanderWrite(uint64_t timeUs, uint8_t pins);
+
+  std::string row(uint8_t row) const;   // the characters in DDRAM under the row, CGRAM glyphs as their code 0-7
+  uint8_t ddram(uint8_t address) const { return _ddram[address & 0x7f]; }
+  const uint8_t *cgram() const { return _cgram; }
+  bool displayOn() const { return _displayOn; }
+  bool backlight() const { return _backlight; }
+  bool fourBit() const { return _fourBit; }
+  uint8_t address() const { return _address; }
+  bool cgramAccess() const { return _cgramAccess; }
+  bool increment() const { return _increment; }
+  bool shiftsDisplay() const { return _shiftDisplay; }
+  uint64_t changedAt(uint8_t row) const { return _changedAt[row & 3]; }   // last time what the row shows changed
+  uint32_t changes() const { return _changes; }
+
+protected:
+  // one instruction or data byte as the controller executes it
+  virtual void execute(uint64_t timeUs, bool data, uint8_t value);
+  uint8_t _cols;
+  uint8_t _rows;
+
+private:
+  void strobe(uint64_t timeUs, uint8_t pins);
+  void instruction(uint8_t value);
+  void writeData(uint8_t value);
+  void moveAddress(bool increment);
+  uint8_t visibleAddress(uint8_t row, uint8_t col) const;
+  void visibleChange(uint64_t timeUs);
+
+  uint8_t _pins;
+  bool _fourBit;
+  bool _highNibble;             // 4 bit mode, waiting for the first nibble of a byte
+  uint8_t _pending;             // the high nibble already received
+  bool _twoLine;
+  bool _cgramAccess;            // the address counter points into CGRAM
+  uint8_t _address;
+  bool _increment;
+  bool _shiftDisplay;
+  uint8_t _shift;               // display shift, in DDRAM positions per line
+  bool _displayOn;
+  bool _backlight;
+  uint8_t _ddram[128];
+  uint8_t _cgram[64];
+  std::string _shown[4];        // each row as it looks with its glyphs, empty while dark
+  uint64_t _changedAt[4];
+  uint32_t _changes;
+};
+
+#endif
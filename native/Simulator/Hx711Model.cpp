@@ -0,0 +1,68 @@
+#include "Hx711Model.h"
+#include <math.h>
+
+Hx711Model::Hx711Model(SimClock &clock, SimGpio &gpio, uint8_t dout, uint8_t sck, const LoadCellConfig &config, uint32_t seed)
+  : _clock(clock), _gpio(gpio), _dout(dout), _sck(sck), _config(config), _random(seed) {
+  _periodUs = 1000000 / (config.samplesPerSecond ? config.samplesPerSecond : 10);
+  _data = 0;
+  _pulses = 24;
+  _conversions = 0;
+}
+
+void Hx711Model::begin(uint64_t phaseUs) {
+  _gpio.drive(_dout, 1);
+  _gpio.onWrite(_sck, [this](int level) { clock(level); });
+  _clock.at(phaseUs, [this]() { convert(); });
+}
+
+void Hx711Model::place(uint64_t timeUs, float grams) {
+  Step step = { timeUs, grams };
+  _steps.push_back(step);
+}
+
+float Hx711Model::grams(uint64_t timeUs) const {
+  float total = 0;
+  for (size_t i = 0; i < _steps.size(); i++) {
+    if (timeUs < _steps[i].time) {
+      continue;
+    }
+    float t = (timeUs - _steps[i].time) / 1000.0f;
+    float left = _config.settleMs > 0 ? expf(-t / _config.settleMs) : 0;
+    if (_config.ringHz > 0) {
+      left *= cosf(2 * (float)M_PI * _config.ringHz * t / 1000.0f);
+    }
+    total += _steps[i].grams * (1 - left);
+  }
+  return total;
+}
+
+// Box-Muller on the raw generator, std::normal_distribution differs between standard libraries
+float Hx711Model::noise() {
+  double u1 = (_random() + 1.0) / 4294967297.0;
+  double u2 = _random() / 4294967296.0;
+  return (float)(sqrt(-2 * log(u1)) * cos(2 * M_PI * u2)) * _config.noiseCounts;
+}
+
+void Hx711Model::convert() {
+  uint64_t now = _clock.micros();
+  float counts = _config.zeroCounts + _config.countsPerGram * grams(now) + _config.driftCountsPerSecond * (now / 1e6f) + noise();
+  long value = lroundf(counts);
+  if (value > 0x7FFFFF) {
+    value = 0x7FFFFF;
+  } else if (value < -0x800000) {
+    value = -0x800000;
+  }
+  _data = (uint32_t)value & 0xFFFFFF;
+  _pulses = 0;
+  _conversions++;
+  _clock.at(now + _periodUs, [this]() { convert(); });
+  _gpio.drive(_dout, 0);
+}
+
+void Hx711Model::clock(int level) {
+  if (!level || _pulses >= 24 + 3) {
+    return;
+  }
+  _pulses++;
+  _gpio.drive(_dout, _pulses <= 24 ? (_data >> (24 - _pulses)) & 1 : 1);
+}
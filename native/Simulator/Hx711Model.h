@@ -0,0 +1,54 @@
+#ifndef Hx711Model_h
+#define Hx711Model_h
+
+#include "SimClock.h"
+#include "SimGpio.h"
+#include <random>
+#include <vector>
+
+struct LoadCellConfig {
+  uint8_t samplesPerSecond;     // 10 or 80, the RATE pin
+  float countsPerGram;
+  long zeroCounts;              // reading with nothing on the scale
+  float noiseCounts;            // standard deviation of the gaussian noise
+  float driftCountsPerSecond;   // creep and temperature drift, linear
+  float settleMs;               // time constant of a load coming to rest, 0 for instant
+  float ringHz;                 // the platform bouncing while it settles, 0 for none
+};
+
+// HX711 on the load cell. Conversions finish at the configured rate, the first
+// one at phaseUs, and pull DOUT low; each SCK rising edge then shifts out the
+// next bit MSB first and the 25th and later ones raise DOUT until the next
+// conversion. Like the chip, a conversion that isn't read keeps DOUT low and is
+// overwritten by the next one, so no further falling edge comes.
+class Hx711Model {
+public:
+  Hx711Model(SimClock &clock, SimGpio &gpio, uint8_t dout, uint8_t sck, const LoadCellConfig &config, uint32_t seed);
+  void begin(uint64_t phaseUs);
+  void place(uint64_t timeUs, float grams);   // a load added (negative: taken off) at timeUs
+  float grams(uint64_t timeUs) const;         // what is on the platform, settling included
+  uint32_t conversions() const { return _conversions; }
+
+private:
+  struct Step {
+    uint64_t time;
+    float grams;
+  };
+  void convert();
+  void clock(int level);
+  float noise();
+
+  SimClock &_clock;
+  SimGpio &_gpio;
+  uint8_t _dout;
+  uint8_t _sck;
+  LoadCellConfig _config;
+  std::mt19937 _random;
+  std::vector<Step> _steps;
+  uint64_t _periodUs;
+  uint32_t _data;               // 24 bit two's complement conversion being read
+  uint8_t _pulses;              // SCK pulses since the conversion finished
+  uint32_t _conversions;
+};
+
+#endif
@@ -0,0 +1,325 @@
+#include "Scenario.h"
+#include "Hd44780Checker.h"
+#include "SimClock.h"
+#include "SimGpio.h"
+#include "SimI2c.h"
+#include <Arduino.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+struct Button {
+  const char *name;
+  uint8_t pin;
+};
+
+// the pins main.cpp reads the buttons on
+const Button buttons[] = {
+  { "tare", 3 },
+  { "send", 14 },
+  { "left", 0 },
+  { "right", 2 },
+};
+const uint8_t sendPin = 14;
+
+class NullPrint : public Print {
+public:
+  size_t write(uint8_t /*c*/) { return 1; }
+};
+
+bool parseLoad(const char *text, LoadStep &load) {
+  char *end;
+  load.grams = strtof(text, &end);
+  if (*end != '@') {
+    return false;
+  }
+  load.ms = strtoul(end + 1, &end, 10);
+  return *end == 0;
+}
+
+bool parsePress(const char *text, ButtonPress &press) {
+  const char *at = strchr(text, '@');
+  if (!at) {
+    return false;
+  }
+  size_t length = at - text;
+  for (size_t i = 0; i < sizeof(buttons) / sizeof(buttons[0]); i++) {
+    if (strlen(buttons[i].name) == length && strncmp(text, buttons[i].name, length) == 0) {
+      char *end;
+      press.pin = buttons[i].pin;
+      press.ms = strtoul(at + 1, &end, 10);
+      press.holdMs = 100;
+      if (*end == '+') {
+        press.holdMs = strtoul(end + 1, &end, 10);
+      }
+      return *end == 0;
+    }
+  }
+  return false;
+}
+
+// "Weight = 250g" on the weight row, or "250g" in front of the fill bar
+int32_t shownWeight(const std::string &row) {
+  long grams;
+  if (sscanf(row.c_str(), "Weight = %ldg", &grams) != 1 && sscanf(row.c_str(), "%ldg", &grams) != 1) {
+    return INT32_MIN;
+  }
+  return (int32_t)grams;
+}
+
+// the JSON encoder sends the weight as a string, "weight":"250"
+int32_t postedWeight(const std::string &body) {
+  size_t key = body.find("\"weight\":");
+  if (key == std::string::npos) {
+    return INT32_MIN;
+  }
+  key += 9;
+  if (key < body.size() && body[key] == '"') {
+    key++;
+  }
+  return (int32_t)atol(body.c_str() + key);
+}
+
+}
+
+void defaultScenario(Scenario &scenario) {
+  scenario.runs = 100;
+  scenario.seed = 1;
+  scenario.durationMs = 0;
+  scenario.toleranceGrams = 1;
+  scenario.loopUs = 500;
+  scenario.i2cHz = 100000;
+  scenario.verbose = false;
+  scenario.cell.samplesPerSecond = 10;
+  scenario.cell.countsPerGram = 2067;
+  scenario.cell.zeroCounts = 150000;
+  scenario.cell.noiseCounts = 200;
+  scenario.cell.driftCountsPerSecond = 0;
+  scenario.cell.settleMs = 120;
+  scenario.cell.ringHz = 6;
+  scenario.network.joinMs = 1500;
+  scenario.network.latencyUs = 3000;
+  scenario.network.serverUs = 10000;
+  scenario.network.collectorPort = 8090;
+  scenario.loads.clear();
+  scenario.presses.clear();
+}
+
+bool parseScenario(int argc, char **argv, Scenario &scenario, std::string &error) {
+  for (int i = 1; i < argc; i++) {
+    std::string option = argv[i];
+    if (option == "--verbose") {
+      scenario.verbose = true;
+      continue;
+    }
+    if (option == "--help") {
+      error.clear();
+      return false;
+    }
+    if (i + 1 >= argc) {
+      error = option + " needs a value";
+      return false;
+    }
+    const char *value = argv[++i];
+    if (option == "--runs") scenario.runs = strtoul(value, 0, 10);
+    else if (option == "--seed") scenario.seed = strtoul(value, 0, 10);
+    else if (option == "--duration") scenario.durationMs = strtoul(value, 0, 10);
+    else if (option == "--tolerance") scenario.toleranceGrams = strtof(value, 0);
+    else if (option == "--loop-us") scenario.loopUs = strtoul(value, 0, 10);
+    else if (option == "--i2c-hz") scenario.i2cHz = strtoul(value, 0, 10);
+    else if (option == "--sps") scenario.cell.samplesPerSecond = strtoul(value, 0, 10);
+    else if (option == "--counts-per-gram") scenario.cell.countsPerGram = strtof(value, 0);
+    else if (option == "--noise") scenario.cell.noiseCounts = strtof(value, 0);
+    else if (option == "--drift") scenario.cell.driftCountsPerSecond = strtof(value, 0);
+    else if (option == "--settle-ms") scenario.cell.settleMs = strtof(value, 0);
+    else if (option == "--ring-hz") scenario.cell.ringHz = strtof(value, 0);
+    else if (option == "--join-ms") scenario.network.joinMs = strtoul(value, 0, 10);
+    else if (option == "--latency-us") scenario.network.latencyUs = strtoul(value, 0, 10);
+    else if (option == "--server-us") scenario.network.serverUs = strtoul(value, 0, 10);
+    else if (option == "--load") {
+      LoadStep load;
+      if (!parseLoad(value, load)) {
+        error = "--load takes grams@ms, not " + std::string(value);
+        return false;
+      }
+      scenario.loads.push_back(load);
+    }
+    else if (option == "--press") {
+      ButtonPress press;
+      if (!parsePress(value, press)) {
+        error = "--press takes tare|send|left|right@ms[+holdms], not " + std::string(value);
+        return false;
+      }
+      scenario.presses.push_back(press);
+    }
+    else {
+      error = "unknown option " + option;
+      return false;
+    }
+  }
+  if (scenario.cell.samplesPerSecond == 0 || scenario.i2cHz == 0 || scenario.loopUs == 0) {
+    error = "--sps, --i2c-hz and --loop-us can't be 0";
+    return false;
+  }
+  // a jar goes on once the boot tare is done and the reading is sent once it has had time to settle
+  if (scenario.loads.empty()) {
+    LoadStep jar = { 4000, 250 };
+    scenario.loads.push_back(jar);
+  }
+  if (scenario.presses.empty()) {
+    ButtonPress send = { sendPin, scenario.loads.back().ms + 3000, 100 };
+    scenario.presses.push_back(send);
+  }
+  if (scenario.durationMs == 0) {
+    uint32_t last = scenario.loads.back().ms;
+    for (size_t i = 0; i < scenario.presses.size(); i++) {
+      if (scenario.presses[i].ms + scenario.presses[i].holdMs > last) {
+        last = scenario.presses[i].ms + scenario.presses[i].holdMs;
+      }
+    }
+    scenario.durationMs = last + 3000;
+  }
+  return true;
+}
+
+std::string describeScenario(const Scenario &scenario) {
+  char line[160];
+  std::string text;
+  for (size_t i = 0; i < scenario.loads.size(); i++) {
+    snprintf(line, sizeof(line), "%s%gg at %ums", i ? ", " : "load ", scenario.loads[i].grams, scenario.loads[i].ms);
+    text += line;
+  }
+  for (size_t i = 0; i < scenario.presses.size(); i++) {
+    const char *name = "?";
+    for (size_t b = 0; b < sizeof(buttons) / sizeof(buttons[0]); b++) {
+      if (buttons[b].pin == scenario.presses[i].pin) {
+        name = buttons[b].name;
+      }
+    }
+    snprintf(line, sizeof(line), "%s%s at %ums", i ? ", " : "; press ", name, scenario.presses[i].ms);
+    text += line;
+  }
+  snprintf(line, sizeof(line), "\nHX711 %u SPS, noise %g counts, drift %g counts/s, settle %gms, ring %gHz\n",
+           scenario.cell.samplesPerSecond, scenario.cell.noiseCounts, scenario.cell.driftCountsPerSecond,
+           scenario.cell.settleMs, scenario.cell.ringHz);
+  text += line;
+  snprintf(line, sizeof(line), "settled within %gg, ", scenario.toleranceGrams);
+  text += line;
+  snprintf(line, sizeof(line), "wifi up after %ums, latency %uus, collector %uus, I2C %uHz, loop %uus, %ums per run",
+           scenario.network.joinMs, scenario.network.latencyUs, scenario.network.serverUs, scenario.i2cHz,
+           scenario.loopUs, scenario.durationMs);
+  text += line;
+  return text;
+}
+
+RunResult runScenario(const Scenario &scenario, uint32_t run, const char *fsRoot, bool listViolations) {
+  std::mt19937 random(scenario.seed * 1000003u + run);
+  SimClock clock(scenario.loopUs);
+  SimGpio gpio;
+  SimI2c i2c(clock, scenario.i2cHz);
+  SimNetwork network(clock, scenario.network);
+  Hd44780Checker lcd(SIM_LCD_COLS, SIM_LCD_ROWS, scenario.i2cHz);
+  Hx711Model cell(clock, gpio, SIM_HX711_DOUT, SIM_HX711_SCK, scenario.cell, random());
+  NullPrint quiet;
+
+  i2c.attach(SIM_LCD_ADDRESS, [&lcd](uint64_t time, uint8_t pins) { lcd.expanderWrite(time, pins); });
+  cell.begin(random() % (1000000 / scenario.cell.samplesPerSecond));
+  uint64_t lastLoad = 0;
+  float load = 0;
+  for (size_t i = 0; i < scenario.loads.size(); i++) {
+    cell.place((uint64_t)scenario.loads[i].ms * 1000, scenario.loads[i].grams);
+    load += scenario.loads[i].grams;
+    if (scenario.loads[i].ms * 1000ULL > lastLoad) {
+      lastLoad = scenario.loads[i].ms * 1000ULL;
+    }
+  }
+  int64_t sendAt = -1;
+  for (size_t i = 0; i < scenario.presses.size(); i++) {
+    const ButtonPress &press = scenario.presses[i];
+    uint8_t pin = press.pin;
+    clock.at((uint64_t)press.ms * 1000, [&gpio, pin]() { gpio.drive(pin, 0); });
+    clock.at((uint64_t)(press.ms + press.holdMs) * 1000, [&gpio, pin]() { gpio.drive(pin, 1); });
+    if (pin == sendPin && (int64_t)press.ms * 1000 > sendAt) {
+      sendAt = (int64_t)press.ms * 1000;
+    }
+  }
+
+  hal.clock = &clock;
+  hal.gpio = &gpio;
+  hal.i2c = &i2c;
+  hal.network = &network;
+  hal.fsRoot = fsRoot;
+  hal.serial = scenario.verbose ? 0 : &quiet;
+
+  RunResult result;
+  result.loopPasses = 0;
+  uint64_t end = (uint64_t)scenario.durationMs * 1000;
+  // the weight row is looked at once a pass, a row half way through being redrawn is never seen
+  uint64_t seen = 0;
+  int64_t settled = -1;         // since when the row has shown the load
+  setup();
+  while (clock.micros() < end) {
+    loop();
+    yield();
+    result.loopPasses++;
+    if (lcd.changedAt(SIM_WEIGHT_ROW) != seen) {
+      seen = lcd.changedAt(SIM_WEIGHT_ROW);
+      int32_t grams = shownWeight(lcd.row(SIM_WEIGHT_ROW));
+      if (grams == INT32_MIN || fabsf(grams - load) > scenario.toleranceGrams) {
+        settled = -1;
+      } else if (settled < 0) {
+        settled = seen;
+      }
+    }
+  }
+
+  result.settledUs = settled < 0 ? -1 : settled > (int64_t)lastLoad ? settled - (int64_t)lastLoad : 0;
+  result.shownGrams = shownWeight(lcd.row(SIM_WEIGHT_ROW));
+  result.postedUs = -1;
+  result.endToEndUs = -1;
+  result.postedGrams = INT32_MIN;
+  for (size_t i = 0; i < network.posts().size(); i++) {
+    const SimPost &post = network.posts()[i];
+    if (sendAt >= 0 && (int64_t)post.time >= sendAt) {
+      result.postedUs = post.time - sendAt;
+      result.endToEndUs = post.time - lastLoad;
+      result.postedGrams = postedWeight(post.body);
+      break;
+    }
+  }
+  result.sentLoad = 0;
+  for (size_t i = 0; i < scenario.loads.size(); i++) {
+    if ((int64_t)scenario.loads[i].ms * 1000 <= sendAt) {
+      result.sentLoad += scenario.loads[i].grams;
+    }
+  }
+  result.conversions = cell.conversions();
+  result.i2cBytes = i2c.bytes();
+  result.i2cBusyUs = i2c.busyUs();
+  result.lcdViolations = lcd.violationCount();
+  result.lcdMinimumBytes = lcd.minimumBytes();
+  result.lcdMinimumBusUs = lcd.minimumBusUs();
+  result.lcdSlackUs = lcd.slackUs();
+  if (listViolations && lcd.violationCount()) {
+    printf("LCD timing violations in run %u:\n", run);
+    for (size_t i = 0; i < lcd.violations().size(); i++) {
+      const Hd44780Violation &violation = lcd.violations()[i];
+      char previous[32];
+      Hd44780Checker::describe(violation.previousData, violation.previous, previous, sizeof(previous));
+      printf("  %10.3fms  %s, byte 0x%02x after %s", violation.time / 1000.0, violation.rule, violation.pins, previous);
+      if (violation.earlyUs) {
+        printf(", %uus early", violation.earlyUs);
+      }
+      printf("\n");
+    }
+    if (lcd.violationCount() > lcd.violations().size()) {
+      printf("  and %u more\n", lcd.violationCount() - (uint32_t)lcd.violations().size());
+    }
+    printf("\n");
+  }
+  result.simulatedUs = clock.micros();
+  return result;
+}
@@ -0,0 +1,71 @@
+#ifndef Scenario_h
+#define Scenario_h
+
+#include "Hx711Model.h"
+#include "SimNetwork.h"
+#include <string>
+#include <vector>
+
+// what main.cpp has where, the models are wired the same way
+#define SIM_HX711_DOUT 13
+#define SIM_HX711_SCK 12
+#define SIM_LCD_ADDRESS 0x27
+#define SIM_LCD_COLS 16
+#define SIM_LCD_ROWS 2
+#define SIM_WEIGHT_ROW 1
+
+struct LoadStep {
+  uint32_t ms;
+  float grams;
+};
+
+struct ButtonPress {
+  uint8_t pin;
+  uint32_t ms;
+  uint32_t holdMs;
+};
+
+// One configuration of scale, user and network, run many times with a
+// different seed each: the noise and the phase of the HX711 conversions
+// against the load are all that changes between runs.
+struct Scenario {
+  uint32_t runs;
+  uint32_t seed;
+  uint32_t durationMs;          // from power on, 0 to end 3s after the last load or press
+  float toleranceGrams;         // how close to the load the screen has to stay to count as settled
+  uint32_t loopUs;              // cost of one loop() pass and of every yield()
+  uint32_t i2cHz;
+  bool verbose;                 // Serial to stdout
+  LoadCellConfig cell;
+  NetworkConfig network;
+  std::vector<LoadStep> loads;
+  std::vector<ButtonPress> presses;
+};
+
+// what one run measured, times in microseconds and -1 when it never happened
+struct RunResult {
+  int64_t settledUs;            // last load to the weight row showing it for good
+  int64_t postedUs;             // last send press to its reading reaching the collector
+  int64_t endToEndUs;           // last load to that reading reaching the collector
+  int32_t shownGrams;           // weight row at the end, INT32_MIN if it shows no weight
+  int32_t postedGrams;
+  float sentLoad;               // what was on the scale when send was pressed
+  uint32_t conversions;
+  uint32_t loopPasses;
+  uint64_t i2cBytes;
+  uint64_t i2cBusyUs;
+  uint32_t lcdViolations;
+  uint32_t lcdMinimumBytes;
+  uint64_t lcdMinimumBusUs;
+  uint64_t lcdSlackUs;
+  uint64_t simulatedUs;
+};
+
+void defaultScenario(Scenario &scenario);
+bool parseScenario(int argc, char **argv, Scenario &scenario, std::string &error);
+std::string describeScenario(const Scenario &scenario);
+// runs the firmware once from setup() in this process, which must not have run it before,
+// and lists the LCD timing violations on stdout when asked to
+RunResult runScenario(const Scenario &scenario, uint32_t run, const char *fsRoot, bool listViolations);
+
+#endif
@@ -0,0 +1,23 @@
+#include "SimClock.h"
+
+void SimClock::at(uint64_t time, Event event) {
+  Scheduled scheduled = { time < _now ? _now : time, _scheduled++, event };
+  _events.push(scheduled);
+}
+
+// An event may sleep as well (an interrupt clocking out the HX711 does), which
+// runs later events from in there and can leave the clock past target.
+void SimClock::advance(uint64_t us) {
+  uint64_t target = _now + us;
+  while (!_events.empty() && _events.top().time <= target) {
+    Scheduled next = _events.top();
+    _events.pop();
+    if (next.time > _now) {
+      _now = next.time;
+    }
+    next.event();
+  }
+  if (target > _now) {
+    _now = target;
+  }
+}
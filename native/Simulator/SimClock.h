@@ -0,0 +1,43 @@
+#ifndef SimClock_h
+#define SimClock_h
+
+#include <Hal.h>
+#include <functional>
+#include <queue>
+#include <vector>
+
+// Virtual time. Nothing moves it but the firmware itself: every delay() sleeps
+// it forward, every yield() and loop() pass costs idleUs, and an I2C transaction
+// its bus time. Whatever the models scheduled for that stretch runs on the way,
+// in time order and in the order it was scheduled for the same microsecond, so
+// a run only depends on its configuration and seed.
+class SimClock : public HalClock {
+public:
+  typedef std::function<void()> Event;
+
+  explicit SimClock(uint32_t idleUs) : _now(0), _idleUs(idleUs), _scheduled(0) {}
+  uint64_t micros() { return _now; }
+  void sleep(uint32_t us) { advance(us); }
+  void idle() { advance(_idleUs); }
+
+  void at(uint64_t time, Event event);
+  void advance(uint64_t us);
+
+private:
+  struct Scheduled {
+    uint64_t time;
+    uint64_t order;
+    Event event;
+  };
+  struct Later {
+    bool operator()(const Scheduled &a, const Scheduled &b) const {
+      return a.time != b.time ? a.time > b.time : a.order > b.order;
+    }
+  };
+  uint64_t _now;
+  uint32_t _idleUs;
+  uint64_t _scheduled;
+  std::priority_queue<Scheduled, std::vector<Scheduled>, Later> _events;
+};
+
+#endif
@@ -0,0 +1,32 @@
+#include "SimGpio.h"
+
+SimGpio::SimGpio() {
+  for (uint8_t pin = 0; pin < SIM_PIN_COUNT; pin++) {
+    _level[pin] = 1;
+  }
+}
+
+void SimGpio::write(uint8_t pin, uint8_t value) {
+  if (pin >= SIM_PIN_COUNT) {
+    return;
+  }
+  _level[pin] = value ? 1 : 0;
+  if (_listeners[pin]) {
+    _listeners[pin](_level[pin]);
+  }
+}
+
+void SimGpio::drive(uint8_t pin, int level) {
+  level = level ? 1 : 0;
+  if (pin >= SIM_PIN_COUNT || _level[pin] == level) {
+    return;
+  }
+  _level[pin] = level;
+  halPinChanged(pin, level);
+}
+
+void SimGpio::onWrite(uint8_t pin, Listener listener) {
+  if (pin < SIM_PIN_COUNT) {
+    _listeners[pin] = listener;
+  }
+}
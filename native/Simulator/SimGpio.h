@@ -0,0 +1,28 @@
+#ifndef SimGpio_h
+#define SimGpio_h
+
+#include <Hal.h>
+#include <functional>
+
+#define SIM_PIN_COUNT 32
+
+// Pins as the models see them. A model drives the level of an input with
+// drive(), which raises the pin change interrupt, and follows an output with
+// onWrite(). Inputs nothing drives read high, as the pullups leave them.
+class SimGpio : public HalGpio {
+public:
+  typedef std::function<void(int level)> Listener;
+
+  SimGpio();
+  int read(uint8_t pin) { return pin < SIM_PIN_COUNT ? _level[pin] : 1; }
+  void write(uint8_t pin, uint8_t value);
+
+  void drive(uint8_t pin, int level);
+  void onWrite(uint8_t pin, Listener listener);
+
+private:
+  int _level[SIM_PIN_COUNT];
+  Listener _listeners[SIM_PIN_COUNT];
+};
+
+#endif
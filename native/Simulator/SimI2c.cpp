@@ -0,0 +1,21 @@
+#include "SimI2c.h"
+
+uint8_t SimI2c::transmit(uint8_t address, const uint8_t *data, size_t length) {
+  std::map<uint8_t, Device>::iterator device = _devices.find(address);
+  // START and STOP come to about one clock between them
+  uint64_t start = _clock.micros();
+  uint64_t clocks = 1 + 9;
+  if (device == _devices.end()) {
+    _clock.sleep(clocks * 1000000 / _frequency);
+    return 2;
+  }
+  for (size_t i = 0; i < length; i++) {
+    clocks += 9;
+    device->second(start + clocks * 1000000 / _frequency, data[i]);
+  }
+  uint64_t us = clocks * 1000000 / _frequency;
+  _bytes += length;
+  _busyUs += us;
+  _clock.sleep(us);
+  return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef SimI2c_h
+#define SimI2c_h
+
+#include "SimClock.h"
+#include <functional>
+#include <map>
+
+// The I2C bus. A transaction takes its bus time (START, address, 9 clocks a
+// byte, STOP) off the clock, and each byte reaches its device with the time it
+// was acked. Nobody answers on addresses without a device.
+class SimI2c : public HalI2c {
+public:
+  typedef std::function<void(uint64_t timeUs, uint8_t value)> Device;
+
+  SimI2c(SimClock &clock, uint32_t frequency) : _clock(clock), _frequency(frequency), _bytes(0), _busyUs(0) {}
+  void attach(uint8_t address, Device device) { _devices[address] = device; }
+  uint8_t transmit(uint8_t address, const uint8_t *data, size_t length);
+
+  uint64_t bytes() const { return _bytes; }       // data bytes acked, all devices
+  uint64_t busyUs() const { return _busyUs; }     // time the bus was in use
+
+private:
+  SimClock &_clock;
+  uint32_t _frequency;
+  std::map<uint8_t, Device> _devices;
+  uint64_t _bytes;
+  uint64_t _busyUs;
+};
+
+#endif
@@ -0,0 +1,178 @@
+#include "SimNetwork.h"
+#include <string.h>
+#include <stdlib.h>
+
+// 2026-01-01T00:00:00Z, what the NTP server says at time zero
+#define SIM_EPOCH_SECONDS 1767225600ULL
+#define NTP_UNIX_OFFSET 2208988800ULL
+
+namespace {
+
+struct Timed {
+  uint64_t time;
+  uint8_t value;
+};
+
+// the scale's end of a connection to the collector
+class CollectorSocket : public HalSocket {
+public:
+  explicit CollectorSocket(SimNetwork &network)
+    : _network(network), _closed(false), _hostClosedAt(UINT64_MAX), _length(-1) {}
+
+  int available() {
+    uint64_t now = _network.clock().micros();
+    int n = 0;
+    for (std::deque<Timed>::iterator i = _in.begin(); i != _in.end() && i->time <= now; ++i) {
+      n++;
+    }
+    return n;
+  }
+
+  int read(uint8_t *buffer, size_t size) {
+    uint64_t now = _network.clock().micros();
+    size_t n = 0;
+    while (n < size && !_in.empty() && _in.front().time <= now) {
+      buffer[n++] = _in.front().value;
+      _in.pop_front();
+    }
+    return (int)n;
+  }
+
+  int peek() {
+    return available() ? _in.front().value : -1;
+  }
+
+  size_t write(const uint8_t *data, size_t length) {
+    if (!connected()) {
+      return 0;
+    }
+    uint64_t arrival = _network.clock().micros() + _network.config().latencyUs;
+    for (size_t i = 0; i < length; i++) {
+      receive(arrival, data[i]);
+    }
+    return length;
+  }
+
+  int writable() { return connected() ? 2920 : 0; }
+
+  bool connected() {
+    return !_closed && (_network.clock().micros() < _hostClosedAt || available() > 0);
+  }
+
+  void close() { _closed = true; }
+
+private:
+  // the collector's side, one byte at a time as it arrives
+  void receive(uint64_t time, uint8_t c) {
+    if (_length < 0) {
+      _head += (char)c;
+      if (_head.size() < 4 || _head.compare(_head.size() - 4, 4, "\r\n\r\n") != 0) {
+        return;
+      }
+      const char *length = strcasestr(_head.c_str(), "\r\nContent-Length:");
+      _length = length ? atol(length + 17) : 0;
+      _body.clear();
+    } else {
+      _body += (char)c;
+    }
+    if ((long)_body.size() < _length) {
+      return;
+    }
+    respond(time);
+    _head.clear();
+    _length = -1;
+  }
+
+  void respond(uint64_t time) {
+    size_t space = _head.find(' ');
+    std::string method = _head.substr(0, space);
+    std::string path = _head.substr(space + 1, _head.find(' ', space + 1) - space - 1);
+    const char *response = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    bool close = false;
+    if (method == "POST") {
+      SimPost post = { time, path, _body };
+      _network.post(post);
+      response = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+    } else if (method == "GET" && path == "/foods") {
+      response = "HTTP/1.1 304 Not Modified\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+      close = true;
+    }
+    // answers go out in order, never before the one in front
+    uint64_t at = time + _network.config().serverUs + _network.config().latencyUs;
+    if (!_in.empty() && _in.back().time > at) {
+      at = _in.back().time;
+    }
+    for (const char *p = response; *p; p++) {
+      Timed timed = { at, (uint8_t)*p };
+      _in.push_back(timed);
+    }
+    if (close) {
+      _hostClosedAt = at;
+    }
+  }
+
+  SimNetwork &_network;
+  bool _closed;
+  uint64_t _hostClosedAt;
+  std::deque<Timed> _in;
+  std::string _head;
+  std::string _body;
+  long _length;                 // body still to come, -1 while reading the headers
+};
+
+}
+
+SimNetwork::SimNetwork(SimClock &clock, const NetworkConfig &config)
+  : _clock(clock), _config(config), _joined(false), _upAt(0) {}
+
+void SimNetwork::join(const char */*ssid*/, const char */*password*/) {
+  _joined = true;
+  _upAt = _clock.micros() + (uint64_t)_config.joinMs * 1000;
+}
+
+HalSocketPtr SimNetwork::connect(const char */*host*/, uint16_t port) {
+  if (!linkUp() || port != _config.collectorPort) {
+    return HalSocketPtr();
+  }
+  // the handshake is one round trip
+  _clock.sleep(2 * _config.latencyUs);
+  return HalSocketPtr(new CollectorSocket(*this));
+}
+
+// only NTP is answered, with the transmit time of the request echoed as the originate time
+bool SimNetwork::sendDatagram(uint16_t localPort, const char */*host*/, uint16_t port, const uint8_t *data, size_t length) {
+  if (!linkUp()) {
+    return false;
+  }
+  if (port != 123 || length < 48) {
+    return true;
+  }
+  Datagram reply;
+  reply.time = _clock.micros() + 2 * _config.latencyUs;
+  reply.port = localPort;
+  reply.data.assign(48, 0);
+  reply.data[0] = 0x24;         // version 4, server mode
+  reply.data[1] = 2;            // stratum
+  memcpy(&reply.data[24], data + 40, 8);
+  uint64_t serverUs = _clock.micros() + _config.latencyUs;
+  uint64_t seconds = SIM_EPOCH_SECONDS + NTP_UNIX_OFFSET + serverUs / 1000000;
+  uint64_t fraction = ((serverUs % 1000000) << 32) / 1000000;
+  for (uint8_t i = 0; i < 4; i++) {
+    reply.data[40 + i] = (uint8_t)(seconds >> (24 - 8 * i));
+    reply.data[44 + i] = (uint8_t)(fraction >> (24 - 8 * i));
+  }
+  _datagrams.push_back(reply);
+  return true;
+}
+
+int SimNetwork::receiveDatagram(uint16_t localPort, uint8_t *buffer, size_t size) {
+  for (std::deque<Datagram>::iterator i = _datagrams.begin(); i != _datagrams.end(); ++i) {
+    if (i->port == localPort && i->time <= _clock.micros()) {
+      size_t n = i->data.size() < size ? i->data.size() : size;
+      memcpy(buffer, &i->data[0], n);
+      _datagrams.erase(i);
+      return (int)n;
+    }
+  }
+  return -1;
+}
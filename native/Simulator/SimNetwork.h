@@ -0,0 +1,58 @@
+#ifndef SimNetwork_h
+#define SimNetwork_h
+
+#include "SimClock.h"
+#include <deque>
+#include <string>
+#include <vector>
+
+struct NetworkConfig {
+  uint32_t joinMs;              // from WiFi.begin() to the link being up
+  uint32_t latencyUs;           // one way, scale to collector and back the same
+  uint32_t serverUs;            // collector time per request
+  uint16_t collectorPort;       // what the collector listens on, any other port refuses
+};
+
+struct SimPost {
+  uint64_t time;                // when the last byte reached the collector
+  std::string path;
+  std::string body;
+};
+
+// The network around the scale: the access point, the collector and an NTP
+// server, all on the far side of the same fixed latency. The collector answers
+// every POST with 200 after serverUs and recorded it, and GET /foods with 304
+// so the catalog stays as it is. Requests are parsed as they are written, with
+// the time they arrive, so nothing has to run on the collector's side.
+class SimNetwork : public HalNetwork {
+public:
+  SimNetwork(SimClock &clock, const NetworkConfig &config);
+  void join(const char *ssid, const char *password);
+  void leave() { _joined = false; }
+  bool linkUp() { return _joined && _clock.micros() >= _upAt; }
+  uint32_t localIp() { return linkUp() ? 0x3200a8c0 : 0; }    // 192.168.0.50
+  HalSocketPtr connect(const char *host, uint16_t port);
+  HalSocketPtr accept(uint16_t /*port*/) { return HalSocketPtr(); }
+  bool sendDatagram(uint16_t localPort, const char *host, uint16_t port, const uint8_t *data, size_t length);
+  int receiveDatagram(uint16_t localPort, uint8_t *buffer, size_t size);
+
+  const std::vector<SimPost> &posts() const { return _posts; }
+  void post(const SimPost &post) { _posts.push_back(post); }
+  SimClock &clock() { return _clock; }
+  const NetworkConfig &config() const { return _config; }
+
+private:
+  struct Datagram {
+    uint64_t time;
+    uint16_t port;
+    std::vector<uint8_t> data;
+  };
+  SimClock &_clock;
+  NetworkConfig _config;
+  bool _joined;
+  uint64_t _upAt;
+  std::vector<SimPost> _posts;
+  std::deque<Datagram> _datagrams;
+};
+
+#endif
@@ -0,0 +1,169 @@
+// Runs the firmware under virtual time against the models in this library,
+// many times over, and reports how long a reading takes to show and to send,
+// and how the LCD driver did against the HD44780's timing. Exits with 1 when
+// a run crashed or broke the LCD timing.
+// Every run forks from a process that has never called setup(), so the
+// firmware's globals start fresh each time, and gets its own LittleFS directory.
+
+#include "Scenario.h"
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace {
+
+void removeTree(const char *path) {
+  DIR *dir = opendir(path);
+  if (!dir) {
+    return;
+  }
+  while (dirent *entry = readdir(dir)) {
+    if (strcmp(entry->d_name, ".") && strcmp(entry->d_name, "..")) {
+      std::string file = std::string(path) + "/" + entry->d_name;
+      unlink(file.c_str());
+    }
+  }
+  closedir(dir);
+  rmdir(path);
+}
+
+bool runOnce(const Scenario &scenario, uint32_t run, bool listViolations, RunResult &result) {
+  char fsRoot[] = "/tmp/scalesim.XXXXXX";
+  int fds[2];
+  if (!mkdtemp(fsRoot) || pipe(fds) != 0) {
+    perror("scalesim");
+    exit(1);
+  }
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fds[0]);
+    RunResult measured = runScenario(scenario, run, fsRoot, listViolations);
+    fflush(stdout);
+    ssize_t written = write(fds[1], &measured, sizeof(measured));
+    _exit(written == sizeof(measured) ? 0 : 1);
+  }
+  close(fds[1]);
+  ssize_t got = pid > 0 ? read(fds[0], &result, sizeof(result)) : -1;
+  close(fds[0]);
+  int status = 0;
+  if (pid > 0) {
+    waitpid(pid, &status, 0);
+  }
+  removeTree(fsRoot);
+  return got == sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// nearest rank
+double percentile(std::vector<int64_t> values, double p) {
+  std::sort(values.begin(), values.end());
+  size_t rank = (size_t)(p / 100 * values.size() + 0.999999);
+  return values[rank ? rank - 1 : 0] / 1000.0;
+}
+
+void report(const char *name, const std::vector<int64_t> &values, uint32_t runs) {
+  if (values.empty()) {
+    printf("%-18s  never in %u runs\n", name, runs);
+    return;
+  }
+  printf("%-18s %8.1f %8.1f %8.1f %8.1f", name, percentile(values, 50), percentile(values, 90),
+         percentile(values, 99), percentile(values, 100));
+  if (values.size() < runs) {
+    printf("   missing in %u runs", runs - (uint32_t)values.size());
+  }
+  printf("\n");
+}
+
+void usage() {
+  fprintf(stderr,
+    "usage: scalesim [options]\n"
+    "  --runs N --seed N --duration MS --tolerance GRAMS --loop-us US --i2c-hz HZ --verbose\n"
+    "  --sps 10|80 --counts-per-gram F --noise COUNTS --drift COUNTS/S --settle-ms MS --ring-hz HZ\n"
+    "  --join-ms MS --latency-us US --server-us US\n"
+    "  --load GRAMS@MS ...      default 250@4000\n"
+    "  --press tare|send|left|right@MS[+HOLDMS] ...   default send 3s after the last load\n");
+}
+
+}
+
+int main(int argc, char **argv) {
+  Scenario scenario;
+  std::string error;
+  defaultScenario(scenario);
+  if (!parseScenario(argc, argv, scenario, error)) {
+    if (!error.empty()) {
+      fprintf(stderr, "scalesim: %s\n", error.c_str());
+    }
+    usage();
+    return error.empty() ? 0 : 2;
+  }
+  printf("%s\n\n", describeScenario(scenario).c_str());
+
+  std::vector<int64_t> settled, posted, endToEnd;
+  double shownError = 0, postedError = 0;
+  uint32_t shown = 0, sent = 0, crashed = 0;
+  uint64_t simulatedUs = 0, i2cBytes = 0, i2cBusyUs = 0, passes = 0;
+  uint64_t lcdViolations = 0, lcdMinimumBytes = 0, lcdMinimumBusUs = 0, lcdSlackUs = 0;
+  float load = 0;
+  for (size_t i = 0; i < scenario.loads.size(); i++) {
+    load += scenario.loads[i].grams;
+  }
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (uint32_t run = 0; run < scenario.runs; run++) {
+    RunResult result;
+    // the violations of the first run that has any are listed as it goes
+    if (!runOnce(scenario, run, lcdViolations == 0, result)) {
+      crashed++;
+      continue;
+    }
+    if (result.settledUs >= 0) settled.push_back(result.settledUs);
+    if (result.postedUs >= 0) posted.push_back(result.postedUs);
+    if (result.endToEndUs >= 0) endToEnd.push_back(result.endToEndUs);
+    if (result.shownGrams != INT32_MIN) {
+      shownError += fabs(result.shownGrams - load);
+      shown++;
+    }
+    if (result.postedGrams != INT32_MIN) {
+      postedError += fabs(result.postedGrams - result.sentLoad);
+      sent++;
+    }
+    simulatedUs += result.simulatedUs;
+    i2cBytes += result.i2cBytes;
+    i2cBusyUs += result.i2cBusyUs;
+    passes += result.loopPasses;
+    lcdViolations += result.lcdViolations;
+    lcdMinimumBytes += result.lcdMinimumBytes;
+    lcdMinimumBusUs += result.lcdMinimumBusUs;
+    lcdSlackUs += result.lcdSlackUs;
+  }
+  double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  uint32_t runs = scenario.runs - crashed;
+
+  printf("%-18s %8s %8s %8s %8s   ms\n", "", "p50", "p90", "p99", "max");
+  report("load -> settled", settled, runs);
+  report("send -> posted", posted, runs);
+  report("load -> posted", endToEnd, runs);
+  printf("\n");
+  if (shown) printf("shown weight off by %.2fg on average\n", shownError / shown);
+  if (sent) printf("posted weight off by %.2fg on average\n", postedError / sent);
+  if (runs) {
+    printf("%llu loop passes and %llu I2C bytes (bus busy %.1f%%) per run\n", (unsigned long long)(passes / runs),
+           (unsigned long long)(i2cBytes / runs), simulatedUs ? 100.0 * i2cBusyUs / simulatedUs : 0.0);
+    // the LCD is the only thing on the bus
+    printf("LCD bus time %.1fms per run, %.1fms at the minimum of %llu bytes\n", i2cBusyUs / 1000.0 / runs,
+           lcdMinimumBusUs / 1000.0 / runs, (unsigned long long)(lcdMinimumBytes / runs));
+    printf("LCD waited %.1fms per run longer than needed between back to back strobes\n", lcdSlackUs / 1000.0 / runs);
+    printf("LCD timing violations: %llu\n", (unsigned long long)lcdViolations);
+  }
+  if (crashed) printf("%u runs crashed\n", crashed);
+  printf("%u runs, %.1fs simulated in %.2fs, %.0fx real time\n", scenario.runs, simulatedUs / 1e6, wall,
+         wall > 0 ? simulatedUs / 1e6 / wall : 0.0);
+  return crashed || lcdViolations ? 1 : 0;
+}
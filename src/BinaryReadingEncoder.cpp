@@ -0,0 +1,34 @@
+#include "BinaryReadingEncoder.h"
+#include <TelemetryCodec.h>
+
+BinaryReadingEncoder::BinaryReadingEncoder(Format format) {
+  _format = format;
+}
+
+const char *BinaryReadingEncoder::contentType() {
+  return (_format == CBOR) ? TELEMETRY_CBOR_TYPE : TELEMETRY_RECORD_TYPE;
+}
+
+// a CBOR batch is an array, a single reading is the bare map.
+// records need no framing, the body length says how many there are
+size_t BinaryReadingEncoder::begin(uint8_t count, Print &out) {
+  if (_format != CBOR || count < 2) {
+    return 0;
+  }
+  uint8_t head[9];
+  return out.write(head, TelemetryCodec::encodeCborArray(count, head));
+}
+
+size_t BinaryReadingEncoder::item(const Reading &reading, uint8_t /*index*/, uint8_t /*count*/, Print &out) {
+  TelemetryReading telemetry;
+  telemetry.seq = reading.seq;
+  telemetry.timestamp = reading.time;
+  telemetry.weight = reading.weight;
+  telemetry.food = reading.food;
+  telemetry.flags = (reading.flags & READING_EPOCH) ? TELEMETRY_FLAG_EPOCH : 0;
+
+  uint8_t buffer[TELEMETRY_CBOR_MAX];
+  size_t length = (_format == CBOR) ? TelemetryCodec::encodeCbor(telemetry, buffer)
+                                    : TelemetryCodec::encodeRecord(telemetry, buffer);
+  return out.write(buffer, length);
+}
@@ -0,0 +1,30 @@
+#ifndef ButtonEvents_h
+#define ButtonEvents_h
+
+#include <inttypes.h>
+#include <ButtonDebounce.h>
+#include "RingBuffer.h"
+
+// gestures buffered between loop() passes
+#define BUTTON_QUEUE_SIZE 16
+// the pins are sampled this often
+#define BUTTON_TICK_MS 5
+// samples in a row a button has to agree on, 20ms
+#define BUTTON_INTEGRATE 4
+// held this long for a long press, then repeats this often while still held
+#define BUTTON_LONG_PRESS_MS 500
+#define BUTTON_REPEAT_MS 80
+
+// bit numbers in the sampled mask
+enum ButtonId { BUTTON_TARE, BUTTON_SEND, BUTTON_LEFT, BUTTON_RIGHT, BUTTON_COUNT };
+
+// what the sampling tick records, nothing else happens outside loop()
+struct ButtonEvent {
+  uint8_t button;         // ButtonId
+  uint8_t gesture;        // ButtonGesture
+  unsigned long time;     // millis() at the tick that produced it
+};
+
+typedef RingBuffer<ButtonEvent, BUTTON_QUEUE_SIZE> ButtonQueue;
+
+#endif
@@ -0,0 +1,158 @@
+#include "CatalogUpdater.h"
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+CatalogUpdater::CatalogUpdater(Client &client, const char *host, uint16_t port, const char *path,
+                               FoodCatalogWriter &writer, FoodIndexWriter &indexer)
+  : _client(client), _writer(writer), _indexer(indexer) {
+  _host = host;
+  _port = port;
+  _path = path;
+  _state = IDLE;
+  _lineLen = 0;
+  _status = 0;
+  _remaining = 0;
+  _lastProgress = 0;
+  _updated = false;
+}
+
+bool CatalogUpdater::start(uint32_t revision, unsigned long now) {
+  if (_state != IDLE) {
+    return false;
+  }
+  _status = 0;
+  _updated = false;
+  if (!_client.connect(_host, _port)) {
+    return false;
+  }
+  // HTTP/1.0 so the body is never chunked, it ends at Content-Length or when the server closes
+  _client.print("GET ");
+  _client.print(_path);
+  _client.print(" HTTP/1.0\r\nHost: ");
+  _client.print(_host);
+  _client.print(":");
+  _client.print((unsigned int)_port);
+  _client.print("\r\nIf-None-Match: \"");
+  _client.print((unsigned long)revision);
+  _client.print("\"\r\n\r\n");
+  _state = STATUS_LINE;
+  _lineLen = 0;
+  _remaining = -1;
+  _lastProgress = now;
+  return true;
+}
+
+bool CatalogUpdater::poll(unsigned long now) {
+  if (_state == IDLE) {
+    return false;
+  }
+  if (_state == INDEXING) {
+    if (!_indexer.poll()) {
+      finish(_indexer.finish());
+    }
+    return _state == IDLE;
+  }
+
+  if (_state == BODY) {
+    if (receiveBody()) {
+      _lastProgress = now;
+    }
+  } else {
+    while (_client.available() > 0 && (_state == STATUS_LINE || _state == HEADERS)) {
+      consume((char)_client.read());
+      _lastProgress = now;
+    }
+  }
+  if (_state == BODY && (_remaining == 0 || (!_client.connected() && _client.available() <= 0))) {
+    // a body without a length ends when the server closes, the writer knows if it got all of it
+    _client.stop();
+    if (_writer.finish() && _indexer.begin()) {
+      _state = INDEXING;
+    } else {
+      finish(false);
+    }
+  } else if (_state != IDLE && _state != INDEXING && (now - _lastProgress >= CATALOG_TIMEOUT_MS ||
+             (!_client.connected() && _client.available() <= 0))) {
+    finish(false);
+  }
+  return _state == IDLE;
+}
+
+bool CatalogUpdater::receiveBody() {
+  uint8_t buffer[64];
+  size_t budget = CATALOG_POLL_BYTES;
+  bool progress = false;
+  while (budget > 0 && _remaining != 0) {
+    int available = _client.available();
+    if (available <= 0) {
+      break;
+    }
+    size_t want = sizeof(buffer);
+    if (want > (size_t)available) {
+      want = available;
+    }
+    if (want > budget) {
+      want = budget;
+    }
+    if (_remaining > 0 && want > (size_t)_remaining) {
+      want = _remaining;
+    }
+    int n = _client.read(buffer, want);
+    if (n <= 0) {
+      break;
+    }
+    progress = true;
+    budget -= n;
+    if (_remaining > 0) {
+      _remaining -= n;
+    }
+    if (!_writer.write(buffer, n)) {
+      finish(false);
+      return false;
+    }
+  }
+  return progress;
+}
+
+void CatalogUpdater::consume(char c) {
+  if (c == '\n') {
+    _line[_lineLen] = 0;
+    handleLine();
+    _lineLen = 0;
+  } else if (c != '\r' && _lineLen < CATALOG_LINE_SIZE - 1) {
+    _line[_lineLen++] = c;
+  }
+}
+
+void CatalogUpdater::handleLine() {
+  if (_state == STATUS_LINE) {
+    // "HTTP/1.1 200 OK"
+    if (strncmp(_line, "HTTP/", 5) == 0) {
+      const char *code = strchr(_line, ' ');
+      _status = code ? atoi(code + 1) : 0;
+      _state = HEADERS;
+    }
+    return;
+  }
+  if (_lineLen == 0) {
+    // end of headers, only a 200 has a catalog in it, a 304 means ours is current
+    if (_status == 200 && _writer.begin()) {
+      _state = BODY;
+    } else {
+      finish(false);
+    }
+    return;
+  }
+  if (strncasecmp(_line, "Content-Length:", 15) == 0) {
+    _remaining = atol(_line + 15);
+  }
+}
+
+void CatalogUpdater::finish(bool updated) {
+  if (_client.connected()) {
+    _client.stop();
+  }
+  _updated = updated;
+  _state = IDLE;
+}
@@ -0,0 +1,56 @@
+#ifndef CatalogUpdater_h
+#define CatalogUpdater_h
+
+#include <Arduino.h>
+#include <Client.h>
+#include <FoodCatalog.h>
+
+// longest response line we look at, longer headers are cut off
+#define CATALOG_LINE_SIZE 64
+// body bytes written to flash per poll()
+#define CATALOG_POLL_BYTES 512
+// give up when nothing arrived for this long
+#define CATALOG_TIMEOUT_MS 10000
+
+// Downloads a newer food catalog from the collector without holding up loop().
+// start() writes a GET carrying the revision we have as the ETag, so an up to
+// date scale gets a 304 and nothing else. poll() parses the response as it
+// trickles in and feeds the body to the writer at most CATALOG_POLL_BYTES at a
+// time, then builds the id index of the new file one indexer step per call.
+// The old catalog is never touched, poll() returns true once the download is
+// over and updated() says whether the writer's and indexer's files hold a
+// complete catalog for the caller to swap in.
+// connect() itself still blocks for the TCP handshake, once per download.
+class CatalogUpdater {
+public:
+  CatalogUpdater(Client &client, const char *host, uint16_t port, const char *path,
+                 FoodCatalogWriter &writer, FoodIndexWriter &indexer);
+  bool start(uint32_t revision, unsigned long now);   // false if busy or the connection failed
+  bool poll(unsigned long now);                       // true on the call the download ends
+  bool busy() const { return _state != IDLE; }
+  bool updated() const { return _updated; }
+  int status() const { return _status; }              // HTTP code of the last download, 0 if it never got one
+
+private:
+  void consume(char c);
+  void handleLine();
+  bool receiveBody();
+  void finish(bool updated);
+  Client &_client;
+  const char *_host;
+  uint16_t _port;
+  const char *_path;
+  FoodCatalogWriter &_writer;
+  FoodIndexWriter &_indexer;
+
+  enum State { IDLE, STATUS_LINE, HEADERS, BODY, INDEXING };
+  State _state;
+  char _line[CATALOG_LINE_SIZE];
+  uint8_t _lineLen;
+  int _status;
+  long _remaining;        // body bytes still to come, -1 when the server didn't say
+  unsigned long _lastProgress;
+  bool _updated;
+};
+
+#endif
@@ -0,0 +1,17 @@
+#include "Esp8266WifiDriver.h"
+#include <ESP8266WiFi.h>
+
+void Esp8266WifiDriver::begin(const char *ssid, const char *password) {
+  WiFi.persistent(false);
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);
+  WiFi.begin(ssid, password);
+}
+
+bool Esp8266WifiDriver::connected() {
+  return WiFi.status() == WL_CONNECTED;
+}
+
+void Esp8266WifiDriver::disconnect() {
+  WiFi.disconnect();
+}
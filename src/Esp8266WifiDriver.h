@@ -0,0 +1,15 @@
+#ifndef Esp8266WifiDriver_h
+#define Esp8266WifiDriver_h
+
+#include "WifiManager.h"
+
+// WifiDriver on top of the ESP8266 station. The SDK's own reconnect and the
+// credential writes to flash are turned off, WifiManager decides when to retry.
+class Esp8266WifiDriver : public WifiDriver {
+public:
+  void begin(const char *ssid, const char *password);
+  bool connected();
+  void disconnect();
+};
+
+#endif
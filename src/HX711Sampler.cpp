@@ -0,0 +1,77 @@
+#include "HX711Sampler.h"
+
+HX711Sampler *HX711Sampler::_instance = 0;
+
+HX711Sampler::HX711Sampler(uint8_t dout, uint8_t sck, uint8_t gain) {
+  _dout = dout;
+  _sck = sck;
+  switch (gain) {
+    case 64:  _gainPulses = 3; break;   // channel A, gain 64
+    case 32:  _gainPulses = 2; break;   // channel B, gain 32
+    default:  _gainPulses = 1; break;   // channel A, gain 128
+  }
+}
+
+void HX711Sampler::begin(bool useInterrupt) {
+  pinMode(_sck, OUTPUT);
+  pinMode(_dout, INPUT);
+  digitalWrite(_sck, LOW);
+  // the gain only takes effect after one conversion has been clocked out with it
+  if (digitalRead(_dout) == LOW) {
+    shiftIn();
+  }
+  if (useInterrupt) {
+    _instance = this;
+    attachInterrupt(digitalPinToInterrupt(_dout), dataReady, FALLING);
+  }
+}
+
+bool IRAM_ATTR HX711Sampler::poll() {
+  if (digitalRead(_dout) != LOW) {
+    return false;
+  }
+  ScaleSample sample;
+  sample.value = decode(shiftIn());
+  sample.time = millis();
+  return _samples.push(sample);
+}
+
+bool HX711Sampler::read(ScaleSample &sample) {
+  return _samples.pop(sample);
+}
+
+long IRAM_ATTR HX711Sampler::decode(uint32_t raw) {
+  raw &= 0xFFFFFF;
+  if (raw & 0x800000) {
+    raw |= 0xFF000000;
+  }
+  return (long)(int32_t)raw;
+}
+
+// DOUT also toggles while the bits are being clocked out, those edges land here
+// again once we return but DOUT is high by then so they are ignored by poll()
+void IRAM_ATTR HX711Sampler::dataReady() {
+  if (_instance) {
+    _instance->poll();
+  }
+}
+
+// SCK must not stay high for more than 60us or the HX711 powers down,
+// which is fine here since nothing can interrupt an ISR on the ESP8266
+uint32_t IRAM_ATTR HX711Sampler::shiftIn() {
+  uint32_t value = 0;
+  for (uint8_t i = 0; i < 24; i++) {
+    digitalWrite(_sck, HIGH);
+    delayMicroseconds(1);
+    value = (value << 1) | digitalRead(_dout);
+    digitalWrite(_sck, LOW);
+    delayMicroseconds(1);
+  }
+  for (uint8_t i = 0; i < _gainPulses; i++) {
+    digitalWrite(_sck, HIGH);
+    delayMicroseconds(1);
+    digitalWrite(_sck, LOW);
+    delayMicroseconds(1);
+  }
+  return value;
+}
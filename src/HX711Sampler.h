@@ -0,0 +1,44 @@
+#ifndef HX711Sampler_h
+#define HX711Sampler_h
+
+#include <Arduino.h>
+#include "RingBuffer.h"
+
+#ifndef IRAM_ATTR
+#define IRAM_ATTR ICACHE_RAM_ATTR
+#endif
+
+// readings buffered between loop() passes, at 80 SPS this covers a 400ms stall
+#define HX711_SAMPLE_BUFFER 32
+
+struct ScaleSample {
+  long value;             // signed 24 bit reading
+  unsigned long time;     // millis() when it was clocked out
+};
+
+// Reads the HX711 without blocking loop(). Each conversion is clocked out when
+// DOUT falls (data ready) from an interrupt, or from poll() when interrupts are
+// not used, and pushed into a lock free ring buffer that loop() drains with read().
+// Only one sampler can use the interrupt since attachInterrupt takes a plain function.
+class HX711Sampler {
+public:
+  HX711Sampler(uint8_t dout, uint8_t sck, uint8_t gain = 128);
+  void begin(bool useInterrupt = true);
+  bool poll();                          // clock out a reading if one is ready, only for begin(false) (timer or loop driven)
+  bool read(ScaleSample &sample);       // never blocks, false when nothing new has arrived
+  uint8_t available() const { return _samples.size(); }
+  uint16_t overflows() const { return _samples.overflows(); }
+
+  static long decode(uint32_t raw);     // sign extend the 24 bit two's complement reading
+
+private:
+  static void IRAM_ATTR dataReady();
+  uint32_t IRAM_ATTR shiftIn();
+  static HX711Sampler *_instance;
+  uint8_t _dout;
+  uint8_t _sck;
+  uint8_t _gainPulses;                  // extra clocks after the 24 data bits select the next channel/gain
+  RingBuffer<ScaleSample, HX711_SAMPLE_BUFFER> _samples;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#include "HostAddress.h"
+#include <ESP8266WiFi.h>
+
+bool HostAddress::connect(Client &client, uint16_t port) {
+  client.setTimeout(HOST_TIMEOUT_MS);
+  if (!_known) {
+    _lookups++;
+    _known = WiFi.hostByName(_name, _address, HOST_TIMEOUT_MS) == 1;
+    if (!_known) {
+      return false;
+    }
+  }
+  if (!client.connect(_address, port)) {
+    _known = false;
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,33 @@
+#ifndef HostAddress_h
+#define HostAddress_h
+
+#include <Arduino.h>
+#include <Client.h>
+#include <IPAddress.h>
+
+// how long a name lookup, a TCP handshake or a write into a full send buffer may
+// hold up loop(), the collector and the broker sit on the same LAN
+#define HOST_TIMEOUT_MS 500
+
+// Where a transport connects to. Client::connect(host) looks the name up on every
+// connect, which on the ESP8266 blocks for the lookup and then for the handshake,
+// each up to the client's timeout (5 s by default). Here the name is looked up
+// once and kept until a connect to it fails, in case DHCP moved the host, and the
+// client's timeout is cut to HOST_TIMEOUT_MS. So a connect() stalls loop() for at
+// most 2 * HOST_TIMEOUT_MS when the name has to be looked up again and
+// HOST_TIMEOUT_MS otherwise. A literal address is never looked up.
+class HostAddress {
+public:
+  explicit HostAddress(const char *name) : _name(name), _known(false), _lookups(0) {}
+  const char *name() const { return _name; }
+  bool connect(Client &client, uint16_t port);    // false when the lookup or the handshake failed
+  uint16_t lookups() const { return _lookups; }
+
+private:
+  const char *_name;
+  IPAddress _address;
+  bool _known;
+  uint16_t _lookups;
+};
+
+#endif
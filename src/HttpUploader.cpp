@@ -0,0 +1,204 @@
+#include "HttpUploader.h"
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+HttpUploader::HttpUploader(Client &client, const char *host, uint16_t port, const char *path)
+  : _client(client), _host(host) {
+  _port = port;
+  _path = path;
+  _encoder = 0;
+  _callback = 0;
+  _batchMax = 1;
+  _batchWait = 0;
+  _head = 0;
+  _sent = 0;
+  _acked = 0;
+  _requests = 0;
+  _firstRequest = 0;
+  _now = 0;
+  _waitingSince = 0;
+  _lastConnect = 0;
+  _connects = 0;
+  _parse = STATUS_LINE;
+  _lineLen = 0;
+  _status = 0;
+  _remaining = 0;
+  _closeAfter = false;
+}
+
+// one reading per request (the default) sends the bare object, more makes a batch
+void HttpUploader::setBatching(uint8_t maxReadings, unsigned long maxWaitMs) {
+  if (maxReadings < 1) {
+    maxReadings = 1;
+  }
+  _batchMax = (maxReadings > UPLOAD_QUEUE_SIZE) ? UPLOAD_QUEUE_SIZE : maxReadings;
+  _batchWait = maxWaitMs;
+}
+
+bool HttpUploader::enqueue(const Reading &reading) {
+  if (pending() == UPLOAD_QUEUE_SIZE) {
+    return false;
+  }
+  _queue[_head & (UPLOAD_QUEUE_SIZE - 1)] = reading;
+  _queuedAt[_head & (UPLOAD_QUEUE_SIZE - 1)] = _now;
+  _head++;
+  return true;
+}
+
+void HttpUploader::poll(unsigned long now, bool online) {
+  _now = now;
+  if (!online) {
+    dropConnection();
+    return;
+  }
+
+  while (_client.available() > 0 && _requests > 0) {
+    consume((char)_client.read());
+  }
+  if (_requests > 0 && now - _waitingSince >= UPLOAD_RESPONSE_TIMEOUT_MS) {
+    dropConnection();
+  }
+  if (!_client.connected()) {
+    dropConnection();
+  }
+
+  if (_sent == _head || _requests >= UPLOAD_MAX_INFLIGHT || !_encoder) {
+    return;
+  }
+  if (!batchReady(now)) {
+    return;     // let the batch fill up a bit more
+  }
+  if (!_client.connected()) {
+    if (_connects > 0 && now - _lastConnect < UPLOAD_RECONNECT_MS) {
+      return;
+    }
+    _lastConnect = now;
+    if (!_host.connect(_client, _port)) {
+      return;
+    }
+    _connects++;
+  }
+  if (_requests == 0) {
+    _waitingSince = now;
+  }
+  // full batches go out back to back, a partial one only once it has waited long enough
+  while (_sent != _head && _requests < UPLOAD_MAX_INFLIGHT && batchReady(now)) {
+    uint8_t unsent = _head - _sent;
+    sendRequest(unsent < _batchMax ? unsent : _batchMax);
+  }
+}
+
+// the next batch is full, or its oldest reading has waited long enough
+bool HttpUploader::batchReady(unsigned long now) const {
+  uint8_t unsent = _head - _sent;
+  return unsent >= _batchMax || now - _queuedAt[_sent & (UPLOAD_QUEUE_SIZE - 1)] >= _batchWait;
+}
+
+size_t HttpUploader::writeBody(uint8_t count, Print &out) {
+  size_t written = _encoder->begin(count, out);
+  for (uint8_t i = 0; i < count; i++) {
+    written += _encoder->item(_queue[(uint8_t)(_sent + i) & (UPLOAD_QUEUE_SIZE - 1)], i, count, out);
+  }
+  return written + _encoder->end(count, out);
+}
+
+void HttpUploader::sendRequest(uint8_t count) {
+  CountingPrint length;
+  writeBody(count, length);
+
+  _client.print("POST ");
+  _client.print(_path);
+  _client.print(" HTTP/1.1\r\nHost: ");
+  _client.print(_host.name());
+  _client.print(":");
+  _client.print((unsigned int)_port);
+  _client.print("\r\nConnection: keep-alive\r\nContent-Type: ");
+  _client.print(_encoder->contentType());
+  _client.print("\r\nContent-Length: ");
+  _client.print((unsigned long)length.count());
+  _client.print("\r\n\r\n");
+  writeBody(count, _client);
+
+  _batchSizes[(uint8_t)(_firstRequest + _requests) & (UPLOAD_MAX_INFLIGHT - 1)] = count;
+  _requests++;
+  _sent += count;
+}
+
+void HttpUploader::consume(char c) {
+  if (_parse == BODY) {
+    if (--_remaining <= 0) {
+      finishResponse();
+    }
+    return;
+  }
+  if (c == '\n') {
+    _line[_lineLen] = 0;
+    handleLine();
+    _lineLen = 0;
+  } else if (c != '\r' && _lineLen < UPLOAD_LINE_SIZE - 1) {
+    _line[_lineLen++] = c;
+  }
+}
+
+void HttpUploader::handleLine() {
+  if (_parse == STATUS_LINE) {
+    // "HTTP/1.1 200 OK", blank lines between responses are skipped
+    if (strncmp(_line, "HTTP/", 5) == 0) {
+      const char *code = strchr(_line, ' ');
+      _status = code ? atoi(code + 1) : 0;
+      _remaining = 0;
+      _closeAfter = false;
+      _parse = HEADERS;
+    }
+    return;
+  }
+  if (_lineLen == 0) {
+    // end of headers
+    if (_remaining > 0) {
+      _parse = BODY;
+    } else {
+      finishResponse();
+    }
+    return;
+  }
+  if (strncasecmp(_line, "Content-Length:", 15) == 0) {
+    _remaining = atol(_line + 15);
+  } else if (strncasecmp(_line, "Connection:", 11) == 0 && strstr(_line + 11, "close")) {
+    _closeAfter = true;
+  } else if (strncasecmp(_line, "Transfer-Encoding:", 18) == 0) {
+    // we never need the body, without a length the only way to find its end is to close
+    _closeAfter = true;
+  }
+}
+
+void HttpUploader::finishResponse() {
+  uint8_t count = _batchSizes[_firstRequest & (UPLOAD_MAX_INFLIGHT - 1)];
+  for (uint8_t i = 0; i < count; i++) {
+    if (_callback) {
+      _callback(_queue[_acked & (UPLOAD_QUEUE_SIZE - 1)], _status);
+    }
+    _acked++;
+  }
+  _firstRequest++;
+  _requests--;
+  _waitingSince = _now;
+  _parse = STATUS_LINE;
+  if (_closeAfter) {
+    dropConnection();
+  }
+}
+
+// readings that were written but not answered are sent again on the next connection
+void HttpUploader::dropConnection() {
+  if (_client.connected()) {
+    _client.stop();
+  }
+  for (uint8_t i = _acked; i != _sent; i++) {
+    _queuedAt[i & (UPLOAD_QUEUE_SIZE - 1)] = _now - _batchWait;   // these have waited already, resend without delay
+  }
+  _sent = _acked;
+  _requests = 0;
+  _parse = STATUS_LINE;
+  _lineLen = 0;
+}
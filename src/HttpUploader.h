@@ -0,0 +1,77 @@
+#ifndef HttpUploader_h
+#define HttpUploader_h
+
+#include <Arduino.h>
+#include <Client.h>
+#include "HostAddress.h"
+#include "ReadingTransport.h"
+
+// readings waiting for a response, must be a power of two
+#define UPLOAD_QUEUE_SIZE 16
+// requests written ahead of their responses on the one connection, must be a power of two
+#define UPLOAD_MAX_INFLIGHT 4
+// longest response line we look at, longer headers are cut off
+#define UPLOAD_LINE_SIZE 64
+#define UPLOAD_RESPONSE_TIMEOUT_MS 5000
+#define UPLOAD_RECONNECT_MS 2000
+
+// Posts readings to the collector over one HTTP/1.1 keep-alive connection.
+// enqueue() never blocks. poll() from loop() packs queued readings into batches
+// of up to maxReadings, sending a batch once it is full or its oldest reading
+// has waited maxWaitMs, and writes up to UPLOAD_MAX_INFLIGHT requests back to
+// back. Bodies are encoded straight into the socket. The responses are parsed
+// as they trickle in and every reading of a batch is handed to the callback
+// with the batch's status. If the connection drops or times out, every
+// reading without a response is sent again on the next connection.
+// Connecting still blocks, once per connection and bounded by HostAddress.
+class HttpUploader : public ReadingTransport {
+public:
+  HttpUploader(Client &client, const char *host, uint16_t port, const char *path);
+  void setEncoder(ReadingEncoder &encoder) { _encoder = &encoder; }
+  void setBatching(uint8_t maxReadings, unsigned long maxWaitMs);
+  void onResult(UploadCallback callback) { _callback = callback; }
+  bool enqueue(const Reading &reading);       // false when the queue is full
+  void poll(unsigned long now, bool online);
+  uint8_t pending() const { return (uint8_t)(_head - _acked); }
+  uint16_t connects() const { return _connects; }
+
+private:
+  bool batchReady(unsigned long now) const;
+  size_t writeBody(uint8_t count, Print &out);
+  void sendRequest(uint8_t count);
+  void consume(char c);
+  void handleLine();
+  void finishResponse();
+  void dropConnection();
+  Client &_client;
+  HostAddress _host;
+  uint16_t _port;
+  const char *_path;
+  ReadingEncoder *_encoder;
+  UploadCallback _callback;
+  uint8_t _batchMax;
+  unsigned long _batchWait;
+
+  Reading _queue[UPLOAD_QUEUE_SIZE];
+  unsigned long _queuedAt[UPLOAD_QUEUE_SIZE];   // poll() time each reading was enqueued at
+  uint8_t _head;          // next free slot
+  uint8_t _sent;          // next reading to write to the connection
+  uint8_t _acked;         // oldest reading still waiting for its response
+  uint8_t _requests;      // requests written and not answered
+  uint8_t _firstRequest;  // slot in _batchSizes of the oldest of them
+  uint8_t _batchSizes[UPLOAD_MAX_INFLIGHT];
+  unsigned long _now;             // time passed to the current poll()
+  unsigned long _waitingSince;
+  unsigned long _lastConnect;
+  uint16_t _connects;
+
+  enum ParseState { STATUS_LINE, HEADERS, BODY };
+  ParseState _parse;
+  char _line[UPLOAD_LINE_SIZE];
+  uint8_t _lineLen;
+  int _status;
+  long _remaining;        // body bytes still to skip
+  bool _closeAfter;       // server wants the connection closed after this response
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "JsonReadingEncoder.h"
+#include "JsonWriter.h"
+
+JsonReadingEncoder::JsonReadingEncoder(FoodNameLookup foodName, bool ndjson) {
+  _foodName = foodName;
+  _ndjson = ndjson;
+}
+
+const char *JsonReadingEncoder::contentType() {
+  return _ndjson ? "application/x-ndjson" : "application/json";
+}
+
+size_t JsonReadingEncoder::begin(uint8_t count, Print &out) {
+  return (!_ndjson && count > 1) ? out.print('[') : 0;
+}
+
+// The field layout is fixed, so keys and punctuation are written as literals
+// and only the values are formatted, straight into out
+size_t JsonReadingEncoder::item(const Reading &reading, uint8_t index, uint8_t /*count*/, Print &out) {
+  size_t written = 0;
+  if (!_ndjson && index > 0) {
+    written += out.print(',');
+  }
+  //epoch ms once SNTP has synced, readings from before that only know how long after boot they were taken
+  written += out.print((reading.flags & READING_EPOCH) ? "{\"timestamp\":" : "{\"uptime\":");
+  written += jsonWriteUnsigned(out, reading.time);
+  written += out.print(",\"seq\":");
+  written += jsonWriteUnsigned(out, reading.seq);
+  written += out.print(",\"weight\":\"");                                    //the collector takes the weight as a string
+  written += jsonWriteSigned(out, reading.weight);
+  written += out.print("\",\"foodtype\":");
+  written += jsonWriteString(out, _foodName(reading.food));
+  written += out.print('}');
+  if (_ndjson) {
+    written += out.print('\n');
+  }
+  return written;
+}
+
+size_t JsonReadingEncoder::end(uint8_t count, Print &out) {
+  return (!_ndjson && count > 1) ? out.print(']') : 0;
+}
@@ -0,0 +1,22 @@
+#ifndef JsonReadingEncoder_h
+#define JsonReadingEncoder_h
+
+#include "ReadingEncoder.h"
+
+// Readings as JSON objects. A single reading is sent as the bare object the
+// collector has always taken, batches as a JSON array, or as NDJSON (one
+// object per line) when ndjson is set.
+class JsonReadingEncoder : public ReadingEncoder {
+public:
+  JsonReadingEncoder(FoodNameLookup foodName, bool ndjson = false);
+  const char *contentType();
+  size_t begin(uint8_t count, Print &out);
+  size_t item(const Reading &reading, uint8_t index, uint8_t count, Print &out);
+  size_t end(uint8_t count, Print &out);
+
+private:
+  FoodNameLookup _foodName;
+  bool _ndjson;
+};
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef JsonWriter_h
+#define JsonWriter_h
+
+#include <Print.h>
+#include <inttypes.h>
+
+// Small JSON output helpers that write straight to a Print, no heap and no
+// intermediate strings. Keys and punctuation are literals at the call site,
+// only values go through here.
+
+// Print into a fixed buffer the caller owns, keeps it NUL terminated.
+// Anything past the end is dropped and overflowed() says so.
+class BufferPrint : public Print {
+public:
+  BufferPrint(char *buffer, size_t size) : _buffer(buffer), _size(size), _length(0), _overflow(false) {
+    if (_size > 0) {
+      _buffer[0] = 0;
+    }
+  }
+
+  size_t write(uint8_t c) {
+    if (_length + 1 >= _size) {
+      _overflow = true;
+      return 0;
+    }
+    _buffer[_length++] = c;
+    _buffer[_length] = 0;
+    return 1;
+  }
+
+  size_t write(const uint8_t *data, size_t size) {
+    size_t written = 0;
+    while (written < size && write(data[written])) {
+      written++;
+    }
+    return written;
+  }
+
+  size_t length() const { return _length; }
+  bool overflowed() const { return _overflow; }
+
+private:
+  char *_buffer;
+  size_t _size;
+  size_t _length;
+  bool _overflow;
+};
+
+// decimal digits of value, most significant first
+inline size_t jsonWriteUnsigned(Print &out, uint64_t value) {
+  char digits[20];
+  uint8_t count = 0;
+  do {
+    digits[count++] = '0' + (char)(value % 10);
+    value /= 10;
+  } while (value);
+  size_t written = 0;
+  while (count) {
+    written += out.write((uint8_t)digits[--count]);
+  }
+  return written;
+}
+
+inline size_t jsonWriteSigned(Print &out, int32_t value) {
+  if (value < 0) {
+    return out.write((uint8_t)'-') + jsonWriteUnsigned(out, (uint64_t)(-(int64_t)value));
+  }
+  return jsonWriteUnsigned(out, (uint64_t)value);
+}
+
+// quoted string with the characters JSON can't take raw escaped
+inline size_t jsonWriteString(Print &out, const char *value) {
+  static const char hex[] = "0123456789abcdef";
+  size_t written = out.write((uint8_t)'"');
+  for (; *value; value++) {
+    uint8_t c = (uint8_t)*value;
+    if (c == '"' || c == '\\') {
+      written += out.write((uint8_t)'\\');
+      written += out.write(c);
+    } else if (c < 0x20) {
+      written += out.write((const uint8_t *)"\\u00", 4);
+      written += out.write((uint8_t)hex[c >> 4]);
+      written += out.write((uint8_t)hex[c & 0xF]);
+    } else {
+      written += out.write(c);
+    }
+  }
+  return written + out.write((uint8_t)'"');
+}
+
+#endif
@@ -3,26 +3,23 @@
 #include "LiquidCrystal_I2C.h"
 #include <inttypes.h>
 #if defined(ARDUINO) && ARDUINO >= 100
-
 #include "Arduino.h"
-
 #define printIIC(args)	Wire.write(args)
-inline size_t LiquidCrystal_I2C::write(uint8_t value) {
-	send(value, Rs);
-	return 1;
-}
-
 #else
 #include "WProgram.h"
-
 #define printIIC(args)	Wire.send(args)
-inline void LiquidCrystal_I2C::write(uint8_t value) {
-	send(value, Rs);
-}
-
 #endif
 #include "Wire.h"
 
+// kinds of queued operation, a plain send carries its mode (0 or Rs) in the low bits
+#define LCD_OP_NIBBLE 0x10		// only the high nibble, used while switching to 4 bit mode
+#define LCD_OP_EXPANDER 0x20	// raw byte to the PCF8574, no enable pulse
+
+// clear and home need 1.52ms, everything else is covered by bus time
+#define LCD_SLOW_COMMAND_US 2000
+
+// the text side is a template, this compiles it for LiquidCrystal_I2C
+template class LiquidCrystalI2CFrame<LcdRuntimeGeometry>;
 
 
 // When the display powers up, it is configured as follows:
@@ -44,30 +41,30 @@ inline void LiquidCrystal_I2C::write(uint8_t value) {
 // can't assume that its in that state when a sketch starts (and the
 // LiquidCrystal constructor is called).
 
-LiquidCrystal_I2C::LiquidCrystal_I2C(uint8_t lcd_Addr,uint8_t lcd_cols,uint8_t lcd_rows)
+LiquidCrystalI2CBase::LiquidCrystalI2CBase(uint8_t lcd_Addr)
 {
   _Addr = lcd_Addr;
-  _cols = lcd_cols;
-  _rows = lcd_rows;
+  _displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
+  _displaycontrol = 0;
+  _displaymode = 0;
   _backlightval = LCD_NOBACKLIGHT;
-}
-
-void LiquidCrystal_I2C::init(){
-	init_priv();
-}
-
-void LiquidCrystal_I2C::init_priv()
-{
-	Wire.begin();
+  memset(_glyphIds, 0, sizeof(_glyphIds));
+  memset(_glyphUsed, 0, sizeof(_glyphUsed));
+  _glyphClock = 0;
+  _batchDepth = 0;
+  _txlen = 0;
+  _async = false;
+  _queueHead = 0;
+  _queueTail = 0;
+  _opStart = 0;
+  _opWait = 0;
+}
+
+void LiquidCrystalI2CBase::start(uint8_t lines, uint8_t dotsize) {
 	_displayfunction = LCD_4BITMODE | LCD_1LINE | LCD_5x8DOTS;
-	begin(_cols, _rows);  
-}
-
-void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 	if (lines > 1) {
 		_displayfunction |= LCD_2LINE;
 	}
-	_numlines = lines;
 
 	// for some 1 line displays you can select a 10 pixel high font
 	if ((dotsize != 0) && (lines == 1)) {
@@ -77,30 +74,33 @@ void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 	// SEE PAGE 45/46 FOR INITIALIZATION SPECIFICATION!
 	// according to datasheet, we need at least 40ms after power rises above 2.7V
 	// before sending commands. Arduino can turn on way befer 4.5V so we'll wait 50
-	delay(50); 
+	if (_async) {
+		// nothing may block here, the wait becomes the deadline of the expander reset.
+		// the datasheet only asks for the 40ms, not the extra second the blocking path waits
+		transfer(_backlightval, LCD_OP_EXPANDER, 50000);
+	} else {
+		delay(50); 
   
-	// Now we pull both RS and R/W low to begin commands
-	expanderWrite(_backlightval);	// reset expanderand turn backlight off (Bit 8 =1)
-	delay(1000);
+		// Now we pull both RS and R/W low to begin commands
+		expanderWrite(_backlightval);	// reset expanderand turn backlight off (Bit 8 =1)
+		delay(1000);
+	}
 
   	//put the LCD into 4 bit mode
 	// this is according to the hitachi HD44780 datasheet
 	// figure 24, pg 46
 	
 	  // we start in 8bit mode, try to set 4 bit mode
-   write4bits(0x03 << 4);
-   delayMicroseconds(4500); // wait min 4.1ms
+   transfer(0x03 << 4, LCD_OP_NIBBLE, 4500); // wait min 4.1ms
    
    // second try
-   write4bits(0x03 << 4);
-   delayMicroseconds(4500); // wait min 4.1ms
+   transfer(0x03 << 4, LCD_OP_NIBBLE, 4500); // wait min 4.1ms
    
    // third go!
-   write4bits(0x03 << 4); 
-   delayMicroseconds(150);
+   transfer(0x03 << 4, LCD_OP_NIBBLE, 150);
    
    // finally, set to 4-bit interface
-   write4bits(0x02 << 4); 
+   transfer(0x02 << 4, LCD_OP_NIBBLE, 0);
 
 
 	// set # lines, font size, etc.
@@ -110,8 +110,8 @@ void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 	_displaycontrol = LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
 	display();
 	
-	// clear it off
-	clear();
+	// clear it off, the caller resets the shadow frame to match
+	command(LCD_CLEARDISPLAY);
 	
 	// Initialize to default text direction (for roman languages)
 	_displaymode = LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
@@ -119,174 +119,335 @@ void LiquidCrystal_I2C::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
 	// set the entry mode
 	command(LCD_ENTRYMODESET | _displaymode);
 	
-	home();
-  
+	command(LCD_RETURNHOME);
 }
 
 /********** high level commands, for the user! */
-void LiquidCrystal_I2C::clear(){
-	command(LCD_CLEARDISPLAY);// clear display, set cursor position to zero
-	delayMicroseconds(2000);  // this command takes a long time!
-}
-
-void LiquidCrystal_I2C::home(){
-	command(LCD_RETURNHOME);  // set cursor position to zero
-	delayMicroseconds(2000);  // this command takes a long time!
-}
-
-void LiquidCrystal_I2C::setCursor(uint8_t col, uint8_t row){
-	int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
-	if ( row > _numlines ) {
-		row = _numlines-1;    // we count rows starting w/0
-	}
-	command(LCD_SETDDRAMADDR | (col + row_offsets[row]));
-}
 
 // Turn the display on/off (quickly)
-void LiquidCrystal_I2C::noDisplay() {
+void LiquidCrystalI2CBase::noDisplay() {
 	_displaycontrol &= ~LCD_DISPLAYON;
 	command(LCD_DISPLAYCONTROL | _displaycontrol);
 }
-void LiquidCrystal_I2C::display() {
+void LiquidCrystalI2CBase::display() {
 	_displaycontrol |= LCD_DISPLAYON;
 	command(LCD_DISPLAYCONTROL | _displaycontrol);
 }
 
 // Turns the underline cursor on/off
-void LiquidCrystal_I2C::noCursor() {
+void LiquidCrystalI2CBase::noCursor() {
 	_displaycontrol &= ~LCD_CURSORON;
 	command(LCD_DISPLAYCONTROL | _displaycontrol);
 }
-void LiquidCrystal_I2C::cursor() {
+void LiquidCrystalI2CBase::cursor() {
 	_displaycontrol |= LCD_CURSORON;
 	command(LCD_DISPLAYCONTROL | _displaycontrol);
 }
 
 // Turn on and off the blinking cursor
-void LiquidCrystal_I2C::noBlink() {
+void LiquidCrystalI2CBase::noBlink() {
 	_displaycontrol &= ~LCD_BLINKON;
 	command(LCD_DISPLAYCONTROL | _displaycontrol);
 }
-void LiquidCrystal_I2C::blink() {
+void LiquidCrystalI2CBase::blink() {
 	_displaycontrol |= LCD_BLINKON;
 	command(LCD_DISPLAYCONTROL | _displaycontrol);
 }
 
 // These commands scroll the display without changing the RAM
-void LiquidCrystal_I2C::scrollDisplayLeft(void) {
+void LiquidCrystalI2CBase::scrollDisplayLeft(void) {
 	command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT);
 }
-void LiquidCrystal_I2C::scrollDisplayRight(void) {
+void LiquidCrystalI2CBase::scrollDisplayRight(void) {
 	command(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVERIGHT);
 }
 
 // This is for text that flows Left to Right
-void LiquidCrystal_I2C::leftToRight(void) {
+void LiquidCrystalI2CBase::leftToRight(void) {
 	_displaymode |= LCD_ENTRYLEFT;
 	command(LCD_ENTRYMODESET | _displaymode);
 }
 
 // This is for text that flows Right to Left
-void LiquidCrystal_I2C::rightToLeft(void) {
+void LiquidCrystalI2CBase::rightToLeft(void) {
 	_displaymode &= ~LCD_ENTRYLEFT;
 	command(LCD_ENTRYMODESET | _displaymode);
 }
 
 // This will 'right justify' text from the cursor
-void LiquidCrystal_I2C::autoscroll(void) {
+void LiquidCrystalI2CBase::autoscroll(void) {
 	_displaymode |= LCD_ENTRYSHIFTINCREMENT;
 	command(LCD_ENTRYMODESET | _displaymode);
 }
 
 // This will 'left justify' text from the cursor
-void LiquidCrystal_I2C::noAutoscroll(void) {
+void LiquidCrystalI2CBase::noAutoscroll(void) {
 	_displaymode &= ~LCD_ENTRYSHIFTINCREMENT;
 	command(LCD_ENTRYMODESET | _displaymode);
 }
 
 // Allows us to fill the first 8 CGRAM locations
-// with custom characters
-void LiquidCrystal_I2C::createChar(uint8_t location, uint8_t charmap[]) {
+// with custom characters, the glyph cache leaves the location alone from then on
+void LiquidCrystalI2CBase::createChar(uint8_t location, uint8_t charmap[]) {
 	location &= 0x7; // we only have 8 locations 0-7
-	command(LCD_SETCGRAMADDR | (location << 3));
+	_glyphIds[location] = LCD_GLYPH_PINNED;
+	uploadGlyph(location, charmap);
+}
+
+void LiquidCrystalI2CBase::uploadGlyph(uint8_t slot, const uint8_t bitmap[8]) {
+	beginBatch();
+	command(LCD_SETCGRAMADDR | (slot << 3));
 	for (int i=0; i<8; i++) {
-		write(charmap[i]);
+		send(bitmap[i], Rs);   // straight to CGRAM, never through the shadow frame
 	}
+	// the address counter now points into CGRAM, put it back in DDRAM before any more text goes out
+	command(LCD_SETDDRAMADDR);
+	endBatch();
+}
+
+// the slot holding glyph id, marked as just used, or -1 when it isn't in CGRAM.
+// 0 and LCD_GLYPH_PINNED mark free and pinned slots, they are never a glyph's id
+int8_t LiquidCrystalI2CBase::findGlyph(uint8_t id) {
+	if (id == 0 || id == LCD_GLYPH_PINNED) {
+		return -1;
+	}
+	for (uint8_t slot = 0; slot < 8; slot++) {
+		if (_glyphIds[slot] == id) {
+			_glyphUsed[slot] = ++_glyphClock;
+			return slot;
+		}
+	}
+	return -1;
+}
+
+// Upload a glyph to a free slot, or else to the least recently used one. Slots
+// pinned by createChar() and slots set in onScreen are never taken, overwriting
+// a glyph that is showing would change it on the screen. Returns -1 when every
+// slot is one of those, the caller tries again on a later redraw, or when id
+// is one of the two findGlyph() can't look up.
+int8_t LiquidCrystalI2CBase::loadGlyph(uint8_t id, const uint8_t bitmap[8], uint8_t onScreen) {
+	int8_t victim = -1;
+	uint16_t oldest = 0;
+	if (id == 0 || id == LCD_GLYPH_PINNED) {
+		return -1;
+	}
+	for (uint8_t slot = 0; slot < 8; slot++) {
+		if (_glyphIds[slot] == LCD_GLYPH_PINNED || (onScreen & (1 << slot))) {
+			continue;
+		}
+		// ages are counted modulo the clock, so wrapping around doesn't upset the order
+		uint16_t age = (_glyphIds[slot] == 0) ? 0xffff : (uint16_t)(_glyphClock - _glyphUsed[slot]);
+		if (victim < 0 || age > oldest) {
+			victim = slot;
+			oldest = age;
+		}
+	}
+	if (victim < 0) {
+		return -1;
+	}
+	uploadGlyph(victim, bitmap);
+	_glyphIds[victim] = id;
+	_glyphUsed[victim] = ++_glyphClock;
+	return victim;
+}
+
+void LiquidCrystalI2CBase::beginBatch() {
+	_batchDepth++;
+}
+
+void LiquidCrystalI2CBase::endBatch() {
+	if (_batchDepth > 0 && --_batchDepth == 0) {
+		expanderFlush();
+	}
+}
+
+// In async mode every send is queued instead of written, call tick() from loop() to drain the queue.
+// Leaving async mode drains whatever is still queued, blocking until it is done.
+void LiquidCrystalI2CBase::setAsync(bool async) {
+	if (!async) {
+		while (tick()) {
+			yield();
+		}
+	}
+	_async = async;
+}
+
+// Send queued operations until the queue is empty, a slow command has gone out or
+// about budgetUs of bus time is used up. Wire blocks for the whole transfer so
+// the budget is counted in bytes. A run of characters that doesn't fit in what is
+// left waits for the next tick rather than showing half written for a pass, unless
+// it is the first thing in the slice. Returns true while work is still pending.
+bool LiquidCrystalI2CBase::tick(uint16_t budgetUs) {
+	if ((uint32_t)(micros() - _opStart) < _opWait) {
+		return true;	// the last command is still executing
+	}
+	_opWait = 0;
+	if (_queueHead == _queueTail) {
+		return false;
+	}
+	uint16_t maxBytes = budgetUs / LCD_I2C_BYTE_US;
+	uint16_t bytes = 0;
+	beginBatch();
+	do {
+		QueuedOp &op = _queue[_queueTail & (LCD_QUEUE_SIZE - 1)];
+		if (bytes > 0 && op.op == 0 && (op.value & LCD_SETDDRAMADDR) && bytes + queuedRunBytes() > maxBytes) {
+			break;
+		}
+		run(op.value, op.op);
+		_queueTail++;
+		bytes += (op.op & LCD_OP_EXPANDER) ? 1 : (op.op & LCD_OP_NIBBLE) ? 3 : 6;
+		_opWait = op.waitUs;
+	} while (_opWait == 0 && _queueHead != _queueTail && bytes < maxBytes);
+	endBatch();
+	_opStart = micros();	// execution time counts from when the bytes have left
+	return true;
+}
+
+// bytes of the LCD_SETDDRAMADDR at the front of the queue and the characters written after it
+uint16_t LiquidCrystalI2CBase::queuedRunBytes() {
+	uint16_t bytes = 6;
+	for (uint8_t i = _queueTail + 1; i != _queueHead; i++) {
+		if (_queue[i & (LCD_QUEUE_SIZE - 1)].op != Rs) {
+			break;
+		}
+		bytes += 6;
+	}
+	return bytes;
+}
+
+bool LiquidCrystalI2CBase::idle() {
+	return _queueHead == _queueTail && (uint32_t)(micros() - _opStart) >= _opWait;
 }
 
 // Turn the (optional) backlight off/on
-void LiquidCrystal_I2C::noBacklight(void) {
+void LiquidCrystalI2CBase::noBacklight(void) {
 	_backlightval=LCD_NOBACKLIGHT;
 	expanderWrite(0);
 }
 
-void LiquidCrystal_I2C::backlight(void) {
+void LiquidCrystalI2CBase::backlight(void) {
 	_backlightval=LCD_BACKLIGHT;
 	expanderWrite(0);
 }
 
 
 
-/*********** mid level commands, for sending data/cmds */
-
-inline void LiquidCrystal_I2C::command(uint8_t value) {
-	send(value, 0);
-}
-
-
 /************ low level data pushing commands **********/
 
 // write either command or data
-void LiquidCrystal_I2C::send(uint8_t value, uint8_t mode) {
+void LiquidCrystalI2CBase::send(uint8_t value, uint8_t mode) {
+	bool slow = (mode == 0) && (value == LCD_CLEARDISPLAY || (value & ~1) == LCD_RETURNHOME);
+	transfer(value, mode, slow ? LCD_SLOW_COMMAND_US : 0);
+}
+
+// queue the operation in async mode, otherwise put it on the bus and wait out waitUs
+void LiquidCrystalI2CBase::transfer(uint8_t value, uint8_t op, uint16_t waitUs) {
+	if (_async) {
+		while ((uint8_t)(_queueHead - _queueTail) == LCD_QUEUE_SIZE) {
+			tick();		// only blocks when the queue overflows
+			yield();
+		}
+		QueuedOp &q = _queue[_queueHead & (LCD_QUEUE_SIZE - 1)];
+		q.value = value;
+		q.op = op;
+		q.waitUs = waitUs;
+		_queueHead++;
+		return;
+	}
+	beginBatch();
+	run(value, op);
+	if (waitUs) {
+		// the wait has to start once the command is on the bus, even inside a batch
+		expanderFlush();
+		delayMicroseconds(waitUs);
+	}
+	endBatch();
+}
+
+// both nibbles go out in one I2C transaction (or join the open batch)
+void LiquidCrystalI2CBase::run(uint8_t value, uint8_t op) {
+	if (op & LCD_OP_EXPANDER) {
+		expanderQueue(value);
+		return;
+	}
+	uint8_t mode = op & Rs;
+	if (op & LCD_OP_NIBBLE) {
+		write4bits((value & 0xf0) | mode);
+		return;
+	}
 	uint8_t highnib=value&0xf0;
 	uint8_t lownib=(value<<4)&0xf0;
-       write4bits((highnib)|mode);
+	beginBatch();
+	write4bits((highnib)|mode);
 	write4bits((lownib)|mode); 
+	endBatch();
 }
 
-void LiquidCrystal_I2C::write4bits(uint8_t value) {
-	expanderWrite(value);
+void LiquidCrystalI2CBase::write4bits(uint8_t value) {
+	expanderQueue(value);
 	pulseEnable(value);
+	if (_batchDepth == 0) {
+		expanderFlush();
+	}
 }
 
-void LiquidCrystal_I2C::expanderWrite(uint8_t _data){                                        
+void LiquidCrystalI2CBase::expanderWrite(uint8_t _data){                                        
+	transfer(_data, LCD_OP_EXPANDER, 0);
+}
+
+// The PCF8574 latches every byte of a transaction onto its pins as it is acked,
+// so a whole nibble/enable sequence can share one START/address/STOP.
+// At the PCF8574's 100kHz (and even at 400kHz) one byte is >20us on the wire,
+// which covers the >450ns enable pulse, and the three bytes before the next
+// enable falling edge cover the >37us a command needs to settle.
+void LiquidCrystalI2CBase::expanderQueue(uint8_t _data){
+	if (_txlen == LCD_TX_BUFFER) {
+		expanderFlush();
+	}
+	_txbuf[_txlen++] = _data | _backlightval;
+}
+
+void LiquidCrystalI2CBase::expanderFlush(){
+	if (_txlen == 0) {
+		return;
+	}
 	Wire.beginTransmission(_Addr);
-	printIIC((int)(_data) | _backlightval);
-	Wire.endTransmission();   
+	for (uint8_t i = 0; i < _txlen; i++) {
+		printIIC((int)(_txbuf[i]));
+	}
+	Wire.endTransmission();
+	_txlen = 0;
 }
 
-void LiquidCrystal_I2C::pulseEnable(uint8_t _data){
-	expanderWrite(_data | En);	// En high
-	delayMicroseconds(1);		// enable pulse must be >450ns
-	
-	expanderWrite(_data & ~En);	// En low
-	delayMicroseconds(50);		// commands need > 37us to settle
+void LiquidCrystalI2CBase::pulseEnable(uint8_t _data){
+	expanderQueue(_data | En);	// En high
+	expanderQueue(_data & ~En);	// En low
 } 
 
 
 // Alias functions
 
-void LiquidCrystal_I2C::cursor_on(){
+void LiquidCrystalI2CBase::cursor_on(){
 	cursor();
 }
 
-void LiquidCrystal_I2C::cursor_off(){
+void LiquidCrystalI2CBase::cursor_off(){
 	noCursor();
 }
 
-void LiquidCrystal_I2C::blink_on(){
+void LiquidCrystalI2CBase::blink_on(){
 	blink();
 }
 
-void LiquidCrystal_I2C::blink_off(){
+void LiquidCrystalI2CBase::blink_off(){
 	noBlink();
 }
 
-void LiquidCrystal_I2C::load_custom_character(uint8_t char_num, uint8_t *rows){
+void LiquidCrystalI2CBase::load_custom_character(uint8_t char_num, uint8_t *rows){
 		createChar(char_num, rows);
 }
 
-void LiquidCrystal_I2C::setBacklight(uint8_t new_val){
+void LiquidCrystalI2CBase::setBacklight(uint8_t new_val){
 	if(new_val){
 		backlight();		// turn backlight on
 	}else{
@@ -294,7 +455,7 @@ void LiquidCrystal_I2C::setBacklight(uint8_t new_val){
 	}
 }
 
-void LiquidCrystal_I2C::printstr(const char c[]){
+void LiquidCrystalI2CBase::printstr(const char c[]){
 	//This function is not identical to the function used for "real" I2C displays
 	//it's here so the user sketch doesn't have to be changed 
 	print(c);
@@ -302,14 +463,11 @@ void LiquidCrystal_I2C::printstr(const char c[]){
 
 
 // unsupported API functions
-void LiquidCrystal_I2C::off(){}
-void LiquidCrystal_I2C::on(){}
-void LiquidCrystal_I2C::setDelay (int cmdDelay,int charDelay) {}
-uint8_t LiquidCrystal_I2C::status(){return 0;}
-uint8_t LiquidCrystal_I2C::keypad (){return 0;}
-uint8_t LiquidCrystal_I2C::init_bargraph(uint8_t graphtype){return 0;}
-void LiquidCrystal_I2C::draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_col_end){}
-void LiquidCrystal_I2C::draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_row_end){}
-void LiquidCrystal_I2C::setContrast(uint8_t new_val){}
+void LiquidCrystalI2CBase::off(){}
+void LiquidCrystalI2CBase::on(){}
+void LiquidCrystalI2CBase::setDelay (int /*cmdDelay*/,int /*charDelay*/) {}
+uint8_t LiquidCrystalI2CBase::status(){return 0;}
+uint8_t LiquidCrystalI2CBase::keypad (){return 0;}
+void LiquidCrystalI2CBase::setContrast(uint8_t /*new_val*/){}
 
 	
@@ -3,6 +3,12 @@
 #define LiquidCrystal_I2C_h
 
 #include <inttypes.h>
+#include <string.h>
+#if defined(ARDUINO) && ARDUINO >= 100
+#include "Arduino.h"
+#else
+#include "WProgram.h"
+#endif
 #include "Print.h" 
 #include <Wire.h>
 
@@ -52,12 +58,38 @@
 #define Rw B00000010  // Read/Write bit
 #define Rs B00000001  // Register select bit
 
-class LiquidCrystal_I2C : public Print {
+// bytes of PCF8574 output queued per I2C transaction, limited by the Wire buffer
+#if defined(BUFFER_LENGTH)
+#define LCD_TX_BUFFER BUFFER_LENGTH
+#else
+#define LCD_TX_BUFFER 32
+#endif
+
+// operations waiting in async mode, must be a power of two
+#define LCD_QUEUE_SIZE 64
+
+// bus time of one PCF8574 byte at 100kHz, tick() spends its budget in these
+#define LCD_I2C_BYTE_US 90
+
+// bar graph types for init_bargraph()
+#define LCD_VERTICAL_BAR_GRAPH 1	// 8 steps per cell, glyphs with 1-7 rows lit from the bottom
+#define LCD_HORIZONTAL_BAR_GRAPH 2	// 5 steps per cell, glyphs with 1-4 columns lit from the left
+#define LCD_FULL_BLOCK 0xff		// every pixel lit, in the character ROM so it needs no slot
+
+// glyph ids for glyph(), 1 to 0xdf are the sketch's own, 0 and 0xff only ever get the fallback
+#define LCD_GLYPH_VERTICAL_BAR 0xe0	// plus the rows lit
+#define LCD_GLYPH_HORIZONTAL_BAR 0xf0	// plus the columns lit
+#define LCD_GLYPH_PINNED 0xff		// slot written by createChar(), the cache leaves it alone
+
+// the HD44780 only has 80 bytes of DDRAM so no display geometry needs more shadow cells than this
+#define LCD_MAX_CELLS 80
+
+// Everything that doesn't depend on the display's geometry: the instruction set,
+// the PCF8574 byte batching and the async queue. The shadow frame and cursor
+// addressing live in LiquidCrystalI2CFrame, which knows the geometry.
+class LiquidCrystalI2CBase : public Print {
 public:
-  LiquidCrystal_I2C(uint8_t lcd_Addr,uint8_t lcd_cols,uint8_t lcd_rows);
-  void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS );
-  void clear();
-  void home();
+  explicit LiquidCrystalI2CBase(uint8_t lcd_Addr);
   void noDisplay();
   void display();
   void noBlink();
@@ -77,14 +109,16 @@ public:
   void autoscroll();
   void noAutoscroll(); 
   void createChar(uint8_t, uint8_t[]);
-  void setCursor(uint8_t, uint8_t); 
-#if defined(ARDUINO) && ARDUINO >= 100
-  virtual size_t write(uint8_t);
-#else
-  virtual void write(uint8_t);
-#endif
-  void command(uint8_t);
-  void init();
+  void command(uint8_t value) { send(value, 0); }
+
+////batching, everything sent between beginBatch() and endBatch() goes out in as few I2C transactions as the Wire buffer allows
+void beginBatch();
+void endBatch();
+
+////async mode, nothing blocks: sends are queued and tick() drains them while honouring each command's execution time
+void setAsync(bool async);
+bool tick(uint16_t budgetUs = 2000);	// call every loop, returns true while work is pending
+bool idle();
 
 ////compatibility API function aliases
 void blink_on();						// alias for blink()
@@ -102,25 +136,401 @@ uint8_t keypad();
 void setDelay(int,int);
 void on();
 void off();
-uint8_t init_bargraph(uint8_t graphtype);
-void draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_col_end);
-void draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_col_end);
 	 
 
-private:
-  void init_priv();
+protected:
+  void start(uint8_t lines, uint8_t dotsize);	// the power on sequence, leaves the lcd cleared and homed
   void send(uint8_t, uint8_t);
+  int8_t findGlyph(uint8_t id);
+  int8_t loadGlyph(uint8_t id, const uint8_t bitmap[8], uint8_t onScreen);
+  uint8_t _displaymode;
+
+private:
+  struct QueuedOp {
+    uint8_t value;
+    uint8_t op;
+    uint16_t waitUs;	// execution time to honour after this op
+  };
+  void transfer(uint8_t value, uint8_t op, uint16_t waitUs);
+  uint16_t queuedRunBytes();
+  void run(uint8_t value, uint8_t op);
   void write4bits(uint8_t);
   void expanderWrite(uint8_t);
+  void expanderQueue(uint8_t);
+  void expanderFlush();
   void pulseEnable(uint8_t);
+  void uploadGlyph(uint8_t slot, const uint8_t bitmap[8]);
   uint8_t _Addr;
   uint8_t _displayfunction;
   uint8_t _displaycontrol;
-  uint8_t _displaymode;
-  uint8_t _numlines;
+  uint8_t _backlightval;
+  uint8_t _glyphIds[8];		// glyph id in each CGRAM slot, 0 when free
+  uint16_t _glyphUsed[8];	// _glyphClock when the slot was last asked for
+  uint16_t _glyphClock;
+  uint8_t _batchDepth;
+  uint8_t _txlen;
+  uint8_t _txbuf[LCD_TX_BUFFER];
+  bool _async;
+  uint8_t _queueHead;
+  uint8_t _queueTail;
+  unsigned long _opStart;
+  uint16_t _opWait;
+  QueuedOp _queue[LCD_QUEUE_SIZE];
+};
+
+// Geometry fixed at compile time, the row offsets, bounds and shadow frame size
+// are all constants so cursor addressing with constant arguments folds away.
+// Rows 2 and 3 continue rows 0 and 1 of DDRAM one row length on.
+template<uint8_t Addr, uint8_t Cols, uint8_t Rows>
+struct LcdGeometry {
+  static_assert(Rows >= 1 && Rows <= 4, "the HD44780 drives 1 to 4 rows");
+  static_assert(Cols >= 1 && Cols * Rows <= LCD_MAX_CELLS, "more cells than the HD44780 has DDRAM for");
+  enum { CELLS = Cols * Rows };
+  static constexpr uint8_t address() { return Addr; }
+  static constexpr uint8_t cols() { return Cols; }
+  static constexpr uint8_t rows() { return Rows; }
+  static constexpr uint8_t cells() { return Cols * Rows; }
+  static constexpr uint8_t rowOffset(uint8_t row) { return (row & 1 ? 0x40 : 0) + (row & 2 ? Cols : 0); }
+  void resize(uint8_t /*cols*/, uint8_t /*rows*/) {}
+};
+
+// Geometry given at run time, for LiquidCrystal_I2C. The shadow frame is sized
+// for the largest display and cells() is 0 when the geometry doesn't fit in DDRAM.
+struct LcdRuntimeGeometry {
+  enum { CELLS = LCD_MAX_CELLS };
+  LcdRuntimeGeometry(uint8_t address, uint8_t cols, uint8_t rows) : _address(address) { resize(cols, rows); }
+  uint8_t address() const { return _address; }
+  uint8_t cols() const { return _cols; }
+  uint8_t rows() const { return _rows; }
+  uint8_t cells() const { return _cells; }
+  uint8_t rowOffset(uint8_t row) const { return (row & 1 ? 0x40 : 0) + (row & 2 ? _cols : 0); }
+  void resize(uint8_t cols, uint8_t rows) {
+    _cols = cols;
+    _rows = (rows < 1) ? 1 : (rows > 4) ? 4 : rows;
+    _cells = (_cols * _rows <= LCD_MAX_CELLS) ? _cols * _rows : 0;
+  }
+private:
+  uint8_t _address;
   uint8_t _cols;
   uint8_t _rows;
-  uint8_t _backlightval;
+  uint8_t _cells;
 };
 
+// The text side of the driver, for one geometry: print()/setCursor()/clear()/home(),
+// and the shadow framebuffer behind setBuffered()/flush().
+template<class Geometry>
+class LiquidCrystalI2CFrame : public LiquidCrystalI2CBase, private Geometry {
+public:
+  explicit LiquidCrystalI2CFrame(const Geometry &geometry);
+  void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS );
+  void init();
+  void clear();
+  void home();
+  void setCursor(uint8_t, uint8_t); 
+#if defined(ARDUINO) && ARDUINO >= 100
+  virtual size_t write(uint8_t);
+  virtual size_t write(const uint8_t *buffer, size_t size);
+  using Print::write;
+#else
+  virtual void write(uint8_t);
+#endif
+  using Geometry::cols;
+  using Geometry::rows;
+
+////shadow framebuffer, while buffered print()/setCursor()/clear()/home() only touch RAM
+////and flush() sends the cells that differ from what the lcd is showing
+void setBuffered(bool buffered);
+void flush();
+
+////glyph cache, the character to write for glyph id, uploading bitmap to one of the 8 CGRAM slots
+////only when it isn't there already. The least recently used slot is reused, but while buffered
+////never one that is on the screen or in the frame: fallback is returned instead until it has gone
+uint8_t glyph(uint8_t id, const uint8_t bitmap[8], uint8_t fallback = ' ');
+
+////bar graphs, len cells starting at column/row with the first pixels lit, 0 to len*5 across or
+////0 to len*8 upwards. Only the partly lit cell needs a glyph. Draw them buffered and flush() only
+////sends the cells whose step changed
+uint8_t init_bargraph(uint8_t graphtype);	// loads the bar's glyphs into the cache ahead of drawing, 0 when graphtype is known
+void draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_col_end);
+void draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len,  uint8_t pixel_row_end);
+
+private:
+  uint8_t onScreenGlyphs() const;
+  uint8_t barCell(uint8_t graphtype, uint8_t lit);
+  bool _buffered;
+  bool _shownValid;             // false once unbuffered writes have made _shown stale
+  uint8_t _cursorCol;
+  uint8_t _cursorRow;
+  uint8_t _frame[Geometry::CELLS];  // what we want on the screen
+  uint8_t _shown[Geometry::CELLS];  // what the lcd currently holds
+};
+
+// lcd at a fixed address with a fixed geometry, LiquidCrystalI2C<0x27, 16, 2> lcd;
+template<uint8_t Addr, uint8_t Cols, uint8_t Rows>
+class LiquidCrystalI2C : public LiquidCrystalI2CFrame<LcdGeometry<Addr, Cols, Rows> > {
+public:
+  LiquidCrystalI2C() : LiquidCrystalI2CFrame<LcdGeometry<Addr, Cols, Rows> >(LcdGeometry<Addr, Cols, Rows>()) {}
+};
+
+// the original class, address and geometry chosen at run time
+// (the geometry is a private base, so its name has to be qualified in here)
+class LiquidCrystal_I2C : public LiquidCrystalI2CFrame<LcdRuntimeGeometry> {
+public:
+  LiquidCrystal_I2C(uint8_t lcd_Addr,uint8_t lcd_cols,uint8_t lcd_rows)
+    : LiquidCrystalI2CFrame< ::LcdRuntimeGeometry>(::LcdRuntimeGeometry(lcd_Addr, lcd_cols, lcd_rows)) {}
+};
+
+template<class Geometry>
+LiquidCrystalI2CFrame<Geometry>::LiquidCrystalI2CFrame(const Geometry &geometry)
+  : LiquidCrystalI2CBase(geometry.address()), Geometry(geometry)
+{
+  _buffered = false;
+  _shownValid = false;
+  _cursorCol = 0;
+  _cursorRow = 0;
+  memset(_frame, ' ', sizeof(_frame));
+  memset(_shown, ' ', sizeof(_shown));
+}
+
+template<class Geometry>
+void LiquidCrystalI2CFrame<Geometry>::init(){
+	Wire.begin();
+	begin(cols(), rows());
+}
+
+// a fixed geometry ignores cols and rows, it is what the template says
+template<class Geometry>
+void LiquidCrystalI2CFrame<Geometry>::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
+	Geometry::resize(cols, lines);
+	start(rows(), dotsize);
+	memset(_frame, ' ', sizeof(_frame));
+	memset(_shown, ' ', sizeof(_shown));
+	_shownValid = true;
+	_cursorCol = 0;
+	_cursorRow = 0;
+}
+
+template<class Geometry>
+void LiquidCrystalI2CFrame<Geometry>::clear(){
+	memset(_frame, ' ', sizeof(_frame));
+	_cursorCol = 0;
+	_cursorRow = 0;
+	if (_buffered) {
+		return;               // flush() will blank whatever is still showing
+	}
+	command(LCD_CLEARDISPLAY);// clear display, set cursor position to zero, send() waits out how long this takes
+	memset(_shown, ' ', sizeof(_shown));
+	_shownValid = true;
+}
+
+template<class Geometry>
+void LiquidCrystalI2CFrame<Geometry>::home(){
+	_cursorCol = 0;
+	_cursorRow = 0;
+	if (_buffered) {
+		return;
+	}
+	command(LCD_RETURNHOME);  // set cursor position to zero, this one is slow as well
+}
+
+template<class Geometry>
+void LiquidCrystalI2CFrame<Geometry>::setCursor(uint8_t col, uint8_t row){
+	if ( row >= rows() ) {
+		row = rows()-1;    // we count rows starting w/0
+	}
+	if (_buffered) {
+		_cursorCol = col;
+		_cursorRow = row;
+		return;
+	}
+	command(LCD_SETDDRAMADDR | (col + Geometry::rowOffset(row)));
+}
+
+#if defined(ARDUINO) && ARDUINO >= 100
+template<class Geometry>
+inline size_t LiquidCrystalI2CFrame<Geometry>::write(uint8_t value) {
+	if (_buffered) {
+		// characters past the end of the row are clipped instead of running off into hidden DDRAM
+		if (_cursorCol < cols() && Geometry::cells() > 0) {
+			_frame[_cursorRow * cols() + _cursorCol] = value;
+		}
+		_cursorCol++;
+		return 1;
+	}
+	_shownValid = false;
+	send(value, Rs);
+	return 1;
+}
+
+// strings go out as one batch instead of one transaction per character
+template<class Geometry>
+size_t LiquidCrystalI2CFrame<Geometry>::write(const uint8_t *buffer, size_t size) {
+	beginBatch();
+	for (size_t i = 0; i < size; i++) {
+		write(buffer[i]);
+	}
+	endBatch();
+	return size;
+}
+#else
+template<class Geometry>
+inline void LiquidCrystalI2CFrame<Geometry>::write(uint8_t value) {
+	if (_buffered) {
+		if (_cursorCol < cols() && Geometry::cells() > 0) {
+			_frame[_cursorRow * cols() + _cursorCol] = value;
+		}
+		_cursorCol++;
+		return;
+	}
+	_shownValid = false;
+	send(value, Rs);
+}
+#endif
+
+// Switch between writing straight to the lcd and writing into the shadow frame.
+// Whatever was drawn unbuffered has to be redrawn, flush() can't know what is on the screen.
+template<class Geometry>
+void LiquidCrystalI2CFrame<Geometry>::setBuffered(bool buffered) {
+	_buffered = buffered;
+	_cursorCol = 0;
+	_cursorRow = 0;
+}
+
+// Send every cell of the shadow frame that differs from what the lcd holds.
+// Changed cells are grouped into runs so each run costs one LCD_SETDDRAMADDR,
+// a single unchanged cell between two changes is resent since that costs
+// the same as setting a new address.
+template<class Geometry>
+void LiquidCrystalI2CFrame<Geometry>::flush() {
+	if (Geometry::cells() == 0) {
+		return;
+	}
+	if (!_shownValid) {
+		for (uint8_t i = 0; i < Geometry::cells(); i++) {
+			_shown[i] = ~_frame[i];
+		}
+		_shownValid = true;
+	}
+	// the address counter only walks forward when the entry mode is left to right
+	bool runs = (_displaymode & LCD_ENTRYLEFT) != 0;
+	beginBatch();
+	for (uint8_t row = 0; row < rows(); row++) {
+		uint8_t *frame = &_frame[row * cols()];
+		uint8_t *shown = &_shown[row * cols()];
+		uint8_t col = 0;
+		while (col < cols()) {
+			if (frame[col] == shown[col]) {
+				col++;
+				continue;
+			}
+			uint8_t end = col + 1;
+			while (runs && end < cols()) {
+				if (frame[end] != shown[end]) {
+					end++;
+				} else if (end + 1 < cols() && frame[end + 1] != shown[end + 1]) {
+					end += 2;
+				} else {
+					break;
+				}
+			}
+			command(LCD_SETDDRAMADDR | (col + Geometry::rowOffset(row)));
+			for (; col < end; col++) {
+				send(frame[col], Rs);
+				shown[col] = frame[col];
+			}
+		}
+	}
+	endBatch();
+}
+
+template<class Geometry>
+uint8_t LiquidCrystalI2CFrame<Geometry>::glyph(uint8_t id, const uint8_t bitmap[8], uint8_t fallback) {
+	int8_t slot = findGlyph(id);
+	if (slot < 0) {
+		slot = loadGlyph(id, bitmap, onScreenGlyphs());
+	}
+	return slot < 0 ? fallback : slot;
+}
+
+// CGRAM slots the frame or the lcd shows somewhere, codes 8-15 show slots 0-7 as well.
+// Unbuffered drawing isn't tracked so nothing counts as showing then.
+template<class Geometry>
+uint8_t LiquidCrystalI2CFrame<Geometry>::onScreenGlyphs() const {
+	uint8_t slots = 0;
+	if (!_buffered) {
+		return 0;
+	}
+	for (uint8_t i = 0; i < Geometry::cells(); i++) {
+		if (_frame[i] < 16) {
+			slots |= 1 << (_frame[i] & 7);
+		}
+		if (_shownValid && _shown[i] < 16) {
+			slots |= 1 << (_shown[i] & 7);
+		}
+	}
+	return slots;
+}
+
+// a bar cell with fewer than all its steps lit: a cached glyph, or the nearest
+// whole cell when no slot can be had for it
+template<class Geometry>
+uint8_t LiquidCrystalI2CFrame<Geometry>::barCell(uint8_t graphtype, uint8_t lit) {
+	bool across = (graphtype == LCD_HORIZONTAL_BAR_GRAPH);
+	uint8_t steps = across ? 5 : 8;
+	if (lit == 0) {
+		return ' ';
+	}
+	uint8_t bitmap[8];
+	for (uint8_t line = 0; line < 8; line++) {
+		if (across) {
+			bitmap[line] = (0x1f << (5 - lit)) & 0x1f;	// columns from the left
+		} else {
+			bitmap[line] = (line >= 8 - lit) ? 0x1f : 0;	// rows from the bottom
+		}
+	}
+	uint8_t id = (across ? LCD_GLYPH_HORIZONTAL_BAR : LCD_GLYPH_VERTICAL_BAR) + lit;
+	return glyph(id, bitmap, (lit * 2 >= steps) ? LCD_FULL_BLOCK : ' ');
+}
+
+template<class Geometry>
+uint8_t LiquidCrystalI2CFrame<Geometry>::init_bargraph(uint8_t graphtype) {
+	if (graphtype != LCD_HORIZONTAL_BAR_GRAPH && graphtype != LCD_VERTICAL_BAR_GRAPH) {
+		return 1;
+	}
+	uint8_t steps = (graphtype == LCD_HORIZONTAL_BAR_GRAPH) ? 5 : 8;
+	for (uint8_t lit = 1; lit < steps; lit++) {
+		barCell(graphtype, lit);
+	}
+	return 0;
+}
+
+// the one partly lit cell's glyph is looked up first, an upload moves the cursor
+template<class Geometry>
+void LiquidCrystalI2CFrame<Geometry>::draw_horizontal_graph(uint8_t row, uint8_t column, uint8_t len, uint8_t pixel_col_end) {
+	uint8_t whole = pixel_col_end / 5;
+	uint8_t edge = (whole < len) ? barCell(LCD_HORIZONTAL_BAR_GRAPH, pixel_col_end % 5) : ' ';
+	beginBatch();
+	setCursor(column, row);
+	for (uint8_t i = 0; i < len; i++) {
+		write(i < whole ? LCD_FULL_BLOCK : i == whole ? edge : ' ');
+	}
+	endBatch();
+}
+
+// the bar grows upwards from row, one cell per row
+template<class Geometry>
+void LiquidCrystalI2CFrame<Geometry>::draw_vertical_graph(uint8_t row, uint8_t column, uint8_t len, uint8_t pixel_row_end) {
+	uint8_t whole = pixel_row_end / 8;
+	uint8_t edge = (whole < len) ? barCell(LCD_VERTICAL_BAR_GRAPH, pixel_row_end % 8) : ' ';
+	beginBatch();
+	for (uint8_t i = 0; i < len && i <= row; i++) {
+		setCursor(column, row - i);
+		write(i < whole ? LCD_FULL_BLOCK : i == whole ? edge : ' ');
+	}
+	endBatch();
+}
+
+// the run time geometry is compiled once, in LiquidCrystal_I2C.cpp
+extern template class LiquidCrystalI2CFrame<LcdRuntimeGeometry>;
+
 #endif
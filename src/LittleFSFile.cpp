@@ -0,0 +1,42 @@
+#include "LittleFSFile.h"
+#include <LittleFS.h>
+
+long LittleFSFile::size() {
+  File f = LittleFS.open(_path, "r");
+  if (!f) {
+    return 0;
+  }
+  long size = f.size();
+  f.close();
+  return size;
+}
+
+bool LittleFSFile::read(long offset, uint8_t *buffer, size_t length) {
+  File f = LittleFS.open(_path, "r");
+  if (!f) {
+    return false;
+  }
+  bool ok = f.seek(offset, SeekSet) && (size_t)f.read(buffer, length) == length;
+  f.close();
+  return ok;
+}
+
+bool LittleFSFile::append(const uint8_t *buffer, size_t length) {
+  File f = LittleFS.open(_path, "a");
+  if (!f) {
+    return false;
+  }
+  bool ok = f.write(buffer, length) == length;
+  f.close();
+  return ok;
+}
+
+bool LittleFSFile::truncate(long size) {
+  File f = LittleFS.open(_path, "r+");
+  if (!f) {
+    return size == 0;     // nothing there is as empty as it gets
+  }
+  bool ok = f.truncate(size);
+  f.close();
+  return ok;
+}
@@ -0,0 +1,21 @@
+#ifndef LittleFSFile_h
+#define LittleFSFile_h
+
+#include <FlashFile.h>
+
+// FlashFile in LittleFS. Files are opened per call, appends are rare
+// (one per weigh-in) and LittleFS commits a file when it is closed.
+// LittleFS.begin() must have been called first.
+class LittleFSFile : public FlashFile {
+public:
+  explicit LittleFSFile(const char *path) : _path(path) {}
+  long size();
+  bool read(long offset, uint8_t *buffer, size_t length);
+  bool append(const uint8_t *buffer, size_t length);
+  bool truncate(long size);
+
+private:
+  const char *_path;
+};
+
+#endif
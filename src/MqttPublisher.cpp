@@ -0,0 +1,313 @@
+#include "MqttPublisher.h"
+#include <string.h>
+#include <stdio.h>
+
+#define MQTT_CONNECT 0x10
+#define MQTT_CONNACK 0x20
+#define MQTT_PUBLISH 0x30
+#define MQTT_PUBACK 0x40
+#define MQTT_PINGREQ 0xC0
+#define MQTT_PINGRESP 0xD0
+
+#define MQTT_DUP 0x08
+#define MQTT_RETAIN 0x01
+
+// CONNECT flags
+#define MQTT_USER 0x80
+#define MQTT_PASSWORD 0x40
+#define MQTT_WILL_RETAIN 0x20
+#define MQTT_WILL_QOS1 0x08
+#define MQTT_WILL 0x04
+
+MqttPublisher::MqttPublisher(Client &client, const char *host, uint16_t port, const char *topicPrefix)
+  : _client(client), _host(host) {
+  _port = port;
+  _prefix = topicPrefix;
+  _user = 0;
+  _password = 0;
+  _qos = 1;
+  _encoder = 0;
+  _callback = 0;
+  _state = OFFLINE;
+  _head = 0;
+  _sent = 0;
+  _acked = 0;
+  _nextId = 1;
+  _now = 0;
+  _waitingSince = 0;
+  _lastSent = 0;
+  _lastReceived = 0;
+  _lastConnect = 0;
+  _connects = 0;
+  _parse = TYPE;
+  setClientId("wifiscale");
+}
+
+void MqttPublisher::setClientId(const char *clientId) {
+  strncpy(_clientId, clientId, MQTT_CLIENT_ID_SIZE - 1);
+  _clientId[MQTT_CLIENT_ID_SIZE - 1] = 0;
+  snprintf(_readingTopic, MQTT_TOPIC_SIZE, "%s/%s/reading", _prefix, _clientId);
+  snprintf(_statusTopic, MQTT_TOPIC_SIZE, "%s/%s/status", _prefix, _clientId);
+}
+
+bool MqttPublisher::enqueue(const Reading &reading) {
+  if (pending() == MQTT_QUEUE_SIZE) {
+    return false;
+  }
+  uint8_t slot = _head & (MQTT_QUEUE_SIZE - 1);
+  _queue[slot] = reading;
+  _ids[slot] = 0;
+  _done[slot] = false;
+  _dup[slot] = false;
+  _head++;
+  return true;
+}
+
+void MqttPublisher::poll(unsigned long now, bool online) {
+  _now = now;
+  if (!online) {
+    dropConnection();
+    return;
+  }
+
+  while (_client.available() > 0) {
+    consume((uint8_t)_client.read());
+    _lastReceived = now;
+  }
+  if (_state != OFFLINE && !_client.connected()) {
+    dropConnection();
+  }
+  if (_state == WAIT_CONNACK && now - _waitingSince >= MQTT_RESPONSE_TIMEOUT_MS) {
+    dropConnection();
+  }
+  if (_state == READY && _sent != _acked && now - _waitingSince >= MQTT_RESPONSE_TIMEOUT_MS) {
+    dropConnection();
+  }
+  if (_state == READY && now - _lastReceived >= MQTT_KEEPALIVE_S * 1500UL) {
+    dropConnection();     // the broker would have answered a ping by now
+  }
+
+  if (_state == OFFLINE) {
+    // stay connected even with nothing to send, the retained status says we are up
+    if (_connects > 0 && now - _lastConnect < MQTT_RECONNECT_MS) {
+      return;
+    }
+    _lastConnect = now;
+    if (!_host.connect(_client, _port)) {
+      return;
+    }
+    _connects++;
+    sendConnect();
+    _state = WAIT_CONNACK;
+    _waitingSince = now;
+    _lastReceived = now;
+    return;
+  }
+  if (_state != READY) {
+    return;
+  }
+
+  while (_sent != _head && (uint8_t)(_sent - _acked) < MQTT_MAX_INFLIGHT && _encoder) {
+    if (_sent == _acked) {
+      _waitingSince = now;
+    }
+    uint8_t slot = _sent & (MQTT_QUEUE_SIZE - 1);
+    sendPublish(slot);
+    _sent++;
+    if (_qos == 0) {
+      _done[slot] = true;
+    }
+  }
+  advance();
+  if (now - _lastSent >= MQTT_KEEPALIVE_S * 500UL) {
+    sendPing();
+  }
+}
+
+size_t MqttPublisher::writeBody(const Reading &reading, Print &out) {
+  return _encoder->begin(1, out) + _encoder->item(reading, 0, 1, out) + _encoder->end(1, out);
+}
+
+void MqttPublisher::sendConnect() {
+  uint8_t flags = MQTT_WILL | MQTT_WILL_QOS1 | MQTT_WILL_RETAIN;   // clean session stays off
+  uint32_t length = 10 + 2 + strlen(_clientId) + 2 + strlen(_statusTopic) + 2 + 7;
+  if (_user) {
+    flags |= MQTT_USER;
+    length += 2 + strlen(_user);
+  }
+  if (_password) {
+    flags |= MQTT_PASSWORD;
+    length += 2 + strlen(_password);
+  }
+  uint8_t header[5];
+  header[0] = MQTT_CONNECT;
+  _client.write(header, 1 + putLength(header + 1, length));
+  static const uint8_t protocol[] = { 0, 4, 'M', 'Q', 'T', 'T', 4 };
+  _client.write(protocol, sizeof(protocol));
+  uint8_t variable[3] = { flags, (uint8_t)(MQTT_KEEPALIVE_S >> 8), (uint8_t)MQTT_KEEPALIVE_S };
+  _client.write(variable, sizeof(variable));
+
+  uint8_t buffer[2 + MQTT_TOPIC_SIZE];
+  _client.write(buffer, putString(buffer, _clientId));
+  _client.write(buffer, putString(buffer, _statusTopic));
+  _client.write(buffer, putString(buffer, "offline"));
+  if (_user) {
+    buffer[0] = (uint8_t)(strlen(_user) >> 8);
+    buffer[1] = (uint8_t)strlen(_user);
+    _client.write(buffer, 2);
+    _client.print(_user);
+  }
+  if (_password) {
+    buffer[0] = (uint8_t)(strlen(_password) >> 8);
+    buffer[1] = (uint8_t)strlen(_password);
+    _client.write(buffer, 2);
+    _client.print(_password);
+  }
+  _lastSent = _now;
+}
+
+void MqttPublisher::sendPublish(uint8_t slot) {
+  CountingPrint body;
+  writeBody(_queue[slot], body);
+
+  // fixed header, topic and packet id go out as one write, the body is encoded straight into the socket
+  uint8_t header[5 + 2 + MQTT_TOPIC_SIZE + 2];
+  uint8_t topicLength = (uint8_t)strlen(_readingTopic);
+  header[0] = MQTT_PUBLISH | (_qos << 1) | (_dup[slot] ? MQTT_DUP : 0);
+  uint8_t n = 1 + putLength(header + 1, 2 + topicLength + (_qos ? 2 : 0) + body.count());
+  n += putString(header + n, _readingTopic);
+  if (_qos) {
+    if (_ids[slot] == 0) {
+      _ids[slot] = _nextId++;
+      if (_nextId == 0) {
+        _nextId = 1;      // 0 is not a valid packet id
+      }
+    }
+    header[n++] = (uint8_t)(_ids[slot] >> 8);
+    header[n++] = (uint8_t)_ids[slot];
+  }
+  _client.write(header, n);
+  writeBody(_queue[slot], _client);
+  _dup[slot] = true;
+  _lastSent = _now;
+}
+
+void MqttPublisher::sendStatus() {
+  uint8_t packet[5 + 2 + MQTT_TOPIC_SIZE + 6];
+  packet[0] = MQTT_PUBLISH | MQTT_RETAIN;
+  uint8_t n = 1 + putLength(packet + 1, 2 + strlen(_statusTopic) + 6);
+  n += putString(packet + n, _statusTopic);
+  memcpy(packet + n, "online", 6);
+  _client.write(packet, n + 6);
+  _lastSent = _now;
+}
+
+void MqttPublisher::sendPing() {
+  static const uint8_t ping[] = { MQTT_PINGREQ, 0 };
+  _client.write(ping, sizeof(ping));
+  _lastSent = _now;
+}
+
+// remaining length, 7 bits per byte, least significant first
+uint8_t MqttPublisher::putLength(uint8_t *out, uint32_t length) {
+  uint8_t n = 0;
+  do {
+    uint8_t digit = length & 0x7F;
+    length >>= 7;
+    out[n++] = length ? digit | 0x80 : digit;
+  } while (length);
+  return n;
+}
+
+uint8_t MqttPublisher::putString(uint8_t *out, const char *value) {
+  uint8_t length = (uint8_t)strlen(value);
+  out[0] = 0;
+  out[1] = length;
+  memcpy(out + 2, value, length);
+  return 2 + length;
+}
+
+void MqttPublisher::consume(uint8_t c) {
+  switch (_parse) {
+    case TYPE:
+      _inType = c;
+      _inLength = 0;
+      _inShift = 0;
+      _parse = LENGTH;
+      break;
+    case LENGTH:
+      _inLength |= (uint32_t)(c & 0x7F) << _inShift;
+      _inShift += 7;
+      if (!(c & 0x80)) {
+        _inRead = 0;
+        _parse = BODY;
+        if (_inLength == 0) {
+          _parse = TYPE;
+          handlePacket();
+        }
+      }
+      break;
+    case BODY:
+      if (_inRead < sizeof(_in)) {
+        _in[_inRead] = c;
+      }
+      if (++_inRead == _inLength) {
+        _parse = TYPE;
+        handlePacket();
+      }
+      break;
+  }
+}
+
+void MqttPublisher::handlePacket() {
+  switch (_inType & 0xF0) {
+    case MQTT_CONNACK:
+      // byte 0 says if the broker kept our session, byte 1 is the return code
+      if (_state == WAIT_CONNACK && _inLength >= 2 && _in[1] == 0) {
+        _state = READY;
+        sendStatus();
+      } else {
+        dropConnection();
+      }
+      break;
+    case MQTT_PUBACK:
+      if (_inLength >= 2) {
+        acknowledge(((uint16_t)_in[0] << 8) | _in[1]);
+      }
+      break;
+    default:
+      break;      // PINGRESP only counts as traffic, we subscribe to nothing
+  }
+}
+
+void MqttPublisher::acknowledge(uint16_t id) {
+  for (uint8_t i = _acked; i != _sent; i++) {
+    uint8_t slot = i & (MQTT_QUEUE_SIZE - 1);
+    if (_ids[slot] == id) {
+      _done[slot] = true;
+      _waitingSince = _now;
+      break;
+    }
+  }
+  advance();
+}
+
+// the callback goes in queue order, a PUBACK that overtakes an earlier one waits for it
+void MqttPublisher::advance() {
+  while (_acked != _sent && _done[_acked & (MQTT_QUEUE_SIZE - 1)]) {
+    if (_callback) {
+      _callback(_queue[_acked & (MQTT_QUEUE_SIZE - 1)], 200);
+    }
+    _acked++;
+  }
+}
+
+// publishes without a PUBACK are sent again, with DUP, on the next connection
+void MqttPublisher::dropConnection() {
+  if (_client.connected()) {
+    _client.stop();
+  }
+  _state = OFFLINE;
+  _sent = _acked;
+  _parse = TYPE;
+}
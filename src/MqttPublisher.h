@@ -0,0 +1,98 @@
+#ifndef MqttPublisher_h
+#define MqttPublisher_h
+
+#include <Arduino.h>
+#include <Client.h>
+#include "HostAddress.h"
+#include "ReadingTransport.h"
+
+// readings waiting for their PUBACK, must be a power of two
+#define MQTT_QUEUE_SIZE 16
+// QoS 1 publishes written ahead of their PUBACKs
+#define MQTT_MAX_INFLIGHT 4
+#define MQTT_KEEPALIVE_S 60
+#define MQTT_RESPONSE_TIMEOUT_MS 5000
+#define MQTT_RECONNECT_MS 2000
+#define MQTT_CLIENT_ID_SIZE 24
+#define MQTT_TOPIC_SIZE 48
+
+// Publishes readings to an MQTT 3.1.1 broker, an alternative to HttpUploader.
+// Each reading is one PUBLISH to <prefix>/<client id>/reading, encoded by the
+// ReadingEncoder, so a reading costs a few bytes of framing on top of its body.
+// <prefix>/<client id>/status is retained: "online" after every connect and
+// "offline" as the will when the broker loses us.
+// The session is persistent (clean session off). With QoS 1, up to
+// MQTT_MAX_INFLIGHT publishes are written ahead of their PUBACKs and the
+// callback sees each reading once its PUBACK is in, in queue order. Anything
+// without a PUBACK when the connection drops goes out again with DUP set.
+// With QoS 0 a reading counts as delivered once it is written.
+// Connecting blocks for the lookup and the handshake only, bounded by
+// HostAddress, and CONNACK is waited for in poll().
+class MqttPublisher : public ReadingTransport {
+public:
+  MqttPublisher(Client &client, const char *host, uint16_t port, const char *topicPrefix);
+  void setClientId(const char *clientId);     // also names the topics, call before the first poll()
+  void setCredentials(const char *user, const char *password) { _user = user; _password = password; }
+  void setQos(uint8_t qos) { _qos = qos ? 1 : 0; }
+  void setEncoder(ReadingEncoder &encoder) { _encoder = &encoder; }
+  void onResult(UploadCallback callback) { _callback = callback; }
+  bool enqueue(const Reading &reading);
+  void poll(unsigned long now, bool online);
+  uint8_t pending() const { return (uint8_t)(_head - _acked); }
+  bool connected() const { return _state == READY; }
+  uint16_t connects() const { return _connects; }
+
+private:
+  enum State { OFFLINE, WAIT_CONNACK, READY };
+  void sendConnect();
+  void sendPublish(uint8_t slot);
+  void sendStatus();
+  void sendPing();
+  size_t writeBody(const Reading &reading, Print &out);
+  static uint8_t putLength(uint8_t *out, uint32_t length);
+  static uint8_t putString(uint8_t *out, const char *value);
+  void consume(uint8_t c);
+  void handlePacket();
+  void acknowledge(uint16_t id);
+  void advance();
+  void dropConnection();
+  Client &_client;
+  HostAddress _host;
+  uint16_t _port;
+  const char *_prefix;
+  const char *_user;
+  const char *_password;
+  char _clientId[MQTT_CLIENT_ID_SIZE];
+  char _readingTopic[MQTT_TOPIC_SIZE];
+  char _statusTopic[MQTT_TOPIC_SIZE];
+  uint8_t _qos;
+  ReadingEncoder *_encoder;
+  UploadCallback _callback;
+  State _state;
+
+  Reading _queue[MQTT_QUEUE_SIZE];
+  uint16_t _ids[MQTT_QUEUE_SIZE];   // packet id, 0 until first sent
+  bool _done[MQTT_QUEUE_SIZE];      // PUBACK in, or written with QoS 0
+  bool _dup[MQTT_QUEUE_SIZE];       // written on an earlier connection
+  uint8_t _head;          // next free slot
+  uint8_t _sent;          // next reading to write to the connection
+  uint8_t _acked;         // oldest reading not yet handed to the callback
+  uint16_t _nextId;
+  unsigned long _now;
+  unsigned long _waitingSince;
+  unsigned long _lastSent;
+  unsigned long _lastReceived;
+  unsigned long _lastConnect;
+  uint16_t _connects;
+
+  // incoming packet, only CONNACK, PUBACK and PINGRESP matter and none is over 2 bytes
+  enum ParseState { TYPE, LENGTH, BODY };
+  ParseState _parse;
+  uint8_t _inType;
+  uint32_t _inLength;
+  uint8_t _inShift;
+  uint32_t _inRead;
+  uint8_t _in[4];
+};
+
+#endif
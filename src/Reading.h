@@ -0,0 +1,18 @@
+#ifndef Reading_h
+#define Reading_h
+
+#include <inttypes.h>
+
+// time is epoch ms from SNTP, without it the reading was taken before the first sync and time is ms since boot
+#define READING_EPOCH 0x01
+
+// one weigh-in as it is queued for upload
+struct Reading {
+  uint32_t seq;     // journal sequence number, lets the collector spot replays
+  uint64_t time;    // ms when the weight was sampled, see READING_EPOCH
+  int32_t weight;   // grams
+  uint16_t food;    // food catalog id
+  uint8_t flags;
+};
+
+#endif
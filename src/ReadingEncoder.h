@@ -0,0 +1,23 @@
+#ifndef ReadingEncoder_h
+#define ReadingEncoder_h
+
+#include <Print.h>
+#include "Reading.h"
+
+// maps a food catalog id to the name sent to the collector
+typedef const char *(*FoodNameLookup)(uint16_t food);
+
+// Writes a request body of one or more readings straight to a Print, which is
+// either the socket or a counter working out Content-Length. Every call must
+// write the same bytes for the same readings. begin() and end() frame a batch,
+// item() writes one reading, index counts from 0 within the batch.
+class ReadingEncoder {
+public:
+  virtual ~ReadingEncoder() {}
+  virtual const char *contentType() = 0;
+  virtual size_t begin(uint8_t /*count*/, Print &/*out*/) { return 0; }
+  virtual size_t item(const Reading &reading, uint8_t index, uint8_t count, Print &out) = 0;
+  virtual size_t end(uint8_t /*count*/, Print &/*out*/) { return 0; }
+};
+
+#endif
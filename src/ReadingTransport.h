@@ -0,0 +1,36 @@
+#ifndef ReadingTransport_h
+#define ReadingTransport_h
+
+#include <Print.h>
+#include "Reading.h"
+#include "ReadingEncoder.h"
+
+// status is the HTTP code the collector answered with, transports without one
+// report 200 once the reading has been delivered
+typedef void (*UploadCallback)(const Reading &reading, int status);
+
+// Print that only counts, used to work out a length without a buffer
+class CountingPrint : public Print {
+public:
+  CountingPrint() : _count(0) {}
+  size_t write(uint8_t) { _count++; return 1; }
+  size_t write(const uint8_t *, size_t size) { _count += size; return size; }
+  size_t count() const { return _count; }
+private:
+  size_t _count;
+};
+
+// Gets queued readings off the scale, polled from loop() and never blocking on
+// the network. The callback sees every reading once, in the order they were
+// queued, so the journal can be acknowledged from it.
+class ReadingTransport {
+public:
+  virtual ~ReadingTransport() {}
+  virtual void setEncoder(ReadingEncoder &encoder) = 0;
+  virtual void onResult(UploadCallback callback) = 0;
+  virtual bool enqueue(const Reading &reading) = 0;     // false when the queue is full
+  virtual void poll(unsigned long now, bool online) = 0;
+  virtual uint8_t pending() const = 0;                  // queued and not yet reported to the callback
+};
+
+#endif
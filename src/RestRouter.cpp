@@ -0,0 +1,100 @@
+#include "RestRouter.h"
+#include "JsonWriter.h"
+#include <string.h>
+
+RestRouter::RestRouter() {
+  _count = 0;
+}
+
+bool RestRouter::on(const char *method, const char *path, RestHandler handler) {
+  if (_count == REST_MAX_ROUTES) {
+    return false;
+  }
+  Route &route = _routes[_count++];
+  route.method = method;
+  route.path = path;
+  route.handler = handler;
+  route.stream = REST_NO_STREAM;
+  return true;
+}
+
+bool RestRouter::onStream(const char *path, RestStreamFormat format) {
+  if (_count == REST_MAX_ROUTES) {
+    return false;
+  }
+  Route &route = _routes[_count++];
+  route.method = "GET";
+  route.path = path;
+  route.handler = 0;
+  route.stream = format;
+  return true;
+}
+
+RestStreamFormat RestRouter::respond(const HttpRequestParser &request, Print &out) {
+  const Route *found = 0;
+  bool pathKnown = false;
+  for (uint8_t i = 0; i < _count && !found; i++) {
+    if (!strcmp(_routes[i].path, request.path())) {
+      pathKnown = true;
+      if (!strcmp(_routes[i].method, request.method())) {
+        found = &_routes[i];
+      }
+    }
+  }
+  if (!found) {
+    writeError(pathKnown ? 405 : 404, out);
+    return REST_NO_STREAM;
+  }
+
+  if (found->stream == REST_SSE) {
+    out.print("HTTP/1.1 200 OK\r\nContent-Type: text/event-stream\r\nCache-Control: no-cache\r\nConnection: close\r\n\r\n");
+    return REST_SSE;
+  }
+  if (found->stream == REST_NDJSON) {
+    out.print("HTTP/1.1 200 OK\r\nContent-Type: application/x-ndjson\r\nCache-Control: no-cache\r\nTransfer-Encoding: chunked\r\nConnection: close\r\n\r\n");
+    return REST_NDJSON;
+  }
+
+  char buffer[REST_BODY_SIZE];
+  BufferPrint body(buffer, sizeof(buffer));
+  int status = found->handler(request, body);
+  if (body.overflowed()) {
+    writeError(500, out);
+    return REST_NO_STREAM;
+  }
+  out.print("HTTP/1.1 ");
+  out.print(status);
+  out.print(' ');
+  out.print(reason(status));
+  out.print("\r\nContent-Type: application/json\r\nContent-Length: ");
+  out.print((unsigned long)body.length());
+  out.print(request.keepAlive() ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+  out.write((const uint8_t *)buffer, body.length());
+  return REST_NO_STREAM;
+}
+
+void RestRouter::writeError(int status, Print &out) {
+  out.print("HTTP/1.1 ");
+  out.print(status);
+  out.print(' ');
+  out.print(reason(status));
+  out.print("\r\nContent-Length: 0\r\nConnection: close\r\n\r\n");
+}
+
+const char *RestRouter::reason(int status) {
+  switch (status) {
+    case 200: return "OK";
+    case 202: return "Accepted";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 405: return "Method Not Allowed";
+    case 408: return "Request Timeout";
+    case 409: return "Conflict";
+    case 413: return "Payload Too Large";
+    case 414: return "URI Too Long";
+    case 500: return "Internal Server Error";
+    case 501: return "Not Implemented";
+    case 503: return "Service Unavailable";
+    default: return "Unknown";
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef RestRouter_h
+#define RestRouter_h
+
+#include <Print.h>
+#include <HttpRequestParser.h>
+
+#define REST_MAX_ROUTES 8
+// largest response body, handlers write into a buffer this big so Content-Length is known
+#define REST_BODY_SIZE 256
+
+// how a stream route frames each line
+enum RestStreamFormat {
+  REST_NO_STREAM,
+  REST_SSE,           // text/event-stream, one "data:" event per line
+  REST_NDJSON         // chunked transfer encoding, one chunk per line
+};
+
+// Handlers write a JSON body and return the HTTP status to send with it
+typedef int (*RestHandler)(const HttpRequestParser &request, Print &body);
+
+// Maps method and path to a handler and writes the whole response, headers
+// included, to a Print. Paths match exactly, the query string is the handler's
+// business. A stream route only gets its headers written, the caller keeps the
+// connection and frames every line of the stream the way respond() said.
+class RestRouter {
+public:
+  RestRouter();
+  bool on(const char *method, const char *path, RestHandler handler);   // false when the table is full
+  bool onStream(const char *path, RestStreamFormat format);
+  RestStreamFormat respond(const HttpRequestParser &request, Print &out);  // REST_NO_STREAM unless the connection is now a stream
+  static void writeError(int status, Print &out);
+  static const char *reason(int status);
+
+private:
+  struct Route {
+    const char *method;
+    const char *path;
+    RestHandler handler;
+    RestStreamFormat stream;    // set for stream routes instead of handler
+  };
+  Route _routes[REST_MAX_ROUTES];
+  uint8_t _count;
+};
+
+#endif
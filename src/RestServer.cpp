@@ -0,0 +1,205 @@
+#include "RestServer.h"
+#include <stdlib.h>
+#include <string.h>
+
+RestServer::RestServer(WiFiServer &server, RestRouter &router)
+  : _server(server), _router(router) {
+  for (uint8_t i = 0; i < REST_MAX_CLIENTS; i++) {
+    _connections[i].lastActive = 0;
+    _connections[i].stream = REST_NO_STREAM;
+    _connections[i].head = 0;
+    _connections[i].used = 0;
+  }
+  _dropped = 0;
+}
+
+void RestServer::begin() {
+  _server.begin();
+  _server.setNoDelay(true);
+}
+
+void RestServer::poll(unsigned long now) {
+  accept(now);
+  for (uint8_t i = 0; i < REST_MAX_CLIENTS; i++) {
+    Connection &connection = _connections[i];
+    if (!connection.client) {
+      continue;
+    }
+    if (!connection.client.connected()) {
+      close(connection);
+      continue;
+    }
+    serve(connection, now);
+  }
+}
+
+void RestServer::accept(unsigned long now) {
+  while (_server.hasClient()) {
+    Connection *free = 0;
+    for (uint8_t i = 0; i < REST_MAX_CLIENTS && !free; i++) {
+      if (!_connections[i].client || !_connections[i].client.connected()) {
+        free = &_connections[i];
+      }
+    }
+    if (!free) {
+      WiFiClient extra = _server.available();
+      RestRouter::writeError(503, extra);
+      extra.stop();
+      continue;
+    }
+    close(*free);
+    free->client = _server.available();
+    free->lastActive = now;
+  }
+}
+
+void RestServer::serve(Connection &connection, unsigned long now) {
+  WiFiClient &client = connection.client;
+  if (connection.stream != REST_NO_STREAM) {
+    // nothing more is expected from a stream client, whatever it sends is dropped
+    while (client.available() > 0) {
+      client.read();
+    }
+    drain(connection);
+    return;
+  }
+
+  uint8_t budget = REST_READ_BUDGET;
+  while (budget-- && client.available() > 0) {
+    connection.lastActive = now;
+    HttpRequestParser::Result result = connection.request.feed((char)client.read());
+    if (result == HttpRequestParser::FAILED) {
+      RestRouter::writeError(connection.request.error(), client);
+      close(connection);
+      return;
+    }
+    if (result == HttpRequestParser::COMPLETE) {
+      RestStreamFormat format = _router.respond(connection.request, client);
+      if (format != REST_NO_STREAM) {
+        startStream(connection, format);
+        return;
+      }
+      bool keep = connection.request.keepAlive();
+      connection.request.reset();
+      if (!keep) {
+        close(connection);
+        return;
+      }
+    }
+  }
+
+  if (now - connection.lastActive >= REST_IDLE_TIMEOUT_MS) {
+    if (connection.request.started()) {
+      RestRouter::writeError(408, client);
+    }
+    close(connection);
+  }
+}
+
+void RestServer::startStream(Connection &connection, RestStreamFormat format) {
+  char every[8];
+  connection.stream = format;
+  connection.every = 1;
+  // the headers are out already, so a step past what every counts is clamped rather than refused.
+  // a number too long for the buffer is cut short but still clamps
+  if (connection.request.param("every", every, sizeof(every)) && every[0] >= '0' && every[0] <= '9') {
+    char *end;
+    unsigned long step = strtoul(every, &end, 10);
+    if (!*end && step > 1) {
+      connection.every = step > 255 ? 255 : (uint8_t)step;
+    }
+  }
+  connection.skipped = connection.every - 1;    // the next line goes out
+  connection.request.reset();
+}
+
+void RestServer::broadcast(const char *line) {
+  size_t length = strlen(line);
+  for (uint8_t i = 0; i < REST_MAX_CLIENTS; i++) {
+    Connection &connection = _connections[i];
+    if (connection.stream == REST_NO_STREAM) {
+      continue;
+    }
+    if (++connection.skipped < connection.every) {
+      continue;
+    }
+    connection.skipped = 0;
+    bool ok;
+    if (connection.stream == REST_SSE) {
+      ok = queue(connection, "data: ", 6) && queue(connection, line, length) && queue(connection, "\n\n", 2);
+    } else {
+      // chunk size in hex, the line and its newline, then the chunk's own CRLF
+      char size[8];
+      ultoa(length + 1, size, 16);
+      ok = queue(connection, size, strlen(size)) && queue(connection, "\r\n", 2) &&
+           queue(connection, line, length) && queue(connection, "\n\r\n", 3);
+    }
+    if (!ok) {
+      _dropped++;
+      close(connection);
+    }
+  }
+}
+
+bool RestServer::queue(Connection &connection, const char *data, size_t length) {
+  if (length > (size_t)(REST_STREAM_BUFFER - connection.used)) {
+    return false;
+  }
+  for (size_t i = 0; i < length; i++) {
+    connection.out[connection.head] = data[i];
+    connection.head = (connection.head + 1) % REST_STREAM_BUFFER;
+  }
+  connection.used += length;
+  return true;
+}
+
+// writes only what the socket has room for, the rest waits for the next poll
+void RestServer::drain(Connection &connection) {
+  while (connection.used > 0) {
+    int room = connection.client.availableForWrite();
+    if (room <= 0) {
+      return;
+    }
+    uint16_t tail = (connection.head + REST_STREAM_BUFFER - connection.used) % REST_STREAM_BUFFER;
+    size_t run = REST_STREAM_BUFFER - tail;     // contiguous bytes before the ring wraps
+    if (run > connection.used) {
+      run = connection.used;
+    }
+    if (run > (size_t)room) {
+      run = room;
+    }
+    size_t written = connection.client.write(connection.out + tail, run);
+    if (written == 0) {
+      return;
+    }
+    connection.used -= written;
+  }
+}
+
+void RestServer::close(Connection &connection) {
+  connection.client.stop();
+  connection.client = WiFiClient();
+  connection.request.reset();
+  connection.stream = REST_NO_STREAM;
+  connection.used = 0;
+}
+
+uint8_t RestServer::clients() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < REST_MAX_CLIENTS; i++) {
+    if (_connections[i].client && _connections[i].client.connected()) {
+      count++;
+    }
+  }
+  return count;
+}
+
+uint8_t RestServer::streams() {
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < REST_MAX_CLIENTS; i++) {
+    if (_connections[i].stream != REST_NO_STREAM && _connections[i].client.connected()) {
+      count++;
+    }
+  }
+  return count;
+}
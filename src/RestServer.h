@@ -0,0 +1,60 @@
+#ifndef RestServer_h
+#define RestServer_h
+
+#include <Arduino.h>
+#include <WiFiServer.h>
+#include <WiFiClient.h>
+#include <HttpRequestParser.h>
+#include "RestRouter.h"
+
+// connections served at once, further ones are answered 503 and closed
+#define REST_MAX_CLIENTS 4
+// a connection that hasn't finished a request in this long is closed
+#define REST_IDLE_TIMEOUT_MS 5000
+// request bytes taken from one connection per poll, keeps a chatty client from holding up loop()
+#define REST_READ_BUDGET 128
+// stream bytes queued per connection, a stream client that falls this far behind is dropped
+#define REST_STREAM_BUFFER 512
+
+// Local HTTP API on a WiFiServer, polled from loop() and never waiting on a
+// client. Each connection gets a fixed size parser, complete requests go
+// through the router and keep-alive connections stay open for the next one.
+// Connections that asked for a stream stay open and get every broadcast(),
+// or every Nth with ?every=N. Stream data goes through a ring per connection
+// and poll() only writes what the socket takes without blocking, so a slow
+// client costs nothing until its ring is full, then it is dropped.
+class RestServer {
+public:
+  RestServer(WiFiServer &server, RestRouter &router);
+  void begin();
+  void poll(unsigned long now);
+  void broadcast(const char *line);       // one JSON line, without the newline, to every open stream
+  uint8_t clients();
+  uint8_t streams();
+  uint16_t dropped() const { return _dropped; }   // stream clients cut off for falling behind
+
+private:
+  struct Connection {
+    WiFiClient client;
+    HttpRequestParser request;
+    unsigned long lastActive;
+    uint8_t stream;             // RestStreamFormat
+    uint8_t every;              // send every Nth line of the stream, ?every= above 255 is clamped
+    uint8_t skipped;            // lines not sent since the last one that was
+    uint16_t head;              // next free byte in out
+    uint16_t used;              // bytes waiting in out
+    uint8_t out[REST_STREAM_BUFFER];
+  };
+  void accept(unsigned long now);
+  void serve(Connection &connection, unsigned long now);
+  void startStream(Connection &connection, RestStreamFormat format);
+  bool queue(Connection &connection, const char *data, size_t length);
+  void drain(Connection &connection);
+  void close(Connection &connection);
+  WiFiServer &_server;
+  RestRouter &_router;
+  Connection _connections[REST_MAX_CLIENTS];
+  uint16_t _dropped;
+};
+
+#endif
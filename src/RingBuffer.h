@@ -0,0 +1,54 @@
+#ifndef RingBuffer_h
+#define RingBuffer_h
+
+#include <inttypes.h>
+
+// keeps the compiler from moving the item store past the index update
+#define RING_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+// Single producer / single consumer ring buffer. One side may push from an ISR
+// while the other pops from loop(), neither needs to disable interrupts as long
+// as there is only one of each. N must be a power of two and no more than 128.
+template <typename T, uint8_t N>
+class RingBuffer {
+public:
+  RingBuffer() : _head(0), _tail(0), _overflows(0) {}
+
+  // returns false (and counts an overflow) when the buffer is full,
+  // always inlined so an ISR calling it doesn't jump into flash
+  inline __attribute__((always_inline)) bool push(const T &item) {
+    uint8_t head = _head;
+    if ((uint8_t)(head - _tail) == N) {
+      _overflows++;
+      return false;
+    }
+    _items[head & (N - 1)] = item;
+    RING_BARRIER();
+    _head = head + 1;
+    return true;
+  }
+
+  bool pop(T &item) {
+    uint8_t tail = _tail;
+    if (tail == _head) {
+      return false;
+    }
+    item = _items[tail & (N - 1)];
+    RING_BARRIER();
+    _tail = tail + 1;
+    return true;
+  }
+
+  uint8_t size() const { return (uint8_t)(_head - _tail); }
+  bool empty() const { return _head == _tail; }
+  uint16_t overflows() const { return _overflows; }
+
+private:
+  static_assert((N & (N - 1)) == 0 && N <= 128, "RingBuffer size must be a power of two up to 128");
+  T _items[N];
+  volatile uint8_t _head;   // only written by the producer
+  volatile uint8_t _tail;   // only written by the consumer
+  volatile uint16_t _overflows;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "SntpClock.h"
+#include <string.h>
+
+#define SNTP_PACKET_SIZE 48
+// seconds from the NTP era (1900) to the unix epoch (1970)
+#define SNTP_UNIX_OFFSET 2208988800ULL
+
+SntpClock::SntpClock(UDP &udp, const char *server)
+  : _udp(udp) {
+  _server = server;
+  _lastMillis = 0;
+  _wraps = 0;
+  _udpOpen = false;
+  _waiting = false;
+  _synced = false;
+  _requestAt = 0;
+  _nextAttempt = 0;
+  _offset = 0;
+  memset(_sent, 0, sizeof(_sent));
+}
+
+uint64_t SntpClock::uptime(unsigned long now) {
+  uint32_t ms = now;
+  if (ms - _lastMillis < 0x80000000UL) {
+    // moved forward, past the wrap if the count went down
+    if (ms < _lastMillis) {
+      _wraps++;
+    }
+    _lastMillis = ms;
+    return ((uint64_t)_wraps << 32) | ms;
+  }
+  // a stamp taken a little before the last call, not a wrap, it may be from before the last one though
+  uint32_t wraps = (ms > _lastMillis && _wraps > 0) ? _wraps - 1 : _wraps;
+  return ((uint64_t)wraps << 32) | ms;
+}
+
+uint64_t SntpClock::uptimeAt(unsigned long then, unsigned long now) {
+  return uptime(now) - (uint32_t)(now - then);
+}
+
+void SntpClock::poll(unsigned long millisNow, bool online) {
+  uint64_t now = uptime(millisNow);
+  if (!online) {
+    _waiting = false;
+    return;
+  }
+  if (!_udpOpen) {
+    _udpOpen = _udp.begin(SNTP_LOCAL_PORT);
+    if (!_udpOpen) {
+      return;
+    }
+  }
+  if (_waiting) {
+    if (readReply(now)) {
+      _waiting = false;
+      _nextAttempt = now + SNTP_RESYNC_MS;
+    } else if (now - _requestAt >= SNTP_TIMEOUT_MS) {
+      _waiting = false;
+      _nextAttempt = now + SNTP_RETRY_MS;
+    }
+    return;
+  }
+  if (now >= _nextAttempt) {
+    sendRequest(now);
+  }
+}
+
+void SntpClock::sendRequest(uint64_t now) {
+  uint8_t packet[SNTP_PACKET_SIZE];
+  memset(packet, 0, sizeof(packet));
+  packet[0] = 0x23;     // no leap warning, version 4, client mode
+  // we have no wall time to offer, the uptime just has to be unique enough to match the reply
+  for (uint8_t i = 0; i < 8; i++) {
+    _sent[i] = (uint8_t)(now >> (8 * (7 - i)));
+  }
+  memcpy(packet + 40, _sent, 8);
+  if (_udp.beginPacket(_server, SNTP_PORT) && _udp.write(packet, sizeof(packet)) == sizeof(packet) && _udp.endPacket()) {
+    _waiting = true;
+    _requestAt = now;
+  } else {
+    _nextAttempt = now + SNTP_RETRY_MS;
+  }
+}
+
+bool SntpClock::readReply(uint64_t now) {
+  int size = _udp.parsePacket();
+  if (size <= 0) {
+    return false;
+  }
+  uint8_t packet[SNTP_PACKET_SIZE];
+  if (size < SNTP_PACKET_SIZE || _udp.read(packet, SNTP_PACKET_SIZE) != SNTP_PACKET_SIZE) {
+    _udp.flush();
+    return false;
+  }
+  _udp.flush();
+  uint8_t mode = packet[0] & 0x07;
+  uint8_t stratum = packet[1];
+  if (mode != 4 || stratum == 0 || stratum > 15 || memcmp(packet + 24, _sent, 8) != 0) {
+    return false;     // not a server reply, a kiss of death, or an answer to some other request
+  }
+  uint64_t seconds = ((uint64_t)packet[40] << 24) | ((uint64_t)packet[41] << 16) | ((uint64_t)packet[42] << 8) | packet[43];
+  uint64_t fraction = ((uint64_t)packet[44] << 24) | ((uint64_t)packet[45] << 16) | ((uint64_t)packet[46] << 8) | packet[47];
+  uint64_t serverMs = (seconds - SNTP_UNIX_OFFSET) * 1000 + ((fraction * 1000) >> 32);
+  // the server's time is taken to be half way through the round trip
+  uint64_t roundTrip = now - _requestAt;
+  _offset = (int64_t)(serverMs + roundTrip / 2) - (int64_t)now;
+  _synced = true;
+  return true;
+}
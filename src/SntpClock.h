@@ -0,0 +1,43 @@
+#ifndef SntpClock_h
+#define SntpClock_h
+
+#include <Arduino.h>
+#include <Udp.h>
+
+#define SNTP_PORT 123
+#define SNTP_LOCAL_PORT 2390
+#define SNTP_TIMEOUT_MS 2000
+#define SNTP_RETRY_MS 15000
+#define SNTP_RESYNC_MS 86400000UL   // once a day keeps the drift of the crystal in check
+
+// Wall clock time for readings. millis() is extended to 64 bits so it never
+// wraps, and one SNTP exchange gives the offset from that to epoch ms. Nothing
+// blocks: poll() from loop() sends the request and picks up the answer later.
+// uptime() has to run at least once every 24 days to catch the wrap, poll() does.
+// A stamp older than the last call, like uptimeAt() gets, is not taken for a wrap.
+class SntpClock {
+public:
+  SntpClock(UDP &udp, const char *server);
+  void poll(unsigned long now, bool online);
+  uint64_t uptime(unsigned long now);                         // ms since boot
+  uint64_t uptimeAt(unsigned long then, unsigned long now);   // an older millis() stamp, eg. from a sample, as ms since boot
+  bool synced() const { return _synced; }
+  uint64_t epochMs(uint64_t uptime) const { return uptime + _offset; }   // only meaningful once synced
+
+private:
+  void sendRequest(uint64_t now);
+  bool readReply(uint64_t now);
+  UDP &_udp;
+  const char *_server;
+  uint32_t _lastMillis;
+  uint32_t _wraps;
+  bool _udpOpen;
+  bool _waiting;
+  bool _synced;
+  uint64_t _requestAt;        // uptime the request went out
+  uint64_t _nextAttempt;
+  int64_t _offset;            // epoch ms - uptime
+  uint8_t _sent[8];           // our transmit timestamp, the server echoes it as the originate timestamp
+};
+
+#endif
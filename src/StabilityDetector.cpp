@@ -0,0 +1,69 @@
+#include "StabilityDetector.h"
+#include <math.h>
+
+StabilityDetector::StabilityDetector(long maxStdDev, long maxSlope, long loadDelta) {
+  _maxStdDev = maxStdDev;
+  _maxSlope = maxSlope;
+  _loadDelta = loadDelta;
+  _hasSettledBefore = false;
+  _settledValue = 0;
+  reset();
+}
+
+void StabilityDetector::reset() {
+  _count = 0;
+  _next = 0;
+  _settled = false;
+  _loadChanged = false;
+  _confidence = 0;
+}
+
+bool StabilityDetector::update(long value) {
+  _window[_next] = value;
+  _next = (_next + 1) % STABILITY_WINDOW;
+  if (_count < STABILITY_WINDOW) {
+    _count++;
+  }
+  if (_count < STABILITY_WINDOW) {
+    _confidence = 0;
+    return false;
+  }
+
+  // work relative to the newest reading so the sums stay small, oldest reading is i = 0
+  float mean = 0;
+  float slopeNum = 0;
+  const float centre = (STABILITY_WINDOW - 1) / 2.0f;
+  for (uint8_t i = 0; i < STABILITY_WINDOW; i++) {
+    float x = _window[(_next + i) % STABILITY_WINDOW] - value;
+    mean += x;
+    slopeNum += (i - centre) * x;
+  }
+  mean /= STABILITY_WINDOW;
+  float variance = 0;
+  for (uint8_t i = 0; i < STABILITY_WINDOW; i++) {
+    float d = _window[(_next + i) % STABILITY_WINDOW] - value - mean;
+    variance += d * d;
+  }
+  variance /= STABILITY_WINDOW;
+  // sum((i - centre)^2) over the window
+  const float slopeDen = STABILITY_WINDOW * ((float)STABILITY_WINDOW * STABILITY_WINDOW - 1) / 12.0f;
+  float slope = fabsf(slopeNum / slopeDen);
+
+  float worst = sqrtf(variance) / _maxStdDev;
+  if (slope / _maxSlope > worst) {
+    worst = slope / _maxSlope;
+  }
+  _confidence = (worst >= 1.0f) ? 0 : (uint8_t)((1.0f - worst) * 100);
+
+  bool nowSettled = worst < 1.0f;
+  bool event = nowSettled && !_settled;
+  _settled = nowSettled;
+  if (event) {
+    long settledValue = value + (long)mean;
+    long moved = settledValue - _settledValue;
+    _loadChanged = !_hasSettledBefore || moved > _loadDelta || moved < -_loadDelta;
+    _settledValue = settledValue;
+    _hasSettledBefore = true;
+  }
+  return event;
+}
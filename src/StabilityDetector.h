@@ -0,0 +1,39 @@
+#ifndef StabilityDetector_h
+#define StabilityDetector_h
+
+#include <inttypes.h>
+
+// readings looked at when deciding whether the weight has settled
+#define STABILITY_WINDOW 16
+
+// Watches the filtered readings and decides when the weight has settled.
+// A window counts as settled when both its standard deviation and its
+// least squares slope are under the limits. update() returns true once per
+// settle, and confidence() says how far inside the limits the window is.
+class StabilityDetector {
+public:
+  // limits are in counts and counts per reading, loadDelta is how far a settled
+  // value must move from the previous one to count as a new load
+  StabilityDetector(long maxStdDev, long maxSlope, long loadDelta);
+  bool update(long value);
+  void reset();
+  bool settled() const { return _settled; }
+  uint8_t confidence() const { return _confidence; }   // 0-100
+  long settledValue() const { return _settledValue; }
+  bool loadChanged() const { return _loadChanged; }     // the last settle was a different load than the one before
+
+private:
+  long _window[STABILITY_WINDOW];
+  uint8_t _count;
+  uint8_t _next;
+  long _maxStdDev;
+  long _maxSlope;
+  long _loadDelta;
+  bool _settled;
+  bool _hasSettledBefore;
+  bool _loadChanged;
+  uint8_t _confidence;
+  long _settledValue;
+};
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef WeightFilter_h
+#define WeightFilter_h
+
+#include <inttypes.h>
+
+// Filters for raw HX711 counts. Every stage has update(long) and reset(),
+// keeps its state inline (no allocation) and is chained at compile time with
+// FilterChain so a reading passes through the stages without virtual calls, eg.
+//   FilterChain<MedianFilter<3>, KalmanFilter<16, 900, 2000> > filter;
+//   long smoothed = filter.update(raw);
+
+// Running median over the last N readings, a bump of the case only moves a
+// single reading so it never reaches the output. O(N) per reading.
+template <uint8_t N>
+class MedianFilter {
+public:
+  MedianFilter() { reset(); }
+
+  long update(long x) {
+    uint8_t i;
+    if (_count == N) {
+      // drop the oldest reading from the sorted copy
+      long oldest = _window[_next];
+      for (i = 0; _sorted[i] != oldest; i++) {}
+      for (; i + 1 < _count; i++) {
+        _sorted[i] = _sorted[i + 1];
+      }
+      _count--;
+    }
+    _window[_next] = x;
+    _next = (_next + 1) % N;
+    for (i = _count; i > 0 && _sorted[i - 1] > x; i--) {
+      _sorted[i] = _sorted[i - 1];
+    }
+    _sorted[i] = x;
+    _count++;
+    return _sorted[_count / 2];
+  }
+
+  void reset() {
+    _count = 0;
+    _next = 0;
+  }
+
+private:
+  static_assert(N > 0, "MedianFilter needs a window");
+  long _window[N];    // readings in arrival order
+  long _sorted[N];    // the same readings in order of value
+  uint8_t _count;
+  uint8_t _next;
+};
+
+// Exponential moving average with alpha = 1/2^Shift, kept in fixed point
+// since the ESP8266 has no FPU. The first reading primes it directly.
+template <uint8_t Shift>
+class EmaFilter {
+public:
+  EmaFilter() { reset(); }
+
+  long update(long x) {
+    if (!_primed) {
+      _acc = x * (1L << Shift);
+      _primed = true;
+    } else {
+      _acc += x - (_acc >> Shift);
+    }
+    return _acc >> Shift;
+  }
+
+  void reset() { _primed = false; }
+
+private:
+  static_assert(Shift <= 7, "24 bit readings only leave room for 7 fraction bits");
+  long _acc;
+  bool _primed;
+};
+
+// 1-D Kalman filter for a weight that is mostly constant. ProcessNoise and
+// MeasurementNoise are variances in counts^2. A reading more than StepReset
+// counts from the estimate means something was put on or taken off, so the
+// estimate restarts there instead of crawling towards it. Fixed point like the
+// EMA, the estimate with 7 fraction bits, the error with 4 and the gain with 12,
+// so a reading costs a few multiplies and one 32 bit integer division.
+template <long ProcessNoise, long MeasurementNoise, long StepReset>
+class KalmanFilter {
+public:
+  KalmanFilter() { reset(); }
+
+  long update(long x) {
+    long innovation = x - ((_estimate + (1L << 6)) >> 7);
+    if (!_primed || innovation > StepReset || innovation < -StepReset) {
+      _estimate = x * (1L << 7);
+      _error = MeasurementNoise << 4;
+      _primed = true;
+      return x;
+    }
+    _error += ProcessNoise << 4;
+    unsigned long gain = (_error << 12) / (_error + (MeasurementNoise << 4));
+    _estimate += ((long)gain * (x * (1L << 7) - _estimate) + (1L << 11)) >> 12;
+    _error = (_error * ((1UL << 12) - gain)) >> 12;
+    return (_estimate + (1L << 6)) >> 7;
+  }
+
+  void reset() {
+    _estimate = 0;            // only read before priming to work out the innovation
+    _error = MeasurementNoise << 4;
+    _primed = false;
+  }
+
+private:
+  static_assert(ProcessNoise + MeasurementNoise < (1L << 15), "the error needs 12 bits of headroom for the gain");
+  static_assert(StepReset < (1L << 12), "an innovation times the gain has to fit in 31 bits");
+  long _estimate;
+  unsigned long _error;
+  bool _primed;
+};
+
+// Chains filter stages, the output of each is the input of the next.
+template <typename First, typename... Rest>
+class FilterChain {
+public:
+  long update(long x) { return _rest.update(_first.update(x)); }
+
+  void reset() {
+    _first.reset();
+    _rest.reset();
+  }
+
+private:
+  First _first;
+  FilterChain<Rest...> _rest;
+};
+
+template <typename Last>
+class FilterChain<Last> {
+public:
+  long update(long x) { return _last.update(x); }
+  void reset() { _last.reset(); }
+
+private:
+  Last _last;
+};
+
+#endif
@@ -0,0 +1,52 @@
+#include "WifiManager.h"
+
+WifiManager::WifiManager(WifiDriver &driver, const char *ssid, const char *password)
+  : _driver(driver) {
+  _ssid = ssid;
+  _password = password;
+  _state = IDLE;
+  _changed = false;
+  _since = 0;
+  _backoff = WIFI_BACKOFF_MIN_MS;
+}
+
+void WifiManager::begin(unsigned long now) {
+  _driver.begin(_ssid, _password);
+  enter(CONNECTING, now);
+}
+
+WifiManager::State WifiManager::poll(unsigned long now) {
+  _changed = false;
+  switch (_state) {
+    case IDLE:
+      break;
+    case CONNECTING:
+      if (_driver.connected()) {
+        _backoff = WIFI_BACKOFF_MIN_MS;
+        enter(CONNECTED, now);
+      } else if (now - _since >= WIFI_CONNECT_TIMEOUT_MS) {
+        _driver.disconnect();
+        enter(BACKOFF, now);
+      }
+      break;
+    case CONNECTED:
+      if (!_driver.connected()) {
+        enter(BACKOFF, now);
+      }
+      break;
+    case BACKOFF:
+      if (now - _since >= _backoff) {
+        _backoff = (_backoff * 2 > WIFI_BACKOFF_MAX_MS) ? WIFI_BACKOFF_MAX_MS : _backoff * 2;
+        _driver.begin(_ssid, _password);
+        enter(CONNECTING, now);
+      }
+      break;
+  }
+  return _state;
+}
+
+void WifiManager::enter(State state, unsigned long now) {
+  _state = state;
+  _since = now;
+  _changed = true;
+}
@@ -0,0 +1,50 @@
+#ifndef WifiManager_h
+#define WifiManager_h
+
+#include <inttypes.h>
+
+// how long one association attempt may take before we back off
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+// backoff after a failed attempt or a lost link, doubles up to the max
+#define WIFI_BACKOFF_MIN_MS 1000
+#define WIFI_BACKOFF_MAX_MS 60000
+
+// The station calls the manager needs, so the state machine doesn't depend on
+// ESP8266WiFi and can be driven by a fake off the device.
+class WifiDriver {
+public:
+  virtual ~WifiDriver() {}
+  virtual void begin(const char *ssid, const char *password) = 0;
+  virtual bool connected() = 0;
+  virtual void disconnect() = 0;
+};
+
+// Connects once and keeps the station associated. Nothing blocks: poll() is
+// called from loop() with the current millis() and moves the state machine
+//   IDLE -> CONNECTING -> CONNECTED
+//               |  ^          |
+//               v  |          |
+//             BACKOFF <-------+  (timeout or link lost)
+class WifiManager {
+public:
+  enum State { IDLE, CONNECTING, CONNECTED, BACKOFF };
+
+  WifiManager(WifiDriver &driver, const char *ssid, const char *password);
+  void begin(unsigned long now);
+  State poll(unsigned long now);
+  State state() const { return _state; }
+  bool connected() const { return _state == CONNECTED; }
+  bool changed() const { return _changed; }     // the state moved during the last poll()
+
+private:
+  void enter(State state, unsigned long now);
+  WifiDriver &_driver;
+  const char *_ssid;
+  const char *_password;
+  State _state;
+  bool _changed;
+  unsigned long _since;                         // when the current state was entered
+  unsigned long _backoff;
+};
+
+#endif
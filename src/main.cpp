@@ -1,11 +1,29 @@
 #include <Arduino.h>
 #include <Wire.h>
 #include <LiquidCrystal_I2C.h>
-#include <HX711.h>
+#include "HX711Sampler.h"
+#include "WeightFilter.h"
+#include "StabilityDetector.h"
+#include "WifiManager.h"
+#include "Esp8266WifiDriver.h"
+#include "HttpUploader.h"
+#include "CatalogUpdater.h"
+#include "MqttPublisher.h"
+#include "JsonReadingEncoder.h"
+#include "BinaryReadingEncoder.h"
+#include "LittleFSFile.h"
+#include <ReadingJournal.h>
+#include <FoodCatalog.h>
+#include <LittleFS.h>
+#include <WiFiUdp.h>
+#include "SntpClock.h"
+#include "ButtonEvents.h"
+#include "RestRouter.h"
+#include "RestServer.h"
+#include "JsonWriter.h"
+#include <Ticker.h>
 #include <ESP8266WiFi.h>
-#include <ESP8266HTTPClient.h>
 #include <ESP8266WiFiMulti.h>
-#include <ArduinoJson.h>
 #include <string>
 
 
@@ -13,10 +31,10 @@
 //Wifi login
 const char* ssid = "WifiSSID";
 const char* password = "PASWORD";
-//Set Web server port
+//Set Web server port, the local API is served from the main loop so the scale can be read without the collector
 WiFiServer server(88); 
-//Store HTTP request
-String HTTPRequest;
+RestRouter apiRouter;
+RestServer api(server, apiRouter);
 
 
 
@@ -26,135 +44,448 @@ String HTTPRequest;
 #define leftPin 0
 #define rightPin 2
 
-//Set the I2C id and LCD size
-LiquidCrystal_I2C lcd(0x27, 16, 2);  
+//Set the I2C id and LCD size, both fixed at compile time so the cursor addressing is worked out by the compiler
+LiquidCrystalI2C<0x27, 16, 2> lcd;
 
-// initialize Scale object
+// initialize Scale sampler, readings are clocked out from the data ready interrupt
 // pin 13 for DOUT and 12 for clk
-HX711 scale(13,12);
+HX711Sampler scale(13,12);
 
 //variables for scale
+const float calibrationfactor = 2067;   //this is slightly off but with my 3d printed case prob as accurate as i will get it untill 
+                                        //i put more thought into its phyiscal construction
+const int tareSamples = 10;             //number of readings averaged for the tare offset
+long tareOffset = 0;
+bool tareRequested = true;              //tare on boot
+int tareCount = 0;
+long tareSum = 0;
+//median knocks out bumps, the kalman stage smooths the rest and jumps straight to a new load (~1g step)
+FilterChain<MedianFilter<3>, KalmanFilter<16, 900, 2000> > weightFilter;
+long filtered = 0;
+//settled once the last 16 readings are within ~0.5g and not drifting, a new load is anything over 1g away
+StabilityDetector stability(1000, 100, 2067);
+const unsigned long unsettledRedrawMs = 250;  //how often the LCD follows the weight while it is still moving
+unsigned long lastRedraw = 0;
+//grams of food a full container holds, above 0 the second row shows the weight and how full the container is as a bar
+const int fillBarGrams = 0;
+const uint8_t fillBarColumn = 6;              //the bar gets the columns after "-1234g", 10 columns are 50 steps
+//wifi, upload pending and stable icons in the last 3 columns of the top row, the lcd keeps their glyphs in CGRAM
+const bool statusIcons = true;
+enum { GLYPH_WIFI = 1, GLYPH_NO_WIFI, GLYPH_UPLOAD, GLYPH_STABLE };
+const uint8_t wifiGlyph[8] = {0x00, 0x0e, 0x11, 0x04, 0x0a, 0x00, 0x04, 0x00};
+const uint8_t noWifiGlyph[8] = {0x00, 0x0e, 0x11, 0x04, 0x0a, 0x00, 0x11, 0x0a};   //the arcs with a cross under them
+const uint8_t uploadGlyph[8] = {0x04, 0x0e, 0x15, 0x04, 0x04, 0x04, 0x1f, 0x00};
+const uint8_t stableGlyph[8] = {0x00, 0x01, 0x03, 0x16, 0x1c, 0x08, 0x00, 0x00};
+uint8_t shownIcons = 0xff;                    //states the icons were last drawn for, 0xff to draw them again
+const bool autoPostOnSettle = false;          //send the reading by itself once a new load has settled
 int weight = 0;
+unsigned long weightTime = 0;                 //millis() when the reading behind weight was sampled
 int lastWeight = 1;  //set to one to ensure LCD updates on first boot
-int foodPos = 0;
-int lastFoodPos = 1;
-String currentFood = "";
-const int numberOfFoodItems = 4;
-String foodName[numberOfFoodItems] = {"Milo", "Coffee", "Tea", "Sugar"};
-
-//variables for wifi
+long foodPos = 0;                             //index into the catalog, which is sorted by name
+long lastFoodPos = -1;                        //set to -1 to ensure LCD updates on first boot
+FoodItem currentFood = {0, 0, 0, ""};
+
+//food catalog, kept sorted by name in flash and read a few foods at a time so any number of them fit
+LittleFSFile foodFile("/foods.bin");
+LittleFSFile foodUpdateFile("/foods.tmp");
+LittleFSFile foodIndexFile("/foods.idx");     //ids in order, so looking one up doesn't read the whole catalog
+LittleFSFile foodScratchFile("/foods.srt");
+LittleFSFile foodUpdateIndexFile("/foods.idt");
+FoodCatalog foods(foodFile, foodIndexFile);
+FoodIndexWriter foodIndexer(foodFile, foodIndexFile, foodScratchFile);
+bool foodIndexing = false;
+FoodItem labelFood = {0, 0, 0, ""};           //the last food foodLabel() looked up, encoder and result callback ask for the same one
+//what a fresh scale starts with, ids are the positions the old fixed list had
+const FoodItem defaultFoods[] PROGMEM = {
+  {1, 0, 0, "Coffee"},
+  {0, 0, 0, "Milo"},
+  {3, 0, 0, "Sugar"},
+  {2, 0, 0, "Tea"},
+};
+//the collector serves the catalog file, it is fetched once per boot when it has a newer revision.
+//the download and its index are written next to the catalog in use and swapped in once both are complete
+WiFiClient catalogClient;
+FoodCatalogWriter foodUpdateWriter(foodUpdateFile);
+FoodIndexWriter foodUpdateIndexer(foodUpdateFile, foodUpdateIndexFile, foodScratchFile);
+CatalogUpdater catalogUpdater(catalogClient, "192.168.0.151", 8090, "/foods", foodUpdateWriter, foodUpdateIndexer);
+bool catalogChecked = false;
+
+//variables for wifi, we connect once at boot and the manager keeps the link up from loop()
+Esp8266WifiDriver wifiDriver;
+WifiManager wifi(wifiDriver, ssid, password);
 bool sendJson = false;
-WiFiClient client = server.available();
 
-//variables for jsonPost
-const int capacity = JSON_OBJECT_SIZE(3) + 70;    //+70 from arduinoJson helper (calcs space needed for strints in http request)        
-StaticJsonDocument<capacity> doc;                 //make our json doc which will hold the json to send
+//variables for uploading, readings are pipelined over one keep-alive connection to the collector
+WiFiClient collectorClient;
+HttpUploader uploader(collectorClient, "192.168.0.151", 8090, "/postjson");
+const char *foodLabel(uint16_t food);
+JsonReadingEncoder jsonEncoder(foodLabel);        //pass true as well to send batches as NDJSON instead of a JSON array
+BinaryReadingEncoder cborEncoder(BinaryReadingEncoder::CBOR);
+BinaryReadingEncoder recordEncoder(BinaryReadingEncoder::RECORD);
+ReadingEncoder &uploadEncoder = jsonEncoder;      //cborEncoder or recordEncoder cut the body to ~20 bytes, the collector goes by the Content-Type
+//readings per request and how long a part filled batch waits, above 1 the collector gets a JSON array
+const uint8_t uploadBatch = 1;
+const unsigned long uploadBatchWaitMs = 10000;
+
+//or publish to an MQTT broker instead, one reading per message on wifiscale/<chip id>/reading
+WiFiClient brokerClient;
+MqttPublisher mqtt(brokerClient, "192.168.0.151", 1883, "wifiscale");
+const bool useMqtt = false;
+const uint8_t mqttQos = 1;                        //1 waits for the broker to confirm every reading, 0 fires and forgets
+char deviceId[16];
+ReadingTransport &transport = useMqtt ? static_cast<ReadingTransport &>(mqtt) : static_cast<ReadingTransport &>(uploader);
+
+//readings are journaled to flash first so nothing is lost while the collector is down
+LittleFSFile journalLog("/journal.bin");
+LittleFSFile journalCursor("/journal.cur");
+ReadingJournal journal(journalLog, journalCursor);
+
+//wall clock for stamping readings, synced once over SNTP and then run from millis()
+WiFiUDP ntpUdp;
+SntpClock wallClock(ntpUdp, "pool.ntp.org");
+const uint8_t replayBatch = 8;                    //readings handed from the journal to the uploader at a time
+//a reading the collector failed stays where it is in the journal and goes again after a backoff, doubling up to a minute
+const unsigned long replayRetryMs = 2000;
+const unsigned long replayRetryMaxMs = 60000;
+unsigned long replayBackoffMs = 0;
+unsigned long replayFailedAt = 0;
+bool replayFailed = false;                        //answers after a failure are for readings that will be sent again
+
+void drawIcon(uint8_t id, const uint8_t *bitmap, char fallback){  //Method to put one status icon at the cursor
+  uint8_t cell = lcd.glyph(id, bitmap, fallback);
+  if (cell == (uint8_t)fallback){
+    shownIcons = 0xff;                            //no CGRAM slot could be freed yet, try again next pass
+  }
+  lcd.write(cell);
+}
 
-void connectToWifi(){                             //Method to connect to Wifi, also displays message telling user the scale is attempting to connect
-  noInterrupts();
-  lcd.setCursor(0, 1);
-  lcd.print("Connecting to Wifi now");
+void drawIcons(){                                 //Method to redraw the status icons when one of them changed
+  uint8_t state = (wifi.connected() ? 1 : 0) | (journal.unacked() > 0 ? 2 : 0) | (stability.settled() ? 4 : 0);
+  if (state == shownIcons){
+    return;
+  }
+  shownIcons = state;
+  lcd.setCursor(lcd.cols() - 3, 0);
+  if (wifi.connected()){
+    drawIcon(GLYPH_WIFI, wifiGlyph, 'W');
+  } else {
+    drawIcon(GLYPH_NO_WIFI, noWifiGlyph, '!');
+  }
+  if (journal.unacked() > 0){
+    drawIcon(GLYPH_UPLOAD, uploadGlyph, '^');
+  } else {
+    lcd.write(' ');
+  }
+  if (stability.settled()){
+    drawIcon(GLYPH_STABLE, stableGlyph, '*');
+  } else {
+    lcd.write(' ');
+  }
+}
 
-  //Setup Wifi connection
-  Serial.println("Setting up Wifi now");
-  WiFi.begin(ssid, password);
-  while(WiFi.status() != WL_CONNECTED){
-    delay(100);
-    Serial.print ("/");
-  }
-  Serial.println("!");
-  Serial.println("Wifi is now connected!");
-  Serial.print("IP address is ");
-  Serial.print(WiFi.localIP());
-  Serial.println("");
-  interrupts();
-}
-
-void jsonPOST(String weight, String foodtype){
-  noInterrupts();
-  Serial.print("Weight is ");
-  Serial.println(weight);
-  Serial.print("Food type is ");
-  Serial.println(foodtype);
-  HTTPClient http;
-
-  doc["timestamp"].set("09/05/2017 18:00:00");       //will be removed in later revisions
-  doc["weight"].set(weight);
-  doc["foodtype"].set(foodtype);
-
-  String jsonString;
-  serializeJson(doc, jsonString);              
-  
-  Serial.println(jsonString);
-  
-  http.begin("http://192.168.0.151:8090/postjson");
-
-  http.addHeader("Content-Type", "application/json");
-
-  int httpCode = http.POST(jsonString);            //Send the request
-  //String payload = http.getString();             //Get the response (usually too big causing esp to crash)
- 
-  Serial.println(httpCode);                        //Print HTTP return code
-  //Serial.println(payload);                       //Print request response payload
- 
-  http.end();                                      //Close connectio
-  interrupts();
+void reportWifi(){                                //Method to log changes of the wifi connection state
+  switch(wifi.state()){
+    case WifiManager::CONNECTING:
+      Serial.println("Connecting to Wifi now");
+      break;
+    case WifiManager::CONNECTED:
+      Serial.println("Wifi is now connected!");
+      Serial.print("IP address is ");
+      Serial.print(WiFi.localIP());
+      Serial.println("");
+      break;
+    case WifiManager::BACKOFF:
+      Serial.println("Wifi connection failed or lost, retrying soon");
+      break;
+    default:
+      break;
+  }
+}
+
+const char *foodLabel(uint16_t food){             //Method to look up the food name the collector gets
+  if (food == currentFood.id){
+    return currentFood.name;
+  }
+  if (food == labelFood.id && labelFood.name[0]){
+    return labelFood.name;
+  }
+  long index = foods.find(food);
+  if (index < 0 || !foods.get(index, labelFood)){
+    labelFood.name[0] = 0;
+    return "unknown";
+  }
+  return labelFood.name;
+}
+
+bool writeDefaultCatalog(){                       //Method to put the built in foods in flash when there is no catalog yet
+  const uint8_t count = sizeof(defaultFoods) / sizeof(defaultFoods[0]);
+  FoodCatalogWriter writer(foodFile);
+  uint8_t buffer[FOOD_RECORD_SIZE];
+  writer.begin();
+  FoodCatalog::encodeHeader(count, 0, buffer);
+  writer.write(buffer, FOOD_HEADER_SIZE);
+  for (uint8_t i = 0; i < count; i++){
+    FoodItem item;
+    memcpy_P(&item, &defaultFoods[i], sizeof(item));
+    FoodCatalog::encode(item, buffer);
+    writer.write(buffer, FOOD_RECORD_SIZE);
+  }
+  return writer.finish() && foods.open();
 }
 
-//Interrupts for the buttons
-//all interupts are using a timeout logic since last interupt to filter out switch bouncing
-void tareInterrupt(){
-  static unsigned long last_interrupt_time = 0;
-  unsigned long interrupt_time = millis();
+void selectFood(uint16_t id){                     //Method to move the selection to a food by id, after the catalog changed
+  labelFood.name[0] = 0;
+  foodPos = foods.find(id);
+  if (foodPos < 0){
+    foodPos = 0;
+  }
+  lastFoodPos = -1;
+}
 
-  if (interrupt_time - last_interrupt_time > 200){
-    Serial.println("Tare Button pressed!!!!!!");            //The tare method is really a bit to long for an ISR but hmmm it seems to work for the moment
-    scale.tare();
-    Serial.println("Tare finished");
+void indexCatalog(){                              //Method to start sorting the catalog ids into the index file, pollCatalogIndex() does the work
+  foodIndexing = foodIndexer.begin();
+  if (!foodIndexing){
+    Serial.println("Food index could not be started");
   }
-  last_interrupt_time = interrupt_time;
 }
 
-void sendInterrupt(){
-  static unsigned long last_interrupt_time = 0;
-  unsigned long interrupt_time = millis();
+void pollCatalogIndex(){                          //Method to sort a little more of the index, lookups by id use it once it is done
+  if (!foodIndexing || foodIndexer.poll()){
+    return;
+  }
+  foodIndexing = false;
+  //positions in the catalog stay the same, only find() starts working
+  if (!foodIndexer.finish() || !foods.open() || !foods.indexed()){
+    Serial.println("Food index could not be built");
+  }
+}
 
-  if (interrupt_time - last_interrupt_time > 200){
-    Serial.println("Send Button pressed!!!!!!");
-    //Set flag for sendJson method to be executed in main loop
-    sendJson = true;
+void pollCatalogUpdate(){                         //Method to move the catalog download along and swap the new catalog in when it is complete
+  if (!catalogUpdater.poll(millis())){
+    return;
   }
-  last_interrupt_time = interrupt_time;
+  if (catalogUpdater.updated() && LittleFS.rename("/foods.tmp", "/foods.bin")){
+    LittleFS.rename("/foods.idt", "/foods.idx");
+    if (foods.open() && !foods.indexed()){
+      indexCatalog();                             //the index didn't make it across, sort the ids again
+    }
+    selectFood(currentFood.id);
+    Serial.print("Food catalog updated, ");
+    Serial.print(foods.count());
+    Serial.println(" foods");
+  }
+  else if (catalogUpdater.status() != 304){
+    Serial.println("Food catalog download failed");
+  }
+  LittleFS.remove("/foods.tmp");
+  LittleFS.remove("/foods.idt");
 }
 
-void leftInterrupt(){                                          //change food possition with logic for end of list
-  static unsigned long last_interrupt_time = 0;
-  unsigned long interrupt_time = millis();
+void uploadResult(const Reading &reading, int httpCode){  //Called by the transport once the collector has answered, MQTT reports 200 on PUBACK
+  Serial.print("Weight ");
+  Serial.print(reading.weight);
+  Serial.print(" of ");
+  Serial.print(foodLabel(reading.food));
+  Serial.print(" posted, HTTP code ");
+  Serial.println(httpCode);                        //Print HTTP return code
+
+  //answers come back in journal order, so only an unbroken run of deliveries is acknowledged.
+  //a server error leaves the reading and everything after it unacknowledged, replayJournal() sends them again
+  //with their original seq so the collector can drop the ones it already has
+  if (replayFailed){
+    return;
+  }
+  if (httpCode <= 0 || httpCode >= 500){
+    replayFailed = true;
+    replayFailedAt = millis();
+    replayBackoffMs = replayBackoffMs == 0 ? replayRetryMs : replayBackoffMs * 2;
+    if (replayBackoffMs > replayRetryMaxMs){
+      replayBackoffMs = replayRetryMaxMs;
+    }
+    return;
+  }
+  replayBackoffMs = 0;
+  journal.ack(1);                                  //a 4xx won't get better by sending it again, it is dropped
+}
 
-  if (interrupt_time - last_interrupt_time > 200){
-    Serial.println("Left Button pressed!!!!!!");
-    foodPos -= 1;
-    if(foodPos < 0){
-      foodPos = 0;
+void replayJournal(){                              //Method to hand the next batch of journaled readings to the uploader
+  if (!wifi.connected() || transport.pending() > 0){
+    return;
+  }
+  if (replayFailed){
+    //the whole batch has been answered, hand out everything from the failed reading on again after the backoff
+    if (millis() - replayFailedAt < replayBackoffMs){
+      return;
     }
-    Serial.println("Left finished");
+    journal.rewind();
+    replayFailed = false;
   }
-  last_interrupt_time = interrupt_time;
+  if (journal.unsent() == 0){
+    return;
+  }
+  JournalRecord records[replayBatch];
+  uint8_t count = journal.peek(records, replayBatch);
+  for (uint8_t i = 0; i < count; i++){
+    Reading reading;
+    reading.seq = records[i].seq;
+    reading.time = records[i].timestamp;
+    reading.weight = records[i].weight;
+    reading.food = records[i].food;
+    reading.flags = records[i].flags;
+    transport.enqueue(reading);
+  }
+}
+
+//Local API handlers, called from api.poll() in the main loop
+int apiReading(const HttpRequestParser &/*request*/, Print &body){  //GET /reading, the weight on the screen right now
+  body.print("{\"weight\":");
+  jsonWriteSigned(body, weight);
+  body.print(",\"settled\":");
+  body.print(stability.settled() ? "true" : "false");
+  body.print(",\"confidence\":");
+  jsonWriteUnsigned(body, stability.confidence());
+  body.print(",\"foodid\":");
+  jsonWriteUnsigned(body, currentFood.id);
+  body.print(",\"food\":");
+  jsonWriteString(body, currentFood.name);
+  body.print(",\"uptime\":");
+  jsonWriteUnsigned(body, wallClock.uptime(millis()));
+  body.print("}");
+  return 200;
+}
+
+int apiTare(const HttpRequestParser &/*request*/, Print &body){     //POST /tare, same as pressing the tare button
+  tareRequested = true;
+  body.print("{\"tare\":\"started\"}");
+  return 202;
 }
 
-void rightInterrupt(){                                         //change food possition with logic for end of list
-  static unsigned long last_interrupt_time = 0;
-  unsigned long interrupt_time = millis();
+int apiFood(const HttpRequestParser &/*request*/, Print &body){     //GET /food, the selected food
+  FoodItem item;
+  if (!foods.get(foodPos, item)){
+    body.print("{}");
+    return 404;
+  }
+  body.print("{\"index\":");
+  jsonWriteUnsigned(body, foodPos);
+  body.print(",\"count\":");
+  jsonWriteUnsigned(body, foods.count());
+  body.print(",\"id\":");
+  jsonWriteUnsigned(body, item.id);
+  body.print(",\"name\":");
+  jsonWriteString(body, item.name);
+  body.print("}");
+  return 200;
+}
 
-  if (interrupt_time - last_interrupt_time > 200){
-    Serial.println("Right Button pressed!!!!!!");
-    foodPos += 1;
-    if(foodPos > (numberOfFoodItems - 1)){
-      foodPos = (numberOfFoodItems - 1);
+int apiSelectFood(const HttpRequestParser &request, Print &body){  //POST /food?id=3 or ?name=cof, selects by id or the first name starting with it
+  char value[FOOD_NAME_LENGTH];
+  long index = -1;
+  if (request.param("id", value, sizeof(value))){
+    index = foods.find((uint16_t)atol(value));
+  }
+  else if (request.param("name", value, sizeof(value)) && value[0]){
+    FoodItem item;
+    index = foods.jump(value);
+    if (!foods.get(index, item) || FoodCatalog::compare(item.name, value, strlen(value)) != 0){
+      index = -1;
     }
-    Serial.println("Right finished");
   }
-  last_interrupt_time = interrupt_time;
+  else {
+    body.print("{\"error\":\"id or name needed\"}");
+    return 400;
+  }
+  if (index < 0){
+    body.print("{\"error\":\"no such food\"}");
+    return 404;
+  }
+  foodPos = index;
+  return apiFood(request, body);
+}
+
+void streamSample(const ScaleSample &sample){      //Method to send one filtered sample to the API streams
+  char line[64];
+  BufferPrint out(line, sizeof(line));
+  out.print("{\"uptime\":");
+  jsonWriteUnsigned(out, wallClock.uptimeAt(sample.time, millis()));
+  out.print(",\"weight\":");
+  jsonWriteSigned(out, (int32_t)((filtered - tareOffset) / calibrationfactor));
+  out.print(",\"settled\":");
+  out.print(stability.settled() ? "true" : "false");
+  out.print("}");
+  api.broadcast(line);
+}
+
+//Buttons
+//all four pins are sampled together on a timer tick and debounced by integrating the samples,
+//the tick only queues the resulting gestures, the actual work happens in dispatchButton() in the main loop
+Ticker buttonTicker;
+ButtonDebounce buttons(BUTTON_INTEGRATE, BUTTON_LONG_PRESS_MS / BUTTON_TICK_MS, BUTTON_REPEAT_MS / BUTTON_TICK_MS);
+ButtonQueue buttonEvents;
+
+void sampleButtons(){
+  //buttons pull the pins low when pressed
+  uint8_t pressed = 0;
+  if(digitalRead(tarePin) == LOW) pressed |= 1 << BUTTON_TARE;
+  if(digitalRead(sendPin) == LOW) pressed |= 1 << BUTTON_SEND;
+  if(digitalRead(leftPin) == LOW) pressed |= 1 << BUTTON_LEFT;
+  if(digitalRead(rightPin) == LOW) pressed |= 1 << BUTTON_RIGHT;
+
+  ButtonGestureEvent gestures[BUTTON_DEBOUNCE_MAX];
+  uint8_t count = buttons.tick(pressed, gestures);
+  for(uint8_t i = 0; i < count; i++){
+    ButtonEvent event;
+    event.button = gestures[i].button;
+    event.gesture = gestures[i].gesture;
+    event.time = millis();
+    buttonEvents.push(event);                                  //a full queue drops the gesture, only if loop() stalls
+  }
+}
+
+void dispatchButton(const ButtonEvent &event){                 //Method to act on a debounced button gesture
+  //releases aren't used, holding left or right jumps a letter through the food list on the long press and every repeat
+  if(event.gesture == BUTTON_RELEASE){
+    return;
+  }
+  if(event.gesture != BUTTON_PRESS && event.button != BUTTON_LEFT && event.button != BUTTON_RIGHT){
+    return;
+  }
+  switch(event.button){
+    case BUTTON_TARE:
+      Serial.println("Tare Button pressed!!!!!!");
+      //the tare offset is averaged from the next readings
+      tareRequested = true;
+      break;
+    case BUTTON_SEND:
+      Serial.println("Send Button pressed!!!!!!");
+      //Set flag for the reading to be journaled further down the loop
+      sendJson = true;
+      break;
+    case BUTTON_LEFT:                                          //change food possition with logic for end of list
+      Serial.println("Left Button pressed!!!!!!");
+      if(event.gesture == BUTTON_PRESS){
+        foodPos -= 1;
+      }
+      else{
+        foodPos = foods.previousInitial(foodPos);
+      }
+      if(foodPos < 0){
+        foodPos = 0;
+      }
+      break;
+    case BUTTON_RIGHT:                                         //change food possition with logic for end of list
+      Serial.println("Right Button pressed!!!!!!");
+      if(event.gesture == BUTTON_PRESS){
+        foodPos += 1;
+      }
+      else{
+        foodPos = foods.nextInitial(foodPos);
+      }
+      if(foodPos > (foods.count() - 1)){
+        foodPos = (foods.count() - 1);
+      }
+      break;
+  }
 }
 
 void setup() {
@@ -162,16 +493,17 @@ void setup() {
   Serial.begin(9600);
   //setup comunication with the lcd
   Wire.begin(D2,D1);
-  // initialize LCD
+  // initialize LCD, in async mode nothing blocks and lcd.tick() sends the queued commands
+  lcd.setAsync(true);
   lcd.init();
   // turn on LCD backlight                      
   lcd.backlight();
+  // draw into the shadow frame, lcd.flush() only sends the characters that changed
+  lcd.setBuffered(true);
   Serial.println("LCD setup finished");
 
-  //scale setup
-  int calibrationfactor = 2067;           //this is slightly off but with my 3d printed case prob as accurate as i will get it untill 
-  scale.set_scale(calibrationfactor);     //i put more thought into its phyiscal construction
-  scale.tare();
+  //scale setup, the first readings are used for the tare
+  scale.begin();
 
   //setup buttons
   pinMode(tarePin, INPUT_PULLUP);
@@ -179,11 +511,17 @@ void setup() {
   pinMode(leftPin, INPUT_PULLUP);
   pinMode(rightPin, INPUT_PULLUP);
 
-  //attach interupts for buttons
-  attachInterrupt(digitalPinToInterrupt(tarePin), tareInterrupt, FALLING);
-  attachInterrupt(digitalPinToInterrupt(sendPin), sendInterrupt, FALLING);
-  attachInterrupt(digitalPinToInterrupt(leftPin), leftInterrupt, FALLING);
-  attachInterrupt(digitalPinToInterrupt(rightPin), rightInterrupt, FALLING);
+  //local API, listens on every interface so it works as soon as wifi is up
+  apiRouter.on("GET", "/reading", apiReading);
+  apiRouter.on("POST", "/tare", apiTare);
+  apiRouter.on("GET", "/food", apiFood);
+  apiRouter.on("POST", "/food", apiSelectFood);
+  apiRouter.onStream("/stream", REST_NDJSON);   //every filtered sample, ?every=N for every Nth
+  apiRouter.onStream("/events", REST_SSE);
+  api.begin();
+
+  //start sampling the buttons
+  buttonTicker.attach_ms(BUTTON_TICK_MS, sampleButtons);
 
   //Welcome Message
   lcd.clear();
@@ -191,57 +529,190 @@ void setup() {
   lcd.print("Wifi Scale");
   lcd.setCursor(0, 1);
   lcd.print("Connecting to Wifi now");
+  lcd.flush();
 
-  delay(2000);
+  //open the journal, anything left from before a reset or power loss is replayed
+  if (!LittleFS.begin() || !journal.open()){
+    Serial.println("Journal could not be opened");
+  }
+  Serial.print(journal.unacked());
+  Serial.println(" readings waiting in the journal");
+
+  //open the food catalog, a fresh or damaged one starts over with the built in foods
+  if (!foods.open() && !writeDefaultCatalog()){
+    Serial.println("Food catalog could not be opened");
+  }
+  else if (!foods.indexed()){
+    indexCatalog();
+  }
+  Serial.print(foods.count());
+  Serial.println(" foods in the catalog");
+
+  //readings are queued and sent from the main loop
+  uploader.setBatching(uploadBatch, uploadBatchWaitMs);
+  snprintf(deviceId, sizeof(deviceId), "scale-%06x", ESP.getChipId());
+  mqtt.setClientId(deviceId);
+  mqtt.setQos(mqttQos);
+  transport.setEncoder(uploadEncoder);
+  transport.onResult(uploadResult);
+
+  //start connecting, from here on wifi.poll() in the main loop looks after the connection
+  wifi.begin(millis());
+  reportWifi();
+
+  //show the welcome message for 2 seconds, the lcd has to be ticked for it to appear
+  unsigned long welcomeStart = millis();
+  while(millis() - welcomeStart < 2000){
+    lcd.tick();
+    yield();
+  }
 }
 
 
 
 void loop() {
+  //act on any button gestures the sampling tick has queued
+  ButtonEvent event;
+  while (buttonEvents.pop(event)){
+    dispatchButton(event);
+  }
+
   //only update food type message if different from last reading
-  if(foodPos != lastFoodPos){
+  if(foodPos != lastFoodPos && foods.get(foodPos, currentFood)){
     // set cursor to first column, first row
     lcd.setCursor(0, 0);
-    lcd.print("                ");        //clear this row before writing to it   
+    lcd.print("                ");        //clear this row before writing to it (only in the shadow frame)
     lcd.setCursor(0, 0);                  //set cursor back to RHS
-    // print food type message
-    String food = foodName[foodPos];
-    currentFood = food;
     //for debug
     Serial.print("Food = ");
-    Serial.println(food);
+    Serial.println(currentFood.name);
     //Print out message
     lcd.print("Food = ");
-    lcd.print(food);
+    lcd.print(currentFood.name);
+    if (fillBarGrams > 0){
+      lastWeight = weight + 1;            //the bar goes by the new food's container tare, redraw it
+    }
+    shownIcons = 0xff;                    //the row was cleared under the icons, long names are cut short by them
   }
   lastFoodPos = foodPos;
-  // update weight
-  weight = scale.get_units(5);
-  
+  // update weight from whatever readings arrived since the last pass, never waits for the scale
+  ScaleSample sample;
+  bool newReading = false;
+  bool settledNow = false;
+  while (scale.read(sample)){
+    if (tareRequested){
+      if (tareCount == 0){
+        tareSum = 0;
+      }
+      tareSum += sample.value;
+      if (++tareCount == tareSamples){
+        tareOffset = tareSum / tareSamples;
+        tareCount = 0;
+        tareRequested = false;
+        stability.reset();
+        Serial.println("Tare finished");
+      }
+      continue;
+    }
+    filtered = weightFilter.update(sample.value);
+    newReading = true;
+    if (stability.update(filtered)){
+      settledNow = true;
+    }
+    //live weight for anyone following /stream or /events, streams that can't keep up are dropped by the server
+    if (api.streams() > 0){
+      streamSample(sample);
+    }
+  }
+  if (newReading){
+    weight = (filtered - tareOffset) / calibrationfactor;
+    weightTime = sample.time;
+  }
+  if (settledNow){
+    weight = (stability.settledValue() - tareOffset) / calibrationfactor;
+    Serial.print("Settled, confidence ");
+    Serial.println(stability.confidence());
+    if (autoPostOnSettle && stability.loadChanged() && weight != 0){
+      sendJson = true;
+    }
+  }
 
-  //only update LCD if weight has changed from last reading
-  if (weight != lastWeight){ 
+  //only update LCD if weight has changed from last reading, and at a reduced rate while it is still moving
+  bool redrawDue = stability.settled() || (millis() - lastRedraw >= unsettledRedrawMs);
+  if (weight != lastWeight && redrawDue){ 
     lcd.setCursor(0,1);
-    lcd.print("                ");         //clear this row before writing to it
+    lcd.print("                ");         //clear this row before writing to it (only in the shadow frame)
     lcd.setCursor(0,1);                    //set cursor back to RHS
-    lcd.print("Weight = ");
-    lcd.print(weight, 10);
-    lcd.print("g");
+    if (fillBarGrams > 0){
+      lcd.print(weight, 10);
+      lcd.print("g");
+      //only the cells whose step changed go out on the next flush, the bar glyphs are uploaded once
+      uint8_t barColumns = lcd.cols() - fillBarColumn;
+      long capacity = fillBarGrams;
+      long food = weight - currentFood.tare;
+      if (food < 0){
+        food = 0;
+      } else if (food > capacity){
+        food = capacity;
+      }
+      lcd.draw_horizontal_graph(1, fillBarColumn, barColumns, food * barColumns * 5 / capacity);
+    } else {
+      lcd.print("Weight = ");
+      lcd.print(weight, 10);
+      lcd.print("g");
+    }
     Serial.println("updated weight");
+    lastRedraw = millis();
+    lastWeight = weight;
+  }
+
+  if (statusIcons){
+    drawIcons();
   }
-  
-  lastWeight = weight;
 
-  //check if need to send json
+  //queue only the characters that changed since the last flush and send a slice of them
+  lcd.flush();
+  lcd.tick();
+
+  //keep the wifi connection alive, never blocks
+  wifi.poll(millis());
+  if (wifi.changed()){
+    reportWifi();
+  }
+  //answer local API requests, only reads what has arrived
+  api.poll(millis());
+  //sort the food ids a bit at a time after a catalog was written
+  pollCatalogIndex();
+  //look for a newer food catalog the first time we are online, the index scratch file is shared so not while indexing
+  if (wifi.connected() && !catalogChecked && !foodIndexing){
+    catalogChecked = true;
+    catalogUpdater.start(foods.revision(), millis());
+  }
+  pollCatalogUpdate();
+  //sync the wall clock once we are online, also keeps the 64 bit uptime going
+  wallClock.poll(millis(), wifi.connected());
+
+  //check if need to send json, a press while offline is sent once the connection is back
   if (sendJson == true){
-    //code to connect to Wifi
-    connectToWifi();
-    //code to send jSon request
-    char strWeight[20] = {};
-    itoa(weight, strWeight, 10);
-    jsonPOST(strWeight, currentFood);
+    //stamp the reading with when it was sampled, not when it goes out
+    uint64_t sampledAt = wallClock.uptimeAt(weightTime, millis());
+    JournalRecord record;
+    record.timestamp = wallClock.synced() ? wallClock.epochMs(sampledAt) : sampledAt;
+    record.weight = weight;
+    record.food = currentFood.id;
+    record.flags = wallClock.synced() ? READING_EPOCH : 0;
+    Serial.print("Weight is ");
+    Serial.println(weight);
+    Serial.print("Food type is ");
+    Serial.println(currentFood.name);
+    if (!journal.append(record)){
+      Serial.println("Journal full, reading dropped");
+    }
     sendJson = false;
   }
+  replayJournal();
+  //write queued readings and collect the collector's answers, never waits for the server
+  transport.poll(millis(), wifi.connected());
 }
 
 
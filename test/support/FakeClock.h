@@ -0,0 +1,16 @@
+#ifndef FakeClock_h
+#define FakeClock_h
+
+#include <Hal.h>
+
+// host time that only moves when the test, a delay or a yield() moves it
+class FakeClock : public HalClock {
+public:
+  uint64_t now = 0;
+  uint64_t slept = 0;           // time spent in delay() and delayMicroseconds()
+  uint64_t micros() { return now; }
+  void sleep(uint32_t us) { now += us; slept += us; }
+  void idle() { now += 10; }
+};
+
+#endif
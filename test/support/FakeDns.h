@@ -0,0 +1,25 @@
+#ifndef FakeDns_h
+#define FakeDns_h
+
+#include <Hal.h>
+#include <IPAddress.h>
+#include <map>
+#include <string>
+
+// names for WiFi.hostByName(), nothing else on the network is used
+class FakeDns : public HalNetwork {
+public:
+  std::map<std::string, uint32_t> hosts;
+  int lookups = 0;
+  uint32_t resolve(const char *host) {
+    lookups++;
+    return hosts.count(host) ? hosts[host] : 0;
+  }
+  bool linkUp() { return true; }
+  HalSocketPtr connect(const char *, uint16_t) { return HalSocketPtr(); }
+  HalSocketPtr accept(uint16_t) { return HalSocketPtr(); }
+  bool sendDatagram(uint16_t, const char *, uint16_t, const uint8_t *, size_t) { return false; }
+  int receiveDatagram(uint16_t, uint8_t *, size_t) { return -1; }
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef FakeNetwork_h
+#define FakeNetwork_h
+
+#include <Hal.h>
+#include <string.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// the client end of a TCP connection, played by the test
+class FakeSocket : public HalSocket {
+public:
+  std::string in;               // what the client sent and the server hasn't read
+  std::string out;              // what the server wrote
+  bool open = true;
+  int room = 1 << 20;           // free space in the TCP send buffer, writes use it up
+  int available() { return (int)in.size(); }
+  int read(uint8_t *buffer, size_t size) {
+    size_t n = size < in.size() ? size : in.size();
+    memcpy(buffer, in.data(), n);
+    in.erase(0, n);
+    return (int)n;
+  }
+  int peek() { return in.empty() ? -1 : (uint8_t)in[0]; }
+  size_t write(const uint8_t *data, size_t length) {
+    if (!open) {
+      return 0;
+    }
+    size_t n = length < (size_t)room ? length : (size_t)room;
+    out.append((const char *)data, n);
+    room -= (int)n;
+    return n;
+  }
+  int writable() { return open ? room : 0; }
+  bool connected() { return open; }
+  void close() { open = false; }
+};
+
+// a link that is always up, with clients queued by dial() for the listening port
+class FakeNetwork : public HalNetwork {
+public:
+  std::vector<std::shared_ptr<FakeSocket> > waiting;
+  uint16_t listening = 0;
+  bool linkUp() { return true; }
+  HalSocketPtr connect(const char *, uint16_t) { return HalSocketPtr(); }
+  bool listen(uint16_t port) { listening = port; return true; }
+  HalSocketPtr accept(uint16_t port) {
+    if (port != listening || waiting.empty()) {
+      return HalSocketPtr();
+    }
+    HalSocketPtr socket = waiting.front();
+    waiting.erase(waiting.begin());
+    return socket;
+  }
+  bool sendDatagram(uint16_t, const char *, uint16_t, const uint8_t *, size_t) { return false; }
+  int receiveDatagram(uint16_t, uint8_t *, size_t) { return -1; }
+
+  std::shared_ptr<FakeSocket> dial(const std::string &request = "") {
+    std::shared_ptr<FakeSocket> socket(new FakeSocket());
+    socket->in = request;
+    waiting.push_back(socket);
+    return socket;
+  }
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef LcdModel_h
+#define LcdModel_h
+
+#include <Hal.h>
+#include <LiquidCrystal_I2C.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "RecordingI2c.h"
+
+struct LcdByte {
+  bool rs;
+  uint8_t value;
+};
+
+// The HD44780 behind the PCF8574 in 4 bit mode: a nibble latches on every falling
+// edge of En, two to a byte. DDRAM, CGRAM and the address counter follow, entry mode
+// left to right. Feed it only what came after init() so the nibbles pair up.
+class Hd44780 {
+public:
+  uint8_t ddram[0x80];
+  uint8_t cgram[64];
+  std::vector<LcdByte> latched; // every byte in the order it latched
+  int cgramBytes;               // data bytes that went into CGRAM
+  int uploads;                  // LCD_SETCGRAMADDR commands
+  int addressSets;              // LCD_SETDDRAMADDR commands
+  Hd44780() { reset(); }
+  void reset() {
+    memset(ddram, ' ', sizeof(ddram));
+    memset(cgram, 0, sizeof(cgram));
+    latched.clear();
+    cgramBytes = 0;
+    uploads = 0;
+    addressSets = 0;
+    _address = 0;
+    _inCgram = false;
+    _previous = 0;
+    _half = -1;
+  }
+  void feed(uint8_t b) {
+    if ((_previous & En) && !(b & En)) {
+      if (_half < 0) {
+        _half = _previous & 0xf0;
+      } else {
+        latch((_previous & Rs) != 0, (uint8_t)(_half | (_previous >> 4)));
+        _half = -1;
+      }
+    }
+    _previous = b;
+  }
+  void run(const std::vector<Transaction> &log) {
+    for (size_t t = 0; t < log.size(); t++) {
+      for (size_t i = 0; i < log[t].bytes.size(); i++) {
+        feed(log[t].bytes[i]);
+      }
+    }
+  }
+  // a visible row, the way the controller scans DDRAM for this geometry
+  std::string row(uint8_t cols, uint8_t row) const {
+    uint8_t offset = (row & 1 ? 0x40 : 0) + (row & 2 ? cols : 0);
+    return std::string((const char *)ddram + offset, cols);
+  }
+  // the bitmap a visible cell shows, 0 for characters from the ROM
+  const uint8_t *bitmapAt(uint8_t address) const {
+    return ddram[address] < 16 ? &cgram[(ddram[address] & 7) * 8] : 0;
+  }
+
+private:
+  void latch(bool rs, uint8_t value) {
+    LcdByte b = { rs, value };
+    latched.push_back(b);
+    if (rs) {
+      if (_inCgram) {
+        cgram[_address & 0x3f] = value;
+        cgramBytes++;
+      } else {
+        ddram[_address & 0x7f] = value;
+      }
+      _address++;
+    } else if (value & LCD_SETDDRAMADDR) {
+      _address = value & 0x7f;
+      _inCgram = false;
+      addressSets++;
+    } else if (value & LCD_SETCGRAMADDR) {
+      _address = value & 0x3f;
+      _inCgram = true;
+      uploads++;
+    } else if (value == LCD_CLEARDISPLAY) {
+      memset(ddram, ' ', sizeof(ddram));
+      _address = 0;
+      _inCgram = false;
+    }
+  }
+  uint8_t _address;
+  bool _inCgram;
+  uint8_t _previous;
+  int _half;
+};
+
+// a bus that feeds every byte straight into a controller model
+class ModelI2c : public HalI2c {
+public:
+  Hd44780 *model = 0;
+  uint8_t transmit(uint8_t, const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length && model; i++) {
+      model->feed(data[i]);
+    }
+    return 0;
+  }
+};
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef MemoryFile_h
+#define MemoryFile_h
+
+#include <FlashFile.h>
+#include <string.h>
+#include <vector>
+
+// a FlashFile held in a vector, counting the reads that reach it. Files sharing
+// a writesLeft budget lose power together: once it runs out every append and
+// truncate fails without touching the data
+class MemoryFile : public FlashFile {
+public:
+  std::vector<uint8_t> data;
+  long reads = 0;
+  long *writesLeft = 0;
+  long size() { return (long)data.size(); }
+  bool read(long offset, uint8_t *buffer, size_t length) {
+    reads++;
+    if (offset < 0 || offset + (long)length > (long)data.size()) {
+      return false;
+    }
+    memcpy(buffer, data.data() + offset, length);
+    return true;
+  }
+  bool append(const uint8_t *buffer, size_t length) {
+    if (!write()) {
+      return false;
+    }
+    data.insert(data.end(), buffer, buffer + length);
+    return true;
+  }
+  bool truncate(long size) {
+    if (!write()) {
+      return false;
+    }
+    data.resize(size);
+    return true;
+  }
+
+private:
+  bool write() {
+    if (!writesLeft) {
+      return true;
+    }
+    if (*writesLeft == 0) {
+      return false;
+    }
+    (*writesLeft)--;
+    return true;
+  }
+};
+
+#endif
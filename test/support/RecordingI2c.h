@@ -0,0 +1,43 @@
+#ifndef RecordingI2c_h
+#define RecordingI2c_h
+
+#include <Hal.h>
+#include <vector>
+#include "FakeClock.h"
+
+struct Transaction {
+  uint8_t address;
+  uint64_t at;                  // when the last byte left, 0 without a clock
+  std::vector<uint8_t> bytes;
+};
+
+// every I2C transaction, taking its bus time off the clock when one is attached
+class RecordingI2c : public HalI2c {
+public:
+  FakeClock *clock = 0;
+  uint32_t byteUs = 90;         // nine clocks per byte at 100kHz
+  bool record = true;
+  std::vector<Transaction> log;
+  uint8_t transmit(uint8_t address, const uint8_t *data, size_t length) {
+    if (clock) {
+      clock->now += length * byteUs;
+    }
+    if (record) {
+      Transaction t;
+      t.address = address;
+      t.at = clock ? clock->now : 0;
+      t.bytes.assign(data, data + length);
+      log.push_back(t);
+    }
+    return 0;
+  }
+  size_t bytes() const {
+    size_t n = 0;
+    for (size_t i = 0; i < log.size(); i++) {
+      n += log[i].bytes.size();
+    }
+    return n;
+  }
+};
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef StringPrint_h
+#define StringPrint_h
+
+#include <Print.h>
+#include <string>
+
+// a Print that keeps everything written to it
+class StringPrint : public Print {
+public:
+  std::string text;
+  size_t write(uint8_t c) { text += (char)c; return 1; }
+  size_t write(const uint8_t *data, size_t size) { text.append((const char *)data, size); return size; }
+};
+
+#endif
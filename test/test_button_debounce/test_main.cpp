@@ -0,0 +1,156 @@
+// ButtonDebounce fed recorded traces, one character per 5ms tick as the
+// firmware samples the pins: bounces and glitches, long press and repeat.
+#include "ButtonDebounce.h"
+#include "ButtonEvents.h"
+#include <unity.h>
+#include <string>
+#include <vector>
+
+struct Seen {
+  int tick;
+  uint8_t button;
+  uint8_t gesture;
+};
+
+// the firmware's timing in ticks
+#define LONG_TICKS (BUTTON_LONG_PRESS_MS / BUTTON_TICK_MS)
+#define REPEAT_TICKS (BUTTON_REPEAT_MS / BUTTON_TICK_MS)
+
+// '1' pressed and '0' released for one button, anything else is skipped
+static std::vector<Seen> replay(ButtonDebounce &debounce, const char *trace, uint8_t button = BUTTON_TARE) {
+  std::vector<Seen> seen;
+  ButtonGestureEvent events[BUTTON_DEBOUNCE_MAX];
+  int tick = 0;
+  for (const char *c = trace; *c; c++) {
+    if (*c != '0' && *c != '1') {
+      continue;
+    }
+    uint8_t n = debounce.tick(*c == '1' ? (uint8_t)(1 << button) : 0, events);
+    for (uint8_t i = 0; i < n; i++) {
+      Seen s = { tick, events[i].button, events[i].gesture };
+      seen.push_back(s);
+    }
+    tick++;
+  }
+  return seen;
+}
+
+static std::vector<Seen> hold(ButtonDebounce &debounce, int ticks) {
+  std::string trace(ticks, '1');
+  trace += "0000";
+  return replay(debounce, trace.c_str());
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_clean_press_and_release() {
+  ButtonDebounce debounce(BUTTON_INTEGRATE, LONG_TICKS, REPEAT_TICKS);
+  std::vector<Seen> seen = replay(debounce, "0000 11111111 0000000");
+  TEST_ASSERT_EQUAL(2, seen.size());
+  TEST_ASSERT_EQUAL(BUTTON_PRESS, seen[0].gesture);
+  TEST_ASSERT_EQUAL(4 + BUTTON_INTEGRATE - 1, seen[0].tick);
+  TEST_ASSERT_EQUAL(BUTTON_RELEASE, seen[1].gesture);
+  TEST_ASSERT_EQUAL(12 + BUTTON_INTEGRATE - 1, seen[1].tick);
+  TEST_ASSERT_EQUAL(0, debounce.state());
+}
+
+// a tact switch closing and opening, chatter lasting a few samples on each edge
+void test_bouncing_contacts_give_one_press() {
+  const char *traces[] = {
+    "0000 1010110111111111111111111111 0101001000000000",
+    "0000 1100110101111111111111111111 0010110100000000",
+    "0000 1000111011111111111111111111 0111010000000000",
+  };
+  for (size_t t = 0; t < sizeof(traces) / sizeof(traces[0]); t++) {
+    ButtonDebounce debounce(BUTTON_INTEGRATE, LONG_TICKS, REPEAT_TICKS);
+    std::vector<Seen> seen = replay(debounce, traces[t]);
+    TEST_ASSERT_EQUAL(2, seen.size());
+    TEST_ASSERT_EQUAL(BUTTON_PRESS, seen[0].gesture);
+    TEST_ASSERT_EQUAL(BUTTON_RELEASE, seen[1].gesture);
+    // the chatter is over within 50ms, the press comes at most one integrate time later
+    TEST_ASSERT_LESS_OR_EQUAL(4 + 10 + BUTTON_INTEGRATE - 1, seen[0].tick);
+  }
+}
+
+// single sample spikes from EMI don't make a press, and a dropout while held isn't a release
+void test_glitches_are_ignored() {
+  ButtonDebounce debounce(BUTTON_INTEGRATE, 0, 0);
+  TEST_ASSERT_EQUAL(0, replay(debounce, "0001000100010000100000010000").size());
+  std::vector<Seen> seen = replay(debounce, "11111111 0111110111101111 1111 0000");
+  TEST_ASSERT_EQUAL(2, seen.size());
+  TEST_ASSERT_EQUAL(BUTTON_PRESS, seen[0].gesture);
+  TEST_ASSERT_EQUAL(BUTTON_RELEASE, seen[1].gesture);
+  TEST_ASSERT_EQUAL(31, seen[1].tick);
+}
+
+void test_long_press_then_repeats() {
+  ButtonDebounce debounce(BUTTON_INTEGRATE, LONG_TICKS, REPEAT_TICKS);
+  // held a second from the debounced press
+  std::vector<Seen> seen = hold(debounce, BUTTON_INTEGRATE + 1000 / BUTTON_TICK_MS);
+  int press = seen[0].tick;
+  TEST_ASSERT_EQUAL(BUTTON_LONG_PRESS, seen[1].gesture);
+  TEST_ASSERT_EQUAL(press + LONG_TICKS, seen[1].tick);
+  int repeats = 0;
+  for (size_t i = 2; i + 1 < seen.size(); i++) {
+    TEST_ASSERT_EQUAL(BUTTON_REPEAT, seen[i].gesture);
+    TEST_ASSERT_EQUAL(press + LONG_TICKS + (int)(i - 1) * REPEAT_TICKS, seen[i].tick);
+    repeats++;
+  }
+  TEST_ASSERT_EQUAL((1000 - BUTTON_LONG_PRESS_MS) / BUTTON_REPEAT_MS, repeats);
+  TEST_ASSERT_EQUAL(BUTTON_RELEASE, seen.back().gesture);
+}
+
+void test_long_press_without_repeat() {
+  ButtonDebounce debounce(BUTTON_INTEGRATE, LONG_TICKS, 0);
+  std::vector<Seen> seen = hold(debounce, 60000 / BUTTON_TICK_MS);
+  TEST_ASSERT_EQUAL(3, seen.size());
+  TEST_ASSERT_EQUAL(BUTTON_LONG_PRESS, seen[1].gesture);
+  TEST_ASSERT_EQUAL(BUTTON_RELEASE, seen[2].gesture);
+}
+
+// the release is debounced as well, so the press lasts as long as the raw samples do
+void test_long_press_threshold() {
+  ButtonDebounce debounce(BUTTON_INTEGRATE, LONG_TICKS, REPEAT_TICKS);
+  TEST_ASSERT_EQUAL(2, hold(debounce, LONG_TICKS).size());
+  std::vector<Seen> seen = hold(debounce, LONG_TICKS + 1);
+  TEST_ASSERT_EQUAL(3, seen.size());
+  TEST_ASSERT_EQUAL(BUTTON_LONG_PRESS, seen[1].gesture);
+}
+
+// each bit has its own integrator, at most one event per button per tick
+void test_buttons_are_independent() {
+  ButtonDebounce debounce(BUTTON_INTEGRATE, 0, 0);
+  ButtonGestureEvent events[BUTTON_DEBOUNCE_MAX];
+  const uint8_t both = (1 << BUTTON_LEFT) | (1 << BUTTON_RIGHT);
+  for (int i = 0; i < BUTTON_INTEGRATE - 1; i++) {
+    TEST_ASSERT_EQUAL(0, debounce.tick(both | (i & 1 ? 1 << BUTTON_SEND : 0), events));
+  }
+  TEST_ASSERT_EQUAL(2, debounce.tick(both, events));
+  TEST_ASSERT_EQUAL(BUTTON_LEFT, events[0].button);
+  TEST_ASSERT_EQUAL(BUTTON_RIGHT, events[1].button);
+  TEST_ASSERT_EQUAL_HEX8(both, debounce.state());
+  TEST_ASSERT_EQUAL(0, debounce.tick(0xFF, events));
+  TEST_ASSERT_EQUAL(0, debounce.tick(0xFF, events));
+  TEST_ASSERT_EQUAL(0, debounce.tick(0xFF, events));
+  TEST_ASSERT_EQUAL(BUTTON_DEBOUNCE_MAX - 2, debounce.tick(0xFF, events));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, debounce.state());
+  debounce.reset();
+  TEST_ASSERT_EQUAL(0, debounce.state());
+  TEST_ASSERT_EQUAL(0, debounce.tick(0, events));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_clean_press_and_release);
+  RUN_TEST(test_bouncing_contacts_give_one_press);
+  RUN_TEST(test_glitches_are_ignored);
+  RUN_TEST(test_long_press_then_repeats);
+  RUN_TEST(test_long_press_without_repeat);
+  RUN_TEST(test_long_press_threshold);
+  RUN_TEST(test_buttons_are_independent);
+  return UNITY_END();
+}
@@ -0,0 +1,154 @@
+// The ButtonQueue between the sampling tick and loop(): gestures come out in
+// the order the tick queued them, across index wrap and interleaved with
+// draining, and a stalled loop() drops the newest ones and counts them.
+#include "ButtonDebounce.h"
+#include "ButtonEvents.h"
+#include <unity.h>
+#include <vector>
+
+static ButtonEvent event(uint8_t button, uint8_t gesture, unsigned long time) {
+  ButtonEvent e = { button, gesture, time };
+  return e;
+}
+
+// what sampleButtons() does on every tick, with the tick's time standing in for millis()
+static void sample(ButtonDebounce &debounce, ButtonQueue &queue, uint8_t pressed, unsigned long now) {
+  ButtonGestureEvent gestures[BUTTON_DEBOUNCE_MAX];
+  uint8_t count = debounce.tick(pressed, gestures);
+  for (uint8_t i = 0; i < count; i++) {
+    queue.push(event(gestures[i].button, gestures[i].gesture, now));
+  }
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// bursts of up to BUTTON_QUEUE_SIZE pushes drained in between, long enough for the 8 bit indices to wrap
+void test_order_kept_across_wrap() {
+  ButtonQueue queue;
+  unsigned long pushed = 0;
+  unsigned long popped = 0;
+  for (int burst = 0; burst < 200; burst++) {
+    int room = BUTTON_QUEUE_SIZE - queue.size();
+    for (int i = 0; i <= burst % BUTTON_QUEUE_SIZE && i < room; i++) {
+      TEST_ASSERT_TRUE(queue.push(event(BUTTON_TARE, BUTTON_PRESS, pushed++)));
+    }
+    // drain only part of it sometimes, what is left goes out first next time
+    int drain = burst % 3 ? BUTTON_QUEUE_SIZE : 1;
+    ButtonEvent e = event(0, 0, 0);
+    while (drain-- > 0 && queue.pop(e)) {
+      TEST_ASSERT_EQUAL(popped++, e.time);
+    }
+    while (queue.size() > BUTTON_QUEUE_SIZE / 2 && queue.pop(e)) {
+      TEST_ASSERT_EQUAL(popped++, e.time);
+    }
+  }
+  ButtonEvent e = event(0, 0, 0);
+  while (queue.pop(e)) {
+    TEST_ASSERT_EQUAL(popped++, e.time);
+  }
+  TEST_ASSERT_GREATER_THAN(256, pushed);
+  TEST_ASSERT_EQUAL(pushed, popped);
+  TEST_ASSERT_EQUAL(0, queue.overflows());
+}
+
+// a full queue turns the newest gesture away and counts it, the ones already queued are kept
+void test_overflow_drops_newest() {
+  ButtonQueue queue;
+  for (unsigned long i = 0; i < BUTTON_QUEUE_SIZE; i++) {
+    TEST_ASSERT_TRUE(queue.push(event(BUTTON_SEND, BUTTON_PRESS, i)));
+  }
+  TEST_ASSERT_FALSE(queue.push(event(BUTTON_SEND, BUTTON_RELEASE, 99)));
+  TEST_ASSERT_FALSE(queue.push(event(BUTTON_SEND, BUTTON_RELEASE, 100)));
+  TEST_ASSERT_EQUAL(2, queue.overflows());
+  TEST_ASSERT_EQUAL(BUTTON_QUEUE_SIZE, queue.size());
+  ButtonEvent e = event(0, 0, 0);
+  TEST_ASSERT_TRUE(queue.pop(e));
+  TEST_ASSERT_EQUAL(0, e.time);
+  TEST_ASSERT_TRUE(queue.push(event(BUTTON_SEND, BUTTON_RELEASE, 101)));
+  for (unsigned long i = 1; i < BUTTON_QUEUE_SIZE; i++) {
+    TEST_ASSERT_TRUE(queue.pop(e));
+    TEST_ASSERT_EQUAL(i, e.time);
+  }
+  TEST_ASSERT_TRUE(queue.pop(e));
+  TEST_ASSERT_EQUAL(101, e.time);
+  TEST_ASSERT_EQUAL(BUTTON_RELEASE, e.gesture);
+  TEST_ASSERT_TRUE(queue.empty());
+  TEST_ASSERT_EQUAL(2, queue.overflows());
+}
+
+// the tick keeps sampling while loop() is busy: a long press with its repeats and the
+// release fit in the queue through a one second stall
+void test_stalled_loop_keeps_a_held_button() {
+  ButtonDebounce debounce(BUTTON_INTEGRATE, BUTTON_LONG_PRESS_MS / BUTTON_TICK_MS, BUTTON_REPEAT_MS / BUTTON_TICK_MS);
+  ButtonQueue queue;
+  unsigned long now = 0;
+  for (; now < 1000; now += BUTTON_TICK_MS) {
+    sample(debounce, queue, 1 << BUTTON_LEFT, now);
+  }
+  for (; now < 1100; now += BUTTON_TICK_MS) {
+    sample(debounce, queue, 0, now);
+  }
+  TEST_ASSERT_EQUAL(0, queue.overflows());
+  std::vector<ButtonEvent> seen;
+  ButtonEvent e = event(0, 0, 0);
+  while (queue.pop(e)) {
+    seen.push_back(e);
+  }
+  // press, long press, a repeat every BUTTON_REPEAT_MS for the rest of the second, release
+  const size_t repeats = (1000 - BUTTON_INTEGRATE * BUTTON_TICK_MS - BUTTON_LONG_PRESS_MS) / BUTTON_REPEAT_MS;
+  TEST_ASSERT_EQUAL(3 + repeats, seen.size());
+  TEST_ASSERT_EQUAL(BUTTON_PRESS, seen.front().gesture);
+  TEST_ASSERT_EQUAL(BUTTON_LONG_PRESS, seen[1].gesture);
+  TEST_ASSERT_EQUAL(BUTTON_RELEASE, seen.back().gesture);
+  for (size_t i = 0; i < seen.size(); i++) {
+    TEST_ASSERT_EQUAL(BUTTON_LEFT, seen[i].button);
+    if (i > 0) {
+      TEST_ASSERT_LESS_THAN(seen[i].time, seen[i - 1].time);
+    }
+  }
+}
+
+// held through a stall long enough to fill the queue, the overflow is counted and the
+// release that comes after it is lost, the gestures loop() does get are still in order
+void test_stall_past_the_queue_overflows() {
+  ButtonDebounce debounce(BUTTON_INTEGRATE, BUTTON_LONG_PRESS_MS / BUTTON_TICK_MS, BUTTON_REPEAT_MS / BUTTON_TICK_MS);
+  ButtonQueue queue;
+  unsigned long now = 0;
+  for (; now < 3000; now += BUTTON_TICK_MS) {
+    sample(debounce, queue, 1 << BUTTON_RIGHT, now);
+  }
+  for (; now < 3100; now += BUTTON_TICK_MS) {
+    sample(debounce, queue, 0, now);
+  }
+  TEST_ASSERT_GREATER_THAN(0, queue.overflows());
+  TEST_ASSERT_EQUAL(BUTTON_QUEUE_SIZE, queue.size());
+  ButtonEvent e = event(0, 0, 0);
+  unsigned long last = 0;
+  uint8_t gesture = BUTTON_RELEASE;
+  while (queue.pop(e)) {
+    TEST_ASSERT_TRUE(e.time >= last);
+    last = e.time;
+    gesture = e.gesture;
+  }
+  TEST_ASSERT_EQUAL(BUTTON_REPEAT, gesture);
+  // once loop() drains it again new gestures get through
+  sample(debounce, queue, 1 << BUTTON_RIGHT, now);
+  for (int i = 0; i < BUTTON_INTEGRATE && queue.empty(); i++) {
+    sample(debounce, queue, 1 << BUTTON_RIGHT, now += BUTTON_TICK_MS);
+  }
+  TEST_ASSERT_TRUE(queue.pop(e));
+  TEST_ASSERT_EQUAL(BUTTON_PRESS, e.gesture);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_order_kept_across_wrap);
+  RUN_TEST(test_overflow_drops_newest);
+  RUN_TEST(test_stalled_loop_keeps_a_held_button);
+  RUN_TEST(test_stall_past_the_queue_overflows);
+  return UNITY_END();
+}
@@ -0,0 +1,399 @@
+// The food catalog on files held in memory: the writer's checks, paging and
+// prefix search, the id index and how many reads a lookup costs as the
+// catalog grows, and CatalogUpdater downloading from a scripted collector.
+#include <Arduino.h>
+#include <Client.h>
+#include <FoodCatalog.h>
+#include "CatalogUpdater.h"
+#include "../support/MemoryFile.h"
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+// the collector's end of a download, the test decides how much of the response has arrived
+class FakeServer : public Client {
+public:
+  std::string request;
+  std::string response;
+  size_t at = 0;
+  size_t arrived = 0;
+  bool open = false;
+  bool closeAtEnd = true;
+  int connect(IPAddress, uint16_t) { return 0; }
+  int connect(const char *, uint16_t) { open = true; return 1; }
+  size_t write(uint8_t c) { request += (char)c; return 1; }
+  size_t write(const uint8_t *buffer, size_t size) { request.append((const char *)buffer, size); return size; }
+  int available() { return (int)(arrived - at); }
+  int read() { return available() > 0 ? (uint8_t)response[at++] : -1; }
+  int read(uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (n < size && available() > 0) {
+      buffer[n++] = (uint8_t)response[at++];
+    }
+    return (int)n;
+  }
+  int peek() { return available() > 0 ? (uint8_t)response[at] : -1; }
+  void flush() {}
+  void stop() { open = false; }
+  uint8_t connected() { return open && !(closeAtEnd && at == response.size()); }
+  operator bool() { return open; }
+  void arrive(size_t bytes) { arrived = (arrived + bytes < response.size()) ? arrived + bytes : response.size(); }
+};
+
+static const char *names[] = { "Apple", "apricot", "Banana", "Basmati rice", "Carrot", "cashew",
+                               "Dates", "Oat milk", "Oats", "Zucchini" };
+
+// a catalog file as the collector serves it, names in order and ids scattered
+static std::string catalogBytes(long count, uint32_t revision, bool useNames = false) {
+  MemoryFile file;
+  uint8_t buffer[FOOD_RECORD_SIZE];
+  FoodCatalog::encodeHeader((uint16_t)count, revision, buffer);
+  file.append(buffer, FOOD_HEADER_SIZE);
+  for (long i = 0; i < count; i++) {
+    FoodItem item = { (uint16_t)((i * 7919) % 65521), (int16_t)i, 0, "" };
+    if (useNames) {
+      snprintf(item.name, sizeof(item.name), "%s", names[i]);
+    } else {
+      snprintf(item.name, sizeof(item.name), "food %05ld", i);
+    }
+    FoodCatalog::encode(item, buffer);
+    file.append(buffer, FOOD_RECORD_SIZE);
+  }
+  return std::string(file.data.begin(), file.data.end());
+}
+
+static void load(MemoryFile &file, const std::string &bytes) {
+  file.data.assign(bytes.begin(), bytes.end());
+}
+
+static bool buildIndex(MemoryFile &catalog, MemoryFile &index, MemoryFile &scratch) {
+  FoodIndexWriter indexer(catalog, index, scratch);
+  if (!indexer.begin()) {
+    return false;
+  }
+  while (indexer.poll()) {
+  }
+  return indexer.finish();
+}
+
+static MemoryFile catalogFile;
+static MemoryFile indexFile;
+static MemoryFile scratchFile;
+static FakeServer server;
+
+void setUp() {
+  catalogFile = MemoryFile();
+  indexFile = MemoryFile();
+  scratchFile = MemoryFile();
+  server = FakeServer();
+}
+
+void tearDown() {
+}
+
+void test_writer_takes_any_chunking() {
+  std::string bytes = catalogBytes(100, 12);
+  const size_t chunks[] = { 1, 7, 31, 32, 33, 4096 };
+  for (size_t c = 0; c < sizeof(chunks) / sizeof(chunks[0]); c++) {
+    FoodCatalogWriter writer(catalogFile);
+    TEST_ASSERT_TRUE(writer.begin());
+    for (size_t at = 0; at < bytes.size(); at += chunks[c]) {
+      size_t n = bytes.size() - at < chunks[c] ? bytes.size() - at : chunks[c];
+      TEST_ASSERT_TRUE(writer.write((const uint8_t *)bytes.data() + at, n));
+    }
+    TEST_ASSERT_TRUE(writer.finish());
+    TEST_ASSERT_EQUAL(12, writer.revision());
+    TEST_ASSERT_TRUE(std::string(catalogFile.data.begin(), catalogFile.data.end()) == bytes);
+  }
+}
+
+void test_writer_rejects_bad_catalogs() {
+  std::string good = catalogBytes(20, 3);
+  FoodCatalogWriter writer(catalogFile);
+
+  std::string damaged = good;
+  damaged[FOOD_HEADER_SIZE + 5 * FOOD_RECORD_SIZE + 10] ^= 1;
+  writer.begin();
+  TEST_ASSERT_FALSE(writer.write((const uint8_t *)damaged.data(), damaged.size()));
+  TEST_ASSERT_FALSE(writer.finish());
+
+  // records 3 and 4 swapped, the names are out of order
+  std::string swapped = good;
+  swapped.replace(FOOD_HEADER_SIZE + 3 * FOOD_RECORD_SIZE, FOOD_RECORD_SIZE, good, FOOD_HEADER_SIZE + 4 * FOOD_RECORD_SIZE, FOOD_RECORD_SIZE);
+  swapped.replace(FOOD_HEADER_SIZE + 4 * FOOD_RECORD_SIZE, FOOD_RECORD_SIZE, good, FOOD_HEADER_SIZE + 3 * FOOD_RECORD_SIZE, FOOD_RECORD_SIZE);
+  writer.begin();
+  TEST_ASSERT_FALSE(writer.write((const uint8_t *)swapped.data(), swapped.size()));
+
+  writer.begin();
+  TEST_ASSERT_TRUE(writer.write((const uint8_t *)good.data(), good.size() - 1));
+  TEST_ASSERT_FALSE(writer.finish());
+
+  std::string extra = good + good.substr(good.size() - FOOD_RECORD_SIZE);
+  writer.begin();
+  TEST_ASSERT_FALSE(writer.write((const uint8_t *)extra.data(), extra.size()));
+
+  std::string header = good;
+  header[0] = 'X';
+  writer.begin();
+  TEST_ASSERT_FALSE(writer.write((const uint8_t *)header.data(), header.size()));
+}
+
+void test_open_checks_size() {
+  load(catalogFile, catalogBytes(20, 3));
+  FoodCatalog foods(catalogFile, indexFile);
+  TEST_ASSERT_TRUE(foods.open());
+  TEST_ASSERT_EQUAL(20, foods.count());
+  TEST_ASSERT_EQUAL(3, foods.revision());
+  TEST_ASSERT_FALSE(foods.indexed());
+  catalogFile.data.pop_back();
+  TEST_ASSERT_FALSE(foods.open());
+  TEST_ASSERT_EQUAL(0, foods.count());
+}
+
+// scrolling through the whole list reads a page of FOOD_WINDOW foods at a time
+void test_paging_reads_a_window_at_a_time() {
+  load(catalogFile, catalogBytes(100, 1));
+  FoodCatalog foods(catalogFile, indexFile);
+  foods.open();
+  catalogFile.reads = 0;
+  FoodItem item;
+  for (long i = 0; i < foods.count(); i++) {
+    TEST_ASSERT_TRUE(foods.get(i, item));
+    TEST_ASSERT_EQUAL(i, item.tare);
+  }
+  TEST_ASSERT_EQUAL((100 + FOOD_WINDOW - 1) / FOOD_WINDOW, catalogFile.reads);
+  TEST_ASSERT_FALSE(foods.get(100, item));
+  TEST_ASSERT_FALSE(foods.get(-1, item));
+}
+
+void test_jump_and_initials() {
+  load(catalogFile, catalogBytes(10, 1, true));
+  FoodCatalog foods(catalogFile, indexFile);
+  foods.open();
+  TEST_ASSERT_EQUAL(0, foods.jump(""));
+  TEST_ASSERT_EQUAL(1, foods.jump("APR"));
+  TEST_ASSERT_EQUAL(3, foods.jump("bas"));
+  TEST_ASSERT_EQUAL(7, foods.jump("oat"));
+  TEST_ASSERT_EQUAL(9, foods.jump("p"));
+  TEST_ASSERT_EQUAL(10, foods.jump("zz"));
+  TEST_ASSERT_EQUAL(2, foods.nextInitial(0));
+  TEST_ASSERT_EQUAL(4, foods.nextInitial(3));
+  TEST_ASSERT_EQUAL(9, foods.nextInitial(7));
+  TEST_ASSERT_EQUAL(9, foods.nextInitial(9));
+  TEST_ASSERT_EQUAL(2, foods.previousInitial(3));
+  TEST_ASSERT_EQUAL(0, foods.previousInitial(2));
+  TEST_ASSERT_EQUAL(0, foods.previousInitial(0));
+}
+
+void test_index_finds_every_id() {
+  const long sizes[] = { 0, 1, FOOD_INDEX_RUN - 1, FOOD_INDEX_RUN, FOOD_INDEX_RUN + 1, 2 * FOOD_INDEX_RUN + 1, 1000 };
+  for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+    setUp();
+    load(catalogFile, catalogBytes(sizes[s], 5));
+    TEST_ASSERT_TRUE(buildIndex(catalogFile, indexFile, scratchFile));
+    TEST_ASSERT_EQUAL(0, scratchFile.size());
+    FoodCatalog foods(catalogFile, indexFile);
+    TEST_ASSERT_TRUE(foods.open());
+    TEST_ASSERT_TRUE(foods.indexed());
+    for (long i = 0; i < sizes[s]; i++) {
+      TEST_ASSERT_EQUAL(i, foods.find((uint16_t)((i * 7919) % 65521)));
+    }
+    TEST_ASSERT_EQUAL(-1, foods.find(65535));
+  }
+}
+
+// lookups cost a read per halving of the index, 5000 foods take a few more than 50 do
+void test_lookup_cost_grows_with_log_of_size() {
+  const long sizes[] = { 50, 500, 5000 };
+  long worst[3];
+  for (size_t s = 0; s < 3; s++) {
+    setUp();
+    load(catalogFile, catalogBytes(sizes[s], 5));
+    buildIndex(catalogFile, indexFile, scratchFile);
+    FoodCatalog foods(catalogFile, indexFile);
+    foods.open();
+    worst[s] = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (long i = 0; i < sizes[s]; i += 3) {
+      long before = indexFile.reads;
+      TEST_ASSERT_EQUAL(i, foods.find((uint16_t)((i * 7919) % 65521)));
+      if (indexFile.reads - before > worst[s]) {
+        worst[s] = indexFile.reads - before;
+      }
+    }
+    double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / ((sizes[s] + 2) / 3);
+    char message[96];
+    snprintf(message, sizeof(message), "%ld foods: at most %ld index reads, %.2f us per lookup on the host",
+             sizes[s], worst[s], us);
+    TEST_MESSAGE(message);
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(8, worst[0]);
+  TEST_ASSERT_LESS_OR_EQUAL(15, worst[2]);
+  TEST_ASSERT_LESS_OR_EQUAL(worst[0] + 8, worst[2]);
+
+  // and whatever the size, this is all the RAM they take outside a call
+  char message[96];
+  snprintf(message, sizeof(message), "sizeof FoodCatalog %u, FoodIndexWriter %u, FoodCatalogWriter %u bytes",
+           (unsigned)sizeof(FoodCatalog), (unsigned)sizeof(FoodIndexWriter), (unsigned)sizeof(FoodCatalogWriter));
+  TEST_MESSAGE(message);
+  TEST_ASSERT_LESS_OR_EQUAL(FOOD_WINDOW * sizeof(FoodItem) + 64, sizeof(FoodCatalog));
+  TEST_ASSERT_LESS_OR_EQUAL(384, sizeof(FoodIndexWriter));
+  TEST_ASSERT_LESS_OR_EQUAL(FOOD_RECORD_SIZE + FOOD_NAME_LENGTH + 48, sizeof(FoodCatalogWriter));
+}
+
+// an index left over from another revision is not used, lookups fall back to the window
+void test_stale_index_is_ignored() {
+  load(catalogFile, catalogBytes(40, 5));
+  buildIndex(catalogFile, indexFile, scratchFile);
+  load(catalogFile, catalogBytes(40, 6));
+  FoodCatalog foods(catalogFile, indexFile);
+  TEST_ASSERT_TRUE(foods.open());
+  TEST_ASSERT_FALSE(foods.indexed());
+  TEST_ASSERT_EQUAL(-1, foods.find((uint16_t)((30 * 7919) % 65521)));
+  FoodItem item;
+  foods.get(30, item);
+  TEST_ASSERT_EQUAL(30, foods.find(item.id));
+}
+
+// records rewritten under the same header, each with a good CRC of its own, don't match the index's
+void test_index_of_other_records_is_ignored() {
+  load(catalogFile, catalogBytes(40, 5));
+  buildIndex(catalogFile, indexFile, scratchFile);
+  FoodItem item = { 4242, 0, 0, "food 00030" };
+  FoodCatalog::encode(item, catalogFile.data.data() + FOOD_HEADER_SIZE + 30 * FOOD_RECORD_SIZE);
+  FoodCatalog foods(catalogFile, indexFile);
+  TEST_ASSERT_TRUE(foods.open());
+  TEST_ASSERT_FALSE(foods.indexed());
+  load(catalogFile, catalogBytes(40, 5));
+  catalogFile.reads = 0;
+  TEST_ASSERT_TRUE(foods.open());
+  TEST_ASSERT_TRUE(foods.indexed());
+  TEST_ASSERT_EQUAL(1 + (40 + FOOD_WINDOW - 1) / FOOD_WINDOW, catalogFile.reads);
+}
+
+// the index entries carry no CRC, an entry pointing at the wrong food isn't believed
+void test_damaged_index_entry_is_not_trusted() {
+  load(catalogFile, catalogBytes(40, 5));
+  buildIndex(catalogFile, indexFile, scratchFile);
+  for (long i = 0; i < 40; i++) {
+    indexFile.data[i * FOOD_INDEX_ENTRY_SIZE + 2] ^= 1;
+  }
+  FoodCatalog foods(catalogFile, indexFile);
+  foods.open();
+  TEST_ASSERT_TRUE(foods.indexed());
+  TEST_ASSERT_EQUAL(-1, foods.find((uint16_t)((11 * 7919) % 65521)));
+}
+
+static bool download(CatalogUpdater &updater, size_t bytesPerPoll, unsigned long msPerPoll, unsigned long &now) {
+  for (int polls = 0; polls < 100000; polls++) {
+    server.arrive(bytesPerPoll);
+    long before = catalogFile.size();
+    if (updater.poll(now += msPerPoll)) {
+      return true;
+    }
+    TEST_ASSERT_LESS_OR_EQUAL(CATALOG_POLL_BYTES, catalogFile.size() - before);
+  }
+  return false;
+}
+
+void test_updater_downloads_and_indexes() {
+  std::string body = catalogBytes(500, 9);
+  server.response = "HTTP/1.0 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+  server.closeAtEnd = false;
+  FoodCatalogWriter writer(catalogFile);
+  FoodIndexWriter indexer(catalogFile, indexFile, scratchFile);
+  CatalogUpdater updater(server, "collector", 8090, "/foods", writer, indexer);
+  unsigned long now = 0;
+  TEST_ASSERT_TRUE(updater.start(8, now));
+  TEST_ASSERT_EQUAL(0, server.request.find("GET /foods HTTP/1.0\r\nHost: collector:8090\r\n"));
+  TEST_ASSERT_TRUE(server.request.find("If-None-Match: \"8\"\r\n\r\n") != std::string::npos);
+  TEST_ASSERT_FALSE(updater.start(8, now));
+  TEST_ASSERT_TRUE(download(updater, 1460, 10, now));
+  TEST_ASSERT_TRUE(updater.updated());
+  TEST_ASSERT_EQUAL(200, updater.status());
+  TEST_ASSERT_FALSE(server.open);
+  FoodCatalog foods(catalogFile, indexFile);
+  TEST_ASSERT_TRUE(foods.open());
+  TEST_ASSERT_TRUE(foods.indexed());
+  TEST_ASSERT_EQUAL(9, foods.revision());
+  TEST_ASSERT_EQUAL(321, foods.find((uint16_t)((321 * 7919) % 65521)));
+}
+
+// without a Content-Length the body ends when the server closes, all of it has to be there
+void test_updater_close_delimited() {
+  std::string body = catalogBytes(50, 9);
+  FoodCatalogWriter writer(catalogFile);
+  FoodIndexWriter indexer(catalogFile, indexFile, scratchFile);
+  CatalogUpdater updater(server, "collector", 8090, "/foods", writer, indexer);
+  unsigned long now = 0;
+
+  server.response = "HTTP/1.0 200 OK\r\n\r\n" + body;
+  updater.start(8, now);
+  TEST_ASSERT_TRUE(download(updater, 100, 10, now));
+  TEST_ASSERT_TRUE(updater.updated());
+
+  server = FakeServer();
+  server.response = "HTTP/1.0 200 OK\r\n\r\n" + body.substr(0, 1000);
+  updater.start(8, now);
+  TEST_ASSERT_TRUE(download(updater, 100, 10, now));
+  TEST_ASSERT_FALSE(updater.updated());
+}
+
+void test_updater_not_modified() {
+  server.response = "HTTP/1.1 304 Not Modified\r\nContent-Length: 0\r\n\r\n";
+  server.closeAtEnd = false;
+  FoodCatalogWriter writer(catalogFile);
+  FoodIndexWriter indexer(catalogFile, indexFile, scratchFile);
+  CatalogUpdater updater(server, "collector", 8090, "/foods", writer, indexer);
+  unsigned long now = 0;
+  load(catalogFile, catalogBytes(5, 8));
+  updater.start(8, now);
+  TEST_ASSERT_TRUE(download(updater, 1, 10, now));
+  TEST_ASSERT_FALSE(updater.updated());
+  TEST_ASSERT_EQUAL(304, updater.status());
+  TEST_ASSERT_FALSE(server.open);
+  TEST_ASSERT_EQUAL(FOOD_HEADER_SIZE + 5 * FOOD_RECORD_SIZE, catalogFile.size());
+}
+
+// the server goes quiet halfway, the download is given up after CATALOG_TIMEOUT_MS
+void test_updater_times_out() {
+  std::string body = catalogBytes(500, 9);
+  server.response = "HTTP/1.0 200 OK\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body.substr(0, 2000);
+  server.closeAtEnd = false;
+  FoodCatalogWriter writer(catalogFile);
+  FoodIndexWriter indexer(catalogFile, indexFile, scratchFile);
+  CatalogUpdater updater(server, "collector", 8090, "/foods", writer, indexer);
+  unsigned long now = 0;
+  updater.start(8, now);
+  server.arrive(server.response.size());
+  while (!updater.poll(now)) {
+    now += 100;
+    TEST_ASSERT_LESS_THAN(60000, now);
+  }
+  TEST_ASSERT_FALSE(updater.updated());
+  TEST_ASSERT_GREATER_OR_EQUAL(CATALOG_TIMEOUT_MS, now);
+  TEST_ASSERT_LESS_OR_EQUAL(CATALOG_TIMEOUT_MS + 1000, now);
+  TEST_ASSERT_FALSE(server.open);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_writer_takes_any_chunking);
+  RUN_TEST(test_writer_rejects_bad_catalogs);
+  RUN_TEST(test_open_checks_size);
+  RUN_TEST(test_paging_reads_a_window_at_a_time);
+  RUN_TEST(test_jump_and_initials);
+  RUN_TEST(test_index_finds_every_id);
+  RUN_TEST(test_lookup_cost_grows_with_log_of_size);
+  RUN_TEST(test_stale_index_is_ignored);
+  RUN_TEST(test_index_of_other_records_is_ignored);
+  RUN_TEST(test_damaged_index_entry_is_not_trusted);
+  RUN_TEST(test_updater_downloads_and_indexes);
+  RUN_TEST(test_updater_close_delimited);
+  RUN_TEST(test_updater_not_modified);
+  RUN_TEST(test_updater_times_out);
+  return UNITY_END();
+}
@@ -0,0 +1,301 @@
+// The CGRAM glyph cache in LiquidCrystal_I2C, counted on a mock I2C bus that
+// decodes into HD44780 DDRAM and CGRAM: uploads skipped for resident glyphs,
+// LRU eviction, pinned and on-screen slots left alone, and icon churn.
+#include <Arduino.h>
+#include <Hal.h>
+#include <LiquidCrystal_I2C.h>
+#include "../support/LcdModel.h"
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+
+static FakeClock fakeClock;
+static ModelI2c bus;
+static Hd44780 controller;
+static HalDevices saved;
+static uint8_t icons[16][8];
+
+void setUp() {
+  saved = hal;
+  fakeClock.now = 0;
+  bus.model = 0;
+  controller.reset();
+  hal.clock = &fakeClock;
+  hal.i2c = &bus;
+  for (uint8_t i = 0; i < 16; i++) {
+    for (uint8_t line = 0; line < 8; line++) {
+      icons[i][line] = (uint8_t)((i * 7 + line * 3 + 1) & 0x1f);
+    }
+  }
+}
+
+void tearDown() {
+  hal = saved;
+}
+
+static void startLcd(LiquidCrystal_I2C &lcd) {
+  lcd.init();
+  lcd.backlight();
+  bus.model = &controller;
+}
+
+// icon i, or the fallback '?' when no slot could be had, at a cell of row 0
+static uint8_t drawIcon(LiquidCrystal_I2C &lcd, uint8_t col, int icon) {
+  uint8_t cell = lcd.glyph((uint8_t)(icon + 1), icons[icon], '?');
+  lcd.setCursor(col, 0);
+  lcd.write(cell);
+  return cell;
+}
+
+// every cell showing a CGRAM glyph shows the bitmap it was drawn with
+static void checkScreen(const int *drawn, uint8_t cells) {
+  for (uint8_t col = 0; col < cells; col++) {
+    const uint8_t *shown = controller.bitmapAt(col);
+    if (drawn[col] >= 0) {
+      TEST_ASSERT_NOT_NULL(shown);
+      TEST_ASSERT_EQUAL_HEX8_ARRAY(icons[drawn[col]], shown, 8);
+    }
+  }
+}
+
+void test_resident_glyph_is_not_uploaded_again() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  uint8_t slot = lcd.glyph(5, icons[0]);
+  TEST_ASSERT_LESS_THAN(8, slot);
+  TEST_ASSERT_EQUAL(1, controller.uploads);
+  TEST_ASSERT_EQUAL(8, controller.cgramBytes);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(icons[0], &controller.cgram[slot * 8], 8);
+  for (int i = 0; i < 100; i++) {
+    TEST_ASSERT_EQUAL(slot, lcd.glyph(5, icons[0]));
+  }
+  TEST_ASSERT_EQUAL(8, controller.cgramBytes);
+  // text after an upload still goes to DDRAM
+  lcd.setCursor(0, 0);
+  lcd.print("ok");
+  TEST_ASSERT_EQUAL('o', controller.ddram[0]);
+  TEST_ASSERT_EQUAL(8, controller.cgramBytes);
+}
+
+// 0 marks a free slot and 0xff a pinned one, neither can be cached
+void test_reserved_ids_get_the_fallback() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  TEST_ASSERT_EQUAL('?', lcd.glyph(0, icons[0], '?'));
+  TEST_ASSERT_EQUAL('?', lcd.glyph(LCD_GLYPH_PINNED, icons[0], '?'));
+  TEST_ASSERT_EQUAL(' ', lcd.glyph(0, icons[0]));
+  TEST_ASSERT_EQUAL(0, controller.cgramBytes);
+}
+
+// the slot used longest ago goes, touching a glyph keeps it
+void test_least_recently_used_is_evicted() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  uint8_t slots[8];
+  for (int i = 0; i < 8; i++) {
+    slots[i] = lcd.glyph((uint8_t)(i + 1), icons[i]);
+  }
+  TEST_ASSERT_EQUAL(8, controller.uploads);
+  lcd.glyph(1, icons[0]);
+  lcd.glyph(3, icons[2]);
+  // 2 is now the oldest, then 4
+  TEST_ASSERT_EQUAL(slots[1], lcd.glyph(9, icons[8]));
+  TEST_ASSERT_EQUAL(slots[3], lcd.glyph(10, icons[9]));
+  TEST_ASSERT_EQUAL(10, controller.uploads);
+  TEST_ASSERT_EQUAL(slots[0], lcd.glyph(1, icons[0]));
+  TEST_ASSERT_EQUAL(slots[2], lcd.glyph(3, icons[2]));
+  TEST_ASSERT_EQUAL(10, controller.uploads);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(icons[8], &controller.cgram[slots[1] * 8], 8);
+}
+
+// the use clock is 16 bits, ages still come out right after it wraps
+void test_lru_across_clock_wrap() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  for (int i = 0; i < 8; i++) {
+    lcd.glyph((uint8_t)(i + 1), icons[i]);
+  }
+  for (long n = 0; n < 70000; n++) {
+    lcd.glyph((uint8_t)(2 + n % 7), icons[1 + n % 7]);
+  }
+  uint8_t first = lcd.glyph(1, icons[0]);
+  lcd.glyph(1, icons[0]);
+  for (int i = 2; i <= 8; i++) {
+    lcd.glyph((uint8_t)i, icons[i - 1]);
+  }
+  // 1 was used before all the others
+  TEST_ASSERT_EQUAL(first, lcd.glyph(9, icons[8]));
+  TEST_ASSERT_EQUAL(9, controller.uploads);
+}
+
+// createChar() writes its slot every time and the cache never takes it
+void test_created_char_is_pinned() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  uint8_t mine[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  lcd.createChar(3, mine);
+  lcd.createChar(3, mine);
+  TEST_ASSERT_EQUAL(16, controller.cgramBytes);
+  for (int i = 0; i < 40; i++) {
+    TEST_ASSERT_NOT_EQUAL(3, lcd.glyph((uint8_t)(20 + i), icons[i % 16]));
+  }
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(mine, &controller.cgram[24], 8);
+  // every slot pinned, nothing is left for the cache
+  for (uint8_t slot = 0; slot < 8; slot++) {
+    lcd.createChar(slot, mine);
+  }
+  int before = controller.cgramBytes;
+  TEST_ASSERT_EQUAL('?', lcd.glyph(60, icons[0], '?'));
+  TEST_ASSERT_EQUAL(before, controller.cgramBytes);
+}
+
+// while buffered, a slot in the frame or still on the lcd isn't overwritten:
+// the fallback comes back until a flush has taken the glyph off the screen
+void test_on_screen_glyph_is_not_overwritten() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.setBuffered(true);
+  int drawn[16];
+  for (int col = 0; col < 16; col++) {
+    drawn[col] = col < 8 ? col : -1;
+  }
+  for (uint8_t col = 0; col < 8; col++) {
+    TEST_ASSERT_NOT_EQUAL('?', drawIcon(lcd, col, col));
+  }
+  lcd.flush();
+  checkScreen(drawn, 16);
+  int before = controller.cgramBytes;
+  TEST_ASSERT_EQUAL('?', lcd.glyph(9, icons[8], '?'));
+  // gone from the frame, but the lcd still shows it until the next flush
+  lcd.setCursor(0, 0);
+  lcd.write(' ');
+  TEST_ASSERT_EQUAL('?', lcd.glyph(9, icons[8], '?'));
+  TEST_ASSERT_EQUAL(before, controller.cgramBytes);
+  lcd.flush();
+  drawn[0] = -1;
+  uint8_t slot = drawIcon(lcd, 0, 8);
+  TEST_ASSERT_LESS_THAN(8, slot);
+  drawn[0] = 8;
+  lcd.flush();
+  checkScreen(drawn, 16);
+  TEST_ASSERT_EQUAL(before + 8, controller.cgramBytes);
+}
+
+// codes 8-15 show slots 0-7 too, so they hold on to the slot just the same
+void test_aliased_codes_count_as_on_screen() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.setBuffered(true);
+  uint8_t slots[8];
+  for (int i = 0; i < 8; i++) {
+    slots[i] = lcd.glyph((uint8_t)(i + 1), icons[i]);
+  }
+  lcd.setCursor(0, 1);
+  lcd.write((uint8_t)(slots[0] + 8));
+  // every other slot is free to go, the aliased one isn't even though it is the oldest
+  TEST_ASSERT_NOT_EQUAL(slots[0], lcd.glyph(9, icons[8]));
+}
+
+// unbuffered drawing isn't tracked, an upload there can change a cell already drawn
+void test_unbuffered_takes_any_slot() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  for (uint8_t col = 0; col < 8; col++) {
+    drawIcon(lcd, col, col);
+  }
+  TEST_ASSERT_NOT_EQUAL('?', lcd.glyph(9, icons[8], '?'));
+}
+
+// three status icons drawn every pass from a set of four: each glyph goes up once
+void test_status_icons_stay_resident() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.setBuffered(true);
+  int drawn[16];
+  for (int col = 0; col < 16; col++) {
+    drawn[col] = -1;
+  }
+  srand(1);
+  for (int pass = 0; pass < 1000; pass++) {
+    for (uint8_t pos = 0; pos < 3; pos++) {
+      int icon = rand() % 4;
+      TEST_ASSERT_NOT_EQUAL('?', drawIcon(lcd, 13 + pos, icon));
+      drawn[13 + pos] = icon;
+    }
+    lcd.flush();
+    checkScreen(drawn, 16);
+  }
+  TEST_ASSERT_EQUAL(4, controller.uploads);
+  TEST_ASSERT_EQUAL(4 * 8, controller.cgramBytes);
+}
+
+// twelve icons in six cells, more glyphs than slots: every cell still shows its own bitmap,
+// and the uploads are a fraction of what createChar() before every draw would cost
+void test_icon_churn() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.setBuffered(true);
+  int drawn[16];
+  for (int col = 0; col < 16; col++) {
+    drawn[col] = -1;
+  }
+  srand(2);
+  int draws = 0;
+  int fallbacks = 0;
+  for (int pass = 0; pass < 1000; pass++) {
+    for (uint8_t pos = 0; pos < 6; pos++) {
+      int icon = rand() % 12;
+      if (drawIcon(lcd, pos, icon) == '?') {
+        fallbacks++;
+        drawn[pos] = -1;
+      } else {
+        drawn[pos] = icon;
+      }
+      draws++;
+    }
+    lcd.flush();
+    checkScreen(drawn, 16);
+  }
+  TEST_ASSERT_EQUAL(controller.uploads * 8, controller.cgramBytes);
+  TEST_ASSERT_LESS_THAN(draws / 2, controller.uploads);
+  TEST_ASSERT_LESS_THAN(draws / 10, fallbacks);
+  char message[120];
+  snprintf(message, sizeof(message), "%d draws: %d CGRAM uploads (%d bytes), %d fallbacks, createChar every draw: %d bytes",
+           draws, controller.uploads, controller.cgramBytes, fallbacks, draws * 8);
+  TEST_MESSAGE(message);
+}
+
+// a bar following the weight only needs its partial cell glyphs, loaded once ahead of time
+void test_bar_graph_uploads() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.setBuffered(true);
+  TEST_ASSERT_EQUAL(0, lcd.init_bargraph(LCD_HORIZONTAL_BAR_GRAPH));
+  TEST_ASSERT_EQUAL(4, controller.uploads);
+  for (int up = 0; up <= 80; up++) {
+    lcd.draw_horizontal_graph(1, 0, 16, (uint8_t)up);
+    lcd.flush();
+  }
+  for (int down = 80; down >= 0; down--) {
+    lcd.draw_horizontal_graph(1, 0, 16, (uint8_t)down);
+    lcd.flush();
+  }
+  TEST_ASSERT_EQUAL(4, controller.uploads);
+  TEST_ASSERT_EQUAL(1, lcd.init_bargraph(7));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_resident_glyph_is_not_uploaded_again);
+  RUN_TEST(test_reserved_ids_get_the_fallback);
+  RUN_TEST(test_least_recently_used_is_evicted);
+  RUN_TEST(test_lru_across_clock_wrap);
+  RUN_TEST(test_created_char_is_pinned);
+  RUN_TEST(test_on_screen_glyph_is_not_overwritten);
+  RUN_TEST(test_aliased_codes_count_as_on_screen);
+  RUN_TEST(test_unbuffered_takes_any_slot);
+  RUN_TEST(test_status_icons_stay_resident);
+  RUN_TEST(test_icon_churn);
+  RUN_TEST(test_bar_graph_uploads);
+  return UNITY_END();
+}
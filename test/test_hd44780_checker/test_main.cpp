@@ -0,0 +1,97 @@
+// The simulator's HD44780 timing checker fed expander bytes directly: a driver
+// that waits as long as the datasheet asks gets through clean, and an Enable
+// pulse that's too short or a byte sent while a clear is still running is caught.
+#include <Hd44780Checker.h>
+#include <unity.h>
+#include <string.h>
+
+#define I2C_HZ 100000
+
+static uint64_t fall;           // when the last nibble was taken
+
+void setUp() {
+  fall = 0;
+}
+
+void tearDown() {
+}
+
+// one nibble taken afterUs after the last one: lines set up, EN raised, EN lowered highUs later
+static void nibble(Hd44780Checker &lcd, uint8_t lines, uint32_t afterUs, uint32_t highUs = 1) {
+  fall += afterUs;
+  lcd.expanderWrite(fall - highUs - 1, lines);
+  lcd.expanderWrite(fall - highUs, lines | PCF8574_EN);
+  lcd.expanderWrite(fall, lines);
+}
+
+// a byte in 4 bit mode, its high nibble afterUs after the last strobe and the low one right behind
+static void send(Hd44780Checker &lcd, uint8_t rs, uint8_t value, uint32_t afterUs) {
+  nibble(lcd, rs | (value & 0xf0), afterUs);
+  nibble(lcd, rs | ((value << 4) & 0xf0), 3);
+}
+
+// the reset by instruction into 4 bit mode, each step waiting exactly what it has to
+static void init(Hd44780Checker &lcd) {
+  nibble(lcd, 0x30, HD44780_POWER_ON_US);
+  nibble(lcd, 0x30, HD44780_FIRST_RESET_US);
+  nibble(lcd, 0x30, HD44780_SECOND_RESET_US);
+  nibble(lcd, 0x20, HD44780_COMMAND_US);
+  send(lcd, 0, 0x28, HD44780_COMMAND_US);
+  send(lcd, 0, 0x0c, HD44780_COMMAND_US);
+  send(lcd, 0, 0x06, HD44780_COMMAND_US);
+}
+
+void test_exact_waits_are_clean() {
+  Hd44780Checker lcd(16, 2, I2C_HZ);
+  init(lcd);
+  send(lcd, 0, 0x01, HD44780_COMMAND_US);
+  send(lcd, PCF8574_RS, 'O', HD44780_CLEAR_US);
+  send(lcd, PCF8574_RS, 'K', HD44780_DATA_US);
+  TEST_ASSERT_EQUAL(0, lcd.violationCount());
+  TEST_ASSERT_EQUAL(4 + 2 * 6, lcd.strobes());
+  TEST_ASSERT_TRUE(lcd.fourBit());
+  TEST_ASSERT_TRUE(lcd.row(0).compare(0, 2, "OK") == 0);
+}
+
+// EN raised and lowered within the same microsecond is under the 450ns the controller needs
+void test_enable_pulse_too_short() {
+  Hd44780Checker lcd(16, 2, I2C_HZ);
+  init(lcd);
+  nibble(lcd, PCF8574_RS | 0x40, HD44780_COMMAND_US);
+  nibble(lcd, PCF8574_RS | 0x10, 3, 0);
+  TEST_ASSERT_EQUAL(1, lcd.violationCount());
+  const Hd44780Violation &v = lcd.violations()[0];
+  TEST_ASSERT_EQUAL_STRING("EN pulse too short", v.rule);
+  TEST_ASSERT_EQUAL(fall, v.time);
+  TEST_ASSERT_EQUAL(0, v.earlyUs);
+}
+
+// a byte after a clear with only a command's wait, and one a single microsecond short of it
+void test_command_before_clear_finishes() {
+  Hd44780Checker lcd(16, 2, I2C_HZ);
+  init(lcd);
+  send(lcd, 0, 0x01, HD44780_COMMAND_US);
+  send(lcd, PCF8574_RS, 'x', HD44780_COMMAND_US);
+  // both nibbles land inside the clear, the byte only executes on the second
+  TEST_ASSERT_EQUAL(2, lcd.violationCount());
+  const Hd44780Violation &v = lcd.violations()[0];
+  TEST_ASSERT_EQUAL_STRING("sent while busy", v.rule);
+  TEST_ASSERT_EQUAL(HD44780_CLEAR_US - HD44780_COMMAND_US, v.earlyUs);
+  TEST_ASSERT_FALSE(v.previousData);
+  TEST_ASSERT_EQUAL_HEX8(0x01, v.previous);
+  TEST_ASSERT_EQUAL(HD44780_CLEAR_US - HD44780_COMMAND_US - 3, lcd.violations()[1].earlyUs);
+
+  send(lcd, 0, 0x01, HD44780_DATA_US);
+  send(lcd, PCF8574_RS, 'y', HD44780_CLEAR_US - 1);
+  TEST_ASSERT_EQUAL(3, lcd.violationCount());
+  TEST_ASSERT_EQUAL_STRING("sent while busy", lcd.violations()[2].rule);
+  TEST_ASSERT_EQUAL(1, lcd.violations()[2].earlyUs);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_exact_waits_are_clean);
+  RUN_TEST(test_enable_pulse_too_short);
+  RUN_TEST(test_command_before_clear_finishes);
+  return UNITY_END();
+}
@@ -0,0 +1,420 @@
+// HttpUploader against a scripted server: requests written ahead of their
+// responses, batching, and readings without a response resent after a drop.
+#include <Arduino.h>
+#include <Client.h>
+#include <Hal.h>
+#include "HttpUploader.h"
+#include "../support/FakeDns.h"
+#include <unity.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+// the collector's side of the one connection, responses are queued by the test
+class FakeSocket : public Client {
+public:
+  std::string out;
+  std::string in;
+  size_t at = 0;
+  bool open = false;
+  bool refuse = false;
+  int connects = 0;
+  IPAddress address;
+  int connect(const char *, uint16_t) { return 0; }   // would look the name up again
+  int connect(IPAddress ip, uint16_t) {
+    connects++;
+    address = ip;
+    if (refuse) {
+      return 0;
+    }
+    open = true;
+    out.clear();
+    in.clear();
+    at = 0;
+    return 1;
+  }
+  size_t write(uint8_t c) { out += (char)c; return 1; }
+  size_t write(const uint8_t *buffer, size_t size) { out.append((const char *)buffer, size); return size; }
+  int available() { return open ? (int)(in.size() - at) : 0; }
+  int read() { return available() > 0 ? (uint8_t)in[at++] : -1; }
+  int read(uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (n < size && available() > 0) {
+      buffer[n++] = (uint8_t)in[at++];
+    }
+    return (int)n;
+  }
+  int peek() { return available() > 0 ? (uint8_t)in[at] : -1; }
+  void flush() {}
+  void stop() { open = false; }
+  uint8_t connected() { return open; }
+  operator bool() { return open; }
+  void respond(int status, const char *extra = "") {
+    char head[128];
+    snprintf(head, sizeof(head), "HTTP/1.1 %d X\r\n%sContent-Length: 2\r\n\r\nok", status, extra);
+    in += head;
+  }
+};
+
+// a body is the sequence numbers of its readings, "1,2,3,"
+class SeqEncoder : public ReadingEncoder {
+public:
+  const char *contentType() { return "text/plain"; }
+  size_t item(const Reading &reading, uint8_t, uint8_t, Print &out) {
+    return out.print((unsigned long)reading.seq) + out.print(',');
+  }
+};
+
+// the bodies written so far, checked against their Content-Length
+static std::vector<std::string> requests(const std::string &out) {
+  std::vector<std::string> bodies;
+  size_t at = 0;
+  while ((at = out.find("POST ", at)) != std::string::npos) {
+    size_t length = out.find("Content-Length: ", at);
+    size_t body = out.find("\r\n\r\n", at);
+    TEST_ASSERT_TRUE(length != std::string::npos && body != std::string::npos);
+    size_t size = atol(out.c_str() + length + 16);
+    bodies.push_back(out.substr(body + 4, size));
+    TEST_ASSERT_EQUAL(size, bodies.back().size());
+    at = body + 4 + size;
+  }
+  return bodies;
+}
+
+struct Result {
+  uint32_t seq;
+  int status;
+};
+
+static std::vector<Result> results;
+static FakeSocket server;
+static FakeDns dns;
+static HalDevices saved;
+static SeqEncoder encoder;
+
+static void onResult(const Reading &reading, int status) {
+  Result r = { reading.seq, status };
+  results.push_back(r);
+}
+
+static Reading reading(uint32_t seq) {
+  Reading r = { seq, 1000 + seq, 250, 3, 0 };
+  return r;
+}
+
+static void startUploader(HttpUploader &uploader) {
+  uploader.setEncoder(encoder);
+  uploader.onResult(onResult);
+}
+
+void setUp() {
+  saved = hal;
+  dns = FakeDns();
+  dns.hosts["collector"] = IPAddress(10, 0, 0, 2);
+  hal.network = &dns;
+  server = FakeSocket();
+  results.clear();
+}
+
+void tearDown() {
+  hal = saved;
+}
+
+void test_single_reading_round_trip() {
+  HttpUploader uploader(server, "collector", 8080, "/readings");
+  startUploader(uploader);
+  TEST_ASSERT_TRUE(uploader.enqueue(reading(7)));
+  uploader.poll(0, true);
+  TEST_ASSERT_EQUAL(0, server.out.find("POST /readings HTTP/1.1\r\nHost: collector:8080\r\n"));
+  TEST_ASSERT_TRUE(server.out.find("Connection: keep-alive\r\nContent-Type: text/plain\r\n") != std::string::npos);
+  std::vector<std::string> bodies = requests(server.out);
+  TEST_ASSERT_EQUAL(1, bodies.size());
+  TEST_ASSERT_EQUAL_STRING("7,", bodies[0].c_str());
+  TEST_ASSERT_EQUAL(1, uploader.pending());
+  server.respond(201);
+  uploader.poll(10, true);
+  TEST_ASSERT_EQUAL(0, uploader.pending());
+  TEST_ASSERT_EQUAL(1, results.size());
+  TEST_ASSERT_EQUAL(7, results[0].seq);
+  TEST_ASSERT_EQUAL(201, results[0].status);
+}
+
+// UPLOAD_MAX_INFLIGHT requests go out before the first response, each answer frees a slot
+void test_requests_are_pipelined() {
+  HttpUploader uploader(server, "collector", 8080, "/readings");
+  startUploader(uploader);
+  for (uint32_t i = 0; i < 10; i++) {
+    uploader.enqueue(reading(i));
+  }
+  uploader.poll(0, true);
+  TEST_ASSERT_EQUAL(UPLOAD_MAX_INFLIGHT, requests(server.out).size());
+  uploader.poll(10, true);
+  TEST_ASSERT_EQUAL(UPLOAD_MAX_INFLIGHT, requests(server.out).size());
+  server.respond(200);
+  server.respond(200);
+  uploader.poll(20, true);
+  std::vector<std::string> bodies = requests(server.out);
+  TEST_ASSERT_EQUAL(UPLOAD_MAX_INFLIGHT + 2, bodies.size());
+  for (size_t i = 0; i < bodies.size(); i++) {
+    TEST_ASSERT_EQUAL(i, (size_t)atol(bodies[i].c_str()));
+  }
+  TEST_ASSERT_EQUAL(2, results.size());
+  TEST_ASSERT_EQUAL(1, uploader.connects());
+}
+
+// a response read a byte per poll() is still matched to its batch
+void test_response_split_across_polls() {
+  HttpUploader uploader(server, "collector", 8080, "/readings");
+  startUploader(uploader);
+  uploader.enqueue(reading(1));
+  uploader.enqueue(reading(2));
+  uploader.poll(0, true);
+  server.respond(200);
+  server.respond(503);
+  std::string all = server.in;
+  server.in.clear();
+  for (size_t i = 0; i < all.size(); i++) {
+    server.in += all[i];
+    uploader.poll(i, true);
+  }
+  TEST_ASSERT_EQUAL(2, results.size());
+  TEST_ASSERT_EQUAL(200, results[0].status);
+  TEST_ASSERT_EQUAL(503, results[1].status);
+  TEST_ASSERT_EQUAL(0, uploader.pending());
+}
+
+void test_batch_waits_until_full_or_old() {
+  HttpUploader uploader(server, "collector", 8080, "/readings");
+  startUploader(uploader);
+  uploader.setBatching(5, 1000);
+  uploader.poll(0, true);
+  for (uint32_t i = 0; i < 3; i++) {
+    uploader.enqueue(reading(i));
+  }
+  uploader.poll(999, true);
+  TEST_ASSERT_EQUAL(0, requests(server.out).size());
+  uploader.poll(1000, true);
+  std::vector<std::string> bodies = requests(server.out);
+  TEST_ASSERT_EQUAL(1, bodies.size());
+  TEST_ASSERT_EQUAL_STRING("0,1,2,", bodies[0].c_str());
+  // a full batch doesn't wait
+  for (uint32_t i = 3; i < 15; i++) {
+    uploader.enqueue(reading(i));
+  }
+  uploader.poll(1001, true);
+  bodies = requests(server.out);
+  TEST_ASSERT_EQUAL(3, bodies.size());
+  TEST_ASSERT_EQUAL_STRING("3,4,5,6,7,", bodies[1].c_str());
+  TEST_ASSERT_EQUAL_STRING("8,9,10,11,12,", bodies[2].c_str());
+  server.respond(200);
+  uploader.poll(1002, true);
+  TEST_ASSERT_EQUAL(3, results.size());
+
+  // a partial batch held back by a full window still goes once its oldest reading is old,
+  // not maxWaitMs after the poll that filled the window
+  server.respond(200);
+  server.respond(200);
+  uploader.setBatching(2, 1000);
+  uploader.poll(1003, true);
+  TEST_ASSERT_EQUAL(13, results.size());
+  for (uint32_t i = 15; i < 22; i++) {
+    uploader.enqueue(reading(i));
+  }
+  uploader.poll(1500, true);
+  bodies = requests(server.out);
+  TEST_ASSERT_EQUAL(7, bodies.size());
+  TEST_ASSERT_EQUAL_STRING("19,20,", bodies[6].c_str());
+  for (int i = 0; i < UPLOAD_MAX_INFLIGHT; i++) {
+    server.respond(200);
+  }
+  uploader.poll(2002, true);
+  TEST_ASSERT_EQUAL(21, results.size());
+  TEST_ASSERT_EQUAL(7, requests(server.out).size());
+  uploader.poll(2003, true);
+  bodies = requests(server.out);
+  TEST_ASSERT_EQUAL(8, bodies.size());
+  TEST_ASSERT_EQUAL_STRING("21,", bodies[7].c_str());
+}
+
+// the server closes after answering the first of three requests, the other two go again
+void test_unanswered_readings_resent_after_drop() {
+  HttpUploader uploader(server, "collector", 8080, "/readings");
+  startUploader(uploader);
+  for (uint32_t i = 0; i < 3; i++) {
+    uploader.enqueue(reading(i));
+  }
+  uploader.poll(0, true);
+  TEST_ASSERT_EQUAL(3, requests(server.out).size());
+  server.respond(200, "Connection: close\r\n");
+  uploader.poll(10, true);
+  TEST_ASSERT_EQUAL(1, results.size());
+  TEST_ASSERT_FALSE(server.open);
+  // no reconnect storm, the next connection waits UPLOAD_RECONNECT_MS
+  uploader.poll(20, true);
+  TEST_ASSERT_EQUAL(1, server.connects);
+  uploader.poll(UPLOAD_RECONNECT_MS, true);
+  TEST_ASSERT_EQUAL(2, server.connects);
+  std::vector<std::string> bodies = requests(server.out);
+  TEST_ASSERT_EQUAL(2, bodies.size());
+  TEST_ASSERT_EQUAL_STRING("1,", bodies[0].c_str());
+  TEST_ASSERT_EQUAL_STRING("2,", bodies[1].c_str());
+  server.respond(200);
+  server.respond(200);
+  uploader.poll(UPLOAD_RECONNECT_MS + 10, true);
+  TEST_ASSERT_EQUAL(3, results.size());
+  for (uint32_t i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(i, results[i].seq);
+  }
+}
+
+void test_silent_server_times_out_and_resends() {
+  HttpUploader uploader(server, "collector", 8080, "/readings");
+  startUploader(uploader);
+  uploader.enqueue(reading(5));
+  uploader.poll(0, true);
+  uploader.poll(UPLOAD_RESPONSE_TIMEOUT_MS - 1, true);
+  TEST_ASSERT_TRUE(server.open);
+  uploader.poll(UPLOAD_RESPONSE_TIMEOUT_MS, true);
+  TEST_ASSERT_EQUAL(2, server.connects);
+  std::vector<std::string> bodies = requests(server.out);
+  TEST_ASSERT_EQUAL(1, bodies.size());
+  TEST_ASSERT_EQUAL_STRING("5,", bodies[0].c_str());
+  TEST_ASSERT_EQUAL(0, results.size());
+}
+
+void test_offline_keeps_queue() {
+  HttpUploader uploader(server, "collector", 8080, "/readings");
+  startUploader(uploader);
+  uploader.enqueue(reading(1));
+  uploader.poll(0, true);
+  uploader.poll(10, false);
+  TEST_ASSERT_FALSE(server.open);
+  TEST_ASSERT_EQUAL(1, uploader.pending());
+  for (uint32_t i = 2; i <= UPLOAD_QUEUE_SIZE; i++) {
+    TEST_ASSERT_TRUE(uploader.enqueue(reading(i)));
+  }
+  TEST_ASSERT_FALSE(uploader.enqueue(reading(99)));
+  server.refuse = true;
+  uploader.poll(UPLOAD_RECONNECT_MS, true);
+  TEST_ASSERT_EQUAL(UPLOAD_QUEUE_SIZE, uploader.pending());
+  server.refuse = false;
+  uploader.poll(2 * UPLOAD_RECONNECT_MS, true);
+  TEST_ASSERT_EQUAL(UPLOAD_MAX_INFLIGHT, requests(server.out).size());
+  TEST_ASSERT_EQUAL_STRING("1,", requests(server.out)[0].c_str());
+}
+
+// the name is looked up for the first connect only, and again after a connect to its address failed
+void test_host_looked_up_once() {
+  HttpUploader uploader(server, "collector", 8080, "/readings");
+  startUploader(uploader);
+  uploader.enqueue(reading(1));
+  uploader.poll(0, true);
+  TEST_ASSERT_EQUAL_STRING("10.0.0.2", server.address.toString().c_str());
+  TEST_ASSERT_EQUAL(HOST_TIMEOUT_MS, server.getTimeout());
+  server.respond(200, "Connection: close\r\n");
+  uploader.poll(10, true);
+  uploader.enqueue(reading(2));
+  uploader.poll(UPLOAD_RECONNECT_MS, true);
+  TEST_ASSERT_EQUAL(2, server.connects);
+  TEST_ASSERT_EQUAL(1, requests(server.out).size());
+
+  HostAddress host("collector");
+  TEST_ASSERT_TRUE(host.connect(server, 8080));
+  TEST_ASSERT_TRUE(host.connect(server, 8080));
+  TEST_ASSERT_EQUAL(1, host.lookups());
+  server.refuse = true;
+  TEST_ASSERT_FALSE(host.connect(server, 8080));
+  server.refuse = false;
+  TEST_ASSERT_TRUE(host.connect(server, 8080));
+  TEST_ASSERT_EQUAL(2, host.lookups());
+  HostAddress literal("192.168.0.151");
+  TEST_ASSERT_TRUE(literal.connect(server, 8080));
+  TEST_ASSERT_EQUAL_STRING("192.168.0.151", server.address.toString().c_str());
+  HostAddress unknown("nowhere");
+  TEST_ASSERT_FALSE(unknown.connect(server, 8080));
+}
+
+// A reading every 20 ms for 2 s to a collector one 30 ms round trip away, in
+// simulated time. The uploader pays for the lookup and the handshake once and
+// keeps UPLOAD_MAX_INFLIGHT requests on the wire. Posting the way the firmware
+// did before, a fresh HTTPClient per reading, blocks loop() for a lookup, a
+// handshake and the request's round trip every time.
+void test_keep_alive_against_connect_per_post() {
+  const unsigned long period = 20, rtt = 30, lookup = rtt, handshake = rtt, duration = 2000;
+  const uint32_t count = duration / period;
+
+  HttpUploader uploader(server, "collector", 8080, "/readings");
+  startUploader(uploader);
+  std::vector<unsigned long> due;
+  std::vector<unsigned long> latency;
+  unsigned long now = 0, last = 0;
+  uint32_t queued = 0;
+  int connects = 0;
+  while (latency.size() < count && now < 10 * duration) {
+    if (queued < count && now >= queued * period) {
+      TEST_ASSERT_TRUE(uploader.enqueue(reading(queued++)));
+    }
+    uploader.poll(now, true);
+    if (server.connects != connects) {
+      connects = server.connects;
+      now += (connects == 1 ? lookup : 0) + handshake;    // connect() blocks loop()
+    }
+    while (due.size() < requests(server.out).size()) {
+      due.push_back(now + rtt);
+    }
+    for (size_t i = 0; i < due.size(); i++) {
+      if (due[i] == now) {
+        server.respond(200);
+      }
+    }
+    while (latency.size() < results.size()) {
+      latency.push_back(now - results[latency.size()].seq * period);
+      last = now;
+    }
+    now++;
+  }
+  TEST_ASSERT_EQUAL(count, latency.size());
+  TEST_ASSERT_EQUAL(1, connects);
+
+  unsigned long busyUntil = 0, perPostLast = 0;
+  std::vector<unsigned long> perPost;
+  for (uint32_t i = 0; i < count; i++) {
+    unsigned long start = i * period > busyUntil ? i * period : busyUntil;
+    busyUntil = start + lookup + handshake + rtt;
+    perPost.push_back(busyUntil - i * period);
+    perPostLast = busyUntil;
+  }
+
+  unsigned long sum = 0, perPostSum = 0, worst = 0;
+  for (uint32_t i = 0; i < count; i++) {
+    sum += latency[i];
+    perPostSum += perPost[i];
+    worst = latency[i] > worst ? latency[i] : worst;
+  }
+  double rate = count * 1000.0 / last;
+  double perPostRate = count * 1000.0 / perPostLast;
+  char message[160];
+  snprintf(message, sizeof(message), "%u readings: keep-alive %.1f posts/s, %lu ms mean latency; connect per post %.1f posts/s, %lu ms",
+           (unsigned)count, rate, sum / count, perPostRate, perPostSum / count);
+  TEST_MESSAGE(message);
+  // keeps up with the readings, a request is answered within its round trip plus a poll
+  TEST_ASSERT_LESS_OR_EQUAL(lookup + handshake + rtt + 2, worst);
+  TEST_ASSERT_TRUE(rate > 45.0);
+  // the old way can't do better than one post per lookup, handshake and round trip
+  TEST_ASSERT_TRUE(perPostRate <= 1000.0 / (lookup + handshake + rtt));
+  TEST_ASSERT_TRUE(perPostSum > 10 * sum);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_single_reading_round_trip);
+  RUN_TEST(test_requests_are_pipelined);
+  RUN_TEST(test_response_split_across_polls);
+  RUN_TEST(test_batch_waits_until_full_or_old);
+  RUN_TEST(test_unanswered_readings_resent_after_drop);
+  RUN_TEST(test_silent_server_times_out_and_resends);
+  RUN_TEST(test_offline_keeps_queue);
+  RUN_TEST(test_host_looked_up_once);
+  RUN_TEST(test_keep_alive_against_connect_per_post);
+  return UNITY_END();
+}
@@ -0,0 +1,179 @@
+// HX711 acquisition: the ring buffer the ISR fills, decoding of the 24 bit
+// readings clocked out of a modelled HX711 and what happens when loop() stalls.
+#include <Arduino.h>
+#include <Hal.h>
+#include "HX711Sampler.h"
+#include "RingBuffer.h"
+#include "../support/FakeClock.h"
+#include <unity.h>
+
+#define DOUT_PIN 12
+#define SCK_PIN 14
+
+// DOUT goes low when a conversion is ready, every SCK rising edge shifts the next
+// bit out MSB first and the pulses after the 24th pick the gain of the next conversion
+class FakeHx711 : public HalGpio {
+public:
+  uint32_t value = 0;
+  int pulses = 0;
+  int lastPulses = 0;
+  int dout = 1;
+  bool interrupts = false;
+  int read(uint8_t pin) { return pin == DOUT_PIN ? dout : 0; }
+  void write(uint8_t pin, uint8_t level) {
+    if (pin != SCK_PIN || !level) {
+      return;
+    }
+    pulses++;
+    if (pulses <= 24) {
+      dout = (value >> (24 - pulses)) & 1;
+    } else {
+      dout = 1;
+    }
+  }
+  void convert(uint32_t raw) {
+    lastPulses = pulses;
+    value = raw & 0xFFFFFF;
+    pulses = 0;
+    dout = 0;
+    if (interrupts) {
+      halPinChanged(DOUT_PIN, 0);
+    }
+  }
+};
+
+static FakeClock fakeClock;
+static FakeHx711 hx711;
+static HalDevices saved;
+
+void setUp() {
+  saved = hal;
+  fakeClock.now = 0;
+  hx711 = FakeHx711();
+  hal.clock = &fakeClock;
+  hal.gpio = &hx711;
+}
+
+void tearDown() {
+  detachInterrupt(DOUT_PIN);
+  hal = saved;
+}
+
+void test_ring_keeps_order_across_index_wrap() {
+  RingBuffer<int, 8> ring;
+  int next = 0;
+  int expected = 0;
+  for (int round = 0; round < 100; round++) {
+    for (int i = 0; i < 5; i++) {
+      TEST_ASSERT_TRUE(ring.push(next++));
+    }
+    int item = -1;
+    for (int i = 0; i < 5; i++) {
+      TEST_ASSERT_TRUE(ring.pop(item));
+      TEST_ASSERT_EQUAL(expected++, item);
+    }
+  }
+  TEST_ASSERT_TRUE(ring.empty());
+  TEST_ASSERT_EQUAL(0, ring.overflows());
+}
+
+void test_ring_counts_overflows() {
+  RingBuffer<int, 4> ring;
+  for (int i = 0; i < 7; i++) {
+    ring.push(i);
+  }
+  TEST_ASSERT_EQUAL(4, ring.size());
+  TEST_ASSERT_EQUAL(3, ring.overflows());
+  int item = -1;
+  ring.pop(item);
+  TEST_ASSERT_EQUAL(0, item);       // the oldest stay, the newest are the ones dropped
+  TEST_ASSERT_TRUE(ring.push(99));
+  TEST_ASSERT_EQUAL(3, ring.overflows());
+}
+
+void test_decode_sign_extends() {
+  TEST_ASSERT_EQUAL(0, HX711Sampler::decode(0x000000));
+  TEST_ASSERT_EQUAL(1, HX711Sampler::decode(0x000001));
+  TEST_ASSERT_EQUAL(8388607, HX711Sampler::decode(0x7FFFFF));
+  TEST_ASSERT_EQUAL(-8388608, HX711Sampler::decode(0x800000));
+  TEST_ASSERT_EQUAL(-1, HX711Sampler::decode(0xFFFFFF));
+  TEST_ASSERT_EQUAL(-1, HX711Sampler::decode(0xAAFFFFFF));   // bits above 24 are ignored
+}
+
+void test_poll_clocks_out_reading() {
+  HX711Sampler sampler(DOUT_PIN, SCK_PIN);
+  sampler.begin(false);
+  TEST_ASSERT_FALSE(sampler.poll());   // nothing ready yet
+  fakeClock.now = 5000000;
+  hx711.convert(0xFFF830);            // -2000
+  TEST_ASSERT_TRUE(sampler.poll());
+  ScaleSample sample;
+  TEST_ASSERT_TRUE(sampler.read(sample));
+  TEST_ASSERT_EQUAL(-2000, sample.value);
+  TEST_ASSERT_EQUAL(5000, sample.time);
+  TEST_ASSERT_FALSE(sampler.read(sample));
+  TEST_ASSERT_FALSE(sampler.poll());   // DOUT is high again until the next conversion
+}
+
+void test_gain_selects_extra_pulses() {
+  const uint8_t gains[] = { 128, 32, 64 };
+  for (uint8_t i = 0; i < 3; i++) {
+    HX711Sampler sampler(DOUT_PIN, SCK_PIN, gains[i]);
+    sampler.begin(false);
+    hx711.convert(1);
+    sampler.poll();
+    hx711.convert(1);
+    TEST_ASSERT_EQUAL(25 + i, hx711.lastPulses);
+  }
+}
+
+void test_interrupt_fills_ring() {
+  HX711Sampler sampler(DOUT_PIN, SCK_PIN);
+  sampler.begin(true);
+  hx711.interrupts = true;
+  for (long i = 0; i < 10; i++) {
+    hx711.convert((uint32_t)(i * 1000 - 5000));
+    hx711.dout = 1;
+    halPinChanged(DOUT_PIN, 1);
+  }
+  TEST_ASSERT_EQUAL(10, sampler.available());
+  ScaleSample sample;
+  for (long i = 0; i < 10; i++) {
+    TEST_ASSERT_TRUE(sampler.read(sample));
+    TEST_ASSERT_EQUAL(i * 1000 - 5000, sample.value);
+  }
+}
+
+// at 80 SPS a stall of more than HX711_SAMPLE_BUFFER conversions loses the newest ones and says how many
+void test_stalled_loop_drops_and_counts() {
+  HX711Sampler sampler(DOUT_PIN, SCK_PIN);
+  sampler.begin(true);
+  hx711.interrupts = true;
+  const int conversions = HX711_SAMPLE_BUFFER + 8;
+  for (int i = 0; i < conversions; i++) {
+    fakeClock.now += 12500;
+    hx711.convert(i);
+    hx711.dout = 1;
+    halPinChanged(DOUT_PIN, 1);
+  }
+  TEST_ASSERT_EQUAL(HX711_SAMPLE_BUFFER, sampler.available());
+  TEST_ASSERT_EQUAL(8, sampler.overflows());
+  ScaleSample sample;
+  long expected = 0;
+  while (sampler.read(sample)) {
+    TEST_ASSERT_EQUAL(expected++, sample.value);
+  }
+  TEST_ASSERT_EQUAL(HX711_SAMPLE_BUFFER, expected);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_ring_keeps_order_across_index_wrap);
+  RUN_TEST(test_ring_counts_overflows);
+  RUN_TEST(test_decode_sign_extends);
+  RUN_TEST(test_poll_clocks_out_reading);
+  RUN_TEST(test_gain_selects_extra_pulses);
+  RUN_TEST(test_interrupt_fills_ring);
+  RUN_TEST(test_stalled_loop_drops_and_counts);
+  return UNITY_END();
+}
@@ -0,0 +1,187 @@
+// The JSON readings go out as: exact bytes for singles, arrays and NDJSON,
+// escaping, the fixed buffer, the bodies jsonPOST's ArduinoJson document made,
+// and heap use and time per message.
+#include <Arduino.h>
+#include "JsonReadingEncoder.h"
+#include "JsonWriter.h"
+#include "HttpUploader.h"
+#include "../support/StringPrint.h"
+#include <unity.h>
+#include <chrono>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// every heap allocation in the process, so a path's share can be measured
+static unsigned long allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = malloc(size ? size : 1);
+  if (!p) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+  free(p);
+}
+
+static const char *foodName(uint16_t food) {
+  switch (food) {
+  case 1: return "Rice";
+  case 2: return "Tea \"Earl Grey\" \\ loose";
+  case 3: return "Line\nbreak\x01";
+  default: return "Unknown";
+  }
+}
+
+static Reading reading(uint32_t seq, int32_t weight, uint16_t food, bool epoch) {
+  Reading r = { seq, epoch ? 1700000000123ULL : 81234ULL, weight, food, (uint8_t)(epoch ? READING_EPOCH : 0) };
+  return r;
+}
+
+static std::string encode(JsonReadingEncoder &encoder, const Reading *readings, uint8_t count) {
+  StringPrint out;
+  CountingPrint length;
+  size_t written = encoder.begin(count, out);
+  encoder.begin(count, length);
+  for (uint8_t i = 0; i < count; i++) {
+    written += encoder.item(readings[i], i, count, out);
+    encoder.item(readings[i], i, count, length);
+  }
+  written += encoder.end(count, out);
+  encoder.end(count, length);
+  // the uploader takes Content-Length from a counting pass, it has to agree with what is sent
+  TEST_ASSERT_EQUAL(out.text.size(), written);
+  TEST_ASSERT_EQUAL(out.text.size(), length.count());
+  return out.text;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_single_reading_is_bare_object() {
+  JsonReadingEncoder encoder(foodName);
+  Reading r = reading(42, -1250, 1, true);
+  TEST_ASSERT_EQUAL_STRING("application/json", encoder.contentType());
+  std::string body = encode(encoder, &r, 1);
+  TEST_ASSERT_EQUAL_STRING("{\"timestamp\":1700000000123,\"seq\":42,\"weight\":\"-1250\",\"foodtype\":\"Rice\"}", body.c_str());
+}
+
+void test_reading_before_sync_has_uptime() {
+  JsonReadingEncoder encoder(foodName);
+  Reading r = reading(0, 0, 9, false);
+  std::string body = encode(encoder, &r, 1);
+  TEST_ASSERT_EQUAL_STRING("{\"uptime\":81234,\"seq\":0,\"weight\":\"0\",\"foodtype\":\"Unknown\"}", body.c_str());
+}
+
+void test_batch_is_array() {
+  JsonReadingEncoder encoder(foodName);
+  Reading r[] = { reading(1, 10, 1, true), reading(2, 20, 9, false) };
+  std::string body = encode(encoder, r, 2);
+  TEST_ASSERT_EQUAL_STRING("[{\"timestamp\":1700000000123,\"seq\":1,\"weight\":\"10\",\"foodtype\":\"Rice\"},"
+                           "{\"uptime\":81234,\"seq\":2,\"weight\":\"20\",\"foodtype\":\"Unknown\"}]", body.c_str());
+}
+
+void test_ndjson_is_one_object_per_line() {
+  JsonReadingEncoder encoder(foodName, true);
+  Reading r[] = { reading(1, 10, 1, true), reading(2, 20, 1, true) };
+  TEST_ASSERT_EQUAL_STRING("application/x-ndjson", encoder.contentType());
+  std::string body = encode(encoder, r, 2);
+  TEST_ASSERT_EQUAL_STRING("{\"timestamp\":1700000000123,\"seq\":1,\"weight\":\"10\",\"foodtype\":\"Rice\"}\n"
+                           "{\"timestamp\":1700000000123,\"seq\":2,\"weight\":\"20\",\"foodtype\":\"Rice\"}\n", body.c_str());
+}
+
+void test_names_are_escaped() {
+  StringPrint out;
+  jsonWriteString(out, foodName(2));
+  TEST_ASSERT_EQUAL_STRING("\"Tea \\\"Earl Grey\\\" \\\\ loose\"", out.text.c_str());
+  out.text.clear();
+  jsonWriteString(out, foodName(3));
+  TEST_ASSERT_EQUAL_STRING("\"Line\\u000abreak\\u0001\"", out.text.c_str());
+}
+
+void test_number_limits() {
+  StringPrint out;
+  jsonWriteSigned(out, (int32_t)0x80000000);
+  out.write(' ');
+  jsonWriteSigned(out, 2147483647);
+  out.write(' ');
+  jsonWriteUnsigned(out, 18446744073709551615ULL);
+  TEST_ASSERT_EQUAL_STRING("-2147483648 2147483647 18446744073709551615", out.text.c_str());
+}
+
+void test_buffer_print_truncates_and_says_so() {
+  char buffer[16];
+  BufferPrint fits(buffer, sizeof(buffer));
+  fits.print("0123456789abcde");
+  TEST_ASSERT_FALSE(fits.overflowed());
+  TEST_ASSERT_EQUAL_STRING("0123456789abcde", buffer);
+  BufferPrint full(buffer, sizeof(buffer));
+  TEST_ASSERT_EQUAL(15, full.print("0123456789abcdef"));
+  TEST_ASSERT_TRUE(full.overflowed());
+  TEST_ASSERT_EQUAL(15, full.length());
+  TEST_ASSERT_EQUAL_STRING("0123456789abcde", buffer);
+}
+
+static const long messages = 100000;
+
+// Host figures per message, printed for comparison and asserted only where
+// they are a property of the code rather than of the machine
+void test_encoder_allocates_nothing() {
+  JsonReadingEncoder encoder(foodName);
+  char buffer[128];
+  unsigned long before = allocations;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (long i = 0; i < messages; i++) {
+    BufferPrint out(buffer, sizeof(buffer));
+    encoder.item(reading((uint32_t)i, (int32_t)(i * 7 - 5000), 1, true), 0, 1, out);
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / messages;
+  char message[96];
+  snprintf(message, sizeof(message), "JsonReadingEncoder: %.1f ns and %.2f allocations per message",
+           ns, (double)(allocations - before) / messages);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_EQUAL(0, allocations - before);
+}
+
+// the bodies the collector got from jsonPOST, whose StaticJsonDocument serialized
+// timestamp, seq, weight as a string and foodtype in that order
+void test_matches_arduinojson_bodies() {
+  struct { int32_t weight; uint16_t food; const char *body; } cases[] = {
+    { -3000, 1, "{\"timestamp\":1700000000123,\"seq\":2000,\"weight\":\"-3000\",\"foodtype\":\"Rice\"}" },
+    { 0, 2, "{\"timestamp\":1700000000123,\"seq\":5000,\"weight\":\"0\",\"foodtype\":\"Tea \\\"Earl Grey\\\" \\\\ loose\"}" },
+    { 77, 1, "{\"timestamp\":1700000000123,\"seq\":5077,\"weight\":\"77\",\"foodtype\":\"Rice\"}" },
+    { 2147483647, 2, "{\"timestamp\":1700000000123,\"seq\":2147488647,\"weight\":\"2147483647\",\"foodtype\":\"Tea \\\"Earl Grey\\\" \\\\ loose\"}" },
+  };
+  JsonReadingEncoder encoder(foodName);
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    Reading r = reading((uint32_t)cases[c].weight + 5000, cases[c].weight, cases[c].food, true);
+    std::string body = encode(encoder, &r, 1);
+    TEST_ASSERT_EQUAL_STRING(cases[c].body, body.c_str());
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_single_reading_is_bare_object);
+  RUN_TEST(test_reading_before_sync_has_uptime);
+  RUN_TEST(test_batch_is_array);
+  RUN_TEST(test_ndjson_is_one_object_per_line);
+  RUN_TEST(test_names_are_escaped);
+  RUN_TEST(test_number_limits);
+  RUN_TEST(test_buffer_print_truncates_and_says_so);
+  RUN_TEST(test_encoder_allocates_nothing);
+  RUN_TEST(test_matches_arduinojson_bodies);
+  return UNITY_END();
+}
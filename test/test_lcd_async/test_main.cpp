@@ -0,0 +1,145 @@
+// The queued LCD mode: nothing touches the bus outside tick(), each tick stays
+// within its budget and slow commands are waited out on the clock, not in a delay.
+#include <Arduino.h>
+#include <Hal.h>
+#include <LiquidCrystal_I2C.h>
+#include "../support/RecordingI2c.h"
+#include <unity.h>
+#include <vector>
+
+static FakeClock fakeClock;
+static RecordingI2c bus;
+static HalDevices saved;
+
+void setUp() {
+  saved = hal;
+  fakeClock.now = 0;
+  fakeClock.slept = 0;
+  bus.clock = &fakeClock;
+  bus.log.clear();
+  hal.clock = &fakeClock;
+  hal.i2c = &bus;
+}
+
+void tearDown() {
+  hal = saved;
+}
+
+// one loop() pass every stepUs until the queue is empty, returns the number of ticks
+static int drain(LiquidCrystal_I2C &lcd, uint16_t budgetUs, uint32_t stepUs) {
+  int ticks = 0;
+  while (lcd.tick(budgetUs)) {
+    fakeClock.now += stepUs;
+    ticks++;
+    TEST_ASSERT_LESS_THAN(100000, ticks);
+  }
+  return ticks;
+}
+
+static void startLcd(LiquidCrystal_I2C &lcd) {
+  lcd.setAsync(true);
+  lcd.init();
+  drain(lcd, 2000, 1000);
+  bus.log.clear();
+}
+
+void test_init_does_not_block() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  lcd.setAsync(true);
+  lcd.init();
+  TEST_ASSERT_EQUAL(0, bus.log.size());
+  TEST_ASSERT_EQUAL(0, fakeClock.slept);
+  drain(lcd, 2000, 500);
+  TEST_ASSERT_EQUAL(0, fakeClock.slept);
+  TEST_ASSERT_TRUE(lcd.idle());
+  // the 40ms power on wait still separates the expander reset from the first nibble
+  TEST_ASSERT_GREATER_THAN(1, bus.log.size());
+  TEST_ASSERT_GREATER_OR_EQUAL(50000, bus.log[1].at - bus.log[1].bytes.size() * LCD_I2C_BYTE_US - bus.log[0].at);
+}
+
+void test_writes_wait_for_tick() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.setCursor(0, 0);
+  lcd.print("Queued");
+  TEST_ASSERT_EQUAL(0, bus.log.size());
+  TEST_ASSERT_FALSE(lcd.idle());
+  drain(lcd, 2000, 100);
+  TEST_ASSERT_EQUAL(7 * 6, bus.bytes());
+}
+
+void test_tick_stays_within_budget() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  for (uint8_t row = 0; row < 2; row++) {
+    lcd.setCursor(0, row);
+    lcd.print("0123456789abcdef");
+  }
+  const uint16_t budget = 1000;
+  int ticks = 0;
+  while (lcd.tick(budget)) {
+    fakeClock.now += 100;
+    ticks++;
+  }
+  // one op may start below the budget and end past it
+  for (size_t i = 0; i < bus.log.size(); i++) {
+    TEST_ASSERT_LESS_OR_EQUAL(budget / LCD_I2C_BYTE_US + 5, bus.log[i].bytes.size());
+  }
+  TEST_ASSERT_EQUAL(2 * 17 * 6, bus.bytes());
+  TEST_ASSERT_GREATER_OR_EQUAL((2 * 17 * 6) / (budget / LCD_I2C_BYTE_US + 5), ticks);
+}
+
+void test_clear_waits_on_the_clock() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.clear();
+  lcd.print("X");
+  TEST_ASSERT_TRUE(lcd.tick());
+  TEST_ASSERT_EQUAL(1, bus.log.size());
+  uint64_t cleared = fakeClock.now;
+  // still executing, the next tick sends nothing and doesn't wait either
+  fakeClock.now += 1000;
+  TEST_ASSERT_TRUE(lcd.tick());
+  TEST_ASSERT_EQUAL(1, bus.log.size());
+  TEST_ASSERT_EQUAL(cleared + 1000, fakeClock.now);
+  fakeClock.now += 1000;
+  lcd.tick();
+  TEST_ASSERT_EQUAL(2, bus.log.size());
+  TEST_ASSERT_FALSE(lcd.tick());
+  TEST_ASSERT_EQUAL(0, fakeClock.slept);
+}
+
+// a run of characters that doesn't fit in what is left of a tick waits for the next one
+void test_run_is_not_split_across_ticks() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.setCursor(0, 0);
+  lcd.print("abcd");
+  lcd.setCursor(0, 1);
+  lcd.print("efgh");
+  lcd.tick(7 * 6 * LCD_I2C_BYTE_US);
+  TEST_ASSERT_EQUAL(5 * 6, bus.bytes());
+  lcd.tick(7 * 6 * LCD_I2C_BYTE_US);
+  TEST_ASSERT_EQUAL(10 * 6, bus.bytes());
+}
+
+void test_leaving_async_drains_queue() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.home();
+  lcd.print("Done");
+  lcd.setAsync(false);
+  TEST_ASSERT_TRUE(lcd.idle());
+  TEST_ASSERT_EQUAL(5 * 6, bus.bytes());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_init_does_not_block);
+  RUN_TEST(test_writes_wait_for_tick);
+  RUN_TEST(test_tick_stays_within_budget);
+  RUN_TEST(test_clear_waits_on_the_clock);
+  RUN_TEST(test_run_is_not_split_across_ticks);
+  RUN_TEST(test_leaving_async_drains_queue);
+  return UNITY_END();
+}
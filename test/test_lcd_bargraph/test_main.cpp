@@ -0,0 +1,183 @@
+// Bar graphs on an HD44780 model: what every cell shows at every fill level
+// across and upwards, the boundary where the partly lit cell appears and
+// goes, and the whole-cell fallback when no CGRAM slot can be had.
+#include <Arduino.h>
+#include <Hal.h>
+#include <LiquidCrystal_I2C.h>
+#include "../support/LcdModel.h"
+#include <unity.h>
+#include <string.h>
+
+static FakeClock fakeClock;
+static ModelI2c bus;
+static Hd44780 controller;
+static HalDevices saved;
+
+static const uint8_t fullRow = 0x1f;
+
+void setUp() {
+  saved = hal;
+  fakeClock.now = 0;
+  bus.model = 0;
+  controller.reset();
+  hal.clock = &fakeClock;
+  hal.i2c = &bus;
+}
+
+void tearDown() {
+  hal = saved;
+}
+
+static void startLcd(LiquidCrystal_I2C &lcd) {
+  lcd.init();
+  lcd.backlight();
+  bus.model = &controller;
+  lcd.setBuffered(true);
+}
+
+// the pixel rows a cell lights, from the ROM for blank and full block or from CGRAM
+static void cellPixels(uint8_t address, uint8_t *pixels) {
+  const uint8_t *bitmap = controller.bitmapAt(address);
+  uint8_t c = controller.ddram[address];
+  TEST_ASSERT_TRUE(bitmap || c == ' ' || c == LCD_FULL_BLOCK);
+  for (uint8_t line = 0; line < 8; line++) {
+    pixels[line] = bitmap ? bitmap[line] : c == LCD_FULL_BLOCK ? fullRow : 0;
+  }
+}
+
+// columns lit from the left in every pixel row of the cell
+static uint8_t litAcross(uint8_t address) {
+  uint8_t pixels[8];
+  cellPixels(address, pixels);
+  for (uint8_t line = 1; line < 8; line++) {
+    TEST_ASSERT_EQUAL_HEX8(pixels[0], pixels[line]);
+  }
+  uint8_t lit = 0;
+  while (lit < 5 && (pixels[0] & (0x10 >> lit))) {
+    lit++;
+  }
+  TEST_ASSERT_EQUAL_HEX8((0x1f << (5 - lit)) & 0x1f, pixels[0]);
+  return lit;
+}
+
+// whole pixel rows lit from the bottom of the cell
+static uint8_t litUpwards(uint8_t address) {
+  uint8_t pixels[8];
+  cellPixels(address, pixels);
+  uint8_t lit = 0;
+  while (lit < 8 && pixels[7 - lit] == fullRow) {
+    lit++;
+  }
+  for (uint8_t line = 0; line < 8 - lit; line++) {
+    TEST_ASSERT_EQUAL_HEX8(0, pixels[line]);
+  }
+  return lit;
+}
+
+// 10 cells on row 1 from column 3, every level from empty to full and one past it
+void test_horizontal_every_level() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  const uint8_t len = 10;
+  for (int pixels = 0; pixels <= len * 5 + 1; pixels++) {
+    lcd.draw_horizontal_graph(1, 3, len, (uint8_t)pixels);
+    lcd.flush();
+    int total = 0;
+    for (uint8_t i = 0; i < len; i++) {
+      int expected = pixels - i * 5;
+      expected = expected < 0 ? 0 : expected > 5 ? 5 : expected;
+      TEST_ASSERT_EQUAL(expected, litAcross(0x40 + 3 + i));
+      total += expected;
+    }
+    TEST_ASSERT_EQUAL(pixels < len * 5 ? pixels : len * 5, total);
+    // the cells around the bar are left alone
+    TEST_ASSERT_EQUAL(' ', controller.ddram[0x40 + 2]);
+    TEST_ASSERT_EQUAL(' ', controller.ddram[0x40 + 3 + len]);
+  }
+}
+
+// a 4 cell bar growing up from row 3 of a 20x4, every level
+void test_vertical_every_level() {
+  LiquidCrystal_I2C lcd(0x27, 20, 4);
+  startLcd(lcd);
+  const uint8_t len = 4;
+  const uint8_t rowAddress[4] = { 0x00, 0x40, 0x14, 0x54 };
+  for (int pixels = 0; pixels <= len * 8; pixels++) {
+    lcd.draw_vertical_graph(3, 7, len, (uint8_t)pixels);
+    lcd.flush();
+    for (uint8_t i = 0; i < len; i++) {
+      int expected = pixels - i * 8;
+      expected = expected < 0 ? 0 : expected > 8 ? 8 : expected;
+      TEST_ASSERT_EQUAL(expected, litUpwards(rowAddress[3 - i] + 7));
+    }
+  }
+}
+
+// at a whole number of cells there is no partly lit cell, one pixel more needs a glyph
+// and one less takes the last full cell down to a glyph, the next cell stays blank
+void test_partial_cell_boundary() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.draw_horizontal_graph(0, 0, 8, 15);
+  lcd.flush();
+  for (uint8_t i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(LCD_FULL_BLOCK, controller.ddram[i]);
+  }
+  TEST_ASSERT_EQUAL(' ', controller.ddram[3]);
+  TEST_ASSERT_EQUAL(0, controller.uploads);
+
+  lcd.draw_horizontal_graph(0, 0, 8, 16);
+  lcd.flush();
+  TEST_ASSERT_EQUAL(1, controller.uploads);
+  TEST_ASSERT_EQUAL(LCD_FULL_BLOCK, controller.ddram[2]);
+  TEST_ASSERT_EQUAL(1, litAcross(3));
+  TEST_ASSERT_EQUAL(' ', controller.ddram[4]);
+
+  lcd.draw_horizontal_graph(0, 0, 8, 14);
+  lcd.flush();
+  TEST_ASSERT_EQUAL(4, litAcross(2));
+  TEST_ASSERT_EQUAL(' ', controller.ddram[3]);
+
+  // full and beyond, every cell is the ROM's full block
+  lcd.draw_horizontal_graph(0, 0, 8, 40);
+  lcd.flush();
+  lcd.draw_horizontal_graph(0, 0, 8, 255);
+  lcd.flush();
+  for (uint8_t i = 0; i < 8; i++) {
+    TEST_ASSERT_EQUAL(LCD_FULL_BLOCK, controller.ddram[i]);
+  }
+  TEST_ASSERT_EQUAL(' ', controller.ddram[8]);
+}
+
+// every slot pinned by createChar(): the partly lit cell rounds to blank or a full block
+void test_no_free_slot_rounds_to_a_whole_cell() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  uint8_t icon[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+  for (uint8_t slot = 0; slot < 8; slot++) {
+    lcd.createChar(slot, icon);
+  }
+  int uploads = controller.uploads;
+  for (uint8_t lit = 1; lit < 5; lit++) {
+    lcd.draw_horizontal_graph(0, 0, 4, (uint8_t)(5 + lit));
+    lcd.flush();
+    TEST_ASSERT_EQUAL(LCD_FULL_BLOCK, controller.ddram[0]);
+    TEST_ASSERT_EQUAL(lit >= 3 ? LCD_FULL_BLOCK : ' ', controller.ddram[1]);
+  }
+  for (uint8_t lit = 1; lit < 8; lit++) {
+    lcd.draw_vertical_graph(1, 15, 1, lit);
+    lcd.flush();
+    TEST_ASSERT_EQUAL(lit >= 4 ? LCD_FULL_BLOCK : ' ', controller.ddram[0x40 + 15]);
+  }
+  TEST_ASSERT_EQUAL(uploads, controller.uploads);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(icon, &controller.cgram[7 * 8], 8);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_horizontal_every_level);
+  RUN_TEST(test_vertical_every_level);
+  RUN_TEST(test_partial_cell_boundary);
+  RUN_TEST(test_no_free_slot_rounds_to_a_whole_cell);
+  return UNITY_END();
+}
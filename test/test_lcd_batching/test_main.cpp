@@ -0,0 +1,122 @@
+// PCF8574 batching in LiquidCrystal_I2C: how many I2C transactions a write costs
+// and that the HD44780 still latches the right bytes out of them.
+#include <Arduino.h>
+#include <Hal.h>
+#include <LiquidCrystal_I2C.h>
+#include "../support/LcdModel.h"
+#include <unity.h>
+#include <vector>
+
+static FakeClock fakeClock;
+static RecordingI2c bus;
+static HalDevices saved;
+
+void setUp() {
+  saved = hal;
+  fakeClock.now = 0;
+  bus.clock = &fakeClock;
+  bus.log.clear();
+  hal.clock = &fakeClock;
+  hal.i2c = &bus;
+}
+
+void tearDown() {
+  hal = saved;
+}
+
+static void startLcd(LiquidCrystal_I2C &lcd) {
+  lcd.init();
+  lcd.backlight();
+  bus.log.clear();
+}
+
+void test_character_is_one_transaction() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.write('A');
+  TEST_ASSERT_EQUAL(1, bus.log.size());
+  // both nibbles with an enable pulse each: data, En high, En low
+  TEST_ASSERT_EQUAL(6, bus.log[0].bytes.size());
+  TEST_ASSERT_EQUAL_HEX8(0x27, bus.log[0].address);
+}
+
+void test_string_shares_transactions() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.print("Hello, scale!");
+  size_t bytes = 13 * 6;
+  TEST_ASSERT_EQUAL(bytes, bus.bytes());
+  TEST_ASSERT_EQUAL((bytes + LCD_TX_BUFFER - 1) / LCD_TX_BUFFER, bus.log.size());
+}
+
+void test_batch_splits_at_wire_buffer() {
+  LiquidCrystal_I2C lcd(0x27, 20, 4);
+  startLcd(lcd);
+  lcd.beginBatch();
+  for (uint8_t row = 0; row < 4; row++) {
+    lcd.setCursor(0, row);
+    lcd.print("01234567890123456789");
+  }
+  TEST_ASSERT_EQUAL(LCD_TX_BUFFER * (4 * 21 * 6 / LCD_TX_BUFFER), bus.bytes());
+  lcd.endBatch();
+  TEST_ASSERT_EQUAL(4 * 21 * 6, bus.bytes());
+  TEST_ASSERT_EQUAL((4 * 21 * 6 + LCD_TX_BUFFER - 1) / LCD_TX_BUFFER, bus.log.size());
+  for (size_t i = 0; i < bus.log.size(); i++) {
+    TEST_ASSERT_LESS_OR_EQUAL(LCD_TX_BUFFER, bus.log[i].bytes.size());
+  }
+}
+
+void test_batched_bytes_decode() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.setCursor(3, 1);
+  lcd.print("Tea");
+  Hd44780 controller;
+  controller.run(bus.log);
+  const std::vector<LcdByte> &bytes = controller.latched;
+  TEST_ASSERT_EQUAL(4, bytes.size());
+  TEST_ASSERT_FALSE(bytes[0].rs);
+  TEST_ASSERT_EQUAL_HEX8(LCD_SETDDRAMADDR | 0x43, bytes[0].value);
+  const char *text = "Tea";
+  for (uint8_t i = 0; i < 3; i++) {
+    TEST_ASSERT_TRUE(bytes[i + 1].rs);
+    TEST_ASSERT_EQUAL_HEX8(text[i], bytes[i + 1].value);
+  }
+}
+
+void test_backlight_on_every_byte() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.print("On");
+  for (size_t t = 0; t < bus.log.size(); t++) {
+    for (size_t i = 0; i < bus.log[t].bytes.size(); i++) {
+      TEST_ASSERT_EQUAL_HEX8(LCD_BACKLIGHT, bus.log[t].bytes[i] & LCD_BACKLIGHT);
+    }
+  }
+}
+
+// clear takes 1.52ms, the wait has to start once it is on the bus even inside a batch
+void test_slow_command_flushes_batch() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.beginBatch();
+  lcd.print("A");
+  lcd.clear();
+  lcd.print("B");
+  lcd.endBatch();
+  TEST_ASSERT_EQUAL(2, bus.log.size());
+  TEST_ASSERT_EQUAL(12, bus.log[0].bytes.size());
+  uint64_t gap = bus.log[1].at - bus.log[1].bytes.size() * bus.byteUs - bus.log[0].at;
+  TEST_ASSERT_GREATER_OR_EQUAL(1520, gap);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_character_is_one_transaction);
+  RUN_TEST(test_string_shares_transactions);
+  RUN_TEST(test_batch_splits_at_wire_buffer);
+  RUN_TEST(test_batched_bytes_decode);
+  RUN_TEST(test_backlight_on_every_byte);
+  RUN_TEST(test_slow_command_flushes_batch);
+  return UNITY_END();
+}
@@ -0,0 +1,167 @@
+// The shadow framebuffer behind setBuffered()/flush(), decoded on an HD44780
+// model: only changed cells go out, nearby changes share one address, and the
+// screen always ends up showing the frame.
+#include <Arduino.h>
+#include <Hal.h>
+#include <LiquidCrystal_I2C.h>
+#include "../support/LcdModel.h"
+#include <unity.h>
+#include <stdlib.h>
+#include <string>
+
+static FakeClock fakeClock;
+static ModelI2c bus;
+static Hd44780 controller;
+static HalDevices saved;
+
+void setUp() {
+  saved = hal;
+  fakeClock.now = 0;
+  bus.model = 0;
+  controller.reset();
+  hal.clock = &fakeClock;
+  hal.i2c = &bus;
+}
+
+void tearDown() {
+  hal = saved;
+}
+
+static void startLcd(LiquidCrystal_I2C &lcd) {
+  lcd.init();
+  lcd.backlight();
+  bus.model = &controller;
+  lcd.setBuffered(true);
+}
+
+// bytes the last flush() latched, and the address sets among them
+static size_t flushed(LiquidCrystal_I2C &lcd, int &addressSets) {
+  size_t before = controller.latched.size();
+  int sets = controller.addressSets;
+  lcd.flush();
+  addressSets = controller.addressSets - sets;
+  return controller.latched.size() - before;
+}
+
+void test_unchanged_frame_sends_nothing() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.print("Food = Coffee");
+  int sets;
+  TEST_ASSERT_EQUAL(1 + 13, flushed(lcd, sets));
+  TEST_ASSERT_EQUAL(1, sets);
+  // the same text drawn again is already on the screen
+  lcd.setCursor(0, 0);
+  lcd.print("Food = Coffee");
+  TEST_ASSERT_EQUAL(0, flushed(lcd, sets));
+  TEST_ASSERT_TRUE(controller.row(16, 0) == "Food = Coffee   ");
+}
+
+// one unchanged cell between two changes is resent, two start a new run
+void test_runs_bridge_a_single_unchanged_cell() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.print("0123456789");
+  int sets;
+  flushed(lcd, sets);
+  lcd.setCursor(2, 0);
+  lcd.print("x");
+  lcd.setCursor(4, 0);
+  lcd.print("y");
+  TEST_ASSERT_EQUAL(1 + 3, flushed(lcd, sets));
+  TEST_ASSERT_EQUAL(1, sets);
+  lcd.setCursor(2, 0);
+  lcd.print("a");
+  lcd.setCursor(5, 0);
+  lcd.print("b");
+  TEST_ASSERT_EQUAL(2 * (1 + 1), flushed(lcd, sets));
+  TEST_ASSERT_EQUAL(2, sets);
+  TEST_ASSERT_TRUE(controller.row(16, 0) == "01a3yb6789      ");
+}
+
+// a buffered clear() only blanks what was showing, it doesn't send the slow LCD_CLEARDISPLAY
+void test_buffered_clear_blanks_only_drawn_cells() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.setCursor(3, 1);
+  lcd.print("12.5g");
+  int sets;
+  flushed(lcd, sets);
+  lcd.clear();
+  TEST_ASSERT_EQUAL(1 + 5, flushed(lcd, sets));
+  for (size_t i = 0; i < controller.latched.size(); i++) {
+    TEST_ASSERT_FALSE(!controller.latched[i].rs && controller.latched[i].value == LCD_CLEARDISPLAY);
+  }
+  TEST_ASSERT_TRUE(controller.row(16, 1) == "                ");
+}
+
+// after drawing unbuffered nothing is known about the screen, the next flush sends every cell
+void test_unbuffered_drawing_forces_a_full_redraw() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.print("kept");
+  int sets;
+  flushed(lcd, sets);
+  lcd.setBuffered(false);
+  lcd.setCursor(0, 1);
+  lcd.print("stray");
+  lcd.setBuffered(true);
+  TEST_ASSERT_EQUAL(2 * (1 + 16), flushed(lcd, sets));
+  TEST_ASSERT_TRUE(controller.row(16, 0) == "kept            ");
+  TEST_ASSERT_TRUE(controller.row(16, 1) == "                ");
+}
+
+// with the address counter walking backwards every changed cell is addressed on its own
+void test_right_to_left_addresses_each_cell() {
+  LiquidCrystal_I2C lcd(0x27, 16, 2);
+  startLcd(lcd);
+  lcd.rightToLeft();
+  lcd.print("abc");
+  int sets;
+  TEST_ASSERT_EQUAL(3 * 2, flushed(lcd, sets));
+  TEST_ASSERT_EQUAL(3, sets);
+  TEST_ASSERT_EQUAL('a', controller.ddram[0]);
+  TEST_ASSERT_EQUAL('c', controller.ddram[2]);
+}
+
+// random edits on a 20x4, the screen matches the frame after every flush, which costs
+// an address per run and the changed cells, plus at most one bridged cell for each
+void test_screen_follows_random_edits() {
+  LiquidCrystal_I2C lcd(0x27, 20, 4);
+  startLcd(lcd);
+  std::string expected[4];
+  for (uint8_t row = 0; row < 4; row++) {
+    expected[row] = std::string(20, ' ');
+  }
+  srand(7);
+  for (int round = 0; round < 200; round++) {
+    int changed = 0;
+    for (int edit = rand() % 4; edit >= 0; edit--) {
+      uint8_t row = (uint8_t)(rand() % 4);
+      uint8_t col = (uint8_t)(rand() % 20);
+      char c = (char)('a' + rand() % 26);
+      changed += expected[row][col] != c;
+      expected[row][col] = c;
+      lcd.setCursor(col, row);
+      lcd.write((uint8_t)c);
+    }
+    int sets;
+    size_t bytes = flushed(lcd, sets);
+    TEST_ASSERT_LESS_OR_EQUAL(changed, sets);
+    TEST_ASSERT_LESS_OR_EQUAL(sets + 2 * changed, bytes);
+    for (uint8_t row = 0; row < 4; row++) {
+      TEST_ASSERT_TRUE(controller.row(20, row) == expected[row]);
+    }
+  }
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_unchanged_frame_sends_nothing);
+  RUN_TEST(test_runs_bridge_a_single_unchanged_cell);
+  RUN_TEST(test_buffered_clear_blanks_only_drawn_cells);
+  RUN_TEST(test_unbuffered_drawing_forces_a_full_redraw);
+  RUN_TEST(test_right_to_left_addresses_each_cell);
+  RUN_TEST(test_screen_follows_random_edits);
+  return UNITY_END();
+}
@@ -0,0 +1,263 @@
+// LiquidCrystalI2C<Addr, Cols, Rows> against the run time LiquidCrystal_I2C:
+// row offsets and bounds, where text lands in DDRAM for 16x2 and 20x4, the
+// bytes each puts on the bus, and setCursor + print cost on the host.
+#include <Arduino.h>
+#include <Hal.h>
+#include <LiquidCrystal_I2C.h>
+#include "../support/LcdModel.h"
+#include <unity.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+static FakeClock fakeClock;
+static RecordingI2c bus;
+static HalDevices saved;
+
+void setUp() {
+  saved = hal;
+  fakeClock.now = 0;
+  bus.record = true;
+  bus.log.clear();
+  hal.clock = &fakeClock;
+  hal.i2c = &bus;
+}
+
+void tearDown() {
+  hal = saved;
+}
+
+template<class Lcd>
+static void startLcd(Lcd &lcd) {
+  lcd.init();
+  lcd.backlight();
+  bus.log.clear();
+}
+
+// everything about a fixed geometry is known to the compiler
+typedef LcdGeometry<0x27, 16, 2> Lcd1602;
+typedef LcdGeometry<0x3F, 20, 4> Lcd2004;
+static_assert(Lcd1602::cells() == 32 && Lcd1602::CELLS == 32, "16x2 cells");
+static_assert(Lcd1602::rowOffset(0) == 0x00 && Lcd1602::rowOffset(1) == 0x40, "16x2 rows");
+static_assert(Lcd2004::rowOffset(0) == 0x00 && Lcd2004::rowOffset(1) == 0x40, "20x4 rows 0 and 1");
+static_assert(Lcd2004::rowOffset(2) == 0x14 && Lcd2004::rowOffset(3) == 0x54, "20x4 rows 2 and 3");
+static_assert(LcdGeometry<0x27, 16, 4>::rowOffset(3) == 0x50, "16x4 row 3");
+static_assert(Lcd2004::address() == 0x3F, "address");
+
+void test_row_offsets_match_runtime() {
+  const uint8_t shapes[][2] = { { 16, 2 }, { 20, 4 }, { 16, 4 }, { 8, 1 }, { 40, 2 } };
+  for (size_t s = 0; s < sizeof(shapes) / sizeof(shapes[0]); s++) {
+    LcdRuntimeGeometry geometry(0x27, shapes[s][0], shapes[s][1]);
+    TEST_ASSERT_EQUAL(shapes[s][0] * shapes[s][1], geometry.cells());
+    for (uint8_t row = 0; row < shapes[s][1]; row++) {
+      uint8_t expected = (row & 1 ? 0x40 : 0) + (row & 2 ? shapes[s][0] : 0);
+      TEST_ASSERT_EQUAL_HEX8(expected, geometry.rowOffset(row));
+    }
+  }
+  TEST_ASSERT_EQUAL_HEX8(0x14, (LcdGeometry<0x27, 20, 4>::rowOffset(2)));
+}
+
+// rows are clamped to 1-4, a geometry bigger than DDRAM has no shadow cells
+void test_runtime_geometry_limits() {
+  LcdRuntimeGeometry none(0x27, 16, 0);
+  TEST_ASSERT_EQUAL(1, none.rows());
+  LcdRuntimeGeometry tall(0x27, 16, 9);
+  TEST_ASSERT_EQUAL(4, tall.rows());
+  LcdRuntimeGeometry wide(0x27, 40, 4);
+  TEST_ASSERT_EQUAL(0, wide.cells());
+  wide.resize(20, 4);
+  TEST_ASSERT_EQUAL(80, wide.cells());
+
+  LiquidCrystal_I2C lcd(0x27, 40, 4);
+  startLcd(lcd);
+  lcd.setBuffered(true);
+  lcd.print("nowhere to go");
+  lcd.flush();
+  TEST_ASSERT_EQUAL(0, bus.log.size());
+}
+
+// the shadow frame of a fixed geometry is exactly its cells, the run time one always holds 80
+void test_frame_is_sized_exactly() {
+  size_t fixed = sizeof(LiquidCrystalI2C<0x27, 16, 2>);
+  size_t runtime = sizeof(LiquidCrystal_I2C);
+  TEST_ASSERT_GREATER_OR_EQUAL(2 * (LCD_MAX_CELLS - 32), runtime - fixed);
+  // two frames of 80 cells against two of 32
+  TEST_ASSERT_EQUAL(2 * (80 - 32), sizeof(LiquidCrystalI2C<0x27, 20, 4>) - fixed);
+}
+
+// every cell of the display written through setCursor lands where that geometry shows it
+template<uint8_t Cols, uint8_t Rows>
+static void checkRouting() {
+  LiquidCrystalI2C<0x27, Cols, Rows> lcd;
+  startLcd(lcd);
+  for (uint8_t row = 0; row < Rows; row++) {
+    for (uint8_t col = 0; col < Cols; col++) {
+      lcd.setCursor(col, row);
+      lcd.write((uint8_t)('A' + (row * 7 + col) % 26));
+    }
+  }
+  Hd44780 controller;
+  controller.run(bus.log);
+  for (uint8_t row = 0; row < Rows; row++) {
+    std::string expected;
+    for (uint8_t col = 0; col < Cols; col++) {
+      expected += (char)('A' + (row * 7 + col) % 26);
+    }
+    std::string shown = controller.row(Cols, row);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), shown.c_str());
+  }
+}
+
+void test_cursor_routing_16x2() {
+  checkRouting<16, 2>();
+}
+
+void test_cursor_routing_20x4() {
+  checkRouting<20, 4>();
+}
+
+// row == rows is past the end as well, it goes to the last row rather than into hidden DDRAM
+void test_row_past_end_is_clamped() {
+  LiquidCrystalI2C<0x27, 16, 2> lcd;
+  startLcd(lcd);
+  lcd.setCursor(0, 2);
+  lcd.print("two");
+  lcd.setCursor(4, 200);
+  lcd.print("far");
+  Hd44780 controller;
+  controller.run(bus.log);
+  std::string shown = controller.row(16, 1);
+  TEST_ASSERT_EQUAL_STRING("two far         ", shown.c_str());
+}
+
+// the template talks to its own address, the run time class to the one it was given
+void test_address_from_template() {
+  LiquidCrystalI2C<0x3F, 20, 4> fixed;
+  startLcd(fixed);
+  fixed.print("x");
+  LiquidCrystal_I2C runtime(0x26, 20, 4);
+  startLcd(runtime);
+  runtime.print("x");
+  TEST_ASSERT_EQUAL(1, bus.log.size());
+  TEST_ASSERT_EQUAL_HEX8(0x26, bus.log[0].address);
+  bus.log.clear();
+  fixed.print("y");
+  TEST_ASSERT_EQUAL_HEX8(0x3F, bus.log[0].address);
+}
+
+template<class Lcd>
+static std::vector<Transaction> script(Lcd &lcd) {
+  bus.log.clear();
+  lcd.init();
+  lcd.backlight();
+  lcd.print("Weight");
+  lcd.setCursor(12, 1);
+  lcd.print(1234);
+  lcd.setCursor(0, 3);
+  lcd.print("row three and past the end");
+  lcd.clear();
+  lcd.setBuffered(true);
+  lcd.setCursor(2, 2);
+  lcd.print("buffered");
+  lcd.setCursor(19, 3);
+  lcd.print("<>");
+  lcd.flush();
+  lcd.setCursor(2, 2);
+  lcd.print("BUF");
+  lcd.flush();
+  return bus.log;
+}
+
+// the adapter and the template put exactly the same bytes on the bus
+void test_template_matches_adapter() {
+  LiquidCrystalI2C<0x27, 20, 4> fixed;
+  LiquidCrystal_I2C runtime(0x27, 20, 4);
+  std::vector<Transaction> a = script(fixed);
+  std::vector<Transaction> b = script(runtime);
+  TEST_ASSERT_EQUAL(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); i++) {
+    TEST_ASSERT_EQUAL(a[i].bytes.size(), b[i].bytes.size());
+    TEST_ASSERT_TRUE(a[i].bytes == b[i].bytes);
+  }
+}
+
+// flush() addresses each row's run with that row's offset and clips at the end of a row
+void test_flush_runs_per_row() {
+  LiquidCrystalI2C<0x27, 20, 4> lcd;
+  startLcd(lcd);
+  lcd.setBuffered(true);
+  for (uint8_t row = 0; row < 4; row++) {
+    lcd.setCursor(16, row);
+    lcd.print("edge+spill");
+  }
+  lcd.flush();
+  Hd44780 controller;
+  controller.run(bus.log);
+  TEST_ASSERT_EQUAL(4, controller.addressSets);
+  for (uint8_t row = 0; row < 4; row++) {
+    std::string shown = controller.row(20, row);
+    TEST_ASSERT_EQUAL_STRING("                edge", shown.c_str());
+  }
+  // one changed cell costs an address and the cell, nothing else is resent
+  bus.log.clear();
+  lcd.setCursor(17, 2);
+  lcd.print("D");
+  lcd.flush();
+  Hd44780 again;
+  again.run(bus.log);
+  TEST_ASSERT_EQUAL(1, again.addressSets);
+  TEST_ASSERT_EQUAL('D', again.ddram[0x14 + 17]);
+}
+
+// setCursor + print of a short field, the way the firmware redraws the weight, bus writes left out
+// best of three so the first one measured doesn't pay for warming up
+template<class Lcd>
+static double redrawNs(Lcd &lcd, int rounds) {
+  double best = 1e9;
+  for (int pass = 0; pass < 3; pass++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; i++) {
+      lcd.setCursor(i & 7, i & 1);
+      lcd.print("123.4g");
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / rounds;
+    best = ns < best ? ns : best;
+  }
+  return best;
+}
+
+void test_redraw_benchmark() {
+  LiquidCrystalI2C<0x27, 16, 2> fixed;
+  LiquidCrystal_I2C runtime(0x27, 16, 2);
+  startLcd(fixed);
+  startLcd(runtime);
+  bus.record = false;
+  const int rounds = 200000;
+  fixed.setBuffered(true);
+  runtime.setBuffered(true);
+  double fixedBuffered = redrawNs(fixed, rounds);
+  double runtimeBuffered = redrawNs(runtime, rounds);
+  fixed.setBuffered(false);
+  runtime.setBuffered(false);
+  double fixedDirect = redrawNs(fixed, rounds / 10);
+  double runtimeDirect = redrawNs(runtime, rounds / 10);
+  char message[160];
+  snprintf(message, sizeof(message), "setCursor + print(\"123.4g\"), template/run time: buffered %.1f/%.1f ns, to the bus %.0f/%.0f ns on the host",
+           fixedBuffered, runtimeBuffered, fixedDirect, runtimeDirect);
+  TEST_MESSAGE(message);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_row_offsets_match_runtime);
+  RUN_TEST(test_runtime_geometry_limits);
+  RUN_TEST(test_frame_is_sized_exactly);
+  RUN_TEST(test_cursor_routing_16x2);
+  RUN_TEST(test_cursor_routing_20x4);
+  RUN_TEST(test_row_past_end_is_clamped);
+  RUN_TEST(test_address_from_template);
+  RUN_TEST(test_template_matches_adapter);
+  RUN_TEST(test_flush_runs_per_row);
+  RUN_TEST(test_redraw_benchmark);
+  return UNITY_END();
+}
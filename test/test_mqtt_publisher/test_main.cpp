@@ -0,0 +1,624 @@
+// MqttPublisher against an in-process broker stand-in that decodes every
+// packet written to it and answers the way Mosquitto would: the CONNECT and
+// its will, the retained status, the QoS 1 window and resends with DUP.
+#include <Arduino.h>
+#include <Client.h>
+#include <Hal.h>
+#include "MqttPublisher.h"
+#include "../support/FakeDns.h"
+#include <unity.h>
+#include <map>
+#include <string>
+#include <vector>
+
+struct Connect {
+  std::string protocol;
+  uint8_t level;
+  uint8_t flags;
+  uint16_t keepAlive;
+  std::string clientId;
+  std::string willTopic;
+  std::string willMessage;
+  std::string user;
+  std::string password;
+};
+
+struct Publish {
+  std::string topic;
+  uint8_t qos;
+  bool dup;
+  bool retain;
+  uint16_t id;
+  std::string payload;
+};
+
+// the broker's end of the publisher's one connection, answers go straight into what the publisher reads
+class FakeBroker : public Client {
+public:
+  bool open = false;
+  bool refuse = false;
+  int connects = 0;
+  IPAddress address;
+  int connackCode = 0;          // -1 never answers CONNECT
+  bool autoAck = true;          // PUBACK every QoS 1 publish as it comes in
+  bool answerPings = true;
+  std::string in;
+  size_t at = 0;
+  std::string partial;          // written bytes not yet a whole packet
+  std::vector<Connect> sessions;
+  std::vector<Publish> publishes;
+  std::vector<uint16_t> unacked;
+  std::map<std::string, std::string> retained;
+  int pings = 0;
+  int connect(const char *, uint16_t) { return 0; }   // would look the name up again
+  int connect(IPAddress ip, uint16_t) {
+    connects++;
+    address = ip;
+    if (refuse) {
+      return 0;
+    }
+    open = true;
+    in.clear();
+    at = 0;
+    partial.clear();
+    unacked.clear();
+    return 1;
+  }
+  size_t write(uint8_t c) { return write(&c, 1); }
+  size_t write(const uint8_t *buffer, size_t size) {
+    if (!open) {
+      return 0;
+    }
+    partial.append((const char *)buffer, size);
+    while (packet()) {
+    }
+    return size;
+  }
+  int available() { return open ? (int)(in.size() - at) : 0; }
+  int read() { return available() > 0 ? (uint8_t)in[at++] : -1; }
+  int read(uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (n < size && available() > 0) {
+      buffer[n++] = (uint8_t)in[at++];
+    }
+    return (int)n;
+  }
+  int peek() { return available() > 0 ? (uint8_t)in[at] : -1; }
+  void flush() {}
+  void stop() { open = false; }
+  uint8_t connected() { return open; }
+  operator bool() { return open; }
+
+  void ack(uint16_t id) {
+    send(0x40, id);
+    for (size_t i = 0; i < unacked.size(); i++) {
+      if (unacked[i] == id) {
+        unacked.erase(unacked.begin() + i);
+        break;
+      }
+    }
+  }
+  // the connection goes without a DISCONNECT, so the will is published
+  void hangUp() {
+    open = false;
+    const Connect &c = sessions.back();
+    retained[c.willTopic] = c.willMessage;
+  }
+  std::vector<Publish> readings(const std::string &topic) const {
+    std::vector<Publish> found;
+    for (size_t i = 0; i < publishes.size(); i++) {
+      if (publishes[i].topic == topic) {
+        found.push_back(publishes[i]);
+      }
+    }
+    return found;
+  }
+
+private:
+  void send(uint8_t type, uint16_t id) {
+    in += (char)type;
+    in += (char)2;
+    in += (char)(id >> 8);
+    in += (char)id;
+  }
+  static std::string string(const std::string &from, size_t &at) {
+    TEST_ASSERT_LESS_OR_EQUAL(from.size(), at + 2);
+    size_t length = ((uint8_t)from[at] << 8) | (uint8_t)from[at + 1];
+    TEST_ASSERT_LESS_OR_EQUAL(from.size(), at + 2 + length);
+    std::string value = from.substr(at + 2, length);
+    at += 2 + length;
+    return value;
+  }
+  // takes one whole packet off the front of what was written, false until there is one
+  bool packet() {
+    uint32_t length = 0;
+    size_t at = 1;
+    for (uint8_t shift = 0;; shift += 7) {
+      if (at >= partial.size()) {
+        return false;
+      }
+      uint8_t digit = (uint8_t)partial[at++];
+      length |= (uint32_t)(digit & 0x7F) << shift;
+      if (!(digit & 0x80)) {
+        break;
+      }
+      TEST_ASSERT_LESS_THAN(21, shift);
+    }
+    if (partial.size() < at + length) {
+      return false;
+    }
+    uint8_t type = (uint8_t)partial[0];
+    std::string body = partial.substr(at, length);
+    partial.erase(0, at + length);
+    size_t p = 0;
+    if ((type & 0xF0) == 0x10) {
+      Connect c;
+      c.protocol = string(body, p);
+      c.level = (uint8_t)body[p++];
+      c.flags = (uint8_t)body[p++];
+      c.keepAlive = ((uint8_t)body[p] << 8) | (uint8_t)body[p + 1];
+      p += 2;
+      c.clientId = string(body, p);
+      if (c.flags & 0x04) {
+        c.willTopic = string(body, p);
+        c.willMessage = string(body, p);
+      }
+      if (c.flags & 0x80) {
+        c.user = string(body, p);
+      }
+      if (c.flags & 0x40) {
+        c.password = string(body, p);
+      }
+      TEST_ASSERT_EQUAL(body.size(), p);
+      // the session is still there when an earlier connect with this id didn't ask for a clean one
+      bool present = false;
+      for (size_t i = 0; i < sessions.size(); i++) {
+        present = present || (sessions[i].clientId == c.clientId && !(c.flags & 0x02));
+      }
+      sessions.push_back(c);
+      if (connackCode >= 0) {
+        in += (char)0x20;
+        in += (char)2;
+        in += (char)(present && connackCode == 0 ? 1 : 0);
+        in += (char)connackCode;
+      }
+    } else if ((type & 0xF0) == 0x30) {
+      Publish m;
+      m.dup = (type & 0x08) != 0;
+      m.qos = (type >> 1) & 3;
+      m.retain = (type & 0x01) != 0;
+      m.topic = string(body, p);
+      m.id = 0;
+      if (m.qos) {
+        m.id = ((uint8_t)body[p] << 8) | (uint8_t)body[p + 1];
+        p += 2;
+        TEST_ASSERT_NOT_EQUAL(0, m.id);
+      }
+      m.payload = body.substr(p);
+      publishes.push_back(m);
+      if (m.retain) {
+        retained[m.topic] = m.payload;
+      }
+      if (m.qos == 1) {
+        if (autoAck) {
+          send(0x40, m.id);
+        } else {
+          unacked.push_back(m.id);
+        }
+      }
+    } else if ((type & 0xF0) == 0xC0) {
+      TEST_ASSERT_EQUAL(0, length);
+      pings++;
+      if (answerPings) {
+        in += (char)0xD0;
+        in += (char)0;
+      }
+    } else {
+      TEST_FAIL_MESSAGE("unexpected packet type");
+    }
+    return true;
+  }
+};
+
+// a payload is the reading's sequence number, padded out to test longer remaining lengths
+class SeqEncoder : public ReadingEncoder {
+public:
+  size_t padding = 0;
+  const char *contentType() { return "text/plain"; }
+  size_t item(const Reading &reading, uint8_t, uint8_t, Print &out) {
+    size_t n = out.print((unsigned long)reading.seq);
+    for (size_t i = 0; i < padding; i++) {
+      n += out.print('.');
+    }
+    return n;
+  }
+};
+
+struct Result {
+  uint32_t seq;
+  int status;
+};
+
+static std::vector<Result> results;
+static FakeBroker broker;
+static SeqEncoder encoder;
+static FakeDns dns;
+static HalDevices saved;
+
+static const char *readingTopic = "scales/kitchen/reading";
+static const char *statusTopic = "scales/kitchen/status";
+
+static void onResult(const Reading &reading, int status) {
+  Result r = { reading.seq, status };
+  results.push_back(r);
+}
+
+static Reading reading(uint32_t seq) {
+  Reading r = { seq, 1000 + seq, 250, 3, 0 };
+  return r;
+}
+
+static void startPublisher(MqttPublisher &publisher) {
+  publisher.setClientId("kitchen");
+  publisher.setEncoder(encoder);
+  publisher.onResult(onResult);
+}
+
+void setUp() {
+  saved = hal;
+  dns = FakeDns();
+  dns.hosts["broker"] = IPAddress(10, 0, 0, 3);
+  hal.network = &dns;
+  broker = FakeBroker();
+  encoder = SeqEncoder();
+  results.clear();
+}
+
+void tearDown() {
+  hal = saved;
+}
+
+void test_connect_and_will() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  publisher.setCredentials("scale", "secret");
+  publisher.poll(0, true);
+  TEST_ASSERT_EQUAL(1, broker.sessions.size());
+  const Connect &c = broker.sessions[0];
+  TEST_ASSERT_EQUAL_STRING("MQTT", c.protocol.c_str());
+  TEST_ASSERT_EQUAL(4, c.level);
+  // user, password, will retained at QoS 1, clean session off
+  TEST_ASSERT_EQUAL_HEX8(0xEC, c.flags);
+  TEST_ASSERT_EQUAL(MQTT_KEEPALIVE_S, c.keepAlive);
+  TEST_ASSERT_EQUAL_STRING("kitchen", c.clientId.c_str());
+  TEST_ASSERT_EQUAL_STRING(statusTopic, c.willTopic.c_str());
+  TEST_ASSERT_EQUAL_STRING("offline", c.willMessage.c_str());
+  TEST_ASSERT_EQUAL_STRING("scale", c.user.c_str());
+  TEST_ASSERT_EQUAL_STRING("secret", c.password.c_str());
+  TEST_ASSERT_FALSE(publisher.connected());
+  TEST_ASSERT_EQUAL_STRING("10.0.0.3", broker.address.toString().c_str());
+  TEST_ASSERT_EQUAL(HOST_TIMEOUT_MS, broker.getTimeout());
+
+  publisher.poll(10, true);
+  TEST_ASSERT_TRUE(publisher.connected());
+  TEST_ASSERT_EQUAL(1, broker.publishes.size());
+  TEST_ASSERT_TRUE(broker.publishes[0].retain);
+  TEST_ASSERT_EQUAL(0, broker.publishes[0].qos);
+  TEST_ASSERT_EQUAL_STRING("online", broker.retained[statusTopic].c_str());
+
+  broker.hangUp();
+  TEST_ASSERT_EQUAL_STRING("offline", broker.retained[statusTopic].c_str());
+  publisher.poll(20, true);
+  TEST_ASSERT_FALSE(publisher.connected());
+  publisher.poll(MQTT_RECONNECT_MS, true);
+  publisher.poll(MQTT_RECONNECT_MS + 10, true);
+  TEST_ASSERT_TRUE(publisher.connected());
+  TEST_ASSERT_EQUAL(2, publisher.connects());
+  TEST_ASSERT_EQUAL(1, dns.lookups);      // the reconnect went to the address already known
+  TEST_ASSERT_EQUAL_STRING("online", broker.retained[statusTopic].c_str());
+}
+
+void test_without_credentials_and_long_id() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  publisher.setClientId("a-client-id-much-longer-than-mqtt-allows");
+  publisher.poll(0, true);
+  const Connect &c = broker.sessions[0];
+  TEST_ASSERT_EQUAL_HEX8(0x2C, c.flags);
+  TEST_ASSERT_EQUAL(MQTT_CLIENT_ID_SIZE - 1, c.clientId.size());
+  std::string will = "scales/" + c.clientId + "/status";
+  TEST_ASSERT_EQUAL_STRING(will.c_str(), c.willTopic.c_str());
+}
+
+// the first publish of a reading carries an id, its payload comes from the encoder
+void test_qos1_publish_round_trip() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  TEST_ASSERT_TRUE(publisher.enqueue(reading(7)));
+  publisher.poll(0, true);
+  publisher.poll(10, true);
+  std::vector<Publish> sent = broker.readings(readingTopic);
+  TEST_ASSERT_EQUAL(1, sent.size());
+  TEST_ASSERT_EQUAL(1, sent[0].qos);
+  TEST_ASSERT_FALSE(sent[0].dup);
+  TEST_ASSERT_FALSE(sent[0].retain);
+  TEST_ASSERT_EQUAL(1, sent[0].id);
+  TEST_ASSERT_EQUAL_STRING("7", sent[0].payload.c_str());
+  TEST_ASSERT_EQUAL(1, publisher.pending());
+  TEST_ASSERT_EQUAL(0, results.size());
+  publisher.poll(20, true);
+  TEST_ASSERT_EQUAL(0, publisher.pending());
+  TEST_ASSERT_EQUAL(1, results.size());
+  TEST_ASSERT_EQUAL(7, results[0].seq);
+  TEST_ASSERT_EQUAL(200, results[0].status);
+}
+
+// bodies over 127 bytes need a second remaining length byte
+void test_long_payload() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  encoder.padding = 300;
+  publisher.enqueue(reading(42));
+  publisher.poll(0, true);
+  publisher.poll(10, true);
+  std::vector<Publish> sent = broker.readings(readingTopic);
+  TEST_ASSERT_EQUAL(1, sent.size());
+  TEST_ASSERT_EQUAL(302, sent[0].payload.size());
+  TEST_ASSERT_EQUAL(0, sent[0].payload.find("42..."));
+  TEST_ASSERT_TRUE(broker.partial.empty());
+}
+
+// no more than MQTT_MAX_INFLIGHT publishes ahead of their PUBACKs
+void test_inflight_window() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  broker.autoAck = false;
+  for (uint32_t i = 1; i <= 10; i++) {
+    TEST_ASSERT_TRUE(publisher.enqueue(reading(i)));
+  }
+  publisher.poll(0, true);
+  publisher.poll(10, true);
+  TEST_ASSERT_EQUAL(MQTT_MAX_INFLIGHT, broker.readings(readingTopic).size());
+  publisher.poll(20, true);
+  TEST_ASSERT_EQUAL(MQTT_MAX_INFLIGHT, broker.readings(readingTopic).size());
+  unsigned long now = 30;
+  while (!broker.unacked.empty()) {
+    broker.ack(broker.unacked.front());
+    publisher.poll(now, true);
+    now += 10;
+    TEST_ASSERT_LESS_OR_EQUAL(MQTT_MAX_INFLIGHT, broker.unacked.size());
+  }
+  std::vector<Publish> sent = broker.readings(readingTopic);
+  TEST_ASSERT_EQUAL(10, sent.size());
+  TEST_ASSERT_EQUAL(10, results.size());
+  for (uint32_t i = 0; i < 10; i++) {
+    TEST_ASSERT_EQUAL(i + 1, sent[i].id);
+    TEST_ASSERT_EQUAL(i + 1, results[i].seq);
+  }
+  TEST_ASSERT_EQUAL(1, publisher.connects());
+}
+
+// a PUBACK that overtakes an earlier one is held until the earlier one is in
+void test_out_of_order_pubacks() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  broker.autoAck = false;
+  for (uint32_t i = 1; i <= 3; i++) {
+    publisher.enqueue(reading(i));
+  }
+  publisher.poll(0, true);
+  publisher.poll(10, true);
+  broker.ack(3);
+  broker.ack(2);
+  publisher.poll(20, true);
+  TEST_ASSERT_EQUAL(0, results.size());
+  TEST_ASSERT_EQUAL(3, publisher.pending());
+  // a PUBACK for nothing in flight changes nothing
+  broker.ack(99);
+  broker.ack(1);
+  publisher.poll(30, true);
+  TEST_ASSERT_EQUAL(3, results.size());
+  for (uint32_t i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(i + 1, results[i].seq);
+  }
+}
+
+// what had no PUBACK when the connection went goes out again with DUP and the same id, each reported once
+void test_resend_with_dup_after_drop() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  broker.autoAck = false;
+  for (uint32_t i = 1; i <= 6; i++) {
+    publisher.enqueue(reading(i));
+  }
+  publisher.poll(0, true);
+  publisher.poll(10, true);
+  broker.ack(1);
+  publisher.poll(20, true);
+  TEST_ASSERT_EQUAL(1, results.size());
+  broker.hangUp();
+  publisher.poll(30, true);
+  TEST_ASSERT_FALSE(publisher.connected());
+  broker.publishes.clear();
+  broker.autoAck = true;
+  publisher.poll(MQTT_RECONNECT_MS, true);
+  publisher.poll(MQTT_RECONNECT_MS + 10, true);
+  TEST_ASSERT_TRUE(publisher.connected());
+  publisher.poll(MQTT_RECONNECT_MS + 20, true);
+  publisher.poll(MQTT_RECONNECT_MS + 30, true);
+
+  std::vector<Publish> sent = broker.readings(readingTopic);
+  TEST_ASSERT_EQUAL(5, sent.size());
+  for (uint32_t i = 0; i < 5; i++) {
+    TEST_ASSERT_EQUAL(i + 2, sent[i].id);
+    std::string seq = std::to_string(i + 2);
+    TEST_ASSERT_EQUAL_STRING(seq.c_str(), sent[i].payload.c_str());
+    // 2 to 5 were written before the drop, 6 never was
+    TEST_ASSERT_EQUAL(i < 4, sent[i].dup);
+  }
+  TEST_ASSERT_EQUAL(6, results.size());
+  for (uint32_t i = 0; i < 6; i++) {
+    TEST_ASSERT_EQUAL(i + 1, results[i].seq);
+  }
+  TEST_ASSERT_EQUAL(0, publisher.pending());
+}
+
+// no PUBACK within MQTT_RESPONSE_TIMEOUT_MS drops the connection and the publish is resent
+void test_puback_timeout() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  broker.autoAck = false;
+  publisher.enqueue(reading(1));
+  publisher.poll(0, true);
+  publisher.poll(10, true);
+  publisher.poll(10 + MQTT_RESPONSE_TIMEOUT_MS - 1, true);
+  TEST_ASSERT_TRUE(publisher.connected());
+  // the last connect was long enough ago to go straight back
+  publisher.poll(10 + MQTT_RESPONSE_TIMEOUT_MS, true);
+  TEST_ASSERT_FALSE(publisher.connected());
+  TEST_ASSERT_EQUAL(2, broker.connects);
+  publisher.poll(20 + MQTT_RESPONSE_TIMEOUT_MS, true);
+  std::vector<Publish> sent = broker.readings(readingTopic);
+  TEST_ASSERT_EQUAL(2, sent.size());
+  TEST_ASSERT_TRUE(sent[1].dup);
+  TEST_ASSERT_EQUAL(sent[0].id, sent[1].id);
+  TEST_ASSERT_EQUAL(0, results.size());
+}
+
+void test_refused_and_unanswered_connack() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  broker.connackCode = 5;       // not authorized
+  publisher.poll(0, true);
+  publisher.poll(10, true);
+  TEST_ASSERT_FALSE(publisher.connected());
+  TEST_ASSERT_FALSE(broker.open);
+  TEST_ASSERT_EQUAL(0, broker.publishes.size());
+  publisher.poll(MQTT_RECONNECT_MS - 1, true);
+  TEST_ASSERT_EQUAL(1, broker.connects);
+
+  broker.connackCode = -1;
+  unsigned long now = MQTT_RECONNECT_MS;
+  publisher.poll(now, true);
+  TEST_ASSERT_EQUAL(2, broker.connects);
+  publisher.poll(now + MQTT_RESPONSE_TIMEOUT_MS - 1, true);
+  TEST_ASSERT_TRUE(broker.open);
+  // given up on and tried again in the same poll
+  now += MQTT_RESPONSE_TIMEOUT_MS;
+  publisher.poll(now, true);
+  TEST_ASSERT_EQUAL(3, broker.connects);
+
+  broker.refuse = true;
+  now += MQTT_RESPONSE_TIMEOUT_MS;
+  publisher.poll(now, true);
+  TEST_ASSERT_EQUAL(4, broker.connects);
+  publisher.poll(now + MQTT_RECONNECT_MS - 1, true);
+  TEST_ASSERT_EQUAL(4, broker.connects);
+  publisher.poll(now + MQTT_RECONNECT_MS, true);
+  TEST_ASSERT_EQUAL(5, broker.connects);
+  TEST_ASSERT_EQUAL(3, publisher.connects());
+}
+
+// QoS 0 publishes have no id and count as delivered once written
+void test_qos0() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  publisher.setQos(0);
+  broker.autoAck = false;
+  for (uint32_t i = 1; i <= 10; i++) {
+    publisher.enqueue(reading(i));
+  }
+  publisher.poll(0, true);
+  publisher.poll(10, true);
+  std::vector<Publish> sent = broker.readings(readingTopic);
+  TEST_ASSERT_EQUAL(MQTT_MAX_INFLIGHT, sent.size());
+  TEST_ASSERT_EQUAL(MQTT_MAX_INFLIGHT, results.size());
+  publisher.poll(20, true);
+  publisher.poll(30, true);
+  sent = broker.readings(readingTopic);
+  TEST_ASSERT_EQUAL(10, sent.size());
+  for (size_t i = 0; i < sent.size(); i++) {
+    TEST_ASSERT_EQUAL(0, sent[i].qos);
+    TEST_ASSERT_EQUAL(0, sent[i].id);
+  }
+  TEST_ASSERT_EQUAL(10, results.size());
+  TEST_ASSERT_EQUAL(0, publisher.pending());
+}
+
+// a ping after half the keep alive without sending, dropped when nothing comes back for one and a half
+void test_keep_alive() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  publisher.poll(0, true);
+  publisher.poll(10, true);
+  publisher.poll(10 + MQTT_KEEPALIVE_S * 500UL - 1, true);
+  TEST_ASSERT_EQUAL(0, broker.pings);
+  publisher.poll(10 + MQTT_KEEPALIVE_S * 500UL, true);
+  TEST_ASSERT_EQUAL(1, broker.pings);
+  // answered pings keep an idle connection up
+  for (unsigned long now = 10 + MQTT_KEEPALIVE_S * 500UL; now < MQTT_KEEPALIVE_S * 5000UL; now += 1000) {
+    publisher.poll(now, true);
+  }
+  TEST_ASSERT_TRUE(publisher.connected());
+  TEST_ASSERT_EQUAL(1, publisher.connects());
+  TEST_ASSERT_EQUAL(9, broker.pings);          // one every half keep alive
+}
+
+// the broker stops answering pings: dropped one and a half keep alives after the CONNACK
+void test_unanswered_pings() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  broker.answerPings = false;
+  publisher.poll(0, true);
+  unsigned long now = 0;
+  while (broker.connects == 1 && now < MQTT_KEEPALIVE_S * 3000UL) {
+    now += 10;
+    publisher.poll(now, true);
+  }
+  // the CONNACK came in at 10, the drop and the reconnect after it are one poll
+  TEST_ASSERT_EQUAL(10 + MQTT_KEEPALIVE_S * 1500UL, now);
+  TEST_ASSERT_EQUAL(2, broker.pings);
+}
+
+void test_queue_full_and_offline() {
+  MqttPublisher publisher(broker, "broker", 1883, "scales");
+  startPublisher(publisher);
+  for (uint32_t i = 0; i < MQTT_QUEUE_SIZE; i++) {
+    TEST_ASSERT_TRUE(publisher.enqueue(reading(i)));
+  }
+  TEST_ASSERT_FALSE(publisher.enqueue(reading(99)));
+  TEST_ASSERT_EQUAL(MQTT_QUEUE_SIZE, publisher.pending());
+  // nothing is attempted while the link is down
+  publisher.poll(0, false);
+  TEST_ASSERT_EQUAL(0, broker.connects);
+  publisher.poll(10, true);
+  publisher.poll(20, true);
+  TEST_ASSERT_TRUE(publisher.connected());
+  publisher.poll(30, false);
+  TEST_ASSERT_FALSE(broker.open);
+  TEST_ASSERT_FALSE(publisher.connected());
+  for (unsigned long now = 40; now < 40 + MQTT_RECONNECT_MS * 4 && publisher.pending(); now += 100) {
+    publisher.poll(now, true);
+  }
+  TEST_ASSERT_EQUAL(0, publisher.pending());
+  TEST_ASSERT_EQUAL(MQTT_QUEUE_SIZE, results.size());
+  TEST_ASSERT_TRUE(publisher.enqueue(reading(99)));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_connect_and_will);
+  RUN_TEST(test_without_credentials_and_long_id);
+  RUN_TEST(test_qos1_publish_round_trip);
+  RUN_TEST(test_long_payload);
+  RUN_TEST(test_inflight_window);
+  RUN_TEST(test_out_of_order_pubacks);
+  RUN_TEST(test_resend_with_dup_after_drop);
+  RUN_TEST(test_puback_timeout);
+  RUN_TEST(test_refused_and_unanswered_connack);
+  RUN_TEST(test_qos0);
+  RUN_TEST(test_keep_alive);
+  RUN_TEST(test_unanswered_pings);
+  RUN_TEST(test_queue_full_and_offline);
+  return UNITY_END();
+}
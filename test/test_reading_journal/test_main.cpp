@@ -0,0 +1,268 @@
+// ReadingJournal on files held in memory: records and cursor entries cut short
+// by a reset are dropped on open(), the cursor and the sequence survive it.
+#include "ReadingJournal.h"
+#include "../support/MemoryFile.h"
+#include <unity.h>
+#include <vector>
+
+static MemoryFile logFile;
+static MemoryFile cursorFile;
+
+static JournalRecord record(int32_t weight) {
+  JournalRecord r = { 0, 1700000000000ULL + weight, weight, 12, 1 };
+  return r;
+}
+
+static void fill(ReadingJournal &journal, int count) {
+  for (int i = 0; i < count; i++) {
+    JournalRecord r = record(i * 10);
+    TEST_ASSERT_TRUE(journal.append(r));
+  }
+}
+
+void setUp() {
+  logFile = MemoryFile();
+  cursorFile = MemoryFile();
+}
+
+void tearDown() {
+}
+
+void test_record_round_trip() {
+  JournalRecord in = { 0xDEADBEEF, 0x0123456789ABCDEFULL, -123456, 0xFFFE, 0x81 };
+  uint8_t buffer[JOURNAL_RECORD_SIZE];
+  ReadingJournal::encode(in, buffer);
+  JournalRecord out;
+  TEST_ASSERT_TRUE(ReadingJournal::decode(buffer, out));
+  TEST_ASSERT_EQUAL_HEX32(in.seq, out.seq);
+  TEST_ASSERT_TRUE(in.timestamp == out.timestamp);
+  TEST_ASSERT_EQUAL(in.weight, out.weight);
+  TEST_ASSERT_EQUAL(in.food, out.food);
+  TEST_ASSERT_EQUAL(in.flags, out.flags);
+  buffer[13] ^= 0x10;
+  TEST_ASSERT_FALSE(ReadingJournal::decode(buffer, out));
+}
+
+void test_peek_hands_out_in_order_until_acked() {
+  ReadingJournal journal(logFile, cursorFile);
+  TEST_ASSERT_TRUE(journal.open());
+  fill(journal, 5);
+  JournalRecord out[4];
+  TEST_ASSERT_EQUAL(3, journal.peek(out, 3));
+  TEST_ASSERT_EQUAL(2, journal.unsent());
+  TEST_ASSERT_EQUAL(5, journal.unacked());
+  for (uint32_t i = 0; i < 3; i++) {
+    TEST_ASSERT_EQUAL(i, out[i].seq);
+    TEST_ASSERT_EQUAL((int32_t)i * 10, out[i].weight);
+  }
+  TEST_ASSERT_TRUE(journal.ack(2));
+  TEST_ASSERT_EQUAL(3, journal.unacked());
+  TEST_ASSERT_EQUAL(2, journal.peek(out, 4));
+  TEST_ASSERT_EQUAL(3, out[0].seq);
+  TEST_ASSERT_EQUAL(0, journal.peek(out, 4));
+}
+
+// a failed record keeps its place and its seq, and nothing past what was handed out is acked
+void test_rewind_resends_from_first_unacked() {
+  ReadingJournal journal(logFile, cursorFile);
+  journal.open();
+  fill(journal, 4);
+  JournalRecord out[4];
+  journal.peek(out, 3);
+  journal.ack(1);
+  journal.rewind();
+  TEST_ASSERT_EQUAL(3, journal.unsent());
+  TEST_ASSERT_EQUAL(3, journal.peek(out, 4));
+  TEST_ASSERT_EQUAL(1, out[0].seq);
+  TEST_ASSERT_EQUAL(3, out[2].seq);
+  journal.rewind();
+  journal.peek(out, 1);
+  journal.ack(3);
+  TEST_ASSERT_EQUAL(2, journal.unacked());
+  TEST_ASSERT_EQUAL(4, journal.nextSeq());
+}
+
+// power lost halfway through writing the fourth record
+void test_open_truncates_torn_record() {
+  {
+    ReadingJournal journal(logFile, cursorFile);
+    journal.open();
+    fill(journal, 4);
+  }
+  logFile.data.resize(3 * JOURNAL_RECORD_SIZE + 9);
+  ReadingJournal journal(logFile, cursorFile);
+  TEST_ASSERT_TRUE(journal.open());
+  TEST_ASSERT_EQUAL(3 * JOURNAL_RECORD_SIZE, logFile.size());
+  TEST_ASSERT_EQUAL(3, journal.unacked());
+  TEST_ASSERT_EQUAL(3, journal.nextSeq());
+  JournalRecord r = record(99);
+  journal.append(r);
+  TEST_ASSERT_EQUAL(3, r.seq);
+}
+
+// everything from the first record that fails its CRC on is dropped
+void test_open_stops_at_corrupt_record() {
+  {
+    ReadingJournal journal(logFile, cursorFile);
+    journal.open();
+    fill(journal, 5);
+  }
+  logFile.data[2 * JOURNAL_RECORD_SIZE + 5] ^= 0xFF;
+  ReadingJournal journal(logFile, cursorFile);
+  TEST_ASSERT_TRUE(journal.open());
+  TEST_ASSERT_EQUAL(2, journal.unacked());
+  TEST_ASSERT_EQUAL(2 * JOURNAL_RECORD_SIZE, logFile.size());
+}
+
+void test_cursor_survives_reset() {
+  {
+    ReadingJournal journal(logFile, cursorFile);
+    journal.open();
+    fill(journal, 5);
+    JournalRecord out[5];
+    journal.peek(out, 5);
+    journal.ack(2);
+    journal.ack(1);
+  }
+  ReadingJournal journal(logFile, cursorFile);
+  TEST_ASSERT_TRUE(journal.open());
+  TEST_ASSERT_EQUAL(2, journal.unacked());
+  TEST_ASSERT_EQUAL(2, journal.unsent());
+  JournalRecord out[2];
+  journal.peek(out, 2);
+  TEST_ASSERT_EQUAL(3, out[0].seq);
+}
+
+// the last cursor entry was cut short, the one before it still counts
+void test_torn_cursor_entry_falls_back() {
+  {
+    ReadingJournal journal(logFile, cursorFile);
+    journal.open();
+    fill(journal, 5);
+    JournalRecord out[5];
+    journal.peek(out, 5);
+    journal.ack(1);
+    journal.ack(2);
+  }
+  // the entry open() wrote, ack(1), and ack(2) cut short
+  cursorFile.data.resize(3 * JOURNAL_CURSOR_SIZE - 4);
+  ReadingJournal journal(logFile, cursorFile);
+  TEST_ASSERT_TRUE(journal.open());
+  TEST_ASSERT_EQUAL(2 * JOURNAL_CURSOR_SIZE, cursorFile.size());
+  TEST_ASSERT_EQUAL(4, journal.unacked());
+}
+
+// a cursor past the end of the log can't be trusted, everything is replayed
+void test_cursor_past_end_replays_all() {
+  {
+    ReadingJournal journal(logFile, cursorFile);
+    journal.open();
+    fill(journal, 5);
+    JournalRecord out[5];
+    journal.peek(out, 5);
+    journal.ack(4);
+  }
+  logFile.data.resize(2 * JOURNAL_RECORD_SIZE);
+  ReadingJournal journal(logFile, cursorFile);
+  TEST_ASSERT_TRUE(journal.open());
+  TEST_ASSERT_EQUAL(2, journal.unacked());
+}
+
+// once everything is delivered the log starts over and the next seq is kept in the cursor
+void test_fully_acked_compacts_and_keeps_seq() {
+  {
+    ReadingJournal journal(logFile, cursorFile);
+    journal.open();
+    TEST_ASSERT_EQUAL(JOURNAL_CURSOR_SIZE, cursorFile.size());
+    fill(journal, 3);
+    JournalRecord out[3];
+    journal.peek(out, 3);
+    TEST_ASSERT_TRUE(journal.ack(3));
+    TEST_ASSERT_EQUAL(0, logFile.size());
+    TEST_ASSERT_EQUAL(2 * JOURNAL_CURSOR_SIZE, cursorFile.size());
+  }
+  ReadingJournal journal(logFile, cursorFile);
+  TEST_ASSERT_TRUE(journal.open());
+  TEST_ASSERT_EQUAL(0, journal.unacked());
+  TEST_ASSERT_EQUAL(3, journal.nextSeq());
+}
+
+void test_cursor_file_stays_bounded() {
+  ReadingJournal journal(logFile, cursorFile);
+  journal.open();
+  fill(journal, 1000);
+  JournalRecord out[1];
+  for (int i = 0; i < 999; i++) {
+    journal.peek(out, 1);
+    journal.ack(1);
+    TEST_ASSERT_LESS_OR_EQUAL(JOURNAL_CURSOR_SIZE * JOURNAL_CURSOR_ENTRIES, cursorFile.size());
+  }
+  ReadingJournal reopened(logFile, cursorFile);
+  reopened.open();
+  TEST_ASSERT_EQUAL(1, reopened.unacked());
+  TEST_ASSERT_EQUAL(1000, reopened.nextSeq());
+}
+
+// power lost at each flash write in turn while acking one record at a time, through
+// a cursor rollover and the final compaction: after the reset nothing unacked is
+// lost, no seq comes back and the cursor file still holds a valid entry
+void test_reset_during_ack_never_reuses_seq() {
+  const int count = JOURNAL_CURSOR_ENTRIES + 2;
+  for (long budget = 0;; budget++) {
+    setUp();
+    long writesLeft = budget;
+    int acked = 0;
+    {
+      ReadingJournal journal(logFile, cursorFile);
+      journal.open();
+      fill(journal, count);
+      JournalRecord out[1];
+      logFile.writesLeft = &writesLeft;
+      cursorFile.writesLeft = &writesLeft;
+      while (journal.peek(out, 1) == 1 && journal.ack(1)) {
+        acked++;
+      }
+      logFile.writesLeft = 0;
+      cursorFile.writesLeft = 0;
+    }
+    ReadingJournal journal(logFile, cursorFile);
+    TEST_ASSERT_TRUE(journal.open());
+    TEST_ASSERT_GREATER_OR_EQUAL(JOURNAL_CURSOR_SIZE, cursorFile.size());
+    TEST_ASSERT_GREATER_OR_EQUAL(count - acked, journal.unacked());
+    TEST_ASSERT_EQUAL(count, journal.nextSeq());
+    JournalRecord r = record(1);
+    TEST_ASSERT_TRUE(journal.append(r));
+    TEST_ASSERT_EQUAL(count, r.seq);
+    if (acked == count) {
+      break;
+    }
+  }
+}
+
+void test_full_journal_refuses() {
+  ReadingJournal journal(logFile, cursorFile);
+  journal.open();
+  const long capacity = JOURNAL_MAX_BYTES / JOURNAL_RECORD_SIZE;
+  fill(journal, capacity);
+  JournalRecord r = record(1);
+  TEST_ASSERT_FALSE(journal.append(r));
+  TEST_ASSERT_EQUAL(capacity, journal.unacked());
+  TEST_ASSERT_EQUAL(capacity, journal.nextSeq());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_record_round_trip);
+  RUN_TEST(test_peek_hands_out_in_order_until_acked);
+  RUN_TEST(test_rewind_resends_from_first_unacked);
+  RUN_TEST(test_open_truncates_torn_record);
+  RUN_TEST(test_open_stops_at_corrupt_record);
+  RUN_TEST(test_cursor_survives_reset);
+  RUN_TEST(test_torn_cursor_entry_falls_back);
+  RUN_TEST(test_cursor_past_end_replays_all);
+  RUN_TEST(test_fully_acked_compacts_and_keeps_seq);
+  RUN_TEST(test_cursor_file_stays_bounded);
+  RUN_TEST(test_reset_during_ack_never_reuses_seq);
+  RUN_TEST(test_full_journal_refuses);
+  return UNITY_END();
+}
@@ -0,0 +1,414 @@
+// The local HTTP API: HttpRequestParser fed byte by byte, RestRouter's
+// responses, and RestServer polled with several clients at once on sockets
+// the test plays the other end of.
+#include <Arduino.h>
+#include <Hal.h>
+#include <WiFiServer.h>
+#include <HttpRequestParser.h>
+#include "RestRouter.h"
+#include "RestServer.h"
+#include "../support/FakeNetwork.h"
+#include "../support/StringPrint.h"
+#include <unity.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Response {
+  int status;
+  std::string headers;
+  std::string body;
+};
+
+// splits what a socket got back into responses, each framed by its Content-Length
+static std::vector<Response> responses(const std::string &out) {
+  std::vector<Response> all;
+  size_t at = 0;
+  while (at < out.size()) {
+    size_t end = out.find("\r\n\r\n", at);
+    TEST_ASSERT_TRUE(end != std::string::npos);
+    TEST_ASSERT_EQUAL(0, out.compare(at, 9, "HTTP/1.1 "));
+    Response r;
+    r.status = atoi(out.c_str() + at + 9);
+    r.headers = out.substr(at, end + 4 - at);
+    size_t length = r.headers.find("Content-Length: ");
+    TEST_ASSERT_TRUE(length != std::string::npos);
+    size_t size = strtoul(r.headers.c_str() + length + 16, 0, 10);
+    TEST_ASSERT_LESS_OR_EQUAL(out.size(), end + 4 + size);
+    r.body = out.substr(end + 4, size);
+    all.push_back(r);
+    at = end + 4 + size;
+  }
+  return all;
+}
+
+static HttpRequestParser::Result parse(HttpRequestParser &parser, const char *request) {
+  HttpRequestParser::Result result = HttpRequestParser::INCOMPLETE;
+  for (const char *c = request; *c && result == HttpRequestParser::INCOMPLETE; c++) {
+    result = parser.feed(*c);
+  }
+  return result;
+}
+
+static int statusRoute(const HttpRequestParser &request, Print &body) {
+  body.print("{\"path\":\"");
+  body.print(request.path());
+  body.print("\"}");
+  return 200;
+}
+
+static int echoRoute(const HttpRequestParser &request, Print &body) {
+  char value[24];
+  if (!request.param("food", value, sizeof(value))) {
+    return 400;
+  }
+  body.print("{\"food\":\"");
+  body.print(value);
+  body.print("\"}");
+  return 202;
+}
+
+// more than a response body holds
+static int hugeRoute(const HttpRequestParser &, Print &body) {
+  for (int i = 0; i < REST_BODY_SIZE; i++) {
+    body.print('x');
+  }
+  return 200;
+}
+
+static FakeNetwork network;
+static HalDevices saved;
+static RestRouter router;
+
+void setUp() {
+  saved = hal;
+  network = FakeNetwork();
+  hal.network = &network;
+  router = RestRouter();
+  router.on("GET", "/status", statusRoute);
+  router.on("POST", "/tare", echoRoute);
+  router.on("GET", "/huge", hugeRoute);
+}
+
+void tearDown() {
+  hal = saved;
+}
+
+void test_parser_request_line_and_query() {
+  HttpRequestParser parser;
+  TEST_ASSERT_EQUAL(HttpRequestParser::COMPLETE, parse(parser, "\r\nGET /status?food=oat+milk&x=%41%2b HTTP/1.1\r\nHost: scale\r\n\r\n"));
+  TEST_ASSERT_EQUAL_STRING("GET", parser.method());
+  TEST_ASSERT_EQUAL_STRING("/status", parser.path());
+  TEST_ASSERT_EQUAL_STRING("food=oat+milk&x=%41%2b", parser.query());
+  TEST_ASSERT_TRUE(parser.keepAlive());
+  char value[16];
+  TEST_ASSERT_TRUE(parser.param("food", value, sizeof(value)));
+  TEST_ASSERT_EQUAL_STRING("oat milk", value);
+  TEST_ASSERT_TRUE(parser.param("x", value, sizeof(value)));
+  TEST_ASSERT_EQUAL_STRING("A+", value);
+  TEST_ASSERT_FALSE(parser.param("foo", value, sizeof(value)));
+  // cut to fit the buffer
+  TEST_ASSERT_TRUE(parser.param("food", value, 4));
+  TEST_ASSERT_EQUAL_STRING("oat", value);
+  // stays complete until reset
+  TEST_ASSERT_EQUAL(HttpRequestParser::COMPLETE, parser.feed('G'));
+  parser.reset();
+  TEST_ASSERT_EQUAL(HttpRequestParser::INCOMPLETE, parser.result());
+  TEST_ASSERT_FALSE(parser.started());
+}
+
+void test_parser_body_and_connection() {
+  HttpRequestParser parser;
+  TEST_ASSERT_EQUAL(HttpRequestParser::INCOMPLETE, parse(parser, "POST /tare HTTP/1.0\r\ncontent-length: 9\r\n\r\nfood=ri"));
+  TEST_ASSERT_TRUE(parser.started());
+  TEST_ASSERT_EQUAL(HttpRequestParser::COMPLETE, parse(parser, "ce"));
+  TEST_ASSERT_EQUAL_STRING("food=rice", parser.body());
+  TEST_ASSERT_EQUAL(9, parser.bodyLength());
+  TEST_ASSERT_FALSE(parser.keepAlive());
+  char value[16];
+  TEST_ASSERT_TRUE(parser.param("food", value, sizeof(value)));
+  TEST_ASSERT_EQUAL_STRING("rice", value);
+
+  parser.reset();
+  TEST_ASSERT_EQUAL(HttpRequestParser::COMPLETE, parse(parser, "GET / HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"));
+  TEST_ASSERT_TRUE(parser.keepAlive());
+  parser.reset();
+  TEST_ASSERT_EQUAL(HttpRequestParser::COMPLETE, parse(parser, "GET / HTTP/1.1\r\nConnection: close\r\n\r\n"));
+  TEST_ASSERT_FALSE(parser.keepAlive());
+  // a header line too long for the buffer is cut off, not an error
+  parser.reset();
+  std::string longHeader = "GET / HTTP/1.1\r\nCookie: " + std::string(200, 'c') + "\r\n\r\n";
+  TEST_ASSERT_EQUAL(HttpRequestParser::COMPLETE, parse(parser, longHeader.c_str()));
+}
+
+void test_parser_refusals() {
+  struct { const char *request; int status; } cases[] = {
+    { "GET /status\r\n\r\n", 400 },
+    { "GET /status FTP/1.1\r\n\r\n", 400 },
+    { "SUBSCRIBE / HTTP/1.1\r\n\r\n", 400 },
+    { "GET /a-path-that-is-far-too-long-for-it HTTP/1.1\r\n\r\n", 414 },
+    { "GET /?q=a-query-string-that-is-much-too-long-for-the-buffer HTTP/1.1\r\n\r\n", 414 },
+    { "POST /tare HTTP/1.1\r\nContent-Length: 65\r\n\r\n", 413 },
+    { "POST /tare HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n", 501 },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    HttpRequestParser parser;
+    TEST_ASSERT_EQUAL(HttpRequestParser::FAILED, parse(parser, cases[i].request));
+    TEST_ASSERT_EQUAL(cases[i].status, parser.error());
+    TEST_ASSERT_FALSE(parser.keepAlive());
+  }
+  HttpRequestParser parser;
+  std::string longLine = "GET /" + std::string(HTTP_LINE_SIZE, 'a') + " HTTP/1.1\r\n\r\n";
+  TEST_ASSERT_EQUAL(HttpRequestParser::FAILED, parse(parser, longLine.c_str()));
+  TEST_ASSERT_EQUAL(414, parser.error());
+  // the largest body taken
+  parser.reset();
+  std::string full = "POST /tare HTTP/1.1\r\nContent-Length: 64\r\n\r\n" + std::string(HTTP_BODY_SIZE, 'b');
+  TEST_ASSERT_EQUAL(HttpRequestParser::COMPLETE, parse(parser, full.c_str()));
+  TEST_ASSERT_EQUAL(HTTP_BODY_SIZE, parser.bodyLength());
+}
+
+void test_router_responses() {
+  HttpRequestParser parser;
+  StringPrint out;
+  parse(parser, "GET /status HTTP/1.1\r\n\r\n");
+  TEST_ASSERT_EQUAL(REST_NO_STREAM, router.respond(parser, out));
+  std::vector<Response> r = responses(out.text);
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_EQUAL(200, r[0].status);
+  TEST_ASSERT_TRUE(r[0].headers.find("Content-Type: application/json\r\n") != std::string::npos);
+  TEST_ASSERT_TRUE(r[0].headers.find("Connection: keep-alive\r\n") != std::string::npos);
+  TEST_ASSERT_EQUAL_STRING("{\"path\":\"/status\"}", r[0].body.c_str());
+
+  struct { const char *request; int status; } cases[] = {
+    { "GET /nothing HTTP/1.1\r\n\r\n", 404 },
+    { "POST /status HTTP/1.1\r\nContent-Length: 0\r\n\r\n", 405 },
+    { "POST /tare HTTP/1.1\r\n\r\n", 400 },
+    { "POST /tare?food=rice HTTP/1.0\r\n\r\n", 202 },
+    { "GET /huge HTTP/1.1\r\n\r\n", 500 },
+  };
+  for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+    parser.reset();
+    parse(parser, cases[i].request);
+    out.text.clear();
+    router.respond(parser, out);
+    r = responses(out.text);
+    TEST_ASSERT_EQUAL(1, r.size());
+    TEST_ASSERT_EQUAL(cases[i].status, r[0].status);
+    std::string line = std::string("HTTP/1.1 ") + std::to_string(cases[i].status) + " " + RestRouter::reason(cases[i].status) + "\r\n";
+    TEST_ASSERT_EQUAL(0, r[0].headers.find(line));
+  }
+  TEST_ASSERT_TRUE(r[0].headers.find("Connection: close\r\n") != std::string::npos);
+}
+
+void test_router_table_full() {
+  RestRouter full;
+  for (int i = 0; i < REST_MAX_ROUTES; i++) {
+    TEST_ASSERT_TRUE(full.on("GET", "/status", statusRoute));
+  }
+  TEST_ASSERT_FALSE(full.on("GET", "/more", statusRoute));
+  TEST_ASSERT_FALSE(full.onStream("/stream", REST_NDJSON));
+}
+
+// a keep-alive connection answers requests one after the other, pipelined or dribbled in
+void test_server_keep_alive_and_pipelining() {
+  WiFiServer listener(80);
+  RestServer server(listener, router);
+  server.begin();
+  TEST_ASSERT_EQUAL(80, network.listening);
+  std::shared_ptr<FakeSocket> client = network.dial(
+    "GET /status HTTP/1.1\r\n\r\n"
+    "POST /tare HTTP/1.1\r\nContent-Length: 9\r\n\r\nfood=rice"
+    "GET /status HTTP/1.1\r\n\r\n");
+  for (unsigned long now = 0; now < 10; now++) {
+    server.poll(now);
+  }
+  std::vector<Response> r = responses(client->out);
+  TEST_ASSERT_EQUAL(3, r.size());
+  TEST_ASSERT_EQUAL(200, r[0].status);
+  TEST_ASSERT_EQUAL(202, r[1].status);
+  TEST_ASSERT_EQUAL_STRING("{\"food\":\"rice\"}", r[1].body.c_str());
+  TEST_ASSERT_EQUAL(200, r[2].status);
+  TEST_ASSERT_TRUE(client->open);
+  TEST_ASSERT_EQUAL(1, server.clients());
+
+  client->out.clear();
+  const char *request = "GET /status HTTP/1.1\r\nConnection: close\r\n\r\n";
+  for (const char *c = request; *c; c++) {
+    client->in += *c;
+    server.poll(100);
+  }
+  r = responses(client->out);
+  TEST_ASSERT_EQUAL(1, r.size());
+  TEST_ASSERT_FALSE(client->open);
+  TEST_ASSERT_EQUAL(0, server.clients());
+}
+
+void test_server_refusals_and_timeouts() {
+  WiFiServer listener(80);
+  RestServer server(listener, router);
+  server.begin();
+  std::shared_ptr<FakeSocket> bad = network.dial("GET /status FTP/1.1\r\n\r\n");
+  std::shared_ptr<FakeSocket> quiet = network.dial();
+  std::shared_ptr<FakeSocket> slow = network.dial("GET /sta");
+  server.poll(1000);
+  TEST_ASSERT_EQUAL(400, responses(bad->out)[0].status);
+  TEST_ASSERT_FALSE(bad->open);
+  TEST_ASSERT_EQUAL(2, server.clients());
+  server.poll(1000 + REST_IDLE_TIMEOUT_MS - 1);
+  TEST_ASSERT_EQUAL(2, server.clients());
+  server.poll(1000 + REST_IDLE_TIMEOUT_MS);
+  TEST_ASSERT_EQUAL(0, server.clients());
+  // a connection that never sent anything is closed without a word, half a request gets a 408
+  TEST_ASSERT_TRUE(quiet->out.empty());
+  TEST_ASSERT_FALSE(quiet->open);
+  TEST_ASSERT_EQUAL(408, responses(slow->out)[0].status);
+  TEST_ASSERT_FALSE(slow->open);
+}
+
+// all slots taken: the next client is answered 503 and closed, the others carry on
+void test_server_turns_away_extra_clients() {
+  WiFiServer listener(80);
+  RestServer server(listener, router);
+  server.begin();
+  std::vector<std::shared_ptr<FakeSocket> > clients;
+  for (int i = 0; i < REST_MAX_CLIENTS + 1; i++) {
+    clients.push_back(network.dial());
+  }
+  server.poll(0);
+  TEST_ASSERT_EQUAL(REST_MAX_CLIENTS, server.clients());
+  TEST_ASSERT_EQUAL(503, responses(clients.back()->out)[0].status);
+  TEST_ASSERT_FALSE(clients.back()->open);
+  // a slot freed by a client hanging up goes to the next one
+  clients[0]->close();
+  std::shared_ptr<FakeSocket> next = network.dial("GET /status HTTP/1.1\r\n\r\n");
+  server.poll(1);
+  TEST_ASSERT_EQUAL(REST_MAX_CLIENTS, server.clients());
+  TEST_ASSERT_EQUAL(200, responses(next->out)[0].status);
+}
+
+// one client with a pile of requests waiting gets REST_READ_BUDGET bytes a poll and doesn't hold up the rest
+void test_server_read_budget() {
+  WiFiServer listener(80);
+  RestServer server(listener, router);
+  server.begin();
+  std::string pile;
+  for (int i = 0; i < 50; i++) {
+    pile += "GET /status HTTP/1.1\r\n\r\n";
+  }
+  std::shared_ptr<FakeSocket> chatty = network.dial(pile);
+  std::shared_ptr<FakeSocket> other = network.dial("GET /status HTTP/1.1\r\n\r\n");
+  server.poll(0);
+  TEST_ASSERT_EQUAL(pile.size() - REST_READ_BUDGET, chatty->in.size());
+  TEST_ASSERT_EQUAL(1, responses(other->out).size());
+  unsigned long now = 1;
+  while (!chatty->in.empty()) {
+    server.poll(now++);
+  }
+  TEST_ASSERT_EQUAL((pile.size() + REST_READ_BUDGET - 1) / REST_READ_BUDGET, now);
+  TEST_ASSERT_EQUAL(50, responses(chatty->out).size());
+}
+
+// REST_MAX_CLIENTS clients at a time, each sending keep-alive requests a few bytes a poll and
+// hanging up after a while, new ones taking their place. Every request gets its own answer.
+void test_server_concurrent_load() {
+  WiFiServer listener(80);
+  RestServer server(listener, router);
+  server.begin();
+  struct Load {
+    std::shared_ptr<FakeSocket> socket;
+    std::string script;         // everything it sends
+    size_t sent;
+    int requests;
+  };
+  std::vector<Load> loads;
+  uint32_t seed = 12345;
+  const int total = 200;
+  int requests = 0;
+  for (int c = 0; c < total; c++) {
+    Load load;
+    load.requests = 1 + c % 7;
+    for (int i = 0; i < load.requests; i++) {
+      bool last = i == load.requests - 1;
+      if ((c + i) % 3) {
+        load.script += "GET /status?n=" + std::to_string(i) + " HTTP/1.1\r\n";
+      } else {
+        load.script += "POST /tare HTTP/1.1\r\nContent-Length: 11\r\n";
+      }
+      load.script += last ? "Connection: close\r\n\r\n" : "\r\n";
+      if ((c + i) % 3 == 0) {
+        load.script += "food=" + std::string(1, (char)('a' + c % 26)) + "bread";
+      }
+    }
+    load.sent = 0;
+    requests += load.requests;
+    loads.push_back(load);
+  }
+
+  size_t next = 0;
+  std::vector<size_t> active;
+  unsigned long now = 0;
+  int served = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  while (served < total) {
+    while (active.size() < REST_MAX_CLIENTS && next < loads.size()) {
+      loads[next].socket = network.dial();
+      active.push_back(next++);
+    }
+    for (size_t a = 0; a < active.size(); a++) {
+      Load &load = loads[active[a]];
+      seed = seed * 1103515245 + 12345;
+      size_t chunk = 1 + (seed >> 16) % 40;
+      size_t left = load.script.size() - load.sent;
+      chunk = chunk < left ? chunk : left;
+      load.socket->in += load.script.substr(load.sent, chunk);
+      load.sent += chunk;
+    }
+    server.poll(now++);
+    for (size_t a = 0; a < active.size();) {
+      if (loads[active[a]].socket->open) {
+        a++;
+        continue;
+      }
+      served++;
+      active.erase(active.begin() + a);
+    }
+    TEST_ASSERT_LESS_THAN(100000, now);
+  }
+  double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+  for (size_t c = 0; c < loads.size(); c++) {
+    std::vector<Response> r = responses(loads[c].socket->out);
+    TEST_ASSERT_EQUAL(loads[c].requests, r.size());
+    for (int i = 0; i < loads[c].requests; i++) {
+      if ((c + i) % 3) {
+        TEST_ASSERT_EQUAL(200, r[i].status);
+      } else {
+        std::string body = "{\"food\":\"" + std::string(1, (char)('a' + c % 26)) + "bread\"}";
+        TEST_ASSERT_EQUAL(202, r[i].status);
+        TEST_ASSERT_EQUAL_STRING(body.c_str(), r[i].body.c_str());
+      }
+    }
+  }
+  TEST_ASSERT_EQUAL(0, server.clients());
+  char message[96];
+  snprintf(message, sizeof(message), "%d clients, %d requests in %lu polls, %.2f us per request on the host",
+           total, requests, now, us / requests);
+  TEST_MESSAGE(message);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_parser_request_line_and_query);
+  RUN_TEST(test_parser_body_and_connection);
+  RUN_TEST(test_parser_refusals);
+  RUN_TEST(test_router_responses);
+  RUN_TEST(test_router_table_full);
+  RUN_TEST(test_server_keep_alive_and_pipelining);
+  RUN_TEST(test_server_refusals_and_timeouts);
+  RUN_TEST(test_server_turns_away_extra_clients);
+  RUN_TEST(test_server_read_budget);
+  RUN_TEST(test_server_concurrent_load);
+  return UNITY_END();
+}
@@ -0,0 +1,298 @@
+// RestServer's sample streams: SSE and chunked NDJSON framing, ?every=N,
+// slow clients dropped when their ring fills instead of holding up
+// broadcast(), and how many samples a second go out to a full set of clients.
+#include <Arduino.h>
+#include <Hal.h>
+#include <WiFiServer.h>
+#include "RestRouter.h"
+#include "RestServer.h"
+#include "../support/FakeNetwork.h"
+#include <unity.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+static std::string sample(int n) {
+  char line[64];
+  snprintf(line, sizeof(line), "{\"uptime\":%d,\"weight\":%d,\"settled\":%s}", n * 100, 250 + n % 7, n % 2 ? "true" : "false");
+  return line;
+}
+
+// the stream after its headers
+static std::string payload(const std::shared_ptr<FakeSocket> &socket) {
+  size_t end = socket->out.find("\r\n\r\n");
+  TEST_ASSERT_TRUE(end != std::string::npos);
+  return socket->out.substr(end + 4);
+}
+
+// the lines of an SSE stream, each event must be a single data: line
+static std::vector<std::string> events(const std::string &stream) {
+  std::vector<std::string> lines;
+  size_t at = 0;
+  while (at < stream.size()) {
+    size_t end = stream.find("\n\n", at);
+    TEST_ASSERT_TRUE(end != std::string::npos);
+    TEST_ASSERT_EQUAL(0, stream.compare(at, 6, "data: "));
+    std::string line = stream.substr(at + 6, end - at - 6);
+    TEST_ASSERT_TRUE(line.find('\n') == std::string::npos);
+    lines.push_back(line);
+    at = end + 2;
+  }
+  return lines;
+}
+
+// the lines of a chunked NDJSON stream, one newline terminated line per chunk
+static std::vector<std::string> chunks(const std::string &stream) {
+  std::vector<std::string> lines;
+  size_t at = 0;
+  while (at < stream.size()) {
+    size_t crlf = stream.find("\r\n", at);
+    TEST_ASSERT_TRUE(crlf != std::string::npos);
+    size_t size = strtoul(stream.substr(at, crlf - at).c_str(), 0, 16);
+    TEST_ASSERT_GREATER_THAN(0, size);
+    TEST_ASSERT_LESS_OR_EQUAL(stream.size(), crlf + 2 + size + 2);
+    std::string chunk = stream.substr(crlf + 2, size);
+    TEST_ASSERT_EQUAL('\n', chunk[size - 1]);
+    TEST_ASSERT_EQUAL(0, stream.compare(crlf + 2 + size, 2, "\r\n"));
+    lines.push_back(chunk.substr(0, size - 1));
+    at = crlf + 2 + size + 2;
+  }
+  return lines;
+}
+
+static FakeNetwork network;
+static HalDevices saved;
+static RestRouter router;
+
+void setUp() {
+  saved = hal;
+  network = FakeNetwork();
+  hal.network = &network;
+  router = RestRouter();
+  router.onStream("/stream", REST_NDJSON);
+  router.onStream("/events", REST_SSE);
+}
+
+void tearDown() {
+  hal = saved;
+}
+
+void test_sse_framing() {
+  WiFiServer listener(88);
+  RestServer server(listener, router);
+  server.begin();
+  std::shared_ptr<FakeSocket> client = network.dial("GET /events HTTP/1.1\r\n\r\n");
+  server.poll(0);
+  TEST_ASSERT_EQUAL(1, server.streams());
+  TEST_ASSERT_EQUAL(0, client->out.find("HTTP/1.1 200 OK\r\n"));
+  TEST_ASSERT_TRUE(client->out.find("Content-Type: text/event-stream\r\n") != std::string::npos);
+  for (int i = 0; i < 20; i++) {
+    server.broadcast(sample(i).c_str());
+    server.poll(i);
+  }
+  std::vector<std::string> lines = events(payload(client));
+  TEST_ASSERT_EQUAL(20, lines.size());
+  for (int i = 0; i < 20; i++) {
+    std::string expected = sample(i);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), lines[i].c_str());
+  }
+}
+
+void test_ndjson_chunks() {
+  WiFiServer listener(88);
+  RestServer server(listener, router);
+  server.begin();
+  std::shared_ptr<FakeSocket> client = network.dial("GET /stream HTTP/1.1\r\n\r\n");
+  server.poll(0);
+  TEST_ASSERT_TRUE(client->out.find("Transfer-Encoding: chunked\r\n") != std::string::npos);
+  TEST_ASSERT_TRUE(client->out.find("Content-Type: application/x-ndjson\r\n") != std::string::npos);
+  server.broadcast("{}");
+  server.broadcast(std::string(40, 'x').c_str());
+  for (int i = 0; i < 20; i++) {
+    server.broadcast(sample(i).c_str());
+    server.poll(i);
+  }
+  std::string stream = payload(client);
+  TEST_ASSERT_EQUAL(0, stream.find("3\r\n{}\n\r\n29\r\n"));
+  std::vector<std::string> lines = chunks(stream);
+  TEST_ASSERT_EQUAL(22, lines.size());
+  for (int i = 0; i < 20; i++) {
+    std::string expected = sample(i);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), lines[i + 2].c_str());
+  }
+}
+
+// ?every=N sends the first line and every Nth after it, anything unusable means every line
+void test_every_nth_line() {
+  struct { const char *query; int every; } cases[] = {
+    { "", 1 },
+    { "?every=3", 3 },
+    { "?every=1", 1 },
+    { "?every=0", 1 },
+    { "?every=-4", 1 },
+    { "?every=x", 1 },
+    { "?every=3x", 1 },
+    { "?every=255", 255 },
+    { "?every=256", 255 },
+    { "?every=99999999999999", 255 },
+  };
+  const int lines = 600;
+  for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+    network = FakeNetwork();
+    WiFiServer listener(88);
+    RestServer server(listener, router);
+    server.begin();
+    std::shared_ptr<FakeSocket> client = network.dial(std::string("GET /events") + cases[c].query + " HTTP/1.1\r\n\r\n");
+    server.poll(0);
+    for (int i = 0; i < lines; i++) {
+      server.broadcast(sample(i).c_str());
+      server.poll(i);
+    }
+    std::vector<std::string> got = events(payload(client));
+    TEST_ASSERT_EQUAL_MESSAGE((lines + cases[c].every - 1) / cases[c].every, got.size(), cases[c].query);
+    for (size_t i = 0; i < got.size(); i++) {
+      std::string expected = sample((int)i * cases[c].every);
+      TEST_ASSERT_EQUAL_STRING(expected.c_str(), got[i].c_str());
+    }
+  }
+}
+
+// only what the socket takes goes out each poll, the rest waits in the ring and comes out in order
+void test_drain_follows_socket_room() {
+  WiFiServer listener(88);
+  RestServer server(listener, router);
+  server.begin();
+  std::shared_ptr<FakeSocket> client = network.dial("GET /stream HTTP/1.1\r\n\r\n");
+  server.poll(0);
+  size_t headers = client->out.size();
+  client->room = 0;
+  for (int i = 0; i < 8; i++) {
+    server.broadcast(sample(i).c_str());
+  }
+  server.poll(1);
+  TEST_ASSERT_EQUAL(headers, client->out.size());
+  // ten bytes of room a poll, a new sample every fifth
+  int sent = 8;
+  for (int i = 2; i < 400; i++) {
+    size_t before = client->out.size();
+    client->room = 10;
+    server.poll(i);
+    TEST_ASSERT_EQUAL(10, client->out.size() - before);
+    if (i % 5 == 0) {
+      server.broadcast(sample(sent++).c_str());
+    }
+  }
+  client->room = 1 << 20;
+  server.poll(2000);
+  std::vector<std::string> lines = chunks(payload(client));
+  TEST_ASSERT_EQUAL(sent, lines.size());
+  for (size_t i = 0; i < lines.size(); i++) {
+    std::string expected = sample((int)i);
+    TEST_ASSERT_EQUAL_STRING(expected.c_str(), lines[i].c_str());
+  }
+  TEST_ASSERT_EQUAL(0, server.dropped());
+  TEST_ASSERT_EQUAL(1, server.streams());
+}
+
+// a client that stops reading is dropped once its ring is full, the others don't notice
+void test_slow_client_dropped() {
+  WiFiServer listener(88);
+  RestServer server(listener, router);
+  server.begin();
+  std::shared_ptr<FakeSocket> stuck = network.dial("GET /events HTTP/1.1\r\n\r\n");
+  std::shared_ptr<FakeSocket> fine = network.dial("GET /events HTTP/1.1\r\n\r\n");
+  server.poll(0);
+  stuck->room = 0;
+  std::string line = sample(1);
+  size_t event = line.size() + 8;
+  int fits = REST_STREAM_BUFFER / (int)event;
+  for (int i = 0; i < fits; i++) {
+    server.broadcast(line.c_str());
+    server.poll(i);
+  }
+  TEST_ASSERT_EQUAL(2, server.streams());
+  TEST_ASSERT_TRUE(stuck->open);
+  server.broadcast(line.c_str());
+  TEST_ASSERT_FALSE(stuck->open);
+  TEST_ASSERT_EQUAL(1, server.dropped());
+  TEST_ASSERT_EQUAL(1, server.streams());
+  server.poll(100);
+  TEST_ASSERT_EQUAL(fits + 1, events(payload(fine)).size());
+  // the slot is free for the next client
+  std::shared_ptr<FakeSocket> next = network.dial("GET /events HTTP/1.1\r\n\r\n");
+  server.poll(101);
+  TEST_ASSERT_EQUAL(2, server.streams());
+  TEST_ASSERT_EQUAL(0, next->out.find("HTTP/1.1 200 OK\r\n"));
+}
+
+// a stream only goes one way, whatever the client sends is read and dropped
+void test_stream_ignores_input() {
+  WiFiServer listener(88);
+  RestServer server(listener, router);
+  server.begin();
+  std::shared_ptr<FakeSocket> client = network.dial("GET /events HTTP/1.1\r\n\r\nGET /events HTTP/1.1\r\n\r\n");
+  server.poll(0);
+  server.poll(1);
+  TEST_ASSERT_TRUE(client->in.empty());
+  size_t headers = client->out.size();
+  TEST_ASSERT_EQUAL(headers, client->out.find("\r\n\r\n") + 4);
+  // streams stay open past the idle timeout
+  server.poll(REST_IDLE_TIMEOUT_MS * 3);
+  TEST_ASSERT_EQUAL(1, server.streams());
+  client->close();
+  server.poll(REST_IDLE_TIMEOUT_MS * 3 + 1);
+  TEST_ASSERT_EQUAL(0, server.streams());
+  server.broadcast(sample(0).c_str());
+  TEST_ASSERT_EQUAL(headers, client->out.size());
+}
+
+// every slot a stream, one sample a poll like the firmware's loop(), lines the size streamSample() writes
+void test_stream_throughput() {
+  WiFiServer listener(88);
+  RestServer server(listener, router);
+  server.begin();
+  std::vector<std::shared_ptr<FakeSocket> > clients;
+  for (int i = 0; i < REST_MAX_CLIENTS; i++) {
+    clients.push_back(network.dial(i % 2 ? "GET /events HTTP/1.1\r\n\r\n" : "GET /stream HTTP/1.1\r\n\r\n"));
+  }
+  server.poll(0);
+  TEST_ASSERT_EQUAL(REST_MAX_CLIENTS, server.streams());
+  std::vector<std::string> lines;
+  for (int i = 0; i < 1000; i++) {
+    lines.push_back(sample(i));
+  }
+  const int samples = 100000;
+  size_t bytes = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (int i = 0; i < samples; i++) {
+    server.broadcast(lines[i % 1000].c_str());
+    server.poll(i);
+    if (i % 1000 == 999) {
+      for (size_t c = 0; c < clients.size(); c++) {
+        bytes += clients[c]->out.size();
+        clients[c]->out.clear();
+        clients[c]->room = 1 << 20;     // a reader that keeps up
+      }
+    }
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  TEST_ASSERT_EQUAL(0, server.dropped());
+  TEST_ASSERT_EQUAL(REST_MAX_CLIENTS, server.streams());
+  char message[120];
+  snprintf(message, sizeof(message), "%d clients: %.0f samples/s, %.1f MB/s of stream on the host",
+           REST_MAX_CLIENTS, samples / seconds, bytes / seconds / 1e6);
+  TEST_MESSAGE(message);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_sse_framing);
+  RUN_TEST(test_ndjson_chunks);
+  RUN_TEST(test_every_nth_line);
+  RUN_TEST(test_drain_follows_socket_room);
+  RUN_TEST(test_slow_client_dropped);
+  RUN_TEST(test_stream_ignores_input);
+  RUN_TEST(test_stream_throughput);
+  return UNITY_END();
+}
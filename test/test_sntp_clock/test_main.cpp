@@ -0,0 +1,236 @@
+// SntpClock against a UDP socket the test answers for the server: the offset
+// from one exchange, timeouts and retries, replies it has to ignore, and
+// millis() wrapping after 49.7 days.
+#include <Arduino.h>
+#include <Udp.h>
+#include "SntpClock.h"
+#include <unity.h>
+#include <string.h>
+#include <vector>
+
+#define NTP_UNIX_OFFSET 2208988800ULL
+
+struct Packet {
+  std::vector<uint8_t> bytes;
+};
+
+class FakeUdp : public UDP {
+public:
+  bool opens = true;
+  uint16_t localPort = 0;
+  const char *host = 0;
+  uint16_t port = 0;
+  std::vector<uint8_t> building;
+  std::vector<Packet> sent;
+  std::vector<Packet> replies;
+  std::vector<uint8_t> current;
+  size_t at = 0;
+  uint8_t begin(uint16_t p) { localPort = p; return opens; }
+  void stop() {}
+  int beginPacket(IPAddress, uint16_t) { return 0; }
+  int beginPacket(const char *h, uint16_t p) {
+    host = h;
+    port = p;
+    building.clear();
+    return 1;
+  }
+  int endPacket() {
+    Packet packet;
+    packet.bytes = building;
+    sent.push_back(packet);
+    return 1;
+  }
+  size_t write(uint8_t c) { building.push_back(c); return 1; }
+  size_t write(const uint8_t *buffer, size_t size) { building.insert(building.end(), buffer, buffer + size); return size; }
+  int parsePacket() {
+    if (replies.empty()) {
+      return 0;
+    }
+    current = replies.front().bytes;
+    replies.erase(replies.begin());
+    at = 0;
+    return (int)current.size();
+  }
+  int available() { return (int)(current.size() - at); }
+  int read() { return available() > 0 ? current[at++] : -1; }
+  int read(unsigned char *buffer, size_t length) {
+    size_t n = 0;
+    while (n < length && available() > 0) {
+      buffer[n++] = current[at++];
+    }
+    return (int)n;
+  }
+  int read(char *buffer, size_t length) { return read((unsigned char *)buffer, length); }
+  int peek() { return available() > 0 ? current[at] : -1; }
+  void flush() { at = current.size(); }
+  IPAddress remoteIP() { return IPAddress(); }
+  uint16_t remotePort() { return SNTP_PORT; }
+
+  // the server's answer to the last request, its clock reading epochMs when it sent it
+  void reply(uint64_t epochMs, uint8_t stratum = 2, bool echo = true) {
+    TEST_ASSERT_FALSE(sent.empty());
+    Packet packet;
+    packet.bytes.assign(48, 0);
+    packet.bytes[0] = 0x24;     // version 4, server mode
+    packet.bytes[1] = stratum;
+    if (echo) {
+      memcpy(&packet.bytes[24], &sent.back().bytes[40], 8);
+    }
+    uint64_t seconds = epochMs / 1000 + NTP_UNIX_OFFSET;
+    uint64_t fraction = ((epochMs % 1000) << 32) / 1000 + 1;
+    for (uint8_t i = 0; i < 4; i++) {
+      packet.bytes[40 + i] = (uint8_t)(seconds >> (8 * (3 - i)));
+      packet.bytes[44 + i] = (uint8_t)(fraction >> (8 * (3 - i)));
+    }
+    replies.push_back(packet);
+  }
+};
+
+static const uint64_t serverTime = 1700000000250ULL;
+static FakeUdp udp;
+
+void setUp() {
+  udp = FakeUdp();
+}
+
+void tearDown() {
+}
+
+void test_request_format() {
+  SntpClock clock(udp, "pool.ntp.org");
+  clock.poll(1000, true);
+  TEST_ASSERT_EQUAL(SNTP_LOCAL_PORT, udp.localPort);
+  TEST_ASSERT_EQUAL_STRING("pool.ntp.org", udp.host);
+  TEST_ASSERT_EQUAL(SNTP_PORT, udp.port);
+  TEST_ASSERT_EQUAL(1, udp.sent.size());
+  TEST_ASSERT_EQUAL(48, udp.sent[0].bytes.size());
+  TEST_ASSERT_EQUAL_HEX8(0x23, udp.sent[0].bytes[0]);
+  // waiting for the answer, no second request
+  clock.poll(1100, true);
+  TEST_ASSERT_EQUAL(1, udp.sent.size());
+}
+
+// the server's time is taken as half way through a 100ms round trip
+void test_reply_sets_offset() {
+  SntpClock clock(udp, "pool.ntp.org");
+  clock.poll(1000, true);
+  TEST_ASSERT_FALSE(clock.synced());
+  udp.reply(serverTime);
+  clock.poll(1100, true);
+  TEST_ASSERT_TRUE(clock.synced());
+  TEST_ASSERT_TRUE(clock.epochMs(clock.uptime(1100)) == serverTime + 50);
+  TEST_ASSERT_TRUE(clock.epochMs(clock.uptime(61100)) == serverTime + 60050);
+}
+
+void test_timeout_then_retry() {
+  SntpClock clock(udp, "pool.ntp.org");
+  clock.poll(0, true);
+  clock.poll(SNTP_TIMEOUT_MS - 1, true);
+  clock.poll(SNTP_TIMEOUT_MS, true);
+  TEST_ASSERT_EQUAL(1, udp.sent.size());
+  // a late answer to a request given up on doesn't count
+  udp.reply(serverTime);
+  clock.poll(SNTP_TIMEOUT_MS + SNTP_RETRY_MS - 1, true);
+  TEST_ASSERT_FALSE(clock.synced());
+  TEST_ASSERT_EQUAL(1, udp.sent.size());
+  udp.replies.clear();
+  clock.poll(SNTP_TIMEOUT_MS + SNTP_RETRY_MS, true);
+  TEST_ASSERT_EQUAL(2, udp.sent.size());
+}
+
+// a kiss of death, an answer to another request or a short packet leave the clock unsynced
+void test_ignores_bad_replies() {
+  SntpClock clock(udp, "pool.ntp.org");
+  clock.poll(5000, true);
+  udp.reply(serverTime, 0);
+  clock.poll(5010, true);
+  udp.reply(serverTime, 2, false);
+  clock.poll(5020, true);
+  udp.reply(serverTime);
+  udp.replies.back().bytes.resize(40);
+  clock.poll(5030, true);
+  TEST_ASSERT_FALSE(clock.synced());
+  udp.reply(serverTime);
+  clock.poll(5040, true);
+  TEST_ASSERT_TRUE(clock.synced());
+}
+
+void test_resyncs_once_a_day() {
+  SntpClock clock(udp, "pool.ntp.org");
+  clock.poll(0, true);
+  udp.reply(serverTime);
+  clock.poll(0, true);
+  clock.poll(SNTP_RESYNC_MS - 1, true);
+  TEST_ASSERT_EQUAL(1, udp.sent.size());
+  clock.poll(SNTP_RESYNC_MS, true);
+  TEST_ASSERT_EQUAL(2, udp.sent.size());
+}
+
+void test_offline_drops_request_and_waits_for_socket() {
+  SntpClock clock(udp, "pool.ntp.org");
+  udp.opens = false;
+  clock.poll(0, true);
+  TEST_ASSERT_EQUAL(0, udp.sent.size());
+  udp.opens = true;
+  clock.poll(10, true);
+  TEST_ASSERT_EQUAL(1, udp.sent.size());
+  clock.poll(20, false);
+  udp.reply(serverTime);
+  clock.poll(30, true);
+  TEST_ASSERT_FALSE(clock.synced());
+}
+
+// uptime keeps counting through the millis() wrap as long as it is called in between
+void test_uptime_across_wrap() {
+  SntpClock clock(udp, "pool.ntp.org");
+  uint64_t expected = 0;
+  uint32_t ms = 0;
+  for (int i = 0; i < 100; i++) {
+    ms += 0x7F000000UL;
+    expected += 0x7F000000UL;
+    TEST_ASSERT_TRUE(clock.uptime(ms) == expected);
+  }
+  TEST_ASSERT_GREATER_THAN(0xFFFFFFFFULL, expected);
+}
+
+// a stamp from just before the wrap, read just after it, is ms before now and not a wrap ahead
+void test_stamp_from_before_wrap() {
+  SntpClock clock(udp, "pool.ntp.org");
+  clock.uptime(0x70000000UL);
+  clock.uptime(0xE0000000UL);
+  clock.uptime(0xFFFFFF00UL);
+  uint64_t now = clock.uptime(0x100);
+  TEST_ASSERT_TRUE(now == 0x100000100ULL);
+  TEST_ASSERT_TRUE(clock.uptimeAt(0xFFFFFF80UL, 0x200) == 0xFFFFFF80ULL);
+  // an older stamp handed to uptime() itself isn't taken for another wrap either
+  TEST_ASSERT_TRUE(clock.uptime(0xFFFFFFF0UL) == 0xFFFFFFF0ULL);
+  TEST_ASSERT_TRUE(clock.uptime(0x300) == 0x100000300ULL);
+}
+
+// the exchange straddles the wrap, the round trip is still 512ms
+void test_sync_across_wrap() {
+  SntpClock clock(udp, "pool.ntp.org");
+  for (uint32_t i = 0; i < 16; i++) {
+    clock.poll(i * 0x10000000UL, false);
+  }
+  clock.poll(0xFFFFFF00UL, true);
+  udp.reply(serverTime);
+  clock.poll(0x100, true);
+  TEST_ASSERT_TRUE(clock.synced());
+  TEST_ASSERT_TRUE(clock.epochMs(clock.uptime(0x100)) == serverTime + 256);
+  TEST_ASSERT_TRUE(clock.epochMs(clock.uptimeAt(0xFFFFFFFFUL, 0x200)) == serverTime + 256 - 0x101);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_request_format);
+  RUN_TEST(test_reply_sets_offset);
+  RUN_TEST(test_timeout_then_retry);
+  RUN_TEST(test_ignores_bad_replies);
+  RUN_TEST(test_resyncs_once_a_day);
+  RUN_TEST(test_offline_drops_request_and_waits_for_socket);
+  RUN_TEST(test_uptime_across_wrap);
+  RUN_TEST(test_stamp_from_before_wrap);
+  RUN_TEST(test_sync_across_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+// StabilityDetector fed synthetic traces: when a full window counts as
+// settled, where the deviation and slope limits sit, and re-arming on a new load.
+#include "StabilityDetector.h"
+#include <unity.h>
+
+// the limits the tests run with, in counts and counts per reading
+#define MAX_STD_DEV 10
+#define MAX_SLOPE 1
+#define LOAD_DELTA 50
+
+// settle events while feeding count readings of value, plus wobble alternately added and taken off
+static int feed(StabilityDetector &detector, long value, int count, long wobble = 0) {
+  int events = 0;
+  for (int i = 0; i < count; i++) {
+    if (detector.update(value + (i % 2 ? -wobble : wobble))) {
+      events++;
+    }
+  }
+  return events;
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+// nothing is decided before the window is full, then one event for as long as it stays settled
+void test_settles_once_the_window_is_full() {
+  StabilityDetector detector(MAX_STD_DEV, MAX_SLOPE, LOAD_DELTA);
+  TEST_ASSERT_EQUAL(0, feed(detector, 1000, STABILITY_WINDOW - 1));
+  TEST_ASSERT_FALSE(detector.settled());
+  TEST_ASSERT_EQUAL(0, detector.confidence());
+  TEST_ASSERT_TRUE(detector.update(1000));
+  TEST_ASSERT_TRUE(detector.settled());
+  TEST_ASSERT_EQUAL(100, detector.confidence());
+  TEST_ASSERT_EQUAL(1000, detector.settledValue());
+  TEST_ASSERT_TRUE(detector.loadChanged());
+  TEST_ASSERT_EQUAL(0, feed(detector, 1000, 5 * STABILITY_WINDOW));
+  TEST_ASSERT_TRUE(detector.settled());
+}
+
+// alternating +-w has a standard deviation of w, just under the limit settles and just over doesn't
+void test_standard_deviation_threshold() {
+  StabilityDetector under(MAX_STD_DEV, MAX_SLOPE, LOAD_DELTA);
+  TEST_ASSERT_EQUAL(1, feed(under, 1000, 2 * STABILITY_WINDOW, MAX_STD_DEV - 1));
+  TEST_ASSERT_GREATER_THAN(0, under.confidence());
+  TEST_ASSERT_LESS_THAN(100, under.confidence());
+  StabilityDetector over(MAX_STD_DEV, MAX_SLOPE, LOAD_DELTA);
+  TEST_ASSERT_EQUAL(0, feed(over, 1000, 2 * STABILITY_WINDOW, MAX_STD_DEV + 1));
+  TEST_ASSERT_FALSE(over.settled());
+  TEST_ASSERT_EQUAL(0, over.confidence());
+}
+
+// a slow creep stays well inside the deviation limit, only the slope keeps it from settling
+void test_slope_threshold() {
+  StabilityDetector slow(MAX_STD_DEV, 2 * MAX_SLOPE, LOAD_DELTA);
+  StabilityDetector fast(MAX_STD_DEV, 2 * MAX_SLOPE, LOAD_DELTA);
+  int slowEvents = 0;
+  int fastEvents = 0;
+  for (long i = 0; i < 3 * STABILITY_WINDOW; i++) {
+    slowEvents += slow.update(1000 + i);
+    fastEvents += fast.update(1000 + 3 * i);
+  }
+  TEST_ASSERT_EQUAL(1, slowEvents);
+  TEST_ASSERT_EQUAL(0, fastEvents);
+  TEST_ASSERT_FALSE(fast.settled());
+}
+
+// a new weight unsettles the window and settles again as a changed load, once the step has left it
+void test_rearms_on_load_change() {
+  StabilityDetector detector(MAX_STD_DEV, MAX_SLOPE, LOAD_DELTA);
+  TEST_ASSERT_EQUAL(1, feed(detector, 1000, STABILITY_WINDOW));
+  TEST_ASSERT_FALSE(detector.update(5000));
+  TEST_ASSERT_FALSE(detector.settled());
+  TEST_ASSERT_EQUAL(0, feed(detector, 5000, STABILITY_WINDOW - 2));
+  TEST_ASSERT_TRUE(detector.update(5000));
+  TEST_ASSERT_EQUAL(5000, detector.settledValue());
+  TEST_ASSERT_TRUE(detector.loadChanged());
+}
+
+// knocked and put back within LOAD_DELTA, it settles again but as the same load
+void test_same_load_after_a_knock() {
+  StabilityDetector detector(MAX_STD_DEV, MAX_SLOPE, LOAD_DELTA);
+  feed(detector, 1000, STABILITY_WINDOW);
+  TEST_ASSERT_FALSE(detector.update(1400));
+  TEST_ASSERT_EQUAL(1, feed(detector, 1000 + LOAD_DELTA - 1, STABILITY_WINDOW));
+  TEST_ASSERT_EQUAL(1000 + LOAD_DELTA - 1, detector.settledValue());
+  TEST_ASSERT_FALSE(detector.loadChanged());
+  feed(detector, 1000 + LOAD_DELTA - 1, STABILITY_WINDOW);
+  TEST_ASSERT_FALSE(detector.update(600));
+  TEST_ASSERT_EQUAL(1, feed(detector, 1000 + 2 * LOAD_DELTA, STABILITY_WINDOW));
+  TEST_ASSERT_TRUE(detector.loadChanged());
+}
+
+// reset() empties the window but keeps the last settled value to compare the next load with
+void test_reset_waits_for_a_full_window() {
+  StabilityDetector detector(MAX_STD_DEV, MAX_SLOPE, LOAD_DELTA);
+  feed(detector, 1000, STABILITY_WINDOW);
+  detector.reset();
+  TEST_ASSERT_FALSE(detector.settled());
+  TEST_ASSERT_EQUAL(0, feed(detector, 1000, STABILITY_WINDOW - 1));
+  TEST_ASSERT_TRUE(detector.update(1000));
+  TEST_ASSERT_FALSE(detector.loadChanged());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_settles_once_the_window_is_full);
+  RUN_TEST(test_standard_deviation_threshold);
+  RUN_TEST(test_slope_threshold);
+  RUN_TEST(test_rearms_on_load_change);
+  RUN_TEST(test_same_load_after_a_knock);
+  RUN_TEST(test_reset_waits_for_a_full_window);
+  return UNITY_END();
+}
@@ -0,0 +1,203 @@
+// TelemetryCodec round trips at the edges of every field, and the bodies
+// BinaryReadingEncoder sends.
+#include <Arduino.h>
+#include <TelemetryCodec.h>
+#include "BinaryReadingEncoder.h"
+#include "JsonReadingEncoder.h"
+#include "HttpUploader.h"
+#include <unity.h>
+#include <vector>
+
+class BytePrint : public Print {
+public:
+  std::vector<uint8_t> bytes;
+  size_t write(uint8_t c) { bytes.push_back(c); return 1; }
+  size_t write(const uint8_t *data, size_t size) { bytes.insert(bytes.end(), data, data + size); return size; }
+};
+
+static const int32_t weights[] = { 0, 1, -1, 23, 24, -24, -25, 255, 256, -256, -257, 65535, 65536,
+                                   -65537, 2147483647, (int32_t)0x80000000 };
+static const uint64_t times[] = { 0, 23, 24, 0xFFFFFFFFULL, 0x100000000ULL, 1700000000123ULL, 0xFFFFFFFFFFFFFFFFULL };
+
+static void assertSame(const TelemetryReading &expected, const TelemetryReading &actual) {
+  TEST_ASSERT_EQUAL_HEX32(expected.seq, actual.seq);
+  TEST_ASSERT_TRUE(expected.timestamp == actual.timestamp);
+  TEST_ASSERT_EQUAL(expected.weight, actual.weight);
+  TEST_ASSERT_EQUAL(expected.food, actual.food);
+  TEST_ASSERT_EQUAL(expected.flags, actual.flags);
+}
+
+static const char *foodName(uint16_t) {
+  return "Oats";
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+void test_record_round_trip() {
+  uint8_t buffer[TELEMETRY_RECORD_SIZE];
+  for (size_t w = 0; w < sizeof(weights) / sizeof(weights[0]); w++) {
+    for (size_t t = 0; t < sizeof(times) / sizeof(times[0]); t++) {
+      TelemetryReading in = { 0xFFFFFFFF - (uint32_t)t, times[t], weights[w], (uint16_t)(w * 4099), (uint8_t)(t & 1) };
+      TEST_ASSERT_EQUAL(TELEMETRY_RECORD_SIZE, TelemetryCodec::encodeRecord(in, buffer));
+      TelemetryReading out;
+      TEST_ASSERT_EQUAL(TELEMETRY_RECORD_SIZE, TelemetryCodec::decodeRecord(buffer, sizeof(buffer), out));
+      assertSame(in, out);
+    }
+  }
+}
+
+void test_record_rejects_short_or_unknown() {
+  TelemetryReading in = { 1, 2, 3, 4, 0 };
+  uint8_t buffer[TELEMETRY_RECORD_SIZE];
+  TelemetryCodec::encodeRecord(in, buffer);
+  TelemetryReading out;
+  TEST_ASSERT_EQUAL(0, TelemetryCodec::decodeRecord(buffer, TELEMETRY_RECORD_SIZE - 1, out));
+  buffer[0] = 9;
+  TEST_ASSERT_EQUAL(0, TelemetryCodec::decodeRecord(buffer, sizeof(buffer), out));
+}
+
+// {0: 1, 4: 5, 2: -1, 3: 2} as RFC 8949 spells it
+void test_cbor_known_bytes() {
+  TelemetryReading in = { 1, 5, -1, 2, 0 };
+  uint8_t buffer[TELEMETRY_CBOR_MAX];
+  const uint8_t expected[] = { 0xA4, 0x00, 0x01, 0x04, 0x05, 0x02, 0x20, 0x03, 0x02 };
+  TEST_ASSERT_EQUAL(sizeof(expected), TelemetryCodec::encodeCbor(in, buffer));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expected, buffer, sizeof(expected));
+  in.flags = TELEMETRY_FLAG_EPOCH;
+  in.weight = 1000;
+  const uint8_t epoch[] = { 0xA4, 0x00, 0x01, 0x01, 0x05, 0x02, 0x19, 0x03, 0xE8, 0x03, 0x02 };
+  TEST_ASSERT_EQUAL(sizeof(epoch), TelemetryCodec::encodeCbor(in, buffer));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(epoch, buffer, sizeof(epoch));
+}
+
+void test_cbor_round_trip() {
+  uint8_t buffer[TELEMETRY_CBOR_MAX];
+  for (size_t w = 0; w < sizeof(weights) / sizeof(weights[0]); w++) {
+    for (size_t t = 0; t < sizeof(times) / sizeof(times[0]); t++) {
+      TelemetryReading in = { (uint32_t)(w << (t * 4)), times[t], weights[w], (uint16_t)(0xFFFF >> w), (uint8_t)(t & 1) };
+      size_t length = TelemetryCodec::encodeCbor(in, buffer);
+      TEST_ASSERT_LESS_OR_EQUAL(TELEMETRY_CBOR_MAX, length);
+      TelemetryReading out;
+      TEST_ASSERT_EQUAL(length, TelemetryCodec::decodeCbor(buffer, length, out));
+      assertSame(in, out);
+    }
+  }
+}
+
+// worst case on every field has to fit the buffer the encoder uses
+void test_cbor_worst_case_fits() {
+  TelemetryReading in = { 0xFFFFFFFF, 0xFFFFFFFFFFFFFFFFULL, (int32_t)0x80000000, 0xFFFF, TELEMETRY_FLAG_EPOCH };
+  uint8_t buffer[TELEMETRY_CBOR_MAX + 8];
+  TEST_ASSERT_LESS_OR_EQUAL(TELEMETRY_CBOR_MAX, TelemetryCodec::encodeCbor(in, buffer));
+}
+
+void test_cbor_truncated_input_fails() {
+  TelemetryReading in = { 123456, 1700000000123ULL, -4321, 300, TELEMETRY_FLAG_EPOCH };
+  uint8_t buffer[TELEMETRY_CBOR_MAX];
+  size_t length = TelemetryCodec::encodeCbor(in, buffer);
+  TelemetryReading out;
+  for (size_t cut = 0; cut < length; cut++) {
+    TEST_ASSERT_EQUAL(0, TelemetryCodec::decodeCbor(buffer, cut, out));
+  }
+}
+
+// a newer scale may add fields, an older collector skips the keys it doesn't know
+void test_cbor_skips_unknown_keys() {
+  const uint8_t in[] = { 0xA5, 0x00, 0x09, 0x18, 0x63, 0x19, 0x12, 0x34, 0x04, 0x05, 0x02, 0x20, 0x03, 0x02 };
+  TelemetryReading out;
+  TEST_ASSERT_EQUAL(sizeof(in), TelemetryCodec::decodeCbor(in, sizeof(in), out));
+  TelemetryReading expected = { 9, 5, -1, 2, 0 };
+  assertSame(expected, out);
+}
+
+void test_cbor_array_head() {
+  uint8_t buffer[9];
+  const uint32_t counts[] = { 0, 23, 24, 255, 256, 70000 };
+  for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+    size_t length = TelemetryCodec::encodeCborArray(counts[i], buffer);
+    uint32_t count = 0;
+    TEST_ASSERT_EQUAL(length, TelemetryCodec::decodeCborArray(buffer, length, count));
+    TEST_ASSERT_EQUAL(counts[i], count);
+  }
+  TelemetryReading map = { 1, 2, 3, 4, 0 };
+  TelemetryCodec::encodeCbor(map, buffer);
+  uint32_t count;
+  TEST_ASSERT_EQUAL(0, TelemetryCodec::decodeCborArray(buffer, 1, count));
+}
+
+// the body the uploader sends for a batch decodes back to the queued readings
+void test_encoder_batch_decodes() {
+  Reading readings[3] = { { 10, 1700000000000ULL, 250, 3, READING_EPOCH },
+                          { 11, 61000, -5, 4, 0 },
+                          { 12, 1700000005000ULL, 70000, 300, READING_EPOCH } };
+  BinaryReadingEncoder cbor(BinaryReadingEncoder::CBOR);
+  BytePrint out;
+  size_t written = cbor.begin(3, out);
+  for (uint8_t i = 0; i < 3; i++) {
+    written += cbor.item(readings[i], i, 3, out);
+  }
+  written += cbor.end(3, out);
+  TEST_ASSERT_EQUAL(out.bytes.size(), written);
+  TEST_ASSERT_EQUAL_STRING(TELEMETRY_CBOR_TYPE, cbor.contentType());
+
+  uint32_t count;
+  size_t used = TelemetryCodec::decodeCborArray(out.bytes.data(), out.bytes.size(), count);
+  TEST_ASSERT_EQUAL(3, count);
+  for (uint8_t i = 0; i < 3; i++) {
+    TelemetryReading decoded;
+    size_t n = TelemetryCodec::decodeCbor(out.bytes.data() + used, out.bytes.size() - used, decoded);
+    TEST_ASSERT_GREATER_THAN(0, n);
+    used += n;
+    TEST_ASSERT_EQUAL(readings[i].seq, decoded.seq);
+    TEST_ASSERT_TRUE(readings[i].time == decoded.timestamp);
+    TEST_ASSERT_EQUAL(readings[i].weight, decoded.weight);
+    TEST_ASSERT_EQUAL(readings[i].food, decoded.food);
+    TEST_ASSERT_EQUAL((readings[i].flags & READING_EPOCH) ? TELEMETRY_FLAG_EPOCH : 0, decoded.flags);
+  }
+  TEST_ASSERT_EQUAL(out.bytes.size(), used);
+
+  BinaryReadingEncoder record(BinaryReadingEncoder::RECORD);
+  BytePrint records;
+  record.begin(3, records);
+  for (uint8_t i = 0; i < 3; i++) {
+    record.item(readings[i], i, 3, records);
+  }
+  record.end(3, records);
+  TEST_ASSERT_EQUAL(3 * TELEMETRY_RECORD_SIZE, records.bytes.size());
+  TelemetryReading last;
+  TelemetryCodec::decodeRecord(records.bytes.data() + 2 * TELEMETRY_RECORD_SIZE, TELEMETRY_RECORD_SIZE, last);
+  TEST_ASSERT_EQUAL(70000, last.weight);
+}
+
+// a single CBOR reading is the bare map, and a good deal smaller than the same reading as JSON
+void test_single_cbor_is_bare_and_small() {
+  Reading reading = { 4711, 1700000000123ULL, 1234, 17, READING_EPOCH };
+  BinaryReadingEncoder cbor(BinaryReadingEncoder::CBOR);
+  BytePrint out;
+  TEST_ASSERT_EQUAL(0, cbor.begin(1, out));
+  cbor.item(reading, 0, 1, out);
+  TEST_ASSERT_EQUAL_HEX8(0xA4, out.bytes[0]);
+  JsonReadingEncoder json(foodName);
+  CountingPrint jsonLength;
+  json.item(reading, 0, 1, jsonLength);
+  TEST_ASSERT_LESS_THAN(jsonLength.count() / 2, out.bytes.size());
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_record_round_trip);
+  RUN_TEST(test_record_rejects_short_or_unknown);
+  RUN_TEST(test_cbor_known_bytes);
+  RUN_TEST(test_cbor_round_trip);
+  RUN_TEST(test_cbor_worst_case_fits);
+  RUN_TEST(test_cbor_truncated_input_fails);
+  RUN_TEST(test_cbor_skips_unknown_keys);
+  RUN_TEST(test_cbor_array_head);
+  RUN_TEST(test_encoder_batch_decodes);
+  RUN_TEST(test_single_cbor_is_bare_and_small);
+  return UNITY_END();
+}
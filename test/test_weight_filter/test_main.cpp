@@ -0,0 +1,179 @@
+// The filter stages: how fast each settles on a step, what noise and spikes
+// do to the output, and how long the chain the firmware uses takes per sample.
+#include <Arduino.h>
+#include "WeightFilter.h"
+#include <unity.h>
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// the same noise every run, roughly uniform in +-amplitude
+static uint32_t noiseState;
+static long noise(long amplitude) {
+  noiseState = noiseState * 1103515245UL + 12345UL;
+  return (long)((noiseState >> 8) % (2 * amplitude + 1)) - amplitude;
+}
+
+// samples until the output stays within tolerance of target for the rest of count samples
+template <typename Filter>
+static int settleSamples(Filter &filter, long from, long to, long amplitude, long tolerance, int count) {
+  for (int i = 0; i < 50; i++) {
+    filter.update(from + noise(amplitude));
+  }
+  int settled = -1;
+  for (int i = 0; i < count; i++) {
+    long out = filter.update(to + noise(amplitude));
+    if (labs(out - to) > tolerance) {
+      settled = -1;
+    } else if (settled < 0) {
+      settled = i + 1;
+    }
+  }
+  return settled;
+}
+
+void setUp() {
+  noiseState = 1;
+}
+
+void tearDown() {
+}
+
+void test_median_drops_single_spike() {
+  MedianFilter<3> median;
+  median.update(1000);
+  median.update(1000);
+  TEST_ASSERT_EQUAL(1000, median.update(90000));
+  TEST_ASSERT_EQUAL(1000, median.update(1000));
+  TEST_ASSERT_EQUAL(1000, median.update(-90000));
+}
+
+void test_median_follows_step_after_half_window() {
+  MedianFilter<5> median;
+  for (int i = 0; i < 5; i++) {
+    median.update(0);
+  }
+  TEST_ASSERT_EQUAL(0, median.update(500));
+  TEST_ASSERT_EQUAL(0, median.update(500));
+  TEST_ASSERT_EQUAL(500, median.update(500));
+}
+
+void test_ema_primes_and_settles() {
+  EmaFilter<3> ema;
+  TEST_ASSERT_EQUAL(4000, ema.update(4000));
+  // alpha 1/8: 1% of a step is left after ln(100) * 8 = 37 samples
+  int settled = settleSamples(ema, 4000, 14000, 0, 100, 100);
+  TEST_ASSERT_INT_WITHIN(3, 36, settled);
+}
+
+void test_ema_handles_negative_counts() {
+  EmaFilter<4> ema;
+  for (int i = 0; i < 200; i++) {
+    ema.update(-250000);
+  }
+  TEST_ASSERT_INT_WITHIN(16, -250000, ema.update(-250000));
+}
+
+void test_kalman_restarts_on_large_step() {
+  KalmanFilter<16, 900, 2000> kalman;
+  for (int i = 0; i < 20; i++) {
+    kalman.update(10000);
+  }
+  TEST_ASSERT_EQUAL(60000, kalman.update(60000));
+}
+
+void test_kalman_reduces_noise() {
+  KalmanFilter<16, 900, 2000> kalman;
+  double inSquares = 0;
+  double outSquares = 0;
+  for (int i = 0; i < 2000; i++) {
+    long in = 50000 + noise(60);
+    long out = kalman.update(in);
+    if (i >= 200) {
+      inSquares += (double)(in - 50000) * (in - 50000);
+      outSquares += (double)(out - 50000) * (out - 50000);
+    }
+  }
+  TEST_ASSERT_LESS_THAN(inSquares / 9, outSquares);
+}
+
+// the fixed point filter against the same filter in double precision, through noise, small
+// steps it follows and large ones it restarts on, on both sides of zero
+void test_kalman_tracks_floating_point() {
+  KalmanFilter<16, 900, 2000> kalman;
+  double estimate = 0;
+  double error = 900;
+  bool primed = false;
+  const long levels[] = { 50000, 50600, 120000, -3000, -4500, 0, 8000000 };
+  long worst = 0;
+  for (size_t level = 0; level < sizeof(levels) / sizeof(levels[0]); level++) {
+    for (int i = 0; i < 300; i++) {
+      long in = levels[level] + noise(60);
+      double innovation = in - estimate;
+      if (!primed || innovation > 2000 || innovation < -2000) {
+        estimate = in;
+        error = 900;
+        primed = true;
+      } else {
+        error += 16;
+        double gain = error / (error + 900);
+        estimate += gain * innovation;
+        error *= 1 - gain;
+      }
+      long diff = labs(kalman.update(in) - lround(estimate));
+      worst = diff > worst ? diff : worst;
+    }
+  }
+  TEST_ASSERT_LESS_OR_EQUAL(1, worst);
+}
+
+// the firmware's chain: a load goes on and the weight is steady within a few samples
+void test_chain_settles_on_load() {
+  FilterChain<MedianFilter<3>, KalmanFilter<16, 900, 2000> > chain;
+  int settled = settleSamples(chain, 8000, 8000 + 250 * 420, 30, 40, 80);
+  TEST_ASSERT_GREATER_THAN(0, settled);
+  TEST_ASSERT_LESS_OR_EQUAL(4, settled);
+}
+
+void test_chain_reset_forgets_history() {
+  FilterChain<MedianFilter<3>, EmaFilter<3> > chain;
+  for (int i = 0; i < 10; i++) {
+    chain.update(7000);
+  }
+  chain.reset();
+  TEST_ASSERT_EQUAL(-300, chain.update(-300));
+}
+
+// Host time per sample for the firmware's chain, as a guard against a stage
+// going quadratic or allocating, not as a figure for the ESP8266.
+void test_chain_time_per_sample() {
+  FilterChain<MedianFilter<3>, KalmanFilter<16, 900, 2000> > chain;
+  const long samples = 200000;
+  volatile long sink = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (long i = 0; i < samples; i++) {
+    sink = chain.update(100000 + noise(40));
+  }
+  double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / samples;
+  (void)sink;
+  char message[64];
+  snprintf(message, sizeof(message), "%.1f ns per sample on the host", ns);
+  TEST_MESSAGE(message);
+  TEST_ASSERT_LESS_THAN(2000, (long)ns);
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_median_drops_single_spike);
+  RUN_TEST(test_median_follows_step_after_half_window);
+  RUN_TEST(test_ema_primes_and_settles);
+  RUN_TEST(test_ema_handles_negative_counts);
+  RUN_TEST(test_kalman_restarts_on_large_step);
+  RUN_TEST(test_kalman_reduces_noise);
+  RUN_TEST(test_kalman_tracks_floating_point);
+  RUN_TEST(test_chain_settles_on_load);
+  RUN_TEST(test_chain_reset_forgets_history);
+  RUN_TEST(test_chain_time_per_sample);
+  return UNITY_END();
+}
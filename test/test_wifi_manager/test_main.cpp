@@ -0,0 +1,124 @@
+// WifiManager timings against a scripted station and a millis() the test moves:
+// one association per session, the connect timeout and the backoff doubling.
+#include "WifiManager.h"
+#include <unity.h>
+#include <vector>
+
+// associates joinMs after begin(), or never when joinMs is 0
+class FakeDriver : public WifiDriver {
+public:
+  unsigned long now = 0;
+  unsigned long joinMs = 0;
+  unsigned long startedAt = 0;
+  bool started = false;
+  bool linkLost = false;
+  int disconnects = 0;
+  std::vector<unsigned long> begins;
+  void begin(const char *, const char *) {
+    begins.push_back(now);
+    startedAt = now;
+    started = true;
+    linkLost = false;
+  }
+  bool connected() { return started && !linkLost && joinMs > 0 && now - startedAt >= joinMs; }
+  void disconnect() {
+    started = false;
+    disconnects++;
+  }
+};
+
+static FakeDriver driver;
+
+// poll() every stepMs until the state is reached or untilMs have gone by
+static bool pollUntil(WifiManager &wifi, WifiManager::State state, unsigned long untilMs, unsigned long stepMs = 10) {
+  unsigned long start = driver.now;
+  while (driver.now - start < untilMs) {
+    if (wifi.poll(driver.now) == state) {
+      return true;
+    }
+    driver.now += stepMs;
+  }
+  return false;
+}
+
+void setUp() {
+  driver = FakeDriver();
+}
+
+void tearDown() {
+}
+
+void test_connects_once() {
+  WifiManager wifi(driver, "ssid", "secret");
+  TEST_ASSERT_EQUAL(WifiManager::IDLE, wifi.state());
+  wifi.begin(driver.now);
+  TEST_ASSERT_EQUAL(WifiManager::CONNECTING, wifi.state());
+  driver.joinMs = 3200;
+  TEST_ASSERT_TRUE(pollUntil(wifi, WifiManager::CONNECTED, 5000));
+  TEST_ASSERT_EQUAL(3200, driver.now);
+  TEST_ASSERT_TRUE(wifi.changed());
+  TEST_ASSERT_TRUE(wifi.connected());
+  // a connected station is left alone however often loop() runs
+  for (int i = 0; i < 10000; i++) {
+    driver.now += 7;
+    wifi.poll(driver.now);
+    TEST_ASSERT_FALSE(wifi.changed());
+  }
+  TEST_ASSERT_EQUAL(1, driver.begins.size());
+  TEST_ASSERT_EQUAL(0, driver.disconnects);
+}
+
+void test_connect_timeout_backs_off() {
+  WifiManager wifi(driver, "ssid", "secret");
+  wifi.begin(driver.now);
+  TEST_ASSERT_TRUE(pollUntil(wifi, WifiManager::BACKOFF, 20000));
+  TEST_ASSERT_EQUAL(WIFI_CONNECT_TIMEOUT_MS, driver.now);
+  TEST_ASSERT_EQUAL(1, driver.disconnects);
+  TEST_ASSERT_TRUE(pollUntil(wifi, WifiManager::CONNECTING, 20000));
+  TEST_ASSERT_EQUAL(WIFI_CONNECT_TIMEOUT_MS + WIFI_BACKOFF_MIN_MS, driver.now);
+  TEST_ASSERT_EQUAL(2, driver.begins.size());
+}
+
+void test_backoff_doubles_up_to_max() {
+  WifiManager wifi(driver, "ssid", "secret");
+  wifi.begin(driver.now);
+  for (int attempt = 0; attempt < 10; attempt++) {
+    pollUntil(wifi, WifiManager::BACKOFF, 20000);
+    pollUntil(wifi, WifiManager::CONNECTING, 70000);
+  }
+  unsigned long backoff = WIFI_BACKOFF_MIN_MS;
+  for (size_t i = 1; i < driver.begins.size(); i++) {
+    TEST_ASSERT_EQUAL(WIFI_CONNECT_TIMEOUT_MS + backoff, driver.begins[i] - driver.begins[i - 1]);
+    backoff = (backoff * 2 > WIFI_BACKOFF_MAX_MS) ? WIFI_BACKOFF_MAX_MS : backoff * 2;
+  }
+  TEST_ASSERT_EQUAL(WIFI_BACKOFF_MAX_MS, backoff);
+}
+
+void test_lost_link_reconnects_after_min_backoff() {
+  WifiManager wifi(driver, "ssid", "secret");
+  wifi.begin(driver.now);
+  // a few failed attempts first so the backoff has grown
+  for (int attempt = 0; attempt < 3; attempt++) {
+    pollUntil(wifi, WifiManager::BACKOFF, 20000);
+    pollUntil(wifi, WifiManager::CONNECTING, 70000);
+  }
+  driver.joinMs = 500;
+  TEST_ASSERT_TRUE(pollUntil(wifi, WifiManager::CONNECTED, 1000));
+  driver.now += 60000;
+  driver.linkLost = true;
+  wifi.poll(driver.now);
+  TEST_ASSERT_EQUAL(WifiManager::BACKOFF, wifi.state());
+  unsigned long lost = driver.now;
+  TEST_ASSERT_TRUE(pollUntil(wifi, WifiManager::CONNECTING, 5000));
+  TEST_ASSERT_EQUAL(WIFI_BACKOFF_MIN_MS, driver.now - lost);
+  TEST_ASSERT_TRUE(pollUntil(wifi, WifiManager::CONNECTED, 1000));
+}
+
+int main() {
+  UNITY_BEGIN();
+  RUN_TEST(test_connects_once);
+  RUN_TEST(test_connect_timeout_backs_off);
+  RUN_TEST(test_backoff_doubles_up_to_max);
+  RUN_TEST(test_lost_link_reconnects_after_min_backoff);
+  return UNITY_END();
+}